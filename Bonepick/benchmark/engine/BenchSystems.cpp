@@ -0,0 +1,359 @@
+#include "benchmark/engine/BenchSystems.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "benchmark/engine/Benchmark.h"
+#include "engine/system/EntityManager.h"
+#include "engine/utility/ThreadPool.h"
+#include "projects/chain/ChainSimulation.h"
+
+namespace
+{
+  //############################################################################
+  struct Position
+  {
+    float x;
+    float y;
+    float z;
+  };
+
+  //############################################################################
+  struct Velocity
+  {
+    float x;
+    float y;
+    float z;
+  };
+
+  //############################################################################
+  struct Health
+  {
+    int value;
+  };
+
+  using BenchManager = EntityManager<Position, Velocity, Health>;
+}
+
+//##############################################################################
+template <>
+struct SpatialPosition<Position>
+{
+  static Vec2 Get(Position const & position)
+  {
+    return Vec2(position.x, position.y);
+  }
+};
+
+namespace
+{
+  int const EntityCounts[] = { 10000, 100000, 1000000 };
+
+  //############################################################################
+  // Enough frames for every run to touch a few million entities.
+  int FramesFor(int entityCount)
+  {
+    return entityCount >= 1000000 ? 3 : 1000000 / entityCount;
+  }
+
+  //############################################################################
+  void SpawnMoving(BenchManager & entMan, int count)
+  {
+    entMan.AddEntities<Position, Velocity>(count,
+      [](int index, Position & position, Velocity & velocity)
+      {
+        position = Position{ float(index), 0.0f, 0.0f };
+        velocity = Velocity{ 0.0f, 1.0f, float(index % 7) };
+      });
+  }
+
+  //############################################################################
+  void BenchBulkSpawn(int entityCount)
+  {
+    int const frameCount = 3;
+
+    //Every frame spawns into its own empty manager, made and torn down
+    //outside of the timed frames
+    {
+      BenchManager entMans[frameCount];
+
+      RunBenchmark("bulk spawn", entityCount, frameCount,
+        [entityCount, &entMans](int frame)
+        {
+          SpawnMoving(entMans[frame], entityCount);
+          entMans[frame].Advance();
+        });
+    }
+
+    Prefab<Position, Velocity> const prefab(Position{ 0.0f, 0.0f, 0.0f },
+      Velocity{ 0.0f, 1.0f, 0.0f });
+
+    {
+      BenchManager entMans[frameCount];
+
+      RunBenchmark("prefab spawn", entityCount, frameCount,
+        [entityCount, &prefab, &entMans](int frame)
+        {
+          entMans[frame].Instantiate(prefab, entityCount);
+          entMans[frame].Advance();
+        });
+    }
+  }
+
+  //############################################################################
+  void BenchSteadyUpdate(int entityCount)
+  {
+    BenchManager entMan;
+    SpawnMoving(entMan, entityCount);
+    entMan.Advance();
+
+    auto const & query = entMan.RegisterQuery<Position, Velocity>();
+
+    RunBenchmark("steady update", entityCount, FramesFor(entityCount),
+      [&entMan, &query](int)
+      {
+        for (int i = 0; i < query.Size(); ++i)
+        {
+          Position const & position = *query.Components<Position>()[i];
+          Velocity const & velocity = *query.Components<Velocity>()[i];
+
+          entMan.SetComponent(query.EntityIds()[i], Position{
+            position.x + velocity.x,
+            position.y + velocity.y,
+            position.z + velocity.z });
+        }
+
+        entMan.Advance();
+      });
+  }
+
+  //############################################################################
+  // Writes every component of every entity, so each commit has the same work.
+  void BenchCommit(int entityCount, ThreadPool * pool)
+  {
+    BenchManager entMan;
+
+    entMan.AddEntities<Position, Velocity, Health>(entityCount,
+      [](int index, Position & position, Velocity & velocity, Health & health)
+      {
+        position = Position{ float(index), 0.0f, 0.0f };
+        velocity = Velocity{ 0.0f, 1.0f, 0.0f };
+        health = Health{ index };
+      });
+
+    entMan.Advance();
+
+    RunBenchmark(pool ? "parallel commit" : "serial commit", entityCount,
+      FramesFor(entityCount),
+      [&entMan, pool](int frame)
+      {
+        for (int i = 0; i < entMan.EntityCount(); ++i)
+        {
+          int const entityId = entMan.GetEntityId(i);
+
+          entMan.SetComponent(entityId, Position{ float(frame), 0.0f, 0.0f });
+          entMan.SetComponent(entityId, Velocity{ 0.0f, float(frame), 0.0f });
+          entMan.SetComponent(entityId, Health{ frame });
+        }
+
+        if (pool)
+          entMan.Advance(*pool);
+        else
+          entMan.Advance();
+      });
+  }
+
+  //############################################################################
+  // Every entity has a position, one in every selectivity has a velocity too.
+  void BenchJoin(int entityCount, int selectivity)
+  {
+    BenchManager entMan;
+
+    entMan.AddEntities<Position>(entityCount,
+      [](int index, Position & position)
+      {
+        position = Position{ float(index), 0.0f, 0.0f };
+      });
+
+    entMan.Advance();
+
+    for (int i = 0; i < entMan.EntityCount(); i += selectivity)
+      entMan.AddComponent(entMan.GetEntityId(i), Velocity{ 1.0f, 0.0f, 0.0f });
+
+    entMan.Advance();
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "join 1/%d selectivity", selectivity);
+
+    RunBenchmark(name, entityCount, FramesFor(entityCount),
+      [&entMan](int)
+      {
+        auto const joined = entMan.GetComponents<Position, Velocity>();
+
+        if (joined.EntityIds().Empty())
+          std::printf("empty join\n");
+      });
+
+    //The first type drives the walk, the sparse type first skips the misses
+    std::snprintf(name, sizeof(name), "query 1/%d selectivity", selectivity);
+
+    RunBenchmark(name, entityCount, FramesFor(entityCount),
+      [&entMan](int)
+      {
+        float sum = 0.0f;
+
+        for (auto [velocity, position] : entMan.Query<Velocity, Position>())
+          sum += velocity.x * position.x;
+
+        if (sum < 0.0f)
+          std::printf("negative query\n");
+      });
+
+    typedef ComponentFilter<TypeList<Position, Velocity>> Filter;
+
+    std::snprintf(name, sizeof(name), "filter 1/%d selectivity", selectivity);
+
+    RunBenchmark(name, entityCount, FramesFor(entityCount),
+      [&entMan](int)
+      {
+        auto const matched = entMan.GetMatchingComponents<Filter>();
+
+        if (matched.EntityIds().Empty())
+          std::printf("empty filter\n");
+      });
+  }
+
+  //############################################################################
+  // Replaces the oldest percent of the entities every frame.
+  void BenchChurn(int entityCount, int percent)
+  {
+    BenchManager entMan;
+
+    int const firstId = entMan.AddEntities<Position, Health>(entityCount,
+      [](int index, Position & position, Health & health)
+      {
+        position = Position{ float(index), 0.0f, 0.0f };
+        health = Health{ 100 };
+      });
+
+    entMan.Advance();
+
+    Array<int> entityIds;
+    entityIds.Reserve(entityCount);
+
+    for (int i = 0; i < entityCount; ++i)
+      entityIds.EmplaceBack(firstId + i);
+
+    int const churned = entityCount * percent / 100;
+    int oldest = 0;
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "churn %d%%", percent);
+
+    RunBenchmark(name, entityCount, FramesFor(entityCount),
+      [&](int frame)
+      {
+        for (int i = 0; i < churned; ++i)
+        {
+          int & entityId = entityIds[(oldest + i) % entityCount];
+
+          entMan.DestroyEntity(entityId);
+          entityId = entMan.AddEntity(Position{ float(frame), 0.0f, 0.0f },
+            Health{ 100 });
+        }
+
+        oldest = (oldest + churned) % entityCount;
+        entMan.Advance();
+      });
+  }
+
+  //############################################################################
+  // Entities drift around a square with about one per cell, every frame moves
+  // all of them and gathers the pairs that touch.
+  void BenchBroadphase(int entityCount)
+  {
+    BenchManager entMan;
+    int const side = int(std::sqrt(float(entityCount)));
+
+    entMan.AddEntities<Position, Velocity>(entityCount,
+      [side](int index, Position & position, Velocity & velocity)
+      {
+        position = Position{ float(index % side), float(index / side), 0.0f };
+        velocity = Velocity{ float(index % 5) * 0.01f - 0.02f,
+          float(index % 3) * 0.01f - 0.01f, 0.0f };
+      });
+
+    entMan.Advance();
+
+    auto const & query = entMan.RegisterQuery<Position, Velocity>();
+    auto const & index = entMan.RegisterSpatialIndex<Position>(1.0f, 256);
+
+    Array<SpatialHash::Pair> pairs;
+
+    RunBenchmark("broadphase", entityCount, FramesFor(entityCount),
+      [&](int)
+      {
+        for (int i = 0; i < query.Size(); ++i)
+        {
+          Position const & position = *query.Components<Position>()[i];
+          Velocity const & velocity = *query.Components<Velocity>()[i];
+
+          entMan.SetComponent(query.EntityIds()[i], Position{
+            position.x + velocity.x,
+            position.y + velocity.y,
+            position.z });
+        }
+
+        entMan.Advance();
+        index.GetHash().QueryPairs(1.0f, &pairs);
+      });
+  }
+
+  //############################################################################
+  // The Chain project's simulation with a scripted control position instead
+  // of the mouse.
+  void BenchChain(int linkCount)
+  {
+    ChainSimulation simulation(linkCount);
+    ThreadPool pool;
+
+    RunBenchmark("chain simulation", linkCount + 1, 100,
+      [&simulation, &pool](int frame)
+      {
+        float const angle = float(frame) * 0.1f;
+
+        simulation.SetControlPosition(
+          Vec2(std::cos(angle) * 0.5f, std::sin(angle) * 0.5f));
+        simulation.Step(pool);
+      });
+  }
+}
+
+//##############################################################################
+void BenchAllSystems(void)
+{
+  for (int entityCount : EntityCounts)
+    BenchBulkSpawn(entityCount);
+
+  for (int entityCount : EntityCounts)
+    BenchSteadyUpdate(entityCount);
+
+  ThreadPool pool;
+
+  for (int entityCount : EntityCounts)
+  {
+    BenchCommit(entityCount, nullptr);
+    BenchCommit(entityCount, &pool);
+  }
+
+  for (int selectivity : { 1, 10, 100 })
+    BenchJoin(100000, selectivity);
+
+  for (int entityCount : EntityCounts)
+    BenchChurn(entityCount, 1);
+
+  for (int entityCount : EntityCounts)
+    BenchBroadphase(entityCount);
+
+  BenchChain(1000);
+}
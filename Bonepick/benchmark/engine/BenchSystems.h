@@ -0,0 +1,7 @@
+#ifndef BENCHMARK_ENGINE_BENCHSYSTEMS_H
+#define BENCHMARK_ENGINE_BENCHSYSTEMS_H
+
+//##############################################################################
+void BenchAllSystems(void);
+
+#endif
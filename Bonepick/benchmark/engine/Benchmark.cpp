@@ -0,0 +1,140 @@
+#include "benchmark/engine/Benchmark.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+//##############################################################################
+namespace
+{
+  std::atomic<u64> allocationCount(0);
+
+  //############################################################################
+  // Returns null instead of throwing, the throwing forms check for it.
+  void * Allocate(std::size_t size, std::size_t alignment)
+  {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    size = size ? size : 1;
+
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+      return std::malloc(size);
+
+#if defined(_MSC_VER)
+    return _aligned_malloc(size, alignment);
+#else
+    //aligned_alloc() wants the size to be a multiple of the alignment
+    return std::aligned_alloc(alignment,
+      (size + alignment - 1) / alignment * alignment);
+#endif
+  }
+
+  //############################################################################
+  void FreeAligned(void * memory)
+  {
+#if defined(_MSC_VER)
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+  }
+}
+
+//##############################################################################
+// Every allocation of the benchmark goes through the replacements below so it
+// can be counted. The array forms call these on their own.
+void * operator new(std::size_t size)
+{
+  if (void * memory = Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__))
+    return memory;
+
+  throw std::bad_alloc();
+}
+
+//##############################################################################
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+  if (void * memory = Allocate(size, std::size_t(alignment)))
+    return memory;
+
+  throw std::bad_alloc();
+}
+
+//##############################################################################
+void * operator new(std::size_t size, std::nothrow_t const &) noexcept
+{
+  return Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+//##############################################################################
+void * operator new(std::size_t size, std::align_val_t alignment,
+  std::nothrow_t const &) noexcept
+{
+  return Allocate(size, std::size_t(alignment));
+}
+
+//##############################################################################
+void operator delete(void * memory) noexcept
+{
+  std::free(memory);
+}
+
+//##############################################################################
+void operator delete(void * memory, std::size_t) noexcept
+{
+  std::free(memory);
+}
+
+//##############################################################################
+void operator delete(void * memory, std::nothrow_t const &) noexcept
+{
+  std::free(memory);
+}
+
+//##############################################################################
+// Alignments up to the default one came from malloc() as well.
+void operator delete(void * memory, std::align_val_t alignment) noexcept
+{
+  if (std::size_t(alignment) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    std::free(memory);
+  else
+    FreeAligned(memory);
+}
+
+//##############################################################################
+void operator delete(void * memory, std::size_t,
+  std::align_val_t alignment) noexcept
+{
+  operator delete(memory, alignment);
+}
+
+//##############################################################################
+void operator delete(void * memory, std::align_val_t alignment,
+  std::nothrow_t const &) noexcept
+{
+  operator delete(memory, alignment);
+}
+
+//##############################################################################
+u64 GetAllocationCount(void)
+{
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+//##############################################################################
+void ReportBenchmark(char const * name, int entityCount, int frameCount,
+  u64 time, u64 allocations)
+{
+  double const entityFrames = double(entityCount) * double(frameCount);
+
+  std::printf("%-32s %8d entities %5d frames %10.2f ns/entity "
+    "%10.1f allocs/frame\n",
+    name, entityCount, frameCount, double(time) / entityFrames,
+    double(allocations) / double(frameCount));
+  std::fflush(stdout);
+}
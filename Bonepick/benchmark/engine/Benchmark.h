@@ -0,0 +1,35 @@
+#ifndef BENCHMARK_ENGINE_BENCHMARK_H
+#define BENCHMARK_ENGINE_BENCHMARK_H
+
+#include "engine/utility/Profiling.h"
+#include "engine/utility/Typedefs.h"
+
+//##############################################################################
+// Calls to operator new since the program started.
+u64 GetAllocationCount(void);
+
+//##############################################################################
+void ReportBenchmark(char const * name, int entityCount, int frameCount,
+  u64 time, u64 allocations);
+
+//##############################################################################
+// Times frameCount calls of frame, which gets the frame index, and reports
+// the time per entity and frame along with the allocations per frame. Setup
+// belongs outside of frame.
+template <typename Function>
+void RunBenchmark(char const * name, int entityCount, int frameCount,
+  Function const & frame)
+{
+  u64 const allocations = GetAllocationCount();
+  ProfileTimer timer;
+
+  for (int i = 0; i < frameCount; ++i)
+    frame(i);
+
+  u64 const time = timer.Lap();
+
+  ReportBenchmark(name, entityCount, frameCount, time,
+    GetAllocationCount() - allocations);
+}
+
+#endif
@@ -0,0 +1,8 @@
+#include "BenchSystems.h"
+
+int main(void)
+{
+  BenchAllSystems();
+
+  return 0;
+}
@@ -0,0 +1,1214 @@
+#ifndef ENGINE_SYSTEM_ARCHETYPEENTITYMANAGER_H
+#define ENGINE_SYSTEM_ARCHETYPEENTITYMANAGER_H
+
+#include <algorithm>
+#include <tuple>
+
+#include "system/ComponentMask.h"
+#include "system/EntityId.h"
+#include "system/EntityManager.h"
+#include "utility/Bitset.h"
+#include "utility/containers/Array.h"
+#include "utility/containers/FixedArray.h"
+#include "utility/containers/SortedArray.h"
+#include "utility/containers/SparseSet.h"
+#include "utility/containers/Tuple.h"
+#include "utility/Debug.h"
+#include "utility/TemplateTools.h"
+#include "utility/Typedefs.h"
+
+//##############################################################################
+static int const ArchetypeChunkBytes = 16 * 1024;
+
+//##############################################################################
+template <typename ... Components>
+struct Archetypes;
+
+template <typename ... Components>
+class Archetype;
+
+//##############################################################################
+// Storage selector for EntityManager. Entities sharing a component set are
+// stored together in fixed size chunks, one contiguous array per component.
+//
+//   EntityManager<Archetypes<Position, Velocity>> manager;
+template <typename ... Components>
+struct Archetypes
+{};
+
+//##############################################################################
+template <typename ... Components>
+class Archetype
+{
+public:
+  Archetype(ComponentMask mask);
+  Archetype(Archetype const &) = default;
+  Archetype(Archetype &&) = default;
+
+  ~Archetype(void) = default;
+
+  ComponentMask Mask(void) const;
+  int Size(void) const;
+
+  int ChunkCapacity(void) const;
+  int ChunkCount(void) const;
+  int ChunkSize(int chunkIndex) const;
+
+  int const * GetChunkEntityIds(int chunkIndex) const;
+
+  template <typename U>
+  U const * GetChunkComponents(int chunkIndex) const;
+
+  int GetEntityId(int row) const;
+
+  template <typename U>
+  U & GetComponent(int row);
+  template <typename U>
+  U const & GetComponent(int row) const;
+
+  int AddRow(int entityId);
+
+  template <typename U>
+  void EmplaceComponent(int row, U && component);
+
+  int RemoveRow(int row);
+
+  Archetype & operator =(Archetype const &) = default;
+  Archetype & operator =(Archetype &&) = default;
+
+private:
+  struct Chunk
+  {
+    FixedArray<int>                        entityIds;
+    UniqueTuple<FixedArray<Components>...> components;
+  };
+
+  template <typename Component, typename ... Remainder>
+  static int GetRowSize(ComponentMask mask,
+    TypeList<Component, Remainder...> const &);
+
+  static int GetRowSize(ComponentMask, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void ReserveChunk(Chunk * chunk, TypeList<Component, Remainder...> const &);
+
+  void ReserveChunk(Chunk *, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void MoveRow(int fromRow, int toRow,
+    TypeList<Component, Remainder...> const &);
+
+  void MoveRow(int, int, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void PopRow(Chunk * chunk, TypeList<Component, Remainder...> const &);
+
+  void PopRow(Chunk *, TypeList<> const &);
+
+  ComponentMask mask_;
+  int           chunkCapacity_;
+  int           size_          = 0;
+  Array<Chunk>  chunks_;
+};
+
+//##############################################################################
+template <typename ... Components>
+class EntityManager<Archetypes<Components...>>
+{
+public:
+  EntityManager(void) = default;
+  EntityManager(EntityManager const &) = default;
+  EntityManager(EntityManager &&) = default;
+
+  ~EntityManager(void) = default;
+
+  template <typename ... EntityComponents>
+  int AddEntity(EntityComponents const & ... components);
+
+  template <typename U>
+  void AddComponent(int entityId, U const & component);
+
+  template <typename U>
+  void RemoveComponent(int entityId);
+
+  int EntityCount(void) const;
+  int GetEntityId(int entityIndex) const;
+
+  template <typename U>
+  int GetEntityId(U const * component) const;
+
+  template <typename U>
+  U const & GetComponent(int entityId) const;
+
+  template <typename U>
+  void SetComponent(int entityId, U const & component);
+
+  template <typename U>
+  U & UpdateComponent(int entityId);
+
+  template <typename ... EntityComponents>
+  ComponentArray<Components ...> GetComponents(void) const;
+
+  template <typename Filter>
+  ComponentArray<Components ...> GetMatchingComponents(void) const;
+
+  template <typename ... EntityComponents, typename Function>
+  void ForEach(Function const & function) const;
+
+  void DestroyEntity(int entityId);
+
+  template <typename U>
+  bool ContainsComponent(int entityId) const;
+
+  bool DoesEntityExist(int entityId) const;
+
+  int ArchetypeCount(void) const;
+
+  void Advance(void);
+
+private:
+  template <typename T>
+  struct FutureData
+  {
+    FutureData(int entityId, T const & component);
+
+    int entityId;
+    T   component;
+  };
+
+  struct EntityLocation
+  {
+    EntityLocation(int archetype, int row);
+
+    int archetype;
+    int row;
+  };
+
+  struct RemovedComponents
+  {
+    RemovedComponents(int entityId, ComponentMask mask);
+
+    int           entityId;
+    ComponentMask mask;
+  };
+
+  struct EntityRow
+  {
+    int entityId;
+    int archetype;
+    int row;
+  };
+
+  int GetNewEntityId(void);
+  int GetArchetypeIndex(ComponentMask mask);
+
+  template <typename Component, typename ... Remainder>
+  void AddComponents(int entityId, Component const & component,
+    Remainder const & ... remainder);
+
+  void AddComponents(int);
+
+  template <typename Component, typename ... Remainder>
+  void CommitWrites(TypeList<Component, Remainder...> const &);
+
+  void CommitWrites(TypeList<> const &);
+
+  void CommitStructuralChanges(void);
+
+  template <typename Component, typename ... Remainder>
+  void GatherChangedEntities(Array<int> * entityIds,
+    TypeList<Component, Remainder...> const &);
+
+  void GatherChangedEntities(Array<int> *, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  ComponentMask GatherAddedComponents(int entityId, Array<int> * cursors,
+    TypeList<Component, Remainder...> const &) const;
+
+  ComponentMask GatherAddedComponents(int, Array<int> *, TypeList<> const &)
+    const;
+
+  template <typename Component, typename ... Remainder>
+  void EmplaceRow(int archetype, int row, EntityLocation const * source,
+    ComponentMask added, Array<int> const & cursors,
+    TypeList<Component, Remainder...> const &);
+
+  void EmplaceRow(int, int, EntityLocation const *, ComponentMask,
+    Array<int> const &, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void ClearNewData(TypeList<Component, Remainder...> const &);
+
+  void ClearNewData(TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  static void AppendRow(ComponentArray<Components...> * compArray,
+    Archetype<Components...> const & archetype, int row,
+    TypeList<Component, Remainder...> const &);
+
+  static void AppendRow(ComponentArray<Components...> *,
+    Archetype<Components...> const &, int, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  static void AppendOptionalRow(ComponentArray<Components...> * compArray,
+    Archetype<Components...> const & archetype, int row,
+    TypeList<Component, Remainder...> const &);
+
+  static void AppendOptionalRow(ComponentArray<Components...> *,
+    Archetype<Components...> const &, int, TypeList<> const &);
+
+  template <typename ... EntityComponents, typename Function>
+  static void ForEachInChunk(Archetype<Components...> const & archetype,
+    int chunkIndex, Function const & function);
+
+  Array<Archetype<Components...>>                   archetypes_;
+  ArrayMap<ComponentMask, int>                      archetypeIndices_;
+  SparseSet<EntityLocation>                         entityLocations_;
+  SortedArray<int>                                  entityIds_;
+  Array<int>                                        newEntityIds_;
+  EntitySlotTable                                   entitySlots_;
+  Array<int>                                        entitiesToDestroy_;
+  Bitset                                            destroyMarks_;
+  UniqueTuple<SparseSet<FutureData<Components>>...> futureData_;
+  UniqueTuple<Array<FutureData<Components>>...>     newData_;
+  Array<RemovedComponents>                          removedData_;
+};
+
+//##############################################################################
+template <typename ... Components>
+Archetype<Components...>::Archetype(ComponentMask mask) :
+  mask_(mask),
+  chunkCapacity_(std::max(1, ArchetypeChunkBytes /
+    (GetRowSize(mask, TypeList<Components...>()) + int(sizeof(int)))))
+{}
+
+//##############################################################################
+template <typename ... Components>
+ComponentMask Archetype<Components...>::Mask(void) const
+{
+  return mask_;
+}
+
+//##############################################################################
+template <typename ... Components>
+int Archetype<Components...>::Size(void) const
+{
+  return size_;
+}
+
+//##############################################################################
+template <typename ... Components>
+int Archetype<Components...>::ChunkCapacity(void) const
+{
+  return chunkCapacity_;
+}
+
+//##############################################################################
+template <typename ... Components>
+int Archetype<Components...>::ChunkCount(void) const
+{
+  return chunks_.Size();
+}
+
+//##############################################################################
+template <typename ... Components>
+int Archetype<Components...>::ChunkSize(int chunkIndex) const
+{
+  return chunks_[chunkIndex].entityIds.Size();
+}
+
+//##############################################################################
+template <typename ... Components>
+int const * Archetype<Components...>::GetChunkEntityIds(int chunkIndex) const
+{
+  return chunks_[chunkIndex].entityIds.Begin();
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+U const * Archetype<Components...>::GetChunkComponents(int chunkIndex) const
+{
+  ON_DEBUG(ComponentMask const bit = ComponentBit<U, Components...>::value;)
+  ASSERT(mask_ & bit);
+
+  return chunks_[chunkIndex].components.Get<FixedArray<U>>().Begin();
+}
+
+//##############################################################################
+template <typename ... Components>
+int Archetype<Components...>::GetEntityId(int row) const
+{
+  ASSERT(row < size_);
+  ASSERT(row >= 0);
+
+  return chunks_[row / chunkCapacity_].entityIds[row % chunkCapacity_];
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+U & Archetype<Components...>::GetComponent(int row)
+{
+  ON_DEBUG(ComponentMask const bit = ComponentBit<U, Components...>::value;)
+  ASSERT(mask_ & bit);
+  ASSERT(row < size_);
+  ASSERT(row >= 0);
+
+  return chunks_[row / chunkCapacity_].components.Get<FixedArray<U>>()[
+    row % chunkCapacity_];
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+U const & Archetype<Components...>::GetComponent(int row) const
+{
+  return const_cast<Archetype *>(this)->GetComponent<U>(row);
+}
+
+//##############################################################################
+template <typename ... Components>
+int Archetype<Components...>::AddRow(int entityId)
+{
+  if (chunks_.Empty() || chunks_.GetBack().entityIds.Full())
+  {
+    chunks_.EmplaceBack();
+    ReserveChunk(&chunks_.GetBack(), TypeList<Components...>());
+  }
+
+  chunks_.GetBack().entityIds.EmplaceBack(entityId);
+
+  return size_++;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+void Archetype<Components...>::EmplaceComponent(int row, U && component)
+{
+  typedef std::decay_t<U> Type;
+
+  ON_DEBUG(ComponentMask const bit = ComponentBit<Type, Components...>::value;)
+  ASSERT(mask_ & bit);
+  ASSERT(row == size_ - 1);
+
+  FixedArray<Type> & components =
+    chunks_[row / chunkCapacity_].components.Get<FixedArray<Type>>();
+
+  ASSERT(components.Size() == row % chunkCapacity_);
+
+  components.EmplaceBack(std::forward<U>(component));
+}
+
+//##############################################################################
+template <typename ... Components>
+int Archetype<Components...>::RemoveRow(int row)
+{
+  ASSERT(row < size_);
+  ASSERT(row >= 0);
+
+  int const lastRow = size_ - 1;
+  int movedEntityId = 0;
+
+  if (row != lastRow)
+  {
+    movedEntityId = GetEntityId(lastRow);
+    chunks_[row / chunkCapacity_].entityIds[row % chunkCapacity_] =
+      movedEntityId;
+
+    MoveRow(lastRow, row, TypeList<Components...>());
+  }
+
+  Chunk & lastChunk = chunks_.GetBack();
+  lastChunk.entityIds.PopBack();
+  PopRow(&lastChunk, TypeList<Components...>());
+
+  if (lastChunk.entityIds.Empty())
+    chunks_.PopBack();
+
+  --size_;
+
+  return movedEntityId;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+int Archetype<Components...>::GetRowSize(ComponentMask mask,
+  TypeList<Component, Remainder...> const &)
+{
+  int const size = (mask & ComponentBit<Component, Components...>::value) ?
+    int(sizeof(Component)) : 0;
+
+  return size + GetRowSize(mask, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+int Archetype<Components...>::GetRowSize(ComponentMask, TypeList<> const &)
+{
+  return 0;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void Archetype<Components...>::ReserveChunk(Chunk * chunk,
+  TypeList<Component, Remainder...> const &)
+{
+  ASSERT(chunk);
+
+  if (mask_ & ComponentBit<Component, Components...>::value)
+  {
+    chunk->components.Get<FixedArray<Component>>() =
+      FixedArray<Component>(chunkCapacity_);
+  }
+
+  ReserveChunk(chunk, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+void Archetype<Components...>::ReserveChunk(Chunk * chunk, TypeList<> const &)
+{
+  chunk->entityIds = FixedArray<int>(chunkCapacity_);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void Archetype<Components...>::MoveRow(int fromRow, int toRow,
+  TypeList<Component, Remainder...> const &)
+{
+  if (mask_ & ComponentBit<Component, Components...>::value)
+  {
+    GetComponent<Component>(toRow) =
+      std::move(GetComponent<Component>(fromRow));
+  }
+
+  MoveRow(fromRow, toRow, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+void Archetype<Components...>::MoveRow(int, int, TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void Archetype<Components...>::PopRow(Chunk * chunk,
+  TypeList<Component, Remainder...> const &)
+{
+  ASSERT(chunk);
+
+  if (mask_ & ComponentBit<Component, Components...>::value)
+    chunk->components.Get<FixedArray<Component>>().PopBack();
+
+  PopRow(chunk, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+void Archetype<Components...>::PopRow(Chunk *, TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename T>
+EntityManager<Archetypes<Components...>>::FutureData<T>::FutureData(
+  int entityId, T const & component) :
+  entityId(entityId),
+  component(component)
+{}
+
+//##############################################################################
+template <typename ... Components>
+EntityManager<Archetypes<Components...>>::EntityLocation::EntityLocation(
+  int archetype, int row) :
+  archetype(archetype),
+  row(row)
+{}
+
+//##############################################################################
+template <typename ... Components>
+EntityManager<Archetypes<Components...>>::RemovedComponents::RemovedComponents(
+  int entityId, ComponentMask mask) :
+  entityId(entityId),
+  mask(mask)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename ... EntityComponents>
+int EntityManager<Archetypes<Components...>>::AddEntity(
+  EntityComponents const & ... components)
+{
+  static_assert(TypeSetIsSubset<
+    TypeSet<EntityComponents...>,
+    TypeSet<Components...>
+  >::value);
+
+  static_assert(sizeof...(EntityComponents) > 0);
+
+  int const entityId = GetNewEntityId();
+
+  AddComponents(entityId, components...);
+
+  return entityId;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+void EntityManager<Archetypes<Components...>>::AddComponent(int entityId,
+  U const & component)
+{
+  AddComponents(entityId, component);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+void EntityManager<Archetypes<Components...>>::RemoveComponent(int entityId)
+{
+  removedData_.EmplaceBack(entityId, ComponentBit<U, Components...>::value);
+}
+
+//##############################################################################
+template <typename ... Components>
+int EntityManager<Archetypes<Components...>>::EntityCount(void) const
+{
+  return entityIds_.Size();
+}
+
+//##############################################################################
+template <typename ... Components>
+int EntityManager<Archetypes<Components...>>::GetEntityId(int entityIndex)
+  const
+{
+  ASSERT(entityIndex < entityIds_.Size());
+  ASSERT(entityIndex >= 0);
+
+  return entityIds_[entityIndex];
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+int EntityManager<Archetypes<Components...>>::GetEntityId(
+  U const * component) const
+{
+  ComponentMask const bit = ComponentBit<U, Components...>::value;
+
+  for (Archetype<Components...> const & archetype : archetypes_)
+  {
+    if (!(archetype.Mask() & bit))
+      continue;
+
+    for (int i = 0; i < archetype.ChunkCount(); ++i)
+    {
+      U const * chunkComponents = archetype.GetChunkComponents<U>(i);
+      int const chunkSize = archetype.ChunkSize(i);
+
+      if (component >= chunkComponents &&
+        component < chunkComponents + chunkSize)
+      {
+        return archetype.GetChunkEntityIds(i)[component - chunkComponents];
+      }
+    }
+  }
+
+  ERROR("Component is not stored in this entity manager");
+  return 0;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+U const & EntityManager<Archetypes<Components...>>::GetComponent(int entityId)
+  const
+{
+  ASSERT(DoesEntityExist(entityId));
+
+  auto const * location = entityLocations_.Find(GetEntityIndex(entityId));
+  ASSERT(location);
+
+  return archetypes_[location->archetype].GetComponent<U>(
+    location->row);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+void EntityManager<Archetypes<Components...>>::SetComponent(int entityId,
+  U const & component)
+{
+  ASSERT(ContainsComponent<U>(entityId));
+
+  SparseSet<FutureData<U>> & futureData =
+    futureData_.Get<SparseSet<FutureData<U>>>();
+
+  ASSERT(!futureData.Contains(GetEntityIndex(entityId)));
+
+  futureData.Emplace(GetEntityIndex(entityId), entityId, component);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+U & EntityManager<Archetypes<Components...>>::UpdateComponent(int entityId)
+{
+  ASSERT(ContainsComponent<U>(entityId));
+
+  SparseSet<FutureData<U>> & futureData =
+    futureData_.Get<SparseSet<FutureData<U>>>();
+
+  if (FutureData<U> * futureComponent =
+    futureData.Find(GetEntityIndex(entityId)))
+  {
+    return futureComponent->component;
+  }
+
+  return futureData.Emplace(GetEntityIndex(entityId), entityId,
+    GetComponent<U>(entityId)).component;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename ... EntityComponents>
+ComponentArray<Components ...>
+  EntityManager<Archetypes<Components...>>::GetComponents(void) const
+{
+  typedef ComponentFilter<TypeList<EntityComponents...>> Filter;
+
+  return GetMatchingComponents<Filter>();
+}
+
+//##############################################################################
+// Components of every entity matching a ComponentFilter, in id order. Whole
+// archetypes are matched against the filter's masks, optional components an
+// archetype lacks are null.
+template <typename ... Components>
+template <typename Filter>
+ComponentArray<Components ...>
+  EntityManager<Archetypes<Components...>>::GetMatchingComponents(void) const
+{
+  typedef ComponentFilterMasks<Filter, Components...> Masks;
+
+  Array<EntityRow> rows;
+
+  for (int i = 0; i < archetypes_.Size(); ++i)
+  {
+    Archetype<Components...> const & archetype = archetypes_[i];
+
+    if (!MatchesComponentMask(archetype.Mask(), Masks::include,
+      Masks::exclude))
+    {
+      continue;
+    }
+
+    for (int j = 0; j < archetype.Size(); ++j)
+      rows.EmplaceBack(EntityRow{ archetype.GetEntityId(j), i, j });
+  }
+
+  std::sort(rows.Begin(), rows.End(),
+    [](EntityRow const & row0, EntityRow const & row1)
+    {
+      return row0.entityId < row1.entityId;
+    });
+
+  ComponentArray<Components ...> result;
+  result.entityIds_.Reserve(rows.Size());
+
+  for (EntityRow const & row : rows)
+  {
+    result.entityIds_.Emplace(row.entityId);
+    AppendRow(&result, archetypes_[row.archetype], row.row,
+      typename Filter::IncludeTypes());
+    AppendOptionalRow(&result, archetypes_[row.archetype], row.row,
+      typename Filter::OptionalTypes());
+  }
+
+  result.initialized_ = true;
+  result.FillWithNulls();
+
+  return result;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename ... EntityComponents, typename Function>
+void EntityManager<Archetypes<Components...>>::ForEach(
+  Function const & function) const
+{
+  ComponentMask const mask =
+    ComponentMaskOf<TypeList<EntityComponents...>, Components...>::value;
+
+  for (Archetype<Components...> const & archetype : archetypes_)
+  {
+    if ((archetype.Mask() & mask) != mask)
+      continue;
+
+    for (int i = 0; i < archetype.ChunkCount(); ++i)
+      ForEachInChunk<EntityComponents...>(archetype, i, function);
+  }
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Archetypes<Components...>>::DestroyEntity(int entityId)
+{
+  ASSERT(DoesEntityExist(entityId));
+
+  int const entityIndex = GetEntityIndex(entityId);
+
+  if (!destroyMarks_.Get(entityIndex))
+  {
+    destroyMarks_.Set(entityIndex);
+    entitiesToDestroy_.EmplaceBack(entityId);
+  }
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+bool EntityManager<Archetypes<Components...>>::ContainsComponent(int entityId)
+  const
+{
+  ASSERT(DoesEntityExist(entityId));
+
+  auto const * location = entityLocations_.Find(GetEntityIndex(entityId));
+
+  return location &&
+    (archetypes_[location->archetype].Mask() &
+      ComponentBit<U, Components...>::value);
+}
+
+//##############################################################################
+template <typename ... Components>
+bool EntityManager<Archetypes<Components...>>::DoesEntityExist(int entityId)
+  const
+{
+  return entitySlots_.IsAlive(entityId);
+}
+
+//##############################################################################
+template <typename ... Components>
+int EntityManager<Archetypes<Components...>>::ArchetypeCount(void) const
+{
+  return archetypes_.Size();
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Archetypes<Components...>>::Advance(void)
+{
+  CommitWrites(TypeList<Components...>());
+  CommitStructuralChanges();
+
+  for (int entityId : entitiesToDestroy_)
+  {
+    auto * location = entityLocations_.Find(GetEntityIndex(entityId));
+    ASSERT(location);
+
+    Archetype<Components...> & archetype =
+      archetypes_[location->archetype];
+
+    int const row = location->row;
+    int const movedEntityId = archetype.RemoveRow(row);
+
+    if (movedEntityId)
+      entityLocations_.Find(GetEntityIndex(movedEntityId))->row = row;
+
+    entityLocations_.Erase(GetEntityIndex(entityId));
+  }
+
+  if (!entitiesToDestroy_.Empty())
+  {
+    entityIds_.EraseIf(
+      [this](int entityId)
+      {
+        return destroyMarks_.Get(GetEntityIndex(entityId));
+      });
+
+    for (int entityId : entitiesToDestroy_)
+      destroyMarks_.Unset(GetEntityIndex(entityId));
+
+    entitySlots_.Release(entitiesToDestroy_.Begin(),
+      entitiesToDestroy_.Size());
+
+    entitiesToDestroy_.Clear();
+  }
+
+  for (int entityId : newEntityIds_)
+    entitySlots_.Activate(entityId);
+
+  //Reused slots carry a newer generation, so new ids aren't always in order
+  if (!std::is_sorted(newEntityIds_.Begin(), newEntityIds_.End()))
+    std::sort(newEntityIds_.Begin(), newEntityIds_.End());
+
+  entityIds_.Merge(newEntityIds_.Begin(), newEntityIds_.Size());
+
+  newEntityIds_.Clear();
+}
+
+//##############################################################################
+template <typename ... Components>
+int EntityManager<Archetypes<Components...>>::GetNewEntityId(void)
+{
+  int const entityId = entitySlots_.Create();
+
+  newEntityIds_.EmplaceBack(entityId);
+
+  return entityId;
+}
+
+//##############################################################################
+template <typename ... Components>
+int EntityManager<Archetypes<Components...>>::GetArchetypeIndex(
+  ComponentMask mask)
+{
+  auto const * index = archetypeIndices_.Find(mask);
+
+  if (index)
+    return index->value;
+
+  archetypeIndices_.Emplace(mask, archetypes_.Size());
+  archetypes_.EmplaceBack(mask);
+
+  return archetypes_.Size() - 1;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Archetypes<Components...>>::AddComponents(int entityId,
+  Component const & component, Remainder const & ... remainder)
+{
+  ASSERT(!entityLocations_.Contains(GetEntityIndex(entityId)) ||
+    !ContainsComponent<Component>(entityId));
+
+  newData_.Get<Array<FutureData<Component>>>().EmplaceBack(entityId,
+    component);
+
+  AddComponents(entityId, remainder...);
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Archetypes<Components...>>::AddComponents(int)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Archetypes<Components...>>::CommitWrites(
+  TypeList<Component, Remainder...> const &)
+{
+  SparseSet<FutureData<Component>> & futureData =
+    futureData_.Get<SparseSet<FutureData<Component>>>();
+
+  for (int i = 0; i < futureData.Size(); ++i)
+  {
+    FutureData<Component> & nextData = futureData.GetValue(i);
+
+    auto const * location = entityLocations_.Find(futureData.GetKey(i));
+    ASSERT(location);
+
+    archetypes_[location->archetype].GetComponent<Component>(
+      location->row) = std::move(nextData.component);
+  }
+
+  futureData.Clear();
+
+  CommitWrites(TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Archetypes<Components...>>::CommitWrites(
+  TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Archetypes<Components...>>::CommitStructuralChanges(void)
+{
+  Array<int> changedEntityIds;
+  GatherChangedEntities(&changedEntityIds, TypeList<Components...>());
+
+  if (changedEntityIds.Empty())
+    return;
+
+  std::sort(changedEntityIds.Begin(), changedEntityIds.End());
+  changedEntityIds.Resize(int(
+    std::unique(changedEntityIds.Begin(), changedEntityIds.End()) -
+    changedEntityIds.Begin()));
+
+  std::stable_sort(removedData_.Begin(), removedData_.End(),
+    [](RemovedComponents const & data0, RemovedComponents const & data1)
+    {
+      return data0.entityId < data1.entityId;
+    });
+
+  Array<int> cursors(0, int(sizeof...(Components)));
+  int removedCursor = 0;
+
+  for (int entityId : changedEntityIds)
+  {
+    ComponentMask removed = 0;
+
+    while (removedCursor < removedData_.Size() &&
+      removedData_[removedCursor].entityId <= entityId)
+    {
+      if (removedData_[removedCursor].entityId == entityId)
+        removed |= removedData_[removedCursor].mask;
+
+      ++removedCursor;
+    }
+
+    ComponentMask const added =
+      GatherAddedComponents(entityId, &cursors, TypeList<Components...>());
+
+    auto * location = entityLocations_.Find(GetEntityIndex(entityId));
+
+    ComponentMask const previous =
+      location ? archetypes_[location->archetype].Mask() : 0;
+    ComponentMask const next = (previous & ~removed) | added;
+
+    if (location && next == previous && !added)
+      continue;
+
+    int const archetypeIndex = GetArchetypeIndex(next);
+    int const row = archetypes_[archetypeIndex].AddRow(entityId);
+
+    EmplaceRow(archetypeIndex, row, location,
+      added, cursors, TypeList<Components...>());
+
+    if (location)
+    {
+      Archetype<Components...> & previousArchetype =
+        archetypes_[location->archetype];
+
+      int const previousRow = location->row;
+      int const movedEntityId = previousArchetype.RemoveRow(previousRow);
+
+      if (movedEntityId)
+        entityLocations_.Find(GetEntityIndex(movedEntityId))->row = previousRow;
+
+      *location = EntityLocation(archetypeIndex, row);
+    }
+    else
+      entityLocations_.Emplace(GetEntityIndex(entityId), archetypeIndex, row);
+  }
+
+  removedData_.Clear();
+  ClearNewData(TypeList<Components...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Archetypes<Components...>>::GatherChangedEntities(
+  Array<int> * entityIds, TypeList<Component, Remainder...> const &)
+{
+  ASSERT(entityIds);
+
+  Array<FutureData<Component>> & newData =
+    newData_.Get<Array<FutureData<Component>>>();
+
+  std::stable_sort(newData.Begin(), newData.End(),
+    [](FutureData<Component> const & data0,
+      FutureData<Component> const & data1)
+    {
+      return data0.entityId < data1.entityId;
+    });
+
+  for (FutureData<Component> const & data : newData)
+    entityIds->EmplaceBack(data.entityId);
+
+  GatherChangedEntities(entityIds, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Archetypes<Components...>>::GatherChangedEntities(
+  Array<int> * entityIds, TypeList<> const &)
+{
+  for (RemovedComponents const & data : removedData_)
+    entityIds->EmplaceBack(data.entityId);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+ComponentMask
+  EntityManager<Archetypes<Components...>>::GatherAddedComponents(
+  int entityId, Array<int> * cursors,
+  TypeList<Component, Remainder...> const &) const
+{
+  ASSERT(cursors);
+
+  Array<FutureData<Component>> const & newData =
+    newData_.Get<Array<FutureData<Component>>>();
+
+  int & cursor = (*cursors)[TypeIndexInTypes<Component, Components...>::value];
+
+  while (cursor < newData.Size() && newData[cursor].entityId < entityId)
+    ++cursor;
+
+  ComponentMask added = 0;
+
+  if (cursor < newData.Size() && newData[cursor].entityId == entityId)
+  {
+    //Last write wins if a component was added more than once
+    while (cursor + 1 < newData.Size() &&
+      newData[cursor + 1].entityId == entityId)
+    {
+      ++cursor;
+    }
+
+    added = ComponentBit<Component, Components...>::value;
+  }
+
+  return added | GatherAddedComponents(entityId, cursors,
+    TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+ComponentMask
+  EntityManager<Archetypes<Components...>>::GatherAddedComponents(int,
+  Array<int> *, TypeList<> const &) const
+{
+  return 0;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Archetypes<Components...>>::EmplaceRow(int archetype,
+  int row, EntityLocation const * source, ComponentMask added,
+  Array<int> const & cursors, TypeList<Component, Remainder...> const &)
+{
+  ComponentMask const bit = ComponentBit<Component, Components...>::value;
+  Archetype<Components...> & destination = archetypes_[archetype];
+
+  if (destination.Mask() & bit)
+  {
+    if (added & bit)
+    {
+      int const cursor =
+        cursors[TypeIndexInTypes<Component, Components...>::value];
+
+      destination.EmplaceComponent(row, std::move(
+        newData_.Get<Array<FutureData<Component>>>()[cursor].component));
+    }
+    else
+    {
+      ASSERT(source);
+
+      destination.EmplaceComponent(row, std::move(
+        archetypes_[source->archetype].GetComponent<Component>(source->row)));
+    }
+  }
+
+  EmplaceRow(archetype, row, source, added, cursors, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Archetypes<Components...>>::EmplaceRow(int, int,
+  EntityLocation const *, ComponentMask, Array<int> const &,
+  TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Archetypes<Components...>>::ClearNewData(
+  TypeList<Component, Remainder...> const &)
+{
+  newData_.Get<Array<FutureData<Component>>>().Clear();
+
+  ClearNewData(TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Archetypes<Components...>>::ClearNewData(
+  TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Archetypes<Components...>>::AppendRow(
+  ComponentArray<Components...> * compArray,
+  Archetype<Components...> const & archetype, int row,
+  TypeList<Component, Remainder...> const &)
+{
+  ASSERT(compArray);
+
+  compArray->components_.Get<Array<Component const *>>().EmplaceBack(
+    &archetype.GetComponent<Component>(row));
+
+  AppendRow(compArray, archetype, row, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Archetypes<Components...>>::AppendRow(
+  ComponentArray<Components...> *, Archetype<Components...> const &, int,
+  TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Archetypes<Components...>>::AppendOptionalRow(
+  ComponentArray<Components...> * compArray,
+  Archetype<Components...> const & archetype, int row,
+  TypeList<Component, Remainder...> const &)
+{
+  ASSERT(compArray);
+
+  ComponentMask const bit = ComponentBit<Component, Components...>::value;
+
+  compArray->components_.Get<Array<Component const *>>().EmplaceBack(
+    (archetype.Mask() & bit) ? &archetype.GetComponent<Component>(row) :
+      nullptr);
+
+  AppendOptionalRow(compArray, archetype, row, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Archetypes<Components...>>::AppendOptionalRow(
+  ComponentArray<Components...> *, Archetype<Components...> const &, int,
+  TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename ... EntityComponents, typename Function>
+void EntityManager<Archetypes<Components...>>::ForEachInChunk(
+  Archetype<Components...> const & archetype, int chunkIndex,
+  Function const & function)
+{
+  int const * entityIds = archetype.GetChunkEntityIds(chunkIndex);
+  int const chunkSize = archetype.ChunkSize(chunkIndex);
+
+  std::tuple<EntityComponents const *...> const components(
+    archetype.GetChunkComponents<EntityComponents>(chunkIndex)...);
+
+  for (int i = 0; i < chunkSize; ++i)
+  {
+    function(entityIds[i],
+      std::get<EntityComponents const *>(components)[i]...);
+  }
+}
+
+#endif
@@ -0,0 +1,116 @@
+#include "system/ComponentChanges.h"
+
+#include <algorithm>
+
+#include "utility/Debug.h"
+
+//##############################################################################
+namespace
+{
+  //############################################################################
+  void AppendIds(Array<int> * ids, Array<int> const & frameIds)
+  {
+    for (int entityId : frameIds)
+      ids->EmplaceBack(entityId);
+  }
+
+  //############################################################################
+  void SortUnique(Array<int> * ids)
+  {
+    std::sort(ids->Begin(), ids->End());
+    ids->Resize(int(std::unique(ids->Begin(), ids->End()) - ids->Begin()));
+  }
+}
+
+//##############################################################################
+ComponentChangeLog::ComponentChangeLog(void)
+{
+  frames_.Resize(ChangeHistoryFrames);
+}
+
+//##############################################################################
+// Starts recording the changes that become visible on the given frame,
+// dropping the oldest frame. Keeps the lists' memory for reuse.
+void ComponentChangeLog::BeginFrame(int frame)
+{
+  ASSERT(frame > frame_);
+
+  frame_ = frame;
+
+  FrameChanges & frameChanges = CurrentFrame();
+  frameChanges.frame = frame;
+  frameChanges.added.Clear();
+  frameChanges.changed.Clear();
+  frameChanges.removed.Clear();
+}
+
+//##############################################################################
+void ComponentChangeLog::AddAdded(int entityId)
+{
+  CurrentFrame().added.EmplaceBack(entityId);
+}
+
+//##############################################################################
+// A range of consecutive ids, as handed out for bulk creation.
+void ComponentChangeLog::AddAdded(int firstEntityId, int count)
+{
+  Array<int> & added = CurrentFrame().added;
+  added.Reserve(added.Size() + count);
+
+  for (int i = 0; i < count; ++i)
+    added.EmplaceBack(firstEntityId + i);
+}
+
+//##############################################################################
+void ComponentChangeLog::AddChanged(int entityId)
+{
+  CurrentFrame().changed.EmplaceBack(entityId);
+}
+
+//##############################################################################
+void ComponentChangeLog::AddRemoved(int entityId)
+{
+  CurrentFrame().removed.EmplaceBack(entityId);
+}
+
+//##############################################################################
+int ComponentChangeLog::OldestFrame(void) const
+{
+  return std::max(0, frame_ - ChangeHistoryFrames);
+}
+
+//##############################################################################
+// Gathers the changes of every frame after sinceFrame.
+void ComponentChangeLog::GetChanges(ComponentChanges * changes,
+  int sinceFrame) const
+{
+  ASSERT(changes);
+  ASSERT(sinceFrame >= OldestFrame(), "Changes are no longer recorded");
+
+  changes->added.Clear();
+  changes->changed.Clear();
+  changes->removed.Clear();
+
+  for (int frame = sinceFrame + 1; frame <= frame_; ++frame)
+  {
+    FrameChanges const & frameChanges =
+      frames_[frame % ChangeHistoryFrames];
+
+    if (frameChanges.frame != frame)
+      continue;
+
+    AppendIds(&changes->added, frameChanges.added);
+    AppendIds(&changes->changed, frameChanges.changed);
+    AppendIds(&changes->removed, frameChanges.removed);
+  }
+
+  SortUnique(&changes->added);
+  SortUnique(&changes->changed);
+  SortUnique(&changes->removed);
+}
+
+//##############################################################################
+ComponentChangeLog::FrameChanges & ComponentChangeLog::CurrentFrame(void)
+{
+  return frames_[frame_ % ChangeHistoryFrames];
+}
@@ -0,0 +1,55 @@
+#ifndef ENGINE_SYSTEM_COMPONENTCHANGES_H
+#define ENGINE_SYSTEM_COMPONENTCHANGES_H
+
+#include "utility/containers/Array.h"
+
+//##############################################################################
+// Frames of component changes each component manager remembers.
+int const ChangeHistoryFrames = 8;
+
+//##############################################################################
+// Entities whose component of one type was added, written or removed over a
+// range of frames. Each list is sorted and holds an entity at most once.
+struct ComponentChanges
+{
+  Array<int> added;
+  Array<int> changed;
+  Array<int> removed;
+};
+
+//##############################################################################
+// Ring of the changes committed by the last ChangeHistoryFrames calls to
+// Advance(), so reacting to them costs the number of changes rather than the
+// number of entities.
+class ComponentChangeLog
+{
+public:
+  ComponentChangeLog(void);
+
+  void BeginFrame(int frame);
+
+  void AddAdded(int entityId);
+  void AddAdded(int firstEntityId, int count);
+  void AddChanged(int entityId);
+  void AddRemoved(int entityId);
+
+  int OldestFrame(void) const;
+
+  void GetChanges(ComponentChanges * changes, int sinceFrame) const;
+
+private:
+  struct FrameChanges
+  {
+    int        frame = -1;
+    Array<int> added;
+    Array<int> changed;
+    Array<int> removed;
+  };
+
+  FrameChanges & CurrentFrame(void);
+
+  Array<FrameChanges> frames_;
+  int                 frame_ = 0;
+};
+
+#endif
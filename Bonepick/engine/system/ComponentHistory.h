@@ -0,0 +1,83 @@
+#ifndef ENGINE_SYSTEM_COMPONENTHISTORY_H
+#define ENGINE_SYSTEM_COMPONENTHISTORY_H
+
+#include "utility/containers/Array.h"
+#include "utility/containers/Optional.h"
+#include "utility/Debug.h"
+
+//##############################################################################
+// Ring of the component values each Advance() replaced, so frames can be
+// undone and redone by writing the values back. Holds one frame per slot,
+// frame n lives in slot n % FrameCount(). Empty when history is disabled.
+template <typename T>
+class ComponentHistory
+{
+public:
+  struct Change
+  {
+    int         entityId;
+    Optional<T> before;
+    Optional<T> after;
+  };
+
+  void SetFrameCount(int frameCount);
+  int FrameCount(void) const;
+
+  Array<Change> & BeginFrame(int frame);
+
+  Array<Change> & GetFrame(int frame);
+  Array<Change> const & GetFrame(int frame) const;
+
+private:
+  Array<Array<Change>> frames_;
+};
+
+//##############################################################################
+template <typename T>
+void ComponentHistory<T>::SetFrameCount(int frameCount)
+{
+  ASSERT(frameCount >= 0);
+
+  frames_.Clear();
+  frames_.Resize(frameCount);
+}
+
+//##############################################################################
+template <typename T>
+int ComponentHistory<T>::FrameCount(void) const
+{
+  return frames_.Size();
+}
+
+//##############################################################################
+// Starts recording the given frame over the oldest one, keeping its memory.
+template <typename T>
+Array<typename ComponentHistory<T>::Change> &
+  ComponentHistory<T>::BeginFrame(int frame)
+{
+  Array<Change> & changes = GetFrame(frame);
+  changes.Clear();
+
+  return changes;
+}
+
+//##############################################################################
+template <typename T>
+Array<typename ComponentHistory<T>::Change> &
+  ComponentHistory<T>::GetFrame(int frame)
+{
+  ASSERT(!frames_.Empty(), "History is disabled");
+  ASSERT(frame >= 0);
+
+  return frames_[frame % frames_.Size()];
+}
+
+//##############################################################################
+template <typename T>
+Array<typename ComponentHistory<T>::Change> const &
+  ComponentHistory<T>::GetFrame(int frame) const
+{
+  return const_cast<ComponentHistory *>(this)->GetFrame(frame);
+}
+
+#endif
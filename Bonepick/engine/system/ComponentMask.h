@@ -0,0 +1,84 @@
+#ifndef ENGINE_SYSTEM_COMPONENTMASK_H
+#define ENGINE_SYSTEM_COMPONENTMASK_H
+
+#include "utility/TemplateTools.h"
+#include "utility/Typedefs.h"
+
+//##############################################################################
+typedef u64 ComponentMask;
+
+//##############################################################################
+template <typename T, typename ... Components>
+struct ComponentBit;
+
+template <typename Types, typename ... Components>
+struct ComponentMaskOf;
+
+template <typename Include, typename Exclude = TypeList<>,
+  typename Optionals = TypeList<>>
+struct ComponentFilter;
+
+template <typename Filter, typename ... Components>
+struct ComponentFilterMasks;
+
+//##############################################################################
+template <typename T, typename ... Components>
+struct ComponentBit
+{
+  static_assert(sizeof...(Components) <= sizeof(ComponentMask) * 8);
+
+  static constexpr ComponentMask value =
+    ComponentMask(1) << TypeIndexInTypes<T, Components...>::value;
+};
+
+//##############################################################################
+template <typename ... Components>
+struct ComponentMaskOf<TypeList<>, Components...>
+{
+  static constexpr ComponentMask value = 0;
+};
+
+//##############################################################################
+template <typename T, typename ... Types, typename ... Components>
+struct ComponentMaskOf<TypeList<T, Types...>, Components...>
+{
+  static constexpr ComponentMask value =
+    ComponentBit<T, Components...>::value |
+    ComponentMaskOf<TypeList<Types...>, Components...>::value;
+};
+
+//##############################################################################
+// Query description: entities need every included component and none of the
+// excluded ones, optional components are read where present.
+template <typename ... Included, typename ... Excluded, typename ... Optionals>
+struct ComponentFilter<TypeList<Included...>, TypeList<Excluded...>,
+  TypeList<Optionals...>>
+{
+  typedef TypeList<Included...>               IncludeTypes;
+  typedef TypeList<Excluded...>               ExcludeTypes;
+  typedef TypeList<Optionals...>              OptionalTypes;
+  typedef TypeList<Included..., Optionals...> ReadTypes;
+};
+
+//##############################################################################
+template <typename Filter, typename ... Components>
+struct ComponentFilterMasks
+{
+  static constexpr ComponentMask include =
+    ComponentMaskOf<typename Filter::IncludeTypes, Components...>::value;
+
+  static constexpr ComponentMask exclude =
+    ComponentMaskOf<typename Filter::ExcludeTypes, Components...>::value;
+
+  static_assert((include & exclude) == 0,
+    "Components can't be both included and excluded");
+};
+
+//##############################################################################
+inline bool MatchesComponentMask(ComponentMask mask, ComponentMask include,
+  ComponentMask exclude)
+{
+  return (mask & include) == include && (mask & exclude) == 0;
+}
+
+#endif
@@ -0,0 +1,152 @@
+#include "system/ComponentProfile.h"
+
+#include "utility/Debug.h"
+
+//##############################################################################
+ComponentProfiler::ComponentProfiler(ComponentProfiler const & profiler) :
+  frames_(profiler.frames_),
+  frameCount_(profiler.frameCount_),
+  joins_(profiler.joins_.load()),
+  joinTime_(profiler.joinTime_.load()),
+  joinedComponents_(profiler.joinedComponents_.load())
+{}
+
+//##############################################################################
+ComponentProfiler & ComponentProfiler::operator =(
+  ComponentProfiler const & profiler)
+{
+  frames_           = profiler.frames_;
+  frameCount_       = profiler.frameCount_;
+  joins_            = profiler.joins_.load();
+  joinTime_         = profiler.joinTime_.load();
+  joinedComponents_ = profiler.joinedComponents_.load();
+
+  return *this;
+}
+
+//##############################################################################
+// The joins made so far go to the frame that was current. Joins before the
+// first Advance() count towards frame 0.
+ComponentFrameProfile & ComponentProfiler::BeginFrame(int frame)
+{
+  if (frameCount_ == 0 && joins_ > 0)
+    PushFrame(0);
+
+  if (frameCount_ > 0)
+  {
+    AddJoins(&frames_[(frameCount_ - 1) % ProfileFrames]);
+
+    joins_            = 0;
+    joinTime_         = 0;
+    joinedComponents_ = 0;
+  }
+
+  return PushFrame(frame);
+}
+
+//##############################################################################
+void ComponentProfiler::AddJoin(u64 time, int joinedComponents)
+{
+  joins_.fetch_add(1, std::memory_order_relaxed);
+  joinTime_.fetch_add(time, std::memory_order_relaxed);
+  joinedComponents_.fetch_add(joinedComponents, std::memory_order_relaxed);
+}
+
+//##############################################################################
+// Oldest frame first. The joins of the current frame are included.
+void ComponentProfiler::GetFrames(Array<ComponentFrameProfile> * frames) const
+{
+  ASSERT(frames);
+
+  frames->Clear();
+  frames->Reserve(frames_.Size() + 1);
+
+  for (int i = frameCount_ - frames_.Size(); i < frameCount_; ++i)
+    frames->EmplaceBack(frames_[i % ProfileFrames]);
+
+  if (joins_ > 0)
+  {
+    if (frames->Empty())
+      frames->EmplaceBack();
+
+    AddJoins(&frames->GetBack());
+  }
+}
+
+//##############################################################################
+void ComponentProfiler::Clear(void)
+{
+  frames_.Clear();
+  frameCount_       = 0;
+  joins_            = 0;
+  joinTime_         = 0;
+  joinedComponents_ = 0;
+}
+
+//##############################################################################
+bool ComponentProfiler::WriteHeader(std::FILE * file)
+{
+  ASSERT(file);
+
+  return std::fprintf(file, "component,frame,commit_ns,destroy_ns,insert_ns,"
+    "writes,adds,destroys,joins,join_ns,joined_components,storage_slots,"
+    "components,holes\n") > 0;
+}
+
+//##############################################################################
+// One comma separated line per frame, holes are the storage slots not holding
+// a component.
+bool ComponentProfiler::Write(std::FILE * file,
+  char const * componentName) const
+{
+  ASSERT(file);
+  ASSERT(componentName);
+
+  Array<ComponentFrameProfile> frames;
+  GetFrames(&frames);
+
+  for (ComponentFrameProfile const & profile : frames)
+  {
+    int const written = std::fprintf(file,
+      "\"%s\",%d,%llu,%llu,%llu,%d,%d,%d,%d,%llu,%d,%d,%d,%d\n",
+      componentName, profile.frame,
+      static_cast<unsigned long long>(profile.commitTime),
+      static_cast<unsigned long long>(profile.destroyTime),
+      static_cast<unsigned long long>(profile.insertTime),
+      profile.writes, profile.adds, profile.destroys, profile.joins,
+      static_cast<unsigned long long>(profile.joinTime),
+      profile.joinedComponents, profile.storageSlots, profile.components,
+      profile.storageSlots - profile.components);
+
+    if (written < 0)
+      return false;
+  }
+
+  return true;
+}
+
+//##############################################################################
+// Overwrites the oldest frame once the ring is full.
+ComponentFrameProfile & ComponentProfiler::PushFrame(int frame)
+{
+  if (frames_.Size() < ProfileFrames)
+    frames_.EmplaceBack();
+
+  ComponentFrameProfile & profile = frames_[frameCount_ % ProfileFrames];
+  profile = ComponentFrameProfile();
+  profile.frame = frame;
+  ++frameCount_;
+
+  return profile;
+}
+
+//##############################################################################
+void ComponentProfiler::AddJoins(ComponentFrameProfile * profile) const
+{
+  ASSERT(profile);
+
+  profile->joins            += joins_.load(std::memory_order_relaxed);
+  profile->joinTime         += joinTime_.load(std::memory_order_relaxed);
+  profile->joinedComponents +=
+    joinedComponents_.load(std::memory_order_relaxed);
+}
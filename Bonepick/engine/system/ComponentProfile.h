@@ -0,0 +1,70 @@
+#ifndef ENGINE_SYSTEM_COMPONENTPROFILE_H
+#define ENGINE_SYSTEM_COMPONENTPROFILE_H
+
+#include <atomic>
+#include <cstdio>
+
+#include "utility/containers/Array.h"
+#include "utility/Typedefs.h"
+
+//##############################################################################
+// Frames each component profiler keeps, older frames are dropped.
+int const ProfileFrames = 1024;
+
+//##############################################################################
+// What one component manager did during a frame: the Advance() that started
+// it, broken into phases, and the joins made while it was current. Times are
+// in nanoseconds.
+struct ComponentFrameProfile
+{
+  int frame            = 0;
+  u64 commitTime       = 0;
+  u64 destroyTime      = 0;
+  u64 insertTime       = 0;
+  int writes           = 0;
+  int adds             = 0;
+  int destroys         = 0;
+  int joins            = 0;
+  u64 joinTime         = 0;
+  int joinedComponents = 0;
+  int storageSlots     = 0;
+  int components       = 0;
+};
+
+//##############################################################################
+// Per frame counters of one component manager, a ring of the last
+// ProfileFrames frames. Joins are counted atomically since they are made
+// through const getters, possibly from several systems at once, and are only
+// added to their frame when the next one begins.
+class ComponentProfiler
+{
+public:
+  ComponentProfiler(void) = default;
+  ComponentProfiler(ComponentProfiler const & profiler);
+
+  ~ComponentProfiler(void) = default;
+
+  ComponentProfiler & operator =(ComponentProfiler const & profiler);
+
+  ComponentFrameProfile & BeginFrame(int frame);
+
+  void AddJoin(u64 time, int joinedComponents);
+
+  void GetFrames(Array<ComponentFrameProfile> * frames) const;
+  void Clear(void);
+
+  static bool WriteHeader(std::FILE * file);
+  bool Write(std::FILE * file, char const * componentName) const;
+
+private:
+  ComponentFrameProfile & PushFrame(int frame);
+  void AddJoins(ComponentFrameProfile * profile) const;
+
+  Array<ComponentFrameProfile> frames_;
+  int                          frameCount_ = 0;
+  std::atomic<int>             joins_{ 0 };
+  std::atomic<u64>             joinTime_{ 0 };
+  std::atomic<int>             joinedComponents_{ 0 };
+};
+
+#endif
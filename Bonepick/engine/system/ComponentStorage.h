@@ -0,0 +1,155 @@
+#ifndef ENGINE_SYSTEM_COMPONENTSTORAGE_H
+#define ENGINE_SYSTEM_COMPONENTSTORAGE_H
+
+#include "utility/Debug.h"
+
+//##############################################################################
+struct SparseStorage;
+struct DoubleBufferedStorage;
+struct TagStorage;
+struct SingletonStorage;
+
+template <typename T>
+struct ComponentStorage;
+
+template <typename T, typename Storage = typename ComponentStorage<T>::type>
+class ComponentManager;
+
+struct JobWriteBuffer;
+class ScopedWriteBuffer;
+
+inline int ActiveWriteBuffer(void const * owner);
+
+//##############################################################################
+// Slots each component manager may visit per Advance() while restoring a dense,
+// id ordered storage layout.
+int const DefaultCompactionBudget = 4096;
+
+//##############################################################################
+// What the incremental storage compaction did during the last Advance().
+struct CompactionStats
+{
+  int movedComponents  = 0;
+  int sortedComponents = 0;
+  int emptySlots       = 0;
+};
+
+//##############################################################################
+// Default storage. Writes are queued as copies and committed on Advance().
+struct SparseStorage
+{};
+
+//##############################################################################
+// Keeps a current and a next copy of every component. Writes go straight into
+// the next copy and Advance() moves them into the current one, so each write
+// is copied once. Parallel jobs must write disjoint entities.
+struct DoubleBufferedStorage
+{};
+
+//##############################################################################
+// For empty marker types. Only membership is stored, as a bit per entity slot
+// and a sorted id list, and all entities share one instance.
+struct TagStorage
+{};
+
+//##############################################################################
+// For world wide values. The value is stored once, outside of any entity, and
+// read and written with GetSingleton() and SetSingleton().
+struct SingletonStorage
+{};
+
+//##############################################################################
+// Selects how a component type is stored. Specialize to change it:
+//
+//   template <>
+//   struct ComponentStorage<Particle>
+//   {
+//     typedef DoubleBufferedStorage type;
+//   };
+template <typename T>
+struct ComponentStorage
+{
+  typedef SparseStorage type;
+};
+
+//##############################################################################
+// Pending write buffer that component writes from this thread go to, and the
+// entity manager whose ParallelForEach job picked it. Buffer zero of no
+// manager everywhere else.
+struct JobWriteBuffer
+{
+  void const * owner = nullptr;
+  int          index = 0;
+};
+
+//##############################################################################
+inline JobWriteBuffer & CurrentJobWriteBuffer(void)
+{
+  thread_local JobWriteBuffer writeBuffer;
+
+  return writeBuffer;
+}
+
+//##############################################################################
+// Index of the write buffer that writes from this thread to the components of
+// the given entity manager go to. A job's buffer index means nothing to any
+// other manager, so jobs may only write to the manager running them.
+inline int ActiveWriteBuffer(void const * owner)
+{
+  JobWriteBuffer const & writeBuffer = CurrentJobWriteBuffer();
+
+  ASSERT(!writeBuffer.owner || writeBuffer.owner == owner,
+    "Jobs can only write to the entity manager running them");
+
+  return writeBuffer.owner == owner ? writeBuffer.index : 0;
+}
+
+//##############################################################################
+inline bool IsWritingFromJob(void)
+{
+  return CurrentJobWriteBuffer().owner != nullptr;
+}
+
+//##############################################################################
+// Points the thread at a job's write buffer until the scope ends, also when
+// the job throws, so the worker thread goes back to the serial buffer.
+class ScopedWriteBuffer
+{
+public:
+  ScopedWriteBuffer(void const * owner, int writeBuffer);
+  ScopedWriteBuffer(ScopedWriteBuffer const &) = delete;
+
+  ~ScopedWriteBuffer(void);
+
+  ScopedWriteBuffer & operator =(ScopedWriteBuffer const &) = delete;
+
+private:
+  JobWriteBuffer previous_;
+};
+
+//##############################################################################
+inline ScopedWriteBuffer::ScopedWriteBuffer(void const * owner,
+  int writeBuffer) :
+  previous_(CurrentJobWriteBuffer())
+{
+  CurrentJobWriteBuffer() = JobWriteBuffer{ owner, writeBuffer };
+}
+
+//##############################################################################
+inline ScopedWriteBuffer::~ScopedWriteBuffer(void)
+{
+  CurrentJobWriteBuffer() = previous_;
+}
+
+//##############################################################################
+// Set while this thread runs a system of a SystemScheduler. Systems run next
+// to each other and share the entity manager's write and command buffers, so
+// they can't start jobs of their own on any pool or advance the manager.
+inline bool & RunningScheduledSystem(void)
+{
+  thread_local bool running = false;
+
+  return running;
+}
+
+#endif
@@ -0,0 +1,894 @@
+#ifndef ENGINE_SYSTEM_DOUBLEBUFFEREDCOMPONENTMANAGER_H
+#define ENGINE_SYSTEM_DOUBLEBUFFEREDCOMPONENTMANAGER_H
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+#include "system/ComponentChanges.h"
+#include "system/ComponentHistory.h"
+#include "system/ComponentProfile.h"
+#include "system/ComponentStorage.h"
+#include "system/EntityId.h"
+#include "utility/containers/Array.h"
+#include "utility/containers/Optional.h"
+#include "utility/containers/SparseSet.h"
+#include "utility/Debug.h"
+#include "utility/Profiling.h"
+#include "utility/Snapshot.h"
+#include "utility/Typedefs.h"
+
+//##############################################################################
+template <typename T>
+class ComponentManager<T, DoubleBufferedStorage>
+{
+public:
+  ComponentManager(void) = default;
+  ComponentManager(ComponentManager const &) = default;
+  ComponentManager(ComponentManager &&) = default;
+
+  ~ComponentManager(void) = default;
+
+  ComponentManager & operator =(ComponentManager const &) = default;
+  ComponentManager & operator =(ComponentManager &&) = default;
+
+  void AddComponent(int entityId, T const & component);
+  void AddComponents(int firstEntityId, T const * components, int count);
+  void FillComponents(int firstEntityId, T const & component, int count);
+
+  T const & GetComponent(int entityId) const;
+  void SetComponent(int entityId, T const & component);
+  T & UpdateComponent(int entityId);
+  void DestroyComponent(int entityId);
+  bool ContainsComponent(int entityId) const;
+
+  int GetEntityId(T const * component) const;
+
+  int ComponentCount(void) const;
+  int GetEntityIdAt(int index) const;
+  T const * GetComponentAt(int index) const;
+  T const * FindComponent(int entityId) const;
+  void PrefetchLookup(int entityId) const;
+
+  int StorageVersion(void) const;
+  Array<int> const & MovedEntityIds(void) const;
+
+  void ReserveWriteBuffers(int bufferCount, void const * owner);
+
+  void SetCompactionBudget(int budget);
+  CompactionStats const & GetCompactionStats(void) const;
+
+  ComponentChangeLog const & GetChangeLog(void) const;
+
+  void SetHistoryFrames(int frameCount);
+
+  void Advance(int frame);
+
+  void Rewind(int frame);
+  void Replay(int frame);
+
+  void GetComponents(Array<T const *> * components, int const * filterIds,
+    int filterCount) const;
+
+  void GetAllComponents(Array<T const *> * components,
+    Array<int> * entityIds) const;
+
+  void SaveSnapshot(SnapshotWriter * writer) const;
+  bool LoadSnapshot(SnapshotReader * reader);
+
+#if PROFILING_ENABLED
+  ComponentProfiler & GetProfiler(void) const;
+#endif
+
+private:
+  struct NewData
+  {
+    NewData(int entityId, T const & component);
+
+    int entityId;
+    T   component;
+  };
+
+  typedef typename ComponentHistory<T>::Change HistoryChange;
+
+  int const * FindComponentId(int entityId) const;
+  T & MarkWritten(int componentId);
+  Array<int> & GetWrittenSlots(void);
+
+  void CommitWrites(void);
+
+  bool HasPendingChanges(void) const;
+
+  void BeginHistoryFrame(int frame);
+  void EndHistoryFrame(int frame);
+  void RestoreComponent(int entityId, Optional<T> const & component);
+  void FinishRestore(int lowestChangedIndex);
+
+  int PopEmptySlot(void);
+  void Compact(int lowestChangedIndex);
+
+  Array<Optional<T>>  current_;
+  Array<Optional<T>>  next_;
+  Array<byte>         written_;
+  Array<Array<int>>   writtenSlots_;
+  void const *        writeBufferOwner_ = nullptr;
+  Array<int>          entityIds_;
+  Array<NewData>      newData_;
+  Array<int>          entitiesToDestroy_;
+  Array<byte>         destroyMarks_;
+  Array<int>          emptyComponentSlots_;
+  SparseSet<int>      componentIds_;
+  Array<int>          movedEntityIds_;
+  int                 storageVersion_   = 0;
+  int                 compactionBudget_ = DefaultCompactionBudget;
+  int                 sortedCount_      = 0;
+  CompactionStats     compactionStats_;
+  ComponentChangeLog  changeLog_;
+  ComponentHistory<T> history_;
+#if PROFILING_ENABLED
+  mutable ComponentProfiler profiler_;
+#endif
+};
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::AddComponent(int entityId,
+  T const & component)
+{
+  ASSERT(!componentIds_.Contains(GetEntityIndex(entityId)));
+  newData_.EmplaceBack(entityId, component);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::AddComponents(
+  int firstEntityId, T const * components, int count)
+{
+  newData_.Reserve(newData_.Size() + count);
+
+  for (int i = 0; i < count; ++i)
+  {
+    ASSERT(!componentIds_.Contains(GetEntityIndex(firstEntityId + i)));
+    newData_.EmplaceBack(firstEntityId + i, components[i]);
+  }
+}
+
+//##############################################################################
+// Both copies are written per entity on Advance() anyway, so a fill is just
+// the same component added count times.
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::FillComponents(
+  int firstEntityId, T const & component, int count)
+{
+  newData_.Reserve(newData_.Size() + count);
+
+  for (int i = 0; i < count; ++i)
+  {
+    ASSERT(!componentIds_.Contains(GetEntityIndex(firstEntityId + i)));
+    newData_.EmplaceBack(firstEntityId + i, component);
+  }
+}
+
+//##############################################################################
+template <typename T>
+T const &
+  ComponentManager<T, DoubleBufferedStorage>::GetComponent(int entityId) const
+{
+  int const * componentId = FindComponentId(entityId);
+  ASSERT(componentId);
+
+  return *current_[*componentId];
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::SetComponent(int entityId,
+  T const & component)
+{
+  int const * componentId = FindComponentId(entityId);
+  ASSERT(componentId);
+
+  MarkWritten(*componentId) = component;
+}
+
+//##############################################################################
+template <typename T>
+T & ComponentManager<T, DoubleBufferedStorage>::UpdateComponent(int entityId)
+{
+  int const * componentId = FindComponentId(entityId);
+  ASSERT(componentId);
+
+  if (written_[*componentId])
+    return *next_[*componentId];
+
+  T & component = MarkWritten(*componentId);
+
+  if constexpr(std::is_default_constructible_v<T>)
+    component = T();
+  else
+    component = *current_[*componentId];
+
+  return component;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::DestroyComponent(int entityId)
+{
+  if (int const * componentId = FindComponentId(entityId))
+  {
+    if (!destroyMarks_[*componentId])
+    {
+      destroyMarks_[*componentId] = byte(1);
+      entitiesToDestroy_.EmplaceBack(entityId);
+    }
+  }
+}
+
+//##############################################################################
+template <typename T>
+bool ComponentManager<T, DoubleBufferedStorage>::ContainsComponent(
+  int entityId) const
+{
+  return FindComponentId(entityId) != nullptr;
+}
+
+//##############################################################################
+template <typename T>
+int ComponentManager<T, DoubleBufferedStorage>::GetEntityId(
+  T const * component) const
+{
+  int const entityIndex = current_.GetIndex(component);
+  return entityIds_[entityIndex];
+}
+
+//##############################################################################
+// Indices follow slot order, the same order GetAllComponents() uses.
+template <typename T>
+int ComponentManager<T, DoubleBufferedStorage>::ComponentCount(void) const
+{
+  return componentIds_.Size();
+}
+
+//##############################################################################
+template <typename T>
+int ComponentManager<T, DoubleBufferedStorage>::GetEntityIdAt(int index) const
+{
+  ASSERT(componentIds_.IsSorted());
+
+  return entityIds_[componentIds_.GetValue(index)];
+}
+
+//##############################################################################
+template <typename T>
+T const *
+  ComponentManager<T, DoubleBufferedStorage>::GetComponentAt(int index) const
+{
+  ASSERT(componentIds_.IsSorted());
+
+  return current_[componentIds_.GetValue(index)].Ptr();
+}
+
+//##############################################################################
+template <typename T>
+T const *
+  ComponentManager<T, DoubleBufferedStorage>::FindComponent(int entityId) const
+{
+  int const * componentId = FindComponentId(entityId);
+
+  return componentId ? current_[*componentId].Ptr() : nullptr;
+}
+
+//##############################################################################
+template <typename T>
+void
+  ComponentManager<T, DoubleBufferedStorage>::PrefetchLookup(int entityId) const
+{
+  componentIds_.Prefetch(GetEntityIndex(entityId));
+}
+
+//##############################################################################
+template <typename T>
+int ComponentManager<T, DoubleBufferedStorage>::StorageVersion(void) const
+{
+  return storageVersion_;
+}
+
+//##############################################################################
+template <typename T>
+Array<int> const &
+  ComponentManager<T, DoubleBufferedStorage>::MovedEntityIds(void) const
+{
+  return movedEntityIds_;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::ReserveWriteBuffers(
+  int bufferCount, void const * owner)
+{
+  if (writtenSlots_.Size() < bufferCount)
+    writtenSlots_.Resize(bufferCount);
+
+  writeBufferOwner_ = owner;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::SetCompactionBudget(
+  int budget)
+{
+  ASSERT(budget >= 0);
+
+  compactionBudget_ = budget;
+}
+
+//##############################################################################
+template <typename T>
+CompactionStats const &
+  ComponentManager<T, DoubleBufferedStorage>::GetCompactionStats(void) const
+{
+  return compactionStats_;
+}
+
+//##############################################################################
+template <typename T>
+ComponentChangeLog const &
+  ComponentManager<T, DoubleBufferedStorage>::GetChangeLog(void) const
+{
+  return changeLog_;
+}
+
+#if PROFILING_ENABLED
+//##############################################################################
+template <typename T>
+ComponentProfiler &
+  ComponentManager<T, DoubleBufferedStorage>::GetProfiler(void) const
+{
+  return profiler_;
+}
+#endif
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::SetHistoryFrames(
+  int frameCount)
+{
+  history_.SetFrameCount(frameCount);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::Advance(int frame)
+{
+  Optional<T> const * const oldStorage = current_.Begin();
+  int lowestChangedIndex = EntityIndexMask + 1;
+
+  changeLog_.BeginFrame(frame);
+
+  if (history_.FrameCount() > 0)
+    BeginHistoryFrame(frame);
+
+#if PROFILING_ENABLED
+  ComponentFrameProfile & profile = profiler_.BeginFrame(frame);
+  ProfileTimer timer;
+
+  for (Array<int> const & writtenSlots : writtenSlots_)
+    profile.writes += writtenSlots.Size();
+#endif
+
+  CommitWrites();
+
+  ON_PROFILING(profile.commitTime = timer.Lap();)
+
+  if (!entitiesToDestroy_.Empty())
+  {
+    for (int entityId : entitiesToDestroy_)
+    {
+      int const * const found = FindComponentId(entityId);
+      ASSERT(found);
+
+      int const componentId = *found;
+      lowestChangedIndex =
+        std::min(lowestChangedIndex, GetEntityIndex(entityId));
+      changeLog_.AddRemoved(entityId);
+      current_[componentId].Clear();
+      next_[componentId].Clear();
+      entityIds_[componentId] = 0;
+      destroyMarks_[componentId] = byte(0);
+      emptyComponentSlots_.EmplaceBack(componentId);
+    }
+
+    componentIds_.EraseIf(
+      [this](int, int componentId)
+      {
+        return entityIds_[componentId] == 0;
+      });
+
+    ON_PROFILING(profile.destroys = entitiesToDestroy_.Size();)
+    entitiesToDestroy_.Clear();
+  }
+
+  ON_PROFILING(profile.destroyTime = timer.Lap();)
+
+  int const slotsNeeded = newData_.Size() - emptyComponentSlots_.Size();
+
+  if (slotsNeeded > 0)
+  {
+    current_.Reserve(current_.Size() + slotsNeeded);
+    next_.Reserve(next_.Size() + slotsNeeded);
+    written_.Reserve(written_.Size() + slotsNeeded);
+    destroyMarks_.Reserve(destroyMarks_.Size() + slotsNeeded);
+    entityIds_.Reserve(entityIds_.Size() + slotsNeeded);
+    componentIds_.Reserve(componentIds_.Size() + newData_.Size());
+  }
+
+  for (NewData const & newData : newData_)
+  {
+    lowestChangedIndex =
+      std::min(lowestChangedIndex, GetEntityIndex(newData.entityId));
+    changeLog_.AddAdded(newData.entityId);
+
+    int const componentId = PopEmptySlot();
+
+    if (componentId >= 0)
+    {
+      ASSERT(current_[componentId].Ptr() == nullptr);
+
+      entityIds_[componentId] = newData.entityId;
+      current_[componentId].Emplace(newData.component);
+      next_[componentId].Emplace(newData.component);
+      componentIds_.Emplace(GetEntityIndex(newData.entityId), componentId);
+    }
+    else
+    {
+      componentIds_.Emplace(GetEntityIndex(newData.entityId),
+        current_.Size());
+      entityIds_.EmplaceBack(newData.entityId);
+      current_.EmplaceBack(newData.component);
+      next_.EmplaceBack(newData.component);
+      written_.EmplaceBack(byte(0));
+      destroyMarks_.EmplaceBack(byte(0));
+    }
+  }
+
+  ON_PROFILING(profile.adds = newData_.Size();)
+  newData_.Clear();
+
+  ON_PROFILING(profile.insertTime = timer.Lap();)
+
+  componentIds_.Sort();
+
+  Compact(lowestChangedIndex);
+
+  if (history_.FrameCount() > 0)
+    EndHistoryFrame(frame);
+
+  ON_PROFILING(profile.storageSlots = current_.Size();)
+  ON_PROFILING(profile.components = componentIds_.Size();)
+
+  //Growing the buffers moves every component, compaction lists what it moved
+  if (current_.Begin() != oldStorage)
+    ++storageVersion_;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::Rewind(int frame)
+{
+  ASSERT(!HasPendingChanges(), "Can't rewind over pending changes");
+
+  Array<HistoryChange> const & changes = history_.GetFrame(frame);
+  int lowestChangedIndex = EntityIndexMask + 1;
+
+  for (int i = changes.Size() - 1; i >= 0; --i)
+  {
+    RestoreComponent(changes[i].entityId, changes[i].before);
+    lowestChangedIndex =
+      std::min(lowestChangedIndex, GetEntityIndex(changes[i].entityId));
+  }
+
+  FinishRestore(lowestChangedIndex);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::Replay(int frame)
+{
+  ASSERT(!HasPendingChanges(), "Can't replay over pending changes");
+
+  Array<HistoryChange> const & changes = history_.GetFrame(frame);
+  int lowestChangedIndex = EntityIndexMask + 1;
+
+  for (HistoryChange const & change : changes)
+  {
+    RestoreComponent(change.entityId, change.after);
+    lowestChangedIndex =
+      std::min(lowestChangedIndex, GetEntityIndex(change.entityId));
+  }
+
+  FinishRestore(lowestChangedIndex);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::GetComponents(
+  Array<T const *> * components, int const * filterIds, int filterCount) const
+{
+  ASSERT(components);
+
+  components->Clear();
+  components->Resize(filterCount);
+
+  for (int i = 0; i < filterCount; ++i)
+  {
+    int const * componentId = FindComponentId(filterIds[i]);
+
+    if (componentId)
+      (*components)[i] = current_[*componentId].Ptr();
+  }
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::GetAllComponents(
+  Array<T const *> * components, Array<int> * entityIds) const
+{
+  ASSERT(components);
+  ASSERT(entityIds);
+
+  components->Clear();
+  components->Reserve(componentIds_.Size());
+  entityIds->Clear();
+  entityIds->Reserve(componentIds_.Size());
+
+  ASSERT(componentIds_.IsSorted());
+
+  for (int i = 0; i < componentIds_.Size(); ++i)
+  {
+    entityIds->EmplaceBack(entityIds_[componentIds_.GetValue(i)]);
+    components->EmplaceBack(current_[componentIds_.GetValue(i)].Ptr());
+  }
+}
+
+//##############################################################################
+template <typename T>
+int const * ComponentManager<T, DoubleBufferedStorage>::FindComponentId(
+  int entityId) const
+{
+  int const * componentId = componentIds_.Find(GetEntityIndex(entityId));
+
+  if (componentId && entityIds_[*componentId] == entityId)
+    return componentId;
+  else
+    return nullptr;
+}
+
+//##############################################################################
+// Only the current copy is written, the next copy is rebuilt from it on load.
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::SaveSnapshot(
+  SnapshotWriter * writer) const
+{
+  ASSERT(writer);
+
+  writer->AddArray(current_);
+  writer->AddArray(entityIds_);
+  writer->AddArray(emptyComponentSlots_);
+  writer->AddArray(componentIds_.Keys(), componentIds_.Size());
+  writer->AddArray(componentIds_.Values(), componentIds_.Size());
+}
+
+//##############################################################################
+template <typename T>
+bool ComponentManager<T, DoubleBufferedStorage>::LoadSnapshot(
+  SnapshotReader * reader)
+{
+  ASSERT(reader);
+
+  Array<Optional<T>> current;
+  Array<int>         entityIds;
+  Array<int>         emptyComponentSlots;
+  Array<int>         keys;
+  Array<int>         values;
+
+  if (!reader->ReadArray(&current) || !reader->ReadArray(&entityIds) ||
+    !reader->ReadArray(&emptyComponentSlots) || !reader->ReadArray(&keys) ||
+    !reader->ReadArray(&values))
+  {
+    return false;
+  }
+
+  if (current.Size() != entityIds.Size() || keys.Size() != values.Size())
+    return false;
+
+  current_             = std::move(current);
+  next_                = current_;
+  written_             = Array<byte>(byte(0), current_.Size());
+  destroyMarks_        = Array<byte>(byte(0), current_.Size());
+  entityIds_           = std::move(entityIds);
+  emptyComponentSlots_ = std::move(emptyComponentSlots);
+
+  componentIds_.Assign(keys.Begin(), values.Begin(), keys.Size());
+
+  newData_.Clear();
+  entitiesToDestroy_.Clear();
+
+  for (Array<int> & writtenSlots : writtenSlots_)
+    writtenSlots.Clear();
+
+  ++storageVersion_;
+  sortedCount_     = 0;
+  compactionStats_ = CompactionStats();
+  changeLog_       = ComponentChangeLog();
+
+  return true;
+}
+
+//##############################################################################
+template <typename T>
+bool ComponentManager<T, DoubleBufferedStorage>::HasPendingChanges(void) const
+{
+  for (Array<int> const & writtenSlots : writtenSlots_)
+  {
+    if (!writtenSlots.Empty())
+      return true;
+  }
+
+  return !newData_.Empty() || !entitiesToDestroy_.Empty();
+}
+
+//##############################################################################
+// Written slots still hold the committed component in current_, so the values
+// are taken from there before CommitWrites() moves the writes over.
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::BeginHistoryFrame(int frame)
+{
+  Array<int> touchedIds;
+
+  for (Array<int> const & writtenSlots : writtenSlots_)
+  {
+    for (int componentId : writtenSlots)
+      touchedIds.EmplaceBack(entityIds_[componentId]);
+  }
+
+  for (int entityId : entitiesToDestroy_)
+    touchedIds.EmplaceBack(entityId);
+
+  for (NewData const & newData : newData_)
+    touchedIds.EmplaceBack(newData.entityId);
+
+  std::sort(touchedIds.Begin(), touchedIds.End());
+  touchedIds.Resize(int(
+    std::unique(touchedIds.Begin(), touchedIds.End()) - touchedIds.Begin()));
+
+  Array<HistoryChange> & changes = history_.BeginFrame(frame);
+  changes.Reserve(touchedIds.Size());
+
+  for (int entityId : touchedIds)
+  {
+    int const * const found = FindComponentId(entityId);
+
+    changes.EmplaceBack(HistoryChange{ entityId,
+      found ? current_[*found] : Optional<T>(), Optional<T>() });
+  }
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::EndHistoryFrame(int frame)
+{
+  for (HistoryChange & change : history_.GetFrame(frame))
+  {
+    if (int const * const found = FindComponentId(change.entityId))
+      change.after = current_[*found];
+  }
+}
+
+//##############################################################################
+// Writes both copies, nothing is pending while frames are restored.
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::RestoreComponent(
+  int entityId, Optional<T> const & component)
+{
+  int const * const found = FindComponentId(entityId);
+
+  if (found && component.Ptr())
+  {
+    current_[*found] = component;
+    next_[*found] = component;
+  }
+  else if (found)
+  {
+    int const componentId = *found;
+
+    current_[componentId].Clear();
+    next_[componentId].Clear();
+    entityIds_[componentId] = 0;
+    emptyComponentSlots_.EmplaceBack(componentId);
+    componentIds_.Erase(GetEntityIndex(entityId));
+  }
+  else if (component.Ptr())
+  {
+    int componentId = PopEmptySlot();
+
+    if (componentId >= 0)
+    {
+      entityIds_[componentId] = entityId;
+      current_[componentId] = component;
+      next_[componentId] = component;
+    }
+    else
+    {
+      componentId = current_.Size();
+      entityIds_.EmplaceBack(entityId);
+      current_.EmplaceBack(component);
+      next_.EmplaceBack(component);
+      written_.EmplaceBack(byte(0));
+      destroyMarks_.EmplaceBack(byte(0));
+    }
+
+    componentIds_.Emplace(GetEntityIndex(entityId), componentId);
+  }
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::FinishRestore(
+  int lowestChangedIndex)
+{
+  componentIds_.Sort();
+
+  Compact(lowestChangedIndex);
+
+  ++storageVersion_;
+  changeLog_ = ComponentChangeLog();
+}
+
+//##############################################################################
+template <typename T>
+T & ComponentManager<T, DoubleBufferedStorage>::MarkWritten(int componentId)
+{
+  ASSERT(componentId >= 0);
+  ASSERT(componentId < current_.Size());
+  ASSERT(!written_[componentId], "Component was already set this frame");
+
+  written_[componentId] = byte(1);
+  GetWrittenSlots().EmplaceBack(componentId);
+
+  return *next_[componentId];
+}
+
+//##############################################################################
+template <typename T>
+Array<int> & ComponentManager<T, DoubleBufferedStorage>::GetWrittenSlots(void)
+{
+  int const writeBuffer = ActiveWriteBuffer(writeBufferOwner_);
+
+  if (writtenSlots_.Empty())
+    writtenSlots_.Resize(1);
+
+  ASSERT(writeBuffer < writtenSlots_.Size());
+
+  return writtenSlots_[writeBuffer];
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::CommitWrites(void)
+{
+  //Written components are moved over instead of swapping the buffers, so the
+  //committed components stay where cached queries point
+  for (Array<int> & writtenSlots : writtenSlots_)
+  {
+    for (int componentId : writtenSlots)
+    {
+      *current_[componentId] = std::move(*next_[componentId]);
+      written_[componentId] = byte(0);
+
+      if (!destroyMarks_[componentId])
+        changeLog_.AddChanged(entityIds_[componentId]);
+    }
+
+    writtenSlots.Clear();
+  }
+}
+
+//##############################################################################
+template <typename T>
+int ComponentManager<T, DoubleBufferedStorage>::PopEmptySlot(void)
+{
+  while (!emptyComponentSlots_.Empty())
+  {
+    int const componentId = emptyComponentSlots_.GetBack();
+    emptyComponentSlots_.PopBack();
+
+    if (entityIds_[componentId] == 0)
+      return componentId;
+  }
+
+  return -1;
+}
+
+//##############################################################################
+// Same incremental pass as the sparse storage, moving both copies. Runs after
+// the writes were committed, so no slot is marked written.
+template <typename T>
+void ComponentManager<T, DoubleBufferedStorage>::Compact(
+  int lowestChangedIndex)
+{
+  ASSERT(componentIds_.IsSorted());
+
+  int const * keys = componentIds_.Keys();
+  int const changedRank = int(std::lower_bound(keys,
+    keys + componentIds_.Size(), lowestChangedIndex) - keys);
+
+  sortedCount_ = std::min(sortedCount_, changedRank);
+  compactionStats_.movedComponents = 0;
+  movedEntityIds_.Clear();
+
+  for (int budget = compactionBudget_;
+    budget > 0 && sortedCount_ < componentIds_.Size(); --budget)
+  {
+    int const target = sortedCount_++;
+    int & componentId = componentIds_.GetValue(target);
+
+    if (componentId == target)
+      continue;
+
+    int const occupantId = entityIds_[target];
+
+    std::swap(current_[target], current_[componentId]);
+    std::swap(next_[target], next_[componentId]);
+    std::swap(entityIds_[target], entityIds_[componentId]);
+    movedEntityIds_.EmplaceBack(entityIds_[target]);
+
+    if (occupantId)
+    {
+      *componentIds_.Find(GetEntityIndex(occupantId)) = componentId;
+      movedEntityIds_.EmplaceBack(occupantId);
+    }
+    else
+      emptyComponentSlots_.EmplaceBack(componentId);
+
+    componentId = target;
+    ++compactionStats_.movedComponents;
+  }
+
+  if (sortedCount_ == componentIds_.Size())
+  {
+    while (current_.Size() > sortedCount_)
+    {
+      current_.PopBack();
+      next_.PopBack();
+      written_.PopBack();
+      destroyMarks_.PopBack();
+      entityIds_.PopBack();
+    }
+
+    emptyComponentSlots_.Clear();
+  }
+  else if (emptyComponentSlots_.Size() > current_.Size())
+  {
+    emptyComponentSlots_.Clear();
+
+    for (int i = current_.Size() - 1; i >= 0; --i)
+    {
+      if (entityIds_[i] == 0)
+        emptyComponentSlots_.EmplaceBack(i);
+    }
+  }
+
+  compactionStats_.sortedComponents = sortedCount_;
+  compactionStats_.emptySlots = current_.Size() - componentIds_.Size();
+}
+
+//##############################################################################
+template <typename T>
+ComponentManager<T, DoubleBufferedStorage>::NewData::NewData(int entityId,
+  T const & component) :
+  entityId(entityId),
+  component(component)
+{}
+
+#endif
@@ -4,12 +4,18 @@
 #include "system/EntityManager.h"
 
 //##############################################################################
+// Entity id bound to its manager. The id keeps the generation of its slot, so
+// an Entity outliving the entity it refers to is detected instead of reading
+// whatever reused the slot.
 template <typename ... Components>
 class Entity
 {
 public:
   Entity(EntityManager<Components ...> & entityManager, int entityId);
 
+  int GetId(void) const;
+  bool IsValid(void) const;
+
   template <typename T>
   T const & GetComponent(void) const;
 
@@ -30,11 +36,27 @@ Entity<Components...>::Entity(
   entityId_(entityId)
 {}
 
+//##############################################################################
+template <typename ... Components>
+int Entity<Components...>::GetId(void) const
+{
+  return entityId_;
+}
+
+//##############################################################################
+template <typename ... Components>
+bool Entity<Components...>::IsValid(void) const
+{
+  return entityManager_.DoesEntityExist(entityId_);
+}
+
 //##############################################################################
 template <typename ... Components>
 template <typename T>
 T const & Entity<Components...>::GetComponent(void) const
 {
+  ASSERT(IsValid(), "Entity was destroyed");
+
   return entityManager_.GetComponent<T>(entityId_);
 }
 
@@ -0,0 +1,289 @@
+#include "system/EntityId.h"
+
+#include <algorithm>
+
+#include "utility/Snapshot.h"
+
+//##############################################################################
+EntitySlotTable::EntitySlotTable(void) :
+  generations_(0, 1),
+  alive_(byte(0), 1)
+{}
+
+//##############################################################################
+// Reuses the free slot with the highest index, or takes a new one.
+int EntitySlotTable::Create(void)
+{
+  if (freeSlots_.Empty())
+    return TakeNewSlots(1, 0);
+
+  int const entityIndex = freeSlots_.GetBack();
+  freeSlots_.PopBack();
+
+  return MakeEntityId(entityIndex, generations_[entityIndex]);
+}
+
+//##############################################################################
+// Takes count slots with contiguous ids. That needs consecutive slots of the
+// same generation, so the lowest run of free slots that fits is reused. A run
+// at the end of the table is extended with new slots, only after that are all
+// count slots new.
+int EntitySlotTable::CreateRange(int count)
+{
+  ASSERT(count > 0);
+
+  int runStart = 0;
+
+  for (int i = 0; i < freeSlots_.Size(); ++i)
+  {
+    if (i > runStart && (freeSlots_[i] != freeSlots_[i - 1] + 1 ||
+      generations_[freeSlots_[i]] != generations_[freeSlots_[i - 1]]))
+    {
+      runStart = i;
+    }
+
+    if (i + 1 - runStart == count)
+      return TakeFreeSlots(runStart, count);
+  }
+
+  if (freeSlots_.Empty() || freeSlots_.GetBack() != generations_.Size() - 1)
+    return TakeNewSlots(count, 0);
+
+  int const entityIndex = freeSlots_[runStart];
+  int const generation  = generations_[entityIndex];
+  int const runLength   = freeSlots_.Size() - runStart;
+
+  freeSlots_.Resize(runStart);
+  TakeNewSlots(count - runLength, generation);
+
+  return MakeEntityId(entityIndex, generation);
+}
+
+//##############################################################################
+// Takes the slot of the given id, for replaying creations exactly. Slots past
+// the end of the table are added, any skipped on the way have to be claimed
+// as well before they are used.
+void EntitySlotTable::Claim(int entityId)
+{
+  int const entityIndex = GetEntityIndex(entityId);
+
+  ASSERT(entityIndex > 0);
+
+  if (entityIndex >= generations_.Size())
+  {
+    generations_.Resize(entityIndex + 1, 0);
+    alive_.Resize(entityIndex + 1, byte(0));
+  }
+  else if (std::binary_search(freeSlots_.Begin(), freeSlots_.End(),
+    entityIndex))
+  {
+    EraseFreeSlot(entityIndex);
+  }
+
+  ASSERT(!alive_[entityIndex]);
+
+  generations_[entityIndex] = GetEntityGeneration(entityId);
+}
+
+//##############################################################################
+void EntitySlotTable::Activate(int entityId)
+{
+  int const entityIndex = GetEntityIndex(entityId);
+
+  ASSERT(entityIndex > 0 && entityIndex < generations_.Size());
+  ASSERT(generations_[entityIndex] == GetEntityGeneration(entityId));
+  ASSERT(!alive_[entityIndex]);
+
+  alive_[entityIndex] = byte(1);
+}
+
+//##############################################################################
+void EntitySlotTable::Release(int entityId)
+{
+  Release(&entityId, 1);
+}
+
+//##############################################################################
+// Bumps the generation of each slot, wrapping around, so the ids issued for it
+// turn stale. The slots are sorted into the free slots in one merge.
+void EntitySlotTable::Release(int const * entityIds, int count)
+{
+  ASSERT(entityIds || count == 0);
+
+  int const firstReleased = freeSlots_.Size();
+
+  for (int i = 0; i < count; ++i)
+  {
+    ASSERT(IsAlive(entityIds[i]));
+
+    int const entityIndex = GetEntityIndex(entityIds[i]);
+
+    alive_[entityIndex] = byte(0);
+    generations_[entityIndex] =
+      (generations_[entityIndex] + 1) & EntityGenerationMask;
+    freeSlots_.EmplaceBack(entityIndex);
+  }
+
+  std::sort(freeSlots_.Begin() + firstReleased, freeSlots_.End());
+  std::inplace_merge(freeSlots_.Begin(), freeSlots_.Begin() + firstReleased,
+    freeSlots_.End());
+}
+
+//##############################################################################
+// Undoes Release(), the id becomes alive again.
+void EntitySlotTable::Revive(int entityId)
+{
+  int const entityIndex = GetEntityIndex(entityId);
+  int const generation  = GetEntityGeneration(entityId);
+
+  ASSERT(!alive_[entityIndex]);
+  ASSERT(generations_[entityIndex] ==
+    ((generation + 1) & EntityGenerationMask));
+
+  EraseFreeSlot(entityIndex);
+
+  generations_[entityIndex] = generation;
+  alive_[entityIndex] = byte(1);
+}
+
+//##############################################################################
+// Undoes Create() and Activate(). New slots go back to the free slots as well
+// and are dropped again by Truncate().
+void EntitySlotTable::Retract(int entityId)
+{
+  ASSERT(IsAlive(entityId));
+
+  alive_[GetEntityIndex(entityId)] = byte(0);
+  InsertFreeSlot(GetEntityIndex(entityId));
+}
+
+//##############################################################################
+void EntitySlotTable::Truncate(int slotCount)
+{
+  ASSERT(slotCount > 0 && slotCount <= generations_.Size());
+
+  if (slotCount == generations_.Size())
+    return;
+
+  generations_.Resize(slotCount);
+  alive_.Resize(slotCount);
+
+  freeSlots_.Resize(int(std::lower_bound(freeSlots_.Begin(), freeSlots_.End(),
+    slotCount) - freeSlots_.Begin()));
+}
+
+//##############################################################################
+bool EntitySlotTable::IsAlive(int entityId) const
+{
+  int const entityIndex = GetEntityIndex(entityId);
+
+  return entityId > 0 && entityIndex < generations_.Size() &&
+    alive_[entityIndex] &&
+    generations_[entityIndex] == GetEntityGeneration(entityId);
+}
+
+//##############################################################################
+int EntitySlotTable::SlotCount(void) const
+{
+  return generations_.Size();
+}
+
+//##############################################################################
+int EntitySlotTable::FreeSlotCount(void) const
+{
+  return freeSlots_.Size();
+}
+
+//##############################################################################
+void EntitySlotTable::SaveSnapshot(SnapshotWriter * writer) const
+{
+  ASSERT(writer);
+
+  writer->AddArray(generations_);
+  writer->AddArray(alive_);
+  writer->AddArray(freeSlots_);
+}
+
+//##############################################################################
+bool EntitySlotTable::LoadSnapshot(SnapshotReader * reader)
+{
+  ASSERT(reader);
+
+  Array<int>  generations;
+  Array<byte> alive;
+  Array<int>  freeSlots;
+
+  if (!reader->ReadArray(&generations) || !reader->ReadArray(&alive) ||
+    !reader->ReadArray(&freeSlots))
+  {
+    return false;
+  }
+
+  if (generations.Empty() || generations.Size() != alive.Size())
+    return false;
+
+  for (int entityIndex : freeSlots)
+  {
+    if (entityIndex <= 0 || entityIndex >= generations.Size())
+      return false;
+  }
+
+  std::sort(freeSlots.Begin(), freeSlots.End());
+
+  generations_ = std::move(generations);
+  alive_       = std::move(alive);
+  freeSlots_   = std::move(freeSlots);
+
+  return true;
+}
+
+//##############################################################################
+// Removes count free slots starting at firstFreeSlot, a run of consecutive
+// slots of one generation.
+int EntitySlotTable::TakeFreeSlots(int firstFreeSlot, int count)
+{
+  int const entityIndex = freeSlots_[firstFreeSlot];
+
+  std::copy(freeSlots_.Begin() + firstFreeSlot + count, freeSlots_.End(),
+    freeSlots_.Begin() + firstFreeSlot);
+  freeSlots_.Resize(freeSlots_.Size() - count);
+
+  return MakeEntityId(entityIndex, generations_[entityIndex]);
+}
+
+//##############################################################################
+int EntitySlotTable::TakeNewSlots(int count, int generation)
+{
+  ASSERT(count >= 0);
+  ASSERT(count <= EntityIndexMask + 1 - generations_.Size(),
+    "Out of entity slots");
+
+  int const entityIndex = generations_.Size();
+
+  generations_.Resize(entityIndex + count, generation);
+  alive_.Resize(entityIndex + count, byte(0));
+
+  return MakeEntityId(entityIndex, generation);
+}
+
+//##############################################################################
+void EntitySlotTable::InsertFreeSlot(int entityIndex)
+{
+  int * location =
+    std::lower_bound(freeSlots_.Begin(), freeSlots_.End(), entityIndex);
+
+  ASSERT(location == freeSlots_.End() || *location != entityIndex);
+
+  freeSlots_.Emplace(location, entityIndex);
+}
+
+//##############################################################################
+void EntitySlotTable::EraseFreeSlot(int entityIndex)
+{
+  int * location =
+    std::lower_bound(freeSlots_.Begin(), freeSlots_.End(), entityIndex);
+
+  ASSERT(location != freeSlots_.End() && *location == entityIndex);
+
+  freeSlots_.Erase(int(location - freeSlots_.Begin()));
+}
@@ -0,0 +1,94 @@
+#ifndef ENGINE_SYSTEM_ENTITYID_H
+#define ENGINE_SYSTEM_ENTITYID_H
+
+#include "utility/containers/Array.h"
+#include "utility/Debug.h"
+#include "utility/Typedefs.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+//##############################################################################
+// Entity ids are 32 bit handles. The low bits index a slot in the entity
+// manager's slot table and the high bits hold the generation of that slot,
+// which changes every time the slot is reused. Slot 0 is never handed out, so
+// 0 is never a valid id.
+//
+// Generations wrap, so slots can be reused forever. The trade-off is that a
+// stale id is only told apart from a live one until its slot was reused
+// EntityGenerationMask + 1 times, after that it refers to the slot's newest
+// entity again. Ids shouldn't be held that long after the entity died.
+int const EntityIndexBits      = 22;
+int const EntityGenerationBits = 31 - EntityIndexBits;
+int const EntityIndexMask      = (1 << EntityIndexBits) - 1;
+int const EntityGenerationMask = (1 << EntityGenerationBits) - 1;
+
+inline int GetEntityIndex(int entityId);
+inline int GetEntityGeneration(int entityId);
+inline int MakeEntityId(int entityIndex, int generation);
+
+//##############################################################################
+// Hands out entity ids and answers whether an id is still alive in constant
+// time. Ids are reserved when created but only become alive on Activate(), to
+// match the entity manager's frame boundaries. Released slots are reused, and
+// which slot is taken only depends on the set of free slots, so restoring that
+// set through history hands out the same ids again.
+class EntitySlotTable
+{
+public:
+  EntitySlotTable(void);
+
+  int Create(void);
+  int CreateRange(int count);
+  void Claim(int entityId);
+
+  void Activate(int entityId);
+  void Release(int entityId);
+  void Release(int const * entityIds, int count);
+
+  void Revive(int entityId);
+  void Retract(int entityId);
+  void Truncate(int slotCount);
+
+  bool IsAlive(int entityId) const;
+
+  int SlotCount(void) const;
+  int FreeSlotCount(void) const;
+
+  void SaveSnapshot(SnapshotWriter * writer) const;
+  bool LoadSnapshot(SnapshotReader * reader);
+
+private:
+  int TakeFreeSlots(int firstFreeSlot, int count);
+  int TakeNewSlots(int count, int generation);
+  void InsertFreeSlot(int entityIndex);
+  void EraseFreeSlot(int entityIndex);
+
+  Array<int>  generations_;
+  Array<byte> alive_;
+  Array<int>  freeSlots_;
+};
+
+//##############################################################################
+inline int GetEntityIndex(int entityId)
+{
+  return entityId & EntityIndexMask;
+}
+
+//##############################################################################
+inline int GetEntityGeneration(int entityId)
+{
+  return (entityId >> EntityIndexBits) & EntityGenerationMask;
+}
+
+//##############################################################################
+inline int MakeEntityId(int entityIndex, int generation)
+{
+  ASSERT(entityIndex >= 0);
+  ASSERT(entityIndex <= EntityIndexMask);
+
+  return ((generation & EntityGenerationMask) << EntityIndexBits) |
+    entityIndex;
+}
+
+#endif
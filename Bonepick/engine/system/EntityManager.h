@@ -1,16 +1,38 @@
 #ifndef ENGINE_SYSTEM_ENTITYMANAGER_H
 #define ENGINE_SYSTEM_ENTITYMANAGER_H
 
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <memory>
+
+#include "system/ComponentChanges.h"
+#include "system/ComponentHistory.h"
+#include "system/ComponentMask.h"
+#include "system/ComponentProfile.h"
+#include "system/ComponentStorage.h"
+#include "system/DoubleBufferedComponentManager.h"
+#include "system/EntityId.h"
+#include "system/EntityQuery.h"
+#include "system/EntityRelations.h"
+#include "system/Prefab.h"
+#include "system/QueryView.h"
+#include "system/RuntimeComponentManager.h"
+#include "system/SingletonComponentManager.h"
+#include "system/SpatialIndex.h"
+#include "system/TagComponentManager.h"
+#include "utility/Bitset.h"
 #include "utility/containers/Array.h"
 #include "utility/containers/Optional.h"
 #include "utility/containers/SortedArray.h"
+#include "utility/containers/SparseSet.h"
 #include "utility/containers/Tuple.h"
+#include "utility/Profiling.h"
+#include "utility/Snapshot.h"
 #include "utility/TemplateTools.h"
+#include "utility/ThreadPool.h"
 
 //##############################################################################
-template <typename T>
-class ComponentManager;
-
 template <typename ... Components>
 class ComponentArray;
 
@@ -19,7 +41,7 @@ class EntityManager;
 
 //##############################################################################
 template <typename T>
-class ComponentManager
+class ComponentManager<T, SparseStorage>
 {
 public:
   ComponentManager(void) = default;
@@ -28,7 +50,12 @@ public:
 
   ~ComponentManager(void) = default;
 
+  ComponentManager & operator =(ComponentManager const &) = default;
+  ComponentManager & operator =(ComponentManager &&) = default;
+
   void AddComponent(int entityId, T const & component);
+  void AddComponents(int firstEntityId, T const * components, int count);
+  void FillComponents(int firstEntityId, T const & component, int count);
 
   T const & GetComponent(int entityId) const;
   void SetComponent(int entityId, T const & component);
@@ -38,13 +65,41 @@ public:
 
   int GetEntityId(T const * component) const;
 
-  void Advance(void);
+  int ComponentCount(void) const;
+  int GetEntityIdAt(int index) const;
+  T const * GetComponentAt(int index) const;
+  T const * FindComponent(int entityId) const;
+  void PrefetchLookup(int entityId) const;
+
+  int StorageVersion(void) const;
+  Array<int> const & MovedEntityIds(void) const;
+
+  void ReserveWriteBuffers(int bufferCount, void const * owner);
+
+  void SetCompactionBudget(int budget);
+  CompactionStats const & GetCompactionStats(void) const;
+
+  ComponentChangeLog const & GetChangeLog(void) const;
 
-  void GetComponents(Array<T const *> * components,
-    SortedArray<int> const & filterIds) const;
+  void SetHistoryFrames(int frameCount);
+
+  void Advance(int frame);
+
+  void Rewind(int frame);
+  void Replay(int frame);
+
+  void GetComponents(Array<T const *> * components, int const * filterIds,
+    int filterCount) const;
 
   void GetAllComponents(Array<T const *> * components,
-    SortedArray<int> * entityIds) const;
+    Array<int> * entityIds) const;
+
+  void SaveSnapshot(SnapshotWriter * writer) const;
+  bool LoadSnapshot(SnapshotReader * reader);
+
+#if PROFILING_ENABLED
+  ComponentProfiler & GetProfiler(void) const;
+#endif
 
 private:
   struct FutureData
@@ -55,16 +110,55 @@ private:
     T   component;
   };
 
-  Array<Optional<T>> data_;
-  Array<int>         enitityIds_;
-  Array<FutureData>  newData_;
-  Array<FutureData>  futureData_;
-  Array<int>         enititiesToDestroy_;
-  Array<int>         emptyComponentSlots_;
-  ArrayMap<int, int> componentIds_;
+  //Copies of one component for a range of new entity ids
+  struct FillData
+  {
+    int firstEntityId;
+    int count;
+    T   component;
+  };
+
+  typedef typename ComponentHistory<T>::Change HistoryChange;
+
+  int const * FindComponentId(int entityId) const;
+  SparseSet<FutureData> & GetWriteBuffer(void);
+
+  bool HasPendingChanges(void) const;
+
+  void BeginHistoryFrame(int frame);
+  void EndHistoryFrame(int frame);
+  void RestoreComponent(int entityId, Optional<T> const & component);
+  void FinishRestore(int lowestChangedIndex);
+
+  int PopEmptySlot(void);
+  void InsertComponent(int entityId, T const & component);
+  void InsertFill(FillData const & fill);
+  void Compact(int lowestChangedIndex);
+
+  Array<Optional<T>>           data_;
+  Array<int>                   enitityIds_;
+  Array<FutureData>            newData_;
+  Array<FillData>              fillData_;
+  Array<SparseSet<FutureData>> futureData_;
+  void const *                 writeBufferOwner_ = nullptr;
+  Array<int>                   enititiesToDestroy_;
+  Array<byte>                  destroyMarks_;
+  Array<int>                   emptyComponentSlots_;
+  SparseSet<int>               componentIds_;
+  Array<int>                   movedEntityIds_;
+  int                          storageVersion_   = 0;
+  int                          compactionBudget_ = DefaultCompactionBudget;
+  int                          sortedCount_      = 0;
+  CompactionStats              compactionStats_;
+  ComponentChangeLog           changeLog_;
+  ComponentHistory<T>          history_;
+#if PROFILING_ENABLED
+  mutable ComponentProfiler    profiler_;
+#endif
 };
 
 //##############################################################################
+// Result of a component join, entities are in id order.
 template <typename ... EntityComponents>
 class ComponentArray
 {
@@ -80,19 +174,25 @@ public:
   void FillWithNulls(void);
 
 private:
-  void RemoveEntity(int entityIndex);
+  template <typename U>
+  void SetEntities(Array<int> * entityIds, Array<U const *> * components);
+
+  void KeepEntities(Array<int> const & keptIndices);
 
   template <typename Component, typename ... Remainder>
-  void RemoveEntityInternal(int entityIndex,
+  void KeepEntitiesInternal(Array<int> const & keptIndices,
     TypeList<Component, Remainder...> const &);
 
-  void RemoveEntityInternal(int entityIndex, TypeList<> const &);
+  void KeepEntitiesInternal(Array<int> const &, TypeList<> const &);
 
   template <typename Component, typename ... Remainder>
   void FillWithNullsInternal(TypeList<Component, Remainder...> const &);
 
   void FillWithNullsInternal(TypeList<> const &);
 
+  template <typename ... Components>
+  friend class EntityManager;
+
   bool                                            initialized_ = false;
   SortedArray<int>                                entityIds_;
   UniqueTuple<Array<EntityComponents const *>...> components_;
@@ -104,14 +204,27 @@ class EntityManager
 {
 public:
   EntityManager(void) = default;
-  EntityManager(EntityManager const &) = default;
+  EntityManager(EntityManager const & other);
   EntityManager(EntityManager &&) = default;
 
   ~EntityManager(void) = default;
 
+  EntityManager & operator =(EntityManager const & other);
+  EntityManager & operator =(EntityManager &&) = default;
+
   template <typename ... EntityComponents>
   int AddEntity(EntityComponents const & ... components);
 
+  template <typename ... EntityComponents, typename Generator>
+  int AddEntities(int count, Generator const & generator);
+
+  template <typename Component, typename ... Remainder>
+  int AddEntities(Array<Component> const & components,
+    Array<Remainder> const & ... remainder);
+
+  template <typename ... PrefabComponents>
+  int Instantiate(Prefab<PrefabComponents...> const & prefab, int count);
+
   template <typename U>
   void AddComponent(int entityId, U const & component);
 
@@ -133,20 +246,175 @@ public:
   template <typename U>
   U & UpdateComponent(int entityId);
 
+  template <typename U>
+  bool HasSingleton(void) const;
+
+  template <typename U>
+  U const & GetSingleton(void) const;
+
+  template <typename U>
+  void SetSingleton(U const & value);
+
   template <typename ... EntityComponents>
   ComponentArray<Components ...> GetComponents(void) const;
 
+  template <typename Filter>
+  ComponentArray<Components ...> GetMatchingComponents(void) const;
+
+  template <typename ... QueryComponents>
+  QueryView<QueryComponents...> Query(void) const;
+
+  ComponentMask GetSignature(int entityId) const;
+
+  template <typename ... QueryComponents>
+  EntityQuery<EntityManager, QueryComponents...> const & RegisterQuery(void);
+
+  template <typename U>
+  SpatialIndex<EntityManager, U> const & RegisterSpatialIndex(float cellSize,
+    int cellCount);
+
+  void UnregisterQuery(IEntityQuery<EntityManager> const & query);
+
+  template <typename QueryType>
+  QueryType const & GetCopiedQuery(EntityManager const & source,
+    QueryType const & query) const;
+
+  RuntimeComponentManager & RegisterRuntimeComponent(Token name,
+    DataLayout const & layout, unsigned componentSize);
+
+  RuntimeComponentManager * FindRuntimeComponent(Token name);
+  RuntimeComponentManager const * FindRuntimeComponent(Token name) const;
+
+  template <typename U>
+  int GetStorageVersion(void) const;
+
+  template <typename U>
+  Array<int> const & GetMovedEntityIds(void) const;
+
+  void SetCompactionBudget(int budget);
+
+  template <typename U>
+  CompactionStats const & GetCompactionStats(void) const;
+
+  int GetFrame(void) const;
+
+  template <typename U>
+  ComponentChanges GetChangedComponents(void) const;
+
+  template <typename U>
+  ComponentChanges GetChangedComponents(int sinceFrame) const;
+
+  template <typename QueryType, typename Function>
+  void ParallelForEach(ThreadPool & pool, QueryType const & query,
+    Function const & function);
+
   void DestroyEntity(int entityId);
+  void DestroyEntities(Array<int> const & entityIds);
+  void DestroyEntities(int firstEntityId, int count);
 
   template <typename U>
   bool ContainsComponent(int entityId) const;
 
   bool DoesEntityExist(int entityId) const;
 
+  void SetParent(int childId, int parentId);
+  EntityRelations const & GetRelations(void) const;
+
+  template <typename U>
+  void GetRelatedComponents(Array<U const *> * components) const;
+
   void Advance(void);
+  void Advance(ThreadPool & pool);
+
+  void SetHistoryFrames(int frameCount);
+  int RewindableFrames(void) const;
+  int ReplayableFrames(void) const;
+
+  void Rewind(int frameCount);
+  void Replay(int frameCount);
+
+  bool SaveSnapshot(char const * path) const;
+  bool LoadSnapshot(char const * path);
+
+#if PROFILING_ENABLED
+  template <typename U>
+  Array<ComponentFrameProfile> GetProfile(void) const;
+
+  bool SaveProfile(char const * path) const;
+  void ClearProfile(void);
+#endif
 
 private:
+  typedef UniqueTuple<ComponentManager<Components>...> ComponentManagers;
+
+  //Entities a frame created and destroyed, in the order the slot table saw
+  //them, the slot count before and after the frame and the links it changed
+  //between related entities
+  struct HistoryFrame
+  {
+    Array<int>                     createdIds;
+    Array<int>                     destroyedIds;
+    Array<int>                     changedIds;
+    int                            slotCount    = 0;
+    int                            newSlotCount = 0;
+    Array<EntityRelations::Change> relationChanges;
+  };
+
+  struct PendingRelation
+  {
+    int childId;
+    int parentId;
+  };
+
+  //Structural changes a parallel job made to one component type
+  template <typename T>
+  struct ComponentCommands
+  {
+    struct Added
+    {
+      int entityId;
+      T   component;
+    };
+
+    //Copies of one component for a range of entities, like FillComponents()
+    struct Filled
+    {
+      int firstEntityId;
+      int count;
+      T   component;
+    };
+
+    Array<Added>  added;
+    Array<Filled> filled;
+    Array<int>    removedIds;
+  };
+
+  //Structural changes of one parallel job, played back once the jobs are done
+  struct CommandBuffer
+  {
+    Array<int>                                    createdIds;
+    Array<int>                                    destroyedIds;
+    Array<int>                                    changedIds;
+    Array<PendingRelation>                        relations;
+    UniqueTuple<ComponentCommands<Components>...> components;
+  };
+
+  bool HasPendingChanges(void) const;
+  void RecordHistoryFrame(void);
+
+  CommandBuffer * GetCommandBuffer(void);
+  Array<int> & GetChangedIds(void);
+  bool IsCommandEntityId(CommandBuffer const & commands, int entityId) const;
+  int ResolveEntityId(CommandBuffer const & commands, int entityId) const;
+  void PlayBackCommands(void);
+  void BeginAdvance(void);
+  void CommitRelations(void);
+  void CommitEntities(void);
+  void EndAdvance(void);
+  void UpdateSignatures(Array<int> const & entityIds);
+
   int GetNewEntityId(void);
+  int GetNewEntityIds(int count);
 
   template <typename Component, typename ... Remainder>
   void AddComponents(int entityId, Component const & component,
@@ -154,11 +422,30 @@ private:
 
   void AddComponents(int);
 
+  template <typename Component, typename ... Remainder>
+  void AddComponentArrays(int firstEntityId, int count,
+    Array<Component> const & components,
+    Array<Remainder> const & ... remainder);
+
+  void AddComponentArrays(int, int);
+
+  template <typename Component, typename ... Remainder>
+  void AddComponentCopies(int firstEntityId, int count,
+    Component const & component, Remainder const & ... remainder);
+
+  void AddComponentCopies(int, int);
+
   template <typename Component, typename ... Remainder>
   void AdvanceInternal(TypeList<Component, Remainder...> const &);
 
   void AdvanceInternal(TypeList<> const &);
 
+  template <typename Component, typename ... Remainder>
+  void AdvanceInternal(ThreadPool & pool,
+    TypeList<Component, Remainder...> const &);
+
+  void AdvanceInternal(ThreadPool &, TypeList<> const &);
+
   template <typename Component, typename ... Remainder>
   void GetComponentsInternal(ComponentArray<Components ...> * compArray,
     TypeList<Component, Remainder...> const &) const;
@@ -166,549 +453,2906 @@ private:
   void GetComponentsInternal(ComponentArray<Components ...> *,
     TypeList<> const &) const;
 
+  template <typename Component, typename ... Remainder>
+  void GatherComponentsInternal(ComponentArray<Components ...> * compArray,
+    TypeList<Component, Remainder...> const &) const;
+
+  void GatherComponentsInternal(ComponentArray<Components ...> *,
+    TypeList<> const &) const;
+
+  template <typename Component, typename ... Remainder>
+  ComponentMask GetSignatureInternal(int entityId,
+    TypeList<Component, Remainder...> const &) const;
+
+  ComponentMask GetSignatureInternal(int, TypeList<> const &) const;
+
+  template <typename Component, typename ... Remainder>
+  void ReserveWriteBuffersInternal(int bufferCount,
+    TypeList<Component, Remainder...> const &);
+
+  void ReserveWriteBuffersInternal(int, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void PlayBackInternal(CommandBuffer * commands,
+    TypeList<Component, Remainder...> const &);
+
+  void PlayBackInternal(CommandBuffer *, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void SetCompactionBudgetInternal(int budget,
+    TypeList<Component, Remainder...> const &);
+
+  void SetCompactionBudgetInternal(int, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void SetHistoryFramesInternal(int frameCount,
+    TypeList<Component, Remainder...> const &);
+
+  void SetHistoryFramesInternal(int, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void RewindInternal(int frame, TypeList<Component, Remainder...> const &);
+
+  void RewindInternal(int, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void ReplayInternal(int frame, TypeList<Component, Remainder...> const &);
+
+  void ReplayInternal(int, TypeList<> const &);
+
+#if PROFILING_ENABLED
+  template <typename Component, typename ... Remainder>
+  bool SaveProfileInternal(std::FILE * file,
+    TypeList<Component, Remainder...> const &) const;
+
+  bool SaveProfileInternal(std::FILE *, TypeList<> const &) const;
+
+  template <typename Component, typename ... Remainder>
+  void ClearProfileInternal(TypeList<Component, Remainder...> const &);
+
+  void ClearProfileInternal(TypeList<> const &);
+#endif
+
+  template <typename Component, typename ... Remainder>
+  void SaveSnapshotInternal(SnapshotWriter * writer,
+    TypeList<Component, Remainder...> const &) const;
+
+  void SaveSnapshotInternal(SnapshotWriter *, TypeList<> const &) const;
+
+  template <typename Component, typename ... Remainder>
+  static bool LoadSnapshotInternal(ComponentManagers * componentManagers,
+    SnapshotReader * reader, TypeList<Component, Remainder...> const &);
+
+  static bool LoadSnapshotInternal(ComponentManagers *, SnapshotReader *,
+    TypeList<> const &);
+
   template <typename Component, typename ... Remainder>
   void DestroyInternal(int entityId, TypeList<Component, Remainder...> const &);
 
   void DestroyInternal(int, TypeList<> const &);
 
-  UniqueTuple<ComponentManager<Components>...> componentManagers_;
+  typedef std::unique_ptr<IEntityQuery<EntityManager>> QueryPtr;
+  typedef std::unique_ptr<RuntimeComponentManager> RuntimeComponentPtr;
+
+  //Ids handed out inside jobs are this plus the job's creation count, they
+  //are negative so they can't be mistaken for real ids
+  static int const ProvisionalEntityId = std::numeric_limits<int>::min();
+
+  static int const MinRowsPerParallelJob = 256;
+  static int const ParallelJobsPerThread = 4;
+
+  ComponentManagers                            componentManagers_;
   SortedArray<int>                             entityIds_;
   Array<int>                                   newEntityIds_;
-  int                                          nextEntityId_       = 1;
+  EntitySlotTable                              entitySlots_;
   Array<int>                                   enititiesToDestroy_;
+  Bitset                                       destroyMarks_;
+  Array<int>                                   changedEntityIds_;
+  Array<ComponentMask>                         signatures_;
+  EntityRelations                              relations_;
+  Array<PendingRelation>                       pendingRelations_;
+  Array<CommandBuffer>                         commandBuffers_;
+  Array<QueryPtr>                              queries_;
+  Array<RuntimeComponentPtr>                   runtimeComponents_;
+  int                                          frame_              = 0;
+  Array<HistoryFrame>                          history_;
+  int                                          historyBegin_       = 0;
+  int                                          historyEnd_         = 0;
+  int                                          historySlotCount_   = 0;
 };
 
 //##############################################################################
 template <typename T>
-void ComponentManager<T>::AddComponent(int entityId, T const & component)
+void ComponentManager<T, SparseStorage>::AddComponent(int entityId,
+  T const & component)
 {
-  ASSERT(!componentIds_.Contains(entityId));
+  ASSERT(!componentIds_.Contains(GetEntityIndex(entityId)));
   newData_.EmplaceBack(entityId, component);
 }
 
 //##############################################################################
 template <typename T>
-T const & ComponentManager<T>::GetComponent(int entityId) const
+void ComponentManager<T, SparseStorage>::AddComponents(int firstEntityId,
+  T const * components, int count)
 {
-  ASSERT(componentIds_.Contains(entityId));
+  newData_.Reserve(newData_.Size() + count);
 
-  return *data_[componentIds_.Find(entityId)->value];
+  for (int i = 0; i < count; ++i)
+  {
+    ASSERT(!componentIds_.Contains(GetEntityIndex(firstEntityId + i)));
+    newData_.EmplaceBack(firstEntityId + i, components[i]);
+  }
 }
 
 //##############################################################################
+// Stores the component once for the whole range, Advance() copies it straight
+// into storage.
 template <typename T>
-void ComponentManager<T>::SetComponent(int entityId, T const & component)
+void ComponentManager<T, SparseStorage>::FillComponents(int firstEntityId,
+  T const & component, int count)
 {
-  ASSERT(componentIds_.Contains(entityId));
-  ON_DEBUG(int const componentId = componentIds_.Find(entityId)->value;)
+  ASSERT(count >= 0);
+  ASSERT(!componentIds_.Contains(GetEntityIndex(firstEntityId)));
 
-  ASSERT(componentId < data_.Size());
-  ASSERT(componentId >= 0);
+  if (count > 0)
+    fillData_.EmplaceBack(FillData{ firstEntityId, count, component });
+}
 
-  ASSERT(!futureData_.Contains(
-    [&entityId](FutureData const & val)
-    {
-      return val.entityId == entityId;
-    })
-  );
+//##############################################################################
+template <typename T>
+T const & ComponentManager<T, SparseStorage>::GetComponent(int entityId) const
+{
+  int const * componentId = FindComponentId(entityId);
+  ASSERT(componentId);
 
-  futureData_.EmplaceBack(FutureData(entityId, component));
+  return *data_[*componentId];
 }
 
 //##############################################################################
 template <typename T>
-T & ComponentManager<T>::UpdateComponent(int entityId)
+void ComponentManager<T, SparseStorage>::SetComponent(int entityId,
+  T const & component)
 {
-  ASSERT(componentIds_.Contains(entityId));
-  ON_DEBUG(int const componentId = componentIds_.Find(entityId)->value;)
+  int const * componentId = FindComponentId(entityId);
+  ASSERT(componentId);
 
-  ASSERT(componentId < data_.Size());
-  ASSERT(componentId >= 0);
+  ASSERT(*componentId < data_.Size());
+  ASSERT(*componentId >= 0);
 
-  FutureData * futureComponent = futureData_.FindFirst(
-    [&entityId](FutureData const & val)
-    {
-      return val.entityId == entityId;
-    });
+  SparseSet<FutureData> & writeBuffer = GetWriteBuffer();
+
+  ASSERT(!writeBuffer.Contains(*componentId));
+
+  writeBuffer.Emplace(*componentId, entityId, component);
+}
+
+//##############################################################################
+template <typename T>
+T & ComponentManager<T, SparseStorage>::UpdateComponent(int entityId)
+{
+  int const * componentId = FindComponentId(entityId);
+  ASSERT(componentId);
+
+  ASSERT(*componentId < data_.Size());
+  ASSERT(*componentId >= 0);
 
-  if (futureComponent)
+  SparseSet<FutureData> & writeBuffer = GetWriteBuffer();
+
+  if (FutureData * futureComponent = writeBuffer.Find(*componentId))
     return futureComponent->component;
   else if constexpr(std::is_default_constructible_v<T>)
-  {
-    SetComponent(entityId, T());
-    ASSERT(futureData_[futureData_.Size() - 1].entityId == entityId);
-    return futureData_[futureData_.Size() - 1].component;
-  }
+    return writeBuffer.Emplace(*componentId, entityId, T()).component;
   else
   {
-    SetComponent(entityId, GetComponent(entityId));
-    return UpdateComponent(entityId);
+    return writeBuffer.Emplace(
+      *componentId, entityId, GetComponent(entityId)).component;
   }
 }
 
 //##############################################################################
 template <typename T>
-void ComponentManager<T>::DestroyComponent(int entityId)
+void ComponentManager<T, SparseStorage>::DestroyComponent(int entityId)
 {
-  if (componentIds_.Contains(entityId))
+  if (int const * componentId = FindComponentId(entityId))
   {
-    ON_DEBUG(int const componentId = componentIds_.Find(entityId)->value;)
-
-    ASSERT(componentId < data_.Size());
-    ASSERT(componentId >= 0);
+    ASSERT(*componentId < data_.Size());
+    ASSERT(*componentId >= 0);
 
-    if (!enititiesToDestroy_.Contains(entityId))
+    if (!destroyMarks_[*componentId])
+    {
+      destroyMarks_[*componentId] = byte(1);
       enititiesToDestroy_.EmplaceBack(entityId);
+    }
   }
 }
 
 //##############################################################################
 template <typename T>
-bool ComponentManager<T>::ContainsComponent(int entityId) const
+bool ComponentManager<T, SparseStorage>::ContainsComponent(int entityId) const
 {
-  return componentIds_.Contains(entityId);
+  return FindComponentId(entityId) != nullptr;
 }
 
 //##############################################################################
 template <typename T>
-int ComponentManager<T>::GetEntityId(T const * component) const
+int ComponentManager<T, SparseStorage>::GetEntityId(T const * component) const
 {
   int const entityIndex = data_.GetIndex(component);
   return enitityIds_[entityIndex];
 }
 
 //##############################################################################
+// Committed components by index in entity id order, which is not the order
+// they are stored in.
 template <typename T>
-void ComponentManager<T>::Advance(void)
+int ComponentManager<T, SparseStorage>::ComponentCount(void) const
 {
-  for (FutureData nextData : futureData_)
-  {
-    ASSERT(componentIds_.Contains(nextData.entityId));
-    int const componentId = componentIds_.Find(nextData.entityId)->value;
-    data_[componentId] = nextData.component;
-  }
-
-  futureData_.Clear();
-
-  for (int entityId : enititiesToDestroy_)
-  {
-    ASSERT(componentIds_.Contains(entityId));
-    auto * component = componentIds_.Find(entityId);
-    int const componentId = component->value;
-    data_[componentId].Clear();
-    enitityIds_[componentId] = 0;
-    emptyComponentSlots_.EmplaceBack(componentId);
-    componentIds_.Erase(component);
-  }
-
-  enititiesToDestroy_.Clear();
-
-  for (FutureData newData : newData_)
-  {
-    if (!emptyComponentSlots_.Empty())
-    {
-      int const componentId =
-        emptyComponentSlots_[emptyComponentSlots_.Size() - 1];
-      emptyComponentSlots_.PopBack();
-      enitityIds_[componentId] = newData.entityId;
-
-      componentIds_.Emplace(newData.entityId, componentId);
-
-      ASSERT(componentId < data_.Size());
-      ASSERT(componentId >= 0);
-      ASSERT(data_[componentId].Ptr() == nullptr);
-
-      data_[componentId].Emplace(newData.component);
-    }
-    else
-    {
-      componentIds_.Emplace(newData.entityId, data_.Size());
-      enitityIds_.EmplaceBack(newData.entityId);
-      data_.EmplaceBack(newData.component);
-    }
-  }
-
-  newData_.Clear();
+  return componentIds_.Size();
 }
 
 //##############################################################################
 template <typename T>
-void ComponentManager<T>::GetComponents(Array<T const *> * components,
-  SortedArray<int> const & filterIds) const
+int ComponentManager<T, SparseStorage>::GetEntityIdAt(int index) const
 {
-  ASSERT(components);
+  ASSERT(componentIds_.IsSorted());
 
-  components->Clear();
-  components->Resize(filterIds.Size());
+  return enitityIds_[componentIds_.GetValue(index)];
+}
 
-  int i = 0;
-  int j = 0;
+//##############################################################################
+template <typename T>
+T const * ComponentManager<T, SparseStorage>::GetComponentAt(int index) const
+{
+  ASSERT(componentIds_.IsSorted());
 
-  while (i < filterIds.Size() && j < componentIds_.Size())
-  {
-    if (filterIds[i] < componentIds_[j].key)
-      ++i;
-    else if (componentIds_[j].key < filterIds[i])
-      ++j;
-    else
-    {
-      (*components)[i] = data_[componentIds_[j].value].Ptr();
-      ++i;
-      ++j;
-    }
-  }
+  return data_[componentIds_.GetValue(index)].Ptr();
 }
 
 //##############################################################################
 template <typename T>
-void ComponentManager<T>::GetAllComponents(Array<T const *> * components,
-  SortedArray<int> * entityIds) const
+T const * ComponentManager<T, SparseStorage>::FindComponent(int entityId) const
 {
-  ASSERT(components);
-  ASSERT(entityIds);
+  int const * componentId = FindComponentId(entityId);
 
-  components->Clear();
-  components->Reserve(componentIds_.Size());
-  entityIds->Clear();
-  entityIds->Reserve(componentIds_.Size());
+  return componentId ? data_[*componentId].Ptr() : nullptr;
+}
 
-  for (int i = 0; i < componentIds_.Size(); ++i)
-  {
-    entityIds->Emplace(componentIds_[i].key);
-    components->EmplaceBack(data_[componentIds_[i].value].Ptr());
-  }
+//##############################################################################
+// Hints that FindComponent() is about to be called for the entity.
+template <typename T>
+void ComponentManager<T, SparseStorage>::PrefetchLookup(int entityId) const
+{
+  componentIds_.Prefetch(GetEntityIndex(entityId));
 }
 
 //##############################################################################
-template <typename ... EntityComponents>
-SortedArray<int> const & ComponentArray<EntityComponents...>::EntityIds(void)
-  const
+template <typename T>
+int ComponentManager<T, SparseStorage>::StorageVersion(void) const
 {
-  return entityIds_;
+  return storageVersion_;
 }
 
 //##############################################################################
-template <typename ... EntityComponents>
-template <typename U>
-Array<U const *> const & ComponentArray<EntityComponents...>::Components(void)
+// Entities whose component compaction moved during the last Advance(). Only
+// meaningful while StorageVersion() stayed the same, a new version means any
+// component may have moved.
+template <typename T>
+Array<int> const & ComponentManager<T, SparseStorage>::MovedEntityIds(void)
   const
 {
-  return components_.Get<Array<U const *>>();
+  return movedEntityIds_;
 }
 
 //##############################################################################
-template <typename ... EntityComponents>
-template <typename U>
-void ComponentArray<EntityComponents...>::AddComponents(
-  ComponentManager<U> const & compMan)
+// Jobs of the owning entity manager write to buffers 1 to bufferCount - 1.
+template <typename T>
+void ComponentManager<T, SparseStorage>::ReserveWriteBuffers(int bufferCount,
+  void const * owner)
 {
-  if (!initialized_)
-  {
-    compMan.GetAllComponents(&components_.Get<Array<U const *>>(), &entityIds_);
-    initialized_ = true;
-  }
-  else
-  {
-    Array<U const *> & compArray = components_.Get<Array<U const *>>();
-    compMan.GetComponents(&compArray, entityIds_);
+  if (futureData_.Size() < bufferCount)
+    futureData_.Resize(bufferCount);
 
-    for (int i = entityIds_.Size() - 1; i >= 0; --i)
-    {
-      if (compArray[i] == nullptr)
-        RemoveEntity(i);
-    }
-  }
+  writeBufferOwner_ = owner;
 }
 
 //##############################################################################
-template <typename ... EntityComponents>
-void ComponentArray<EntityComponents...>::FillWithNulls(void)
+template <typename T>
+void ComponentManager<T, SparseStorage>::SetCompactionBudget(int budget)
 {
-  FillWithNullsInternal(TypeList<EntityComponents...>());
+  ASSERT(budget >= 0);
+
+  compactionBudget_ = budget;
 }
 
 //##############################################################################
-template <typename ... EntityComponents>
-void ComponentArray<EntityComponents...>::RemoveEntity(int entityIndex)
+template <typename T>
+CompactionStats const &
+  ComponentManager<T, SparseStorage>::GetCompactionStats(void) const
 {
-  entityIds_.Erase(entityIndex);
-
-  RemoveEntityInternal(entityIndex, TypeList<EntityComponents...>());
+  return compactionStats_;
 }
 
 //##############################################################################
-template <typename ... EntityComponents>
-template <typename Component, typename ... Remainder>
-void ComponentArray<EntityComponents...>::RemoveEntityInternal(int entityIndex,
-  TypeList<Component, Remainder...> const &)
+template <typename T>
+ComponentChangeLog const &
+  ComponentManager<T, SparseStorage>::GetChangeLog(void) const
 {
-  Array<Component const *> & compArray =
+  return changeLog_;
+}
+
+#if PROFILING_ENABLED
+//##############################################################################
+// Mutable so joins, which only read, can be counted as well.
+template <typename T>
+ComponentProfiler & ComponentManager<T, SparseStorage>::GetProfiler(void) const
+{
+  return profiler_;
+}
+#endif
+
+//##############################################################################
+// Keeps the components replaced by the last frameCount calls to Advance(), 0
+// turns history off. Drops whatever was recorded so far.
+template <typename T>
+void ComponentManager<T, SparseStorage>::SetHistoryFrames(int frameCount)
+{
+  history_.SetFrameCount(frameCount);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SparseStorage>::Advance(int frame)
+{
+  Optional<T> const * const oldStorage = data_.Begin();
+  int lowestChangedIndex = EntityIndexMask + 1;
+
+  changeLog_.BeginFrame(frame);
+
+  if (history_.FrameCount() > 0)
+    BeginHistoryFrame(frame);
+
+  ON_PROFILING(ComponentFrameProfile & profile = profiler_.BeginFrame(frame);)
+  ON_PROFILING(ProfileTimer timer;)
+
+  //Buffers are merged in index order, so parallel writes land the same way
+  //no matter which thread ran which rows
+  for (SparseSet<FutureData> & writeBuffer : futureData_)
+  {
+    //Pending writes are keyed by slot, commit them in memory order
+    writeBuffer.Sort();
+
+    for (int i = 0; i < writeBuffer.Size(); ++i)
+    {
+      int const componentId = writeBuffer.GetKey(i);
+      int const entityId = writeBuffer.GetValue(i).entityId;
+      ASSERT(enitityIds_[componentId] == entityId);
+
+      data_[componentId] = std::move(writeBuffer.GetValue(i).component);
+
+      if (!destroyMarks_[componentId])
+        changeLog_.AddChanged(entityId);
+    }
+
+    ON_PROFILING(profile.writes += writeBuffer.Size();)
+    writeBuffer.Clear();
+  }
+
+  ON_PROFILING(profile.commitTime = timer.Lap();)
+
+  if (!enititiesToDestroy_.Empty())
+  {
+    for (int entityId : enititiesToDestroy_)
+    {
+      int const * const found = FindComponentId(entityId);
+      ASSERT(found);
+
+      int const componentId = *found;
+      lowestChangedIndex =
+        std::min(lowestChangedIndex, GetEntityIndex(entityId));
+      changeLog_.AddRemoved(entityId);
+      data_[componentId].Clear();
+      enitityIds_[componentId] = 0;
+      destroyMarks_[componentId] = byte(0);
+      emptyComponentSlots_.EmplaceBack(componentId);
+    }
+
+    //One stable pass keeps the id index sorted, erasing one at a time would not
+    componentIds_.EraseIf(
+      [this](int, int componentId)
+      {
+        return enitityIds_[componentId] == 0;
+      });
+
+    ON_PROFILING(profile.destroys = enititiesToDestroy_.Size();)
+    enititiesToDestroy_.Clear();
+  }
+
+  ON_PROFILING(profile.destroyTime = timer.Lap();)
+
+  int addCount = newData_.Size();
+
+  for (FillData const & fill : fillData_)
+    addCount += fill.count;
+
+  int const slotsNeeded = addCount - emptyComponentSlots_.Size();
+
+  if (slotsNeeded > 0)
+  {
+    data_.Reserve(data_.Size() + slotsNeeded);
+    enitityIds_.Reserve(enitityIds_.Size() + slotsNeeded);
+    destroyMarks_.Reserve(destroyMarks_.Size() + slotsNeeded);
+    componentIds_.Reserve(componentIds_.Size() + addCount);
+  }
+
+  for (FutureData const & newData : newData_)
+  {
+    lowestChangedIndex =
+      std::min(lowestChangedIndex, GetEntityIndex(newData.entityId));
+    InsertComponent(newData.entityId, newData.component);
+  }
+
+  for (FillData const & fill : fillData_)
+  {
+    lowestChangedIndex =
+      std::min(lowestChangedIndex, GetEntityIndex(fill.firstEntityId));
+    InsertFill(fill);
+  }
+
+  ON_PROFILING(profile.adds = addCount;)
+  newData_.Clear();
+  fillData_.Clear();
+
+  ON_PROFILING(profile.insertTime = timer.Lap();)
+
+  //Reused ids can land out of order, restore the id sorted view for joins
+  componentIds_.Sort();
+
+  Compact(lowestChangedIndex);
+
+  if (history_.FrameCount() > 0)
+    EndHistoryFrame(frame);
+
+  ON_PROFILING(profile.storageSlots = data_.Size();)
+  ON_PROFILING(profile.components = componentIds_.Size();)
+
+  //Growing the storage moves every component, what compaction moved is listed
+  //in movedEntityIds_ instead
+  if (data_.Begin() != oldStorage)
+    ++storageVersion_;
+}
+
+//##############################################################################
+// Puts back the components the given frame replaced. Frames have to be
+// rewound newest first and with no changes pending.
+template <typename T>
+void ComponentManager<T, SparseStorage>::Rewind(int frame)
+{
+  ASSERT(!HasPendingChanges(), "Can't rewind over pending changes");
+
+  Array<HistoryChange> const & changes = history_.GetFrame(frame);
+  int lowestChangedIndex = EntityIndexMask + 1;
+
+  for (int i = changes.Size() - 1; i >= 0; --i)
+  {
+    RestoreComponent(changes[i].entityId, changes[i].before);
+    lowestChangedIndex =
+      std::min(lowestChangedIndex, GetEntityIndex(changes[i].entityId));
+  }
+
+  FinishRestore(lowestChangedIndex);
+}
+
+//##############################################################################
+// Redoes a rewound frame with the components it committed originally.
+template <typename T>
+void ComponentManager<T, SparseStorage>::Replay(int frame)
+{
+  ASSERT(!HasPendingChanges(), "Can't replay over pending changes");
+
+  Array<HistoryChange> const & changes = history_.GetFrame(frame);
+  int lowestChangedIndex = EntityIndexMask + 1;
+
+  for (HistoryChange const & change : changes)
+  {
+    RestoreComponent(change.entityId, change.after);
+    lowestChangedIndex =
+      std::min(lowestChangedIndex, GetEntityIndex(change.entityId));
+  }
+
+  FinishRestore(lowestChangedIndex);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SparseStorage>::GetComponents(
+  Array<T const *> * components, int const * filterIds, int filterCount) const
+{
+  ASSERT(components);
+
+  components->Clear();
+  components->Resize(filterCount);
+
+  for (int i = 0; i < filterCount; ++i)
+  {
+    int const * componentId = FindComponentId(filterIds[i]);
+
+    if (componentId)
+      (*components)[i] = data_[*componentId].Ptr();
+  }
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SparseStorage>::GetAllComponents(
+  Array<T const *> * components, Array<int> * entityIds) const
+{
+  ASSERT(components);
+  ASSERT(entityIds);
+
+  components->Clear();
+  components->Reserve(componentIds_.Size());
+  entityIds->Clear();
+  entityIds->Reserve(componentIds_.Size());
+
+  ASSERT(componentIds_.IsSorted());
+
+  for (int i = 0; i < componentIds_.Size(); ++i)
+  {
+    entityIds->EmplaceBack(enitityIds_[componentIds_.GetValue(i)]);
+    components->EmplaceBack(data_[componentIds_.GetValue(i)].Ptr());
+  }
+}
+
+//##############################################################################
+// Components are indexed by the entity's slot, an id from an older generation
+// of the same slot does not find anything.
+template <typename T>
+int const *
+  ComponentManager<T, SparseStorage>::FindComponentId(int entityId) const
+{
+  int const * componentId = componentIds_.Find(GetEntityIndex(entityId));
+
+  if (componentId && enitityIds_[*componentId] == entityId)
+    return componentId;
+  else
+    return nullptr;
+}
+
+//##############################################################################
+template <typename T>
+SparseSet<typename ComponentManager<T, SparseStorage>::FutureData> &
+  ComponentManager<T, SparseStorage>::GetWriteBuffer(void)
+{
+  int const writeBuffer = ActiveWriteBuffer(writeBufferOwner_);
+
+  if (futureData_.Empty())
+    futureData_.Resize(1);
+
+  ASSERT(writeBuffer < futureData_.Size());
+
+  return futureData_[writeBuffer];
+}
+
+//##############################################################################
+// Writes the committed storage as is, holes included, so loading it back is a
+// block copy per array. Pending changes are not part of the snapshot.
+template <typename T>
+void ComponentManager<T, SparseStorage>::SaveSnapshot(
+  SnapshotWriter * writer) const
+{
+  ASSERT(writer);
+
+  writer->AddArray(data_);
+  writer->AddArray(enitityIds_);
+  writer->AddArray(emptyComponentSlots_);
+  writer->AddArray(componentIds_.Keys(), componentIds_.Size());
+  writer->AddArray(componentIds_.Values(), componentIds_.Size());
+}
+
+//##############################################################################
+template <typename T>
+bool ComponentManager<T, SparseStorage>::LoadSnapshot(SnapshotReader * reader)
+{
+  ASSERT(reader);
+
+  Array<Optional<T>> data;
+  Array<int>         entityIds;
+  Array<int>         emptyComponentSlots;
+  Array<int>         keys;
+  Array<int>         values;
+
+  if (!reader->ReadArray(&data) || !reader->ReadArray(&entityIds) ||
+    !reader->ReadArray(&emptyComponentSlots) || !reader->ReadArray(&keys) ||
+    !reader->ReadArray(&values))
+  {
+    return false;
+  }
+
+  if (data.Size() != entityIds.Size() || keys.Size() != values.Size())
+    return false;
+
+  data_                = std::move(data);
+  enitityIds_          = std::move(entityIds);
+  emptyComponentSlots_ = std::move(emptyComponentSlots);
+  destroyMarks_        = Array<byte>(byte(0), data_.Size());
+
+  componentIds_.Assign(keys.Begin(), values.Begin(), keys.Size());
+
+  newData_.Clear();
+  fillData_.Clear();
+  enititiesToDestroy_.Clear();
+
+  for (SparseSet<FutureData> & writeBuffer : futureData_)
+    writeBuffer.Clear();
+
+  ++storageVersion_;
+  sortedCount_     = 0;
+  compactionStats_ = CompactionStats();
+  changeLog_       = ComponentChangeLog();
+
+  return true;
+}
+
+//##############################################################################
+template <typename T>
+bool ComponentManager<T, SparseStorage>::HasPendingChanges(void) const
+{
+  for (SparseSet<FutureData> const & writeBuffer : futureData_)
+  {
+    if (!writeBuffer.Empty())
+      return true;
+  }
+
+  return !newData_.Empty() || !fillData_.Empty() ||
+    !enititiesToDestroy_.Empty();
+}
+
+//##############################################################################
+// Remembers the committed component of every entity the frame is about to
+// touch, the committed ones are filled in by EndHistoryFrame().
+template <typename T>
+void ComponentManager<T, SparseStorage>::BeginHistoryFrame(int frame)
+{
+  Array<int> touchedIds;
+
+  for (SparseSet<FutureData> const & writeBuffer : futureData_)
+  {
+    for (int i = 0; i < writeBuffer.Size(); ++i)
+      touchedIds.EmplaceBack(writeBuffer.GetValue(i).entityId);
+  }
+
+  for (int entityId : enititiesToDestroy_)
+    touchedIds.EmplaceBack(entityId);
+
+  for (FutureData const & newData : newData_)
+    touchedIds.EmplaceBack(newData.entityId);
+
+  for (FillData const & fill : fillData_)
+  {
+    for (int i = 0; i < fill.count; ++i)
+      touchedIds.EmplaceBack(fill.firstEntityId + i);
+  }
+
+  std::sort(touchedIds.Begin(), touchedIds.End());
+  touchedIds.Resize(int(
+    std::unique(touchedIds.Begin(), touchedIds.End()) - touchedIds.Begin()));
+
+  Array<HistoryChange> & changes = history_.BeginFrame(frame);
+  changes.Reserve(touchedIds.Size());
+
+  for (int entityId : touchedIds)
+  {
+    int const * const found = FindComponentId(entityId);
+
+    changes.EmplaceBack(HistoryChange{ entityId,
+      found ? data_[*found] : Optional<T>(), Optional<T>() });
+  }
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SparseStorage>::EndHistoryFrame(int frame)
+{
+  for (HistoryChange & change : history_.GetFrame(frame))
+  {
+    if (int const * const found = FindComponentId(change.entityId))
+      change.after = data_[*found];
+  }
+}
+
+//##############################################################################
+// Sets the committed component of an entity directly, adding or removing it
+// as needed. Only for undoing and redoing frames, FinishRestore() has to
+// follow.
+template <typename T>
+void ComponentManager<T, SparseStorage>::RestoreComponent(int entityId,
+  Optional<T> const & component)
+{
+  int const * const found = FindComponentId(entityId);
+
+  if (found && component.Ptr())
+  {
+    data_[*found] = component;
+  }
+  else if (found)
+  {
+    int const componentId = *found;
+
+    data_[componentId].Clear();
+    enitityIds_[componentId] = 0;
+    emptyComponentSlots_.EmplaceBack(componentId);
+    componentIds_.Erase(GetEntityIndex(entityId));
+  }
+  else if (component.Ptr())
+  {
+    int componentId = PopEmptySlot();
+
+    if (componentId >= 0)
+    {
+      enitityIds_[componentId] = entityId;
+      data_[componentId] = component;
+    }
+    else
+    {
+      componentId = data_.Size();
+      enitityIds_.EmplaceBack(entityId);
+      destroyMarks_.EmplaceBack(byte(0));
+      data_.EmplaceBack(component);
+    }
+
+    componentIds_.Emplace(GetEntityIndex(entityId), componentId);
+  }
+}
+
+//##############################################################################
+// Restored components skip the change log, which starts over instead of
+// reporting frames that were undone.
+template <typename T>
+void ComponentManager<T, SparseStorage>::FinishRestore(int lowestChangedIndex)
+{
+  componentIds_.Sort();
+
+  Compact(lowestChangedIndex);
+
+  ++storageVersion_;
+  changeLog_ = ComponentChangeLog();
+}
+
+//##############################################################################
+// Compaction moves holes around and leaves stale entries behind, slots that
+// were filled since they were pushed are skipped.
+template <typename T>
+int ComponentManager<T, SparseStorage>::PopEmptySlot(void)
+{
+  while (!emptyComponentSlots_.Empty())
+  {
+    int const componentId = emptyComponentSlots_.GetBack();
+    emptyComponentSlots_.PopBack();
+
+    if (enitityIds_[componentId] == 0)
+      return componentId;
+  }
+
+  return -1;
+}
+
+//##############################################################################
+// Puts a new component into an empty slot or at the end of storage.
+template <typename T>
+void ComponentManager<T, SparseStorage>::InsertComponent(int entityId,
+  T const & component)
+{
+  changeLog_.AddAdded(entityId);
+
+  int const componentId = PopEmptySlot();
+
+  if (componentId >= 0)
+  {
+    enitityIds_[componentId] = entityId;
+
+    componentIds_.Emplace(GetEntityIndex(entityId), componentId);
+
+    ASSERT(componentId < data_.Size());
+    ASSERT(componentId >= 0);
+    ASSERT(data_[componentId].Ptr() == nullptr);
+
+    data_[componentId].Emplace(component);
+  }
+  else
+  {
+    componentIds_.Emplace(GetEntityIndex(entityId), data_.Size());
+    enitityIds_.EmplaceBack(entityId);
+    destroyMarks_.EmplaceBack(byte(0));
+    data_.EmplaceBack(component);
+  }
+}
+
+//##############################################################################
+// Empty slots are reused first, whatever is left of the range is appended.
+// The entity indices of the range are contiguous, so they go into the id map
+// in one run.
+template <typename T>
+void ComponentManager<T, SparseStorage>::InsertFill(FillData const & fill)
+{
+  changeLog_.AddAdded(fill.firstEntityId, fill.count);
+
+  componentIds_.EmplaceRange(GetEntityIndex(fill.firstEntityId), fill.count,
+    [this, &fill](int i)
+    {
+      int const entityId = fill.firstEntityId + i;
+      int const componentId = PopEmptySlot();
+
+      if (componentId < 0)
+      {
+        enitityIds_.EmplaceBack(entityId);
+        destroyMarks_.EmplaceBack(byte(0));
+        data_.EmplaceBack(fill.component);
+
+        return data_.Size() - 1;
+      }
+
+      ASSERT(data_[componentId].Ptr() == nullptr);
+
+      enitityIds_[componentId] = entityId;
+      data_[componentId].Emplace(fill.component);
+
+      return componentId;
+    });
+}
+
+//##############################################################################
+// Moves components so that slot i holds the i-th component in entity order,
+// visiting at most the budgeted number of slots. The sorted prefix survives
+// between calls and only shrinks back to the lowest entity that changed. Once
+// all components are in order the trailing holes are cut off.
+template <typename T>
+void ComponentManager<T, SparseStorage>::Compact(int lowestChangedIndex)
+{
+  ASSERT(componentIds_.IsSorted());
+
+  int const * keys = componentIds_.Keys();
+  int const changedRank = int(std::lower_bound(keys,
+    keys + componentIds_.Size(), lowestChangedIndex) - keys);
+
+  sortedCount_ = std::min(sortedCount_, changedRank);
+  compactionStats_.movedComponents = 0;
+  movedEntityIds_.Clear();
+
+  for (int budget = compactionBudget_;
+    budget > 0 && sortedCount_ < componentIds_.Size(); --budget)
+  {
+    int const target = sortedCount_++;
+    int & componentId = componentIds_.GetValue(target);
+
+    if (componentId == target)
+      continue;
+
+    int const occupantId = enitityIds_[target];
+
+    std::swap(data_[target], data_[componentId]);
+    std::swap(enitityIds_[target], enitityIds_[componentId]);
+    movedEntityIds_.EmplaceBack(enitityIds_[target]);
+
+    if (occupantId)
+    {
+      *componentIds_.Find(GetEntityIndex(occupantId)) = componentId;
+      movedEntityIds_.EmplaceBack(occupantId);
+    }
+    else
+      emptyComponentSlots_.EmplaceBack(componentId);
+
+    componentId = target;
+    ++compactionStats_.movedComponents;
+  }
+
+  if (sortedCount_ == componentIds_.Size())
+  {
+    while (data_.Size() > sortedCount_)
+    {
+      data_.PopBack();
+      enitityIds_.PopBack();
+      destroyMarks_.PopBack();
+    }
+
+    emptyComponentSlots_.Clear();
+  }
+  else if (emptyComponentSlots_.Size() > data_.Size())
+  {
+    //Too many stale entries piled up while compaction kept restarting
+    emptyComponentSlots_.Clear();
+
+    for (int i = data_.Size() - 1; i >= 0; --i)
+    {
+      if (enitityIds_[i] == 0)
+        emptyComponentSlots_.EmplaceBack(i);
+    }
+  }
+
+  compactionStats_.sortedComponents = sortedCount_;
+  compactionStats_.emptySlots = data_.Size() - componentIds_.Size();
+}
+
+//##############################################################################
+template <typename ... EntityComponents>
+SortedArray<int> const & ComponentArray<EntityComponents...>::EntityIds(void)
+  const
+{
+  return entityIds_;
+}
+
+//##############################################################################
+template <typename ... EntityComponents>
+template <typename U>
+Array<U const *> const & ComponentArray<EntityComponents...>::Components(void)
+  const
+{
+  return components_.Get<Array<U const *>>();
+}
+
+//##############################################################################
+template <typename ... EntityComponents>
+template <typename U>
+void ComponentArray<EntityComponents...>::AddComponents(
+  ComponentManager<U> const & compMan)
+{
+  if (!initialized_)
+  {
+    Array<int> entityIds;
+    compMan.GetAllComponents(&components_.Get<Array<U const *>>(), &entityIds);
+
+    SetEntities(&entityIds, &components_.Get<Array<U const *>>());
+    initialized_ = true;
+  }
+  else
+  {
+    Array<U const *> & compArray = components_.Get<Array<U const *>>();
+    compMan.GetComponents(&compArray, entityIds_.Begin(), entityIds_.Size());
+
+    Array<int> keptIndices;
+    keptIndices.Reserve(entityIds_.Size());
+
+    for (int i = 0; i < entityIds_.Size(); ++i)
+    {
+      if (compArray[i] != nullptr)
+        keptIndices.EmplaceBack(i);
+    }
+
+    if (keptIndices.Size() != entityIds_.Size())
+      KeepEntities(keptIndices);
+  }
+}
+
+//##############################################################################
+template <typename ... EntityComponents>
+void ComponentArray<EntityComponents...>::FillWithNulls(void)
+{
+  FillWithNullsInternal(TypeList<EntityComponents...>());
+}
+
+//##############################################################################
+// Storage hands out components in slot order, which only matches id order
+// until slots are reused. Sorts them into id order when it doesn't.
+template <typename ... EntityComponents>
+template <typename U>
+void ComponentArray<EntityComponents...>::SetEntities(Array<int> * entityIds,
+  Array<U const *> * components)
+{
+  if (!std::is_sorted(entityIds->Begin(), entityIds->End()))
+  {
+    Array<int> order;
+    order.Reserve(entityIds->Size());
+
+    for (int i = 0; i < entityIds->Size(); ++i)
+      order.EmplaceBack(i);
+
+    std::sort(order.Begin(), order.End(),
+      [entityIds](int lhs, int rhs)
+      {
+        return (*entityIds)[lhs] < (*entityIds)[rhs];
+      });
+
+    Array<int> sortedIds;
+    Array<U const *> sortedComponents;
+    sortedIds.Reserve(order.Size());
+    sortedComponents.Reserve(order.Size());
+
+    for (int index : order)
+    {
+      sortedIds.EmplaceBack((*entityIds)[index]);
+      sortedComponents.EmplaceBack((*components)[index]);
+    }
+
+    *entityIds = std::move(sortedIds);
+    *components = std::move(sortedComponents);
+  }
+
+  entityIds_.Clear();
+  entityIds_.Merge(entityIds->Begin(), entityIds->Size());
+}
+
+//##############################################################################
+template <typename ... EntityComponents>
+void ComponentArray<EntityComponents...>::KeepEntities(
+  Array<int> const & keptIndices)
+{
+  Array<int> entityIds;
+  entityIds.Reserve(keptIndices.Size());
+
+  for (int index : keptIndices)
+    entityIds.EmplaceBack(entityIds_[index]);
+
+  entityIds_.Clear();
+  entityIds_.Merge(entityIds.Begin(), entityIds.Size());
+
+  KeepEntitiesInternal(keptIndices, TypeList<EntityComponents...>());
+}
+
+//##############################################################################
+template <typename ... EntityComponents>
+template <typename Component, typename ... Remainder>
+void ComponentArray<EntityComponents...>::KeepEntitiesInternal(
+  Array<int> const & keptIndices, TypeList<Component, Remainder...> const &)
+{
+  Array<Component const *> & compArray =
+    components_.Get<Array<Component const *>>();
+
+  if (!compArray.Empty())
+  {
+    for (int i = 0; i < keptIndices.Size(); ++i)
+      compArray[i] = compArray[keptIndices[i]];
+
+    compArray.Resize(keptIndices.Size());
+  }
+
+  KeepEntitiesInternal(keptIndices, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... EntityComponents>
+void ComponentArray<EntityComponents...>::KeepEntitiesInternal(
+  Array<int> const &, TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... EntityComponents>
+template <typename Component, typename ... Remainder>
+void ComponentArray<EntityComponents...>::FillWithNullsInternal(
+  TypeList<Component, Remainder...> const &)
+{
+  Array<Component const *> & compArray =
     components_.Get<Array<Component const *>>();
 
-  ASSERT(compArray.Size() > entityIndex || compArray.Empty());
+  if (compArray.Empty())
+    compArray.Resize(entityIds_.Size());
+
+  FillWithNullsInternal(TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+void ComponentArray<Components...>::FillWithNullsInternal(TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename T>
+ComponentManager<T, SparseStorage>::FutureData::FutureData(int entityId,
+  T const & component) :
+  entityId(entityId),
+  component(component)
+{}
+
+//##############################################################################
+// Registered queries and runtime components are copied as well. The copied
+// queries read the copy's components, GetCopiedQuery() finds them.
+template <typename ... Components>
+EntityManager<Components...>::EntityManager(EntityManager const & other) :
+  componentManagers_(other.componentManagers_),
+  entityIds_(other.entityIds_),
+  newEntityIds_(other.newEntityIds_),
+  entitySlots_(other.entitySlots_),
+  enititiesToDestroy_(other.enititiesToDestroy_),
+  destroyMarks_(other.destroyMarks_),
+  changedEntityIds_(other.changedEntityIds_),
+  signatures_(other.signatures_),
+  relations_(other.relations_),
+  pendingRelations_(other.pendingRelations_),
+  commandBuffers_(other.commandBuffers_),
+  frame_(other.frame_),
+  history_(other.history_),
+  historyBegin_(other.historyBegin_),
+  historyEnd_(other.historyEnd_),
+  historySlotCount_(other.historySlotCount_)
+{
+  queries_.Reserve(other.queries_.Size());
+
+  for (QueryPtr const & query : other.queries_)
+  {
+    queries_.EmplaceBack(query->Clone());
+    queries_.GetBack()->Rebuild(*this);
+  }
+
+  runtimeComponents_.Reserve(other.runtimeComponents_.Size());
+
+  for (RuntimeComponentPtr const & runtimeComponent : other.runtimeComponents_)
+  {
+    runtimeComponents_.EmplaceBack(
+      new RuntimeComponentManager(*runtimeComponent));
+  }
+}
+
+//##############################################################################
+// Queries of this manager that were registered before are replaced by copies
+// of the other manager's queries.
+template <typename ... Components>
+EntityManager<Components...> & EntityManager<Components...>::operator =(
+  EntityManager const & other)
+{
+  if (this != &other)
+    *this = EntityManager(other);
+
+  return *this;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename ... EntityComponents>
+int EntityManager<Components...>::AddEntity(
+  EntityComponents const & ... components)
+{
+  static_assert(TypeSetIsSubset<
+    TypeSet<EntityComponents...>,
+    TypeSet<Components...>
+  >::value);
+
+  static_assert(sizeof...(EntityComponents) > 0);
+
+  int const entityId = GetNewEntityId();
+
+  AddComponents(entityId, components...);
+  GetChangedIds().EmplaceBack(entityId);
+
+  return entityId;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename ... EntityComponents, typename Generator>
+int EntityManager<Components...>::AddEntities(int count,
+  Generator const & generator)
+{
+  static_assert(TypeSetIsSubset<
+    TypeSet<EntityComponents...>,
+    TypeSet<Components...>
+  >::value);
+
+  static_assert(sizeof...(EntityComponents) > 0);
+
+  UniqueTuple<Array<EntityComponents>...> components(
+    Array<EntityComponents>(EntityComponents(), count)...);
+
+  for (int i = 0; i < count; ++i)
+    generator(i, components.Get<Array<EntityComponents>>()[i]...);
+
+  return AddEntities(components.Get<Array<EntityComponents>>()...);
+}
+
+//##############################################################################
+// Creates one entity per element and returns the first id, the rest follow it.
+// The ids reuse a run of freed slots when one fits, so spawning and destroying
+// in bulk doesn't use up the id space.
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+int EntityManager<Components...>::AddEntities(
+  Array<Component> const & components, Array<Remainder> const & ... remainder)
+{
+  static_assert(TypeSetIsSubset<
+    TypeSet<Component, Remainder...>,
+    TypeSet<Components...>
+  >::value);
+
+  int const count = components.Size();
+
+  if (count == 0)
+    return 0;
+
+  int const firstEntityId = GetNewEntityIds(count);
+
+  AddComponentArrays(firstEntityId, count, components, remainder...);
+
+  Array<int> & changedIds = GetChangedIds();
+  changedIds.Reserve(changedIds.Size() + count);
+
+  for (int i = 0; i < count; ++i)
+    changedIds.EmplaceBack(firstEntityId + i);
+
+  return firstEntityId;
+}
+
+//##############################################################################
+// Creates count entities with the prefab's components and returns the first
+// id, the rest follow it. The component values are handed to storage once for
+// the whole range instead of once per entity. Ids reuse freed slots like
+// AddEntities().
+template <typename ... Components>
+template <typename ... PrefabComponents>
+int EntityManager<Components...>::Instantiate(
+  Prefab<PrefabComponents...> const & prefab, int count)
+{
+  static_assert(TypeSetIsSubset<
+    TypeSet<PrefabComponents...>,
+    TypeSet<Components...>
+  >::value);
+
+  ASSERT(count >= 0);
+
+  if (count == 0)
+    return 0;
+
+  int const firstEntityId = GetNewEntityIds(count);
+
+  AddComponentCopies(firstEntityId, count,
+    prefab.GetComponent<PrefabComponents>()...);
+
+  Array<int> & changedIds = GetChangedIds();
+  changedIds.Reserve(changedIds.Size() + count);
+
+  for (int i = 0; i < count; ++i)
+    changedIds.EmplaceBack(firstEntityId + i);
+
+  return firstEntityId;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+void EntityManager<Components...>::AddComponent(int entityId,
+  U const & component)
+{
+  AddComponents(entityId, component);
+  GetChangedIds().EmplaceBack(entityId);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+void EntityManager<Components...>::RemoveComponent(int entityId)
+{
+  DestroyInternal(entityId, TypeList<U>());
+  GetChangedIds().EmplaceBack(entityId);
+}
+
+//##############################################################################
+template <typename ... Components>
+int EntityManager<Components...>::EntityCount(void) const
+{
+  return entityIds_.Size();
+}
+
+//##############################################################################
+template <typename ... Components>
+int EntityManager<Components...>::GetEntityId(int entityIndex) const
+{
+  ASSERT(entityIndex < entityIds_.Size());
+  ASSERT(entityIndex >= 0);
+
+  return entityIds_[entityIndex];
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+int EntityManager<Components...>::GetEntityId(U const * component) const
+{
+  return componentManagers_.Get<ComponentManager<U>>().GetEntityId(component);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+U const & EntityManager<Components...>::GetComponent(int entityId) const
+{
+  return componentManagers_.Get<ComponentManager<U>>().GetComponent(entityId);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+void
+  EntityManager<Components...>::SetComponent(int entityId, U const & component)
+{
+  componentManagers_.Get<ComponentManager<U>>().SetComponent(
+    entityId, component);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+U & EntityManager<Components...>::UpdateComponent(int entityId)
+{
+  return
+    componentManagers_.Get<ComponentManager<U>>().UpdateComponent(entityId);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+bool EntityManager<Components...>::HasSingleton(void) const
+{
+  return componentManagers_.Get<ComponentManager<U>>().HasValue();
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+U const & EntityManager<Components...>::GetSingleton(void) const
+{
+  return componentManagers_.Get<ComponentManager<U>>().GetValue();
+}
+
+//##############################################################################
+// Replaces the singleton's value on the next Advance(). U has to use
+// SingletonStorage.
+template <typename ... Components>
+template <typename U>
+void EntityManager<Components...>::SetSingleton(U const & value)
+{
+  componentManagers_.Get<ComponentManager<U>>().SetValue(value);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename ... EntityComponents>
+ComponentArray<Components ...>
+  EntityManager<Components...>::GetComponents(void) const
+{
+  ComponentArray<Components ...> result;
+
+  GetComponentsInternal(&result, TypeList<EntityComponents...>());
+
+  result.FillWithNulls();
+
+  return result;
+}
+
+//##############################################################################
+// Same join as GetComponents() without the arrays, see QueryView.
+template <typename ... Components>
+template <typename ... QueryComponents>
+QueryView<QueryComponents...> EntityManager<Components...>::Query(void) const
+{
+  static_assert(TypeSetIsSubset<
+    TypeSet<QueryComponents...>,
+    TypeSet<Components...>
+  >::value);
+
+  return QueryView<QueryComponents...>(
+    componentManagers_.Get<ComponentManager<QueryComponents>>()...);
+}
+
+//##############################################################################
+// Components of every entity matching a ComponentFilter, in id order. Matching
+// only tests each entity's signature against the filter's masks, the included
+// and optional components are then gathered for the matches alone. Optional
+// components an entity lacks are null.
+template <typename ... Components>
+template <typename Filter>
+ComponentArray<Components ...>
+  EntityManager<Components...>::GetMatchingComponents(void) const
+{
+  typedef ComponentFilterMasks<Filter, Components...> Masks;
+
+  ComponentArray<Components ...> result;
+
+  for (int entityId : entityIds_)
+  {
+    if (MatchesComponentMask(signatures_[GetEntityIndex(entityId)],
+      Masks::include, Masks::exclude))
+    {
+      result.entityIds_.Emplace(entityId);
+    }
+  }
+
+  result.initialized_ = true;
+
+  GatherComponentsInternal(&result, typename Filter::ReadTypes());
+
+  result.FillWithNulls();
+
+  return result;
+}
+
+//##############################################################################
+// Bit per component the entity had as of the last Advance().
+template <typename ... Components>
+ComponentMask EntityManager<Components...>::GetSignature(int entityId) const
+{
+  ASSERT(DoesEntityExist(entityId));
+
+  return signatures_[GetEntityIndex(entityId)];
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename ... QueryComponents>
+EntityQuery<EntityManager<Components...>, QueryComponents...> const &
+  EntityManager<Components...>::RegisterQuery(void)
+{
+  static_assert(TypeSetIsSubset<
+    TypeSet<QueryComponents...>,
+    TypeSet<Components...>
+  >::value);
+
+  static_assert(sizeof...(QueryComponents) > 0);
+
+  EntityQuery<EntityManager, QueryComponents...> * query =
+    new EntityQuery<EntityManager, QueryComponents...>();
+
+  queries_.EmplaceBack(query);
+  queries_.GetBack()->Rebuild(*this);
+
+  return *query;
+}
+
+//##############################################################################
+// Hashes the position of every entity with a U component into cells of
+// cellSize, wrapped onto cellCount by cellCount buckets. Kept up to date on
+// every Advance() and unregistered like a query.
+template <typename ... Components>
+template <typename U>
+SpatialIndex<EntityManager<Components...>, U> const &
+  EntityManager<Components...>::RegisterSpatialIndex(float cellSize,
+    int cellCount)
+{
+  static_assert(TypeSetIsSubset<
+    TypeSet<U>,
+    TypeSet<Components...>
+  >::value);
+
+  SpatialIndex<EntityManager, U> * index =
+    new SpatialIndex<EntityManager, U>(cellSize, cellCount);
+
+  queries_.EmplaceBack(index);
+  queries_.GetBack()->Rebuild(*this);
+
+  return *index;
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Components...>::UnregisterQuery(
+  IEntityQuery<EntityManager> const & query)
+{
+  QueryPtr * registered = queries_.FindFirst(
+    [&query](QueryPtr const & val)
+    {
+      return val.get() == &query;
+    });
+
+  ASSERT(registered, "Query was not registered with this entity manager");
+
+  queries_.Erase(registered);
+}
+
+//##############################################################################
+// Finds the copy of a query that was registered with source, when this manager
+// was copied from source. Queries are matched by registration order, so
+// neither manager may have registered or unregistered queries since the copy.
+template <typename ... Components>
+template <typename QueryType>
+QueryType const & EntityManager<Components...>::GetCopiedQuery(
+  EntityManager const & source, QueryType const & query) const
+{
+  ASSERT(queries_.Size() == source.queries_.Size(),
+    "Queries were registered or unregistered after the copy");
+
+  for (int i = 0; i < source.queries_.Size(); ++i)
+  {
+    if (source.queries_[i].get() == &query)
+      return static_cast<QueryType const &>(*queries_[i]);
+  }
+
+  ERROR("Query was not registered with the source entity manager");
+  return query;
+}
+
+//##############################################################################
+// Adds a component type that isn't known at compile time, for data driven
+// content. The returned manager stays valid for the entity manager's lifetime
+// and is committed, destroyed and saved along with the other components.
+// Runtime components aren't kept in history, Rewind() and Replay() can't be
+// used once one is registered.
+template <typename ... Components>
+RuntimeComponentManager &
+  EntityManager<Components...>::RegisterRuntimeComponent(Token name,
+  DataLayout const & layout, unsigned componentSize)
+{
+  ASSERT(!FindRuntimeComponent(name), "Runtime component name is taken");
+
+  runtimeComponents_.EmplaceBack(
+    new RuntimeComponentManager(name, layout, componentSize));
+
+  return *runtimeComponents_.GetBack();
+}
+
+//##############################################################################
+template <typename ... Components>
+RuntimeComponentManager *
+  EntityManager<Components...>::FindRuntimeComponent(Token name)
+{
+  RuntimeComponentPtr * found = runtimeComponents_.FindFirst(
+    [name](RuntimeComponentPtr const & val)
+    {
+      return val->GetName() == name;
+    });
+
+  return found ? found->get() : nullptr;
+}
+
+//##############################################################################
+template <typename ... Components>
+RuntimeComponentManager const *
+  EntityManager<Components...>::FindRuntimeComponent(Token name) const
+{
+  return const_cast<EntityManager *>(this)->FindRuntimeComponent(name);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+int EntityManager<Components...>::GetStorageVersion(void) const
+{
+  return componentManagers_.Get<ComponentManager<U>>().StorageVersion();
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+Array<int> const & EntityManager<Components...>::GetMovedEntityIds(void) const
+{
+  return componentManagers_.Get<ComponentManager<U>>().MovedEntityIds();
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Components...>::SetCompactionBudget(int budget)
+{
+  SetCompactionBudgetInternal(budget, TypeSet<Components...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+CompactionStats const &
+  EntityManager<Components...>::GetCompactionStats(void) const
+{
+  return componentManagers_.Get<ComponentManager<U>>().GetCompactionStats();
+}
+
+//##############################################################################
+// Number of times Advance() was called. Changes are stamped with the frame
+// they became visible on.
+template <typename ... Components>
+int EntityManager<Components...>::GetFrame(void) const
+{
+  return frame_;
+}
+
+//##############################################################################
+// Changes made visible by the last Advance().
+template <typename ... Components>
+template <typename U>
+ComponentChanges EntityManager<Components...>::GetChangedComponents(void) const
+{
+  return GetChangedComponents<U>(std::max(0, frame_ - 1));
+}
+
+//##############################################################################
+// Changes made visible after sinceFrame, up to ChangeHistoryFrames back. Added
+// and changed entities are only listed while they still have the component.
+template <typename ... Components>
+template <typename U>
+ComponentChanges
+  EntityManager<Components...>::GetChangedComponents(int sinceFrame) const
+{
+  ComponentManager<U> const & compMan =
+    componentManagers_.Get<ComponentManager<U>>();
+
+  ComponentChanges changes;
+  compMan.GetChangeLog().GetChanges(&changes, sinceFrame);
+
+  auto const isMissing =
+    [&compMan](int entityId)
+    {
+      return !compMan.ContainsComponent(entityId);
+    };
+
+  changes.added.Resize(int(std::remove_if(changes.added.Begin(),
+    changes.added.End(), isMissing) - changes.added.Begin()));
+  changes.changed.Resize(int(std::remove_if(changes.changed.Begin(),
+    changes.changed.End(), isMissing) - changes.changed.Begin()));
+
+  return changes;
+}
+
+//##############################################################################
+// Calls the function for every row of the query, split into jobs over the
+// pool. Jobs may write components and add or destroy entities and
+// components. Structural changes go to a command buffer per job and are
+// played back in job order once all jobs are done, so the pending changes
+// don't depend on which thread ran which rows. Entities created in a job get
+// placeholder ids that only that job's own calls understand, the real ids
+// are handed out in job order on playback and don't depend on timing either.
+// Can't be called from a job of the same pool, since waiting for the jobs
+// would wait on the caller as well, or from a scheduled system on any pool.
+template <typename ... Components>
+template <typename QueryType, typename Function>
+void EntityManager<Components...>::ParallelForEach(ThreadPool & pool,
+  QueryType const & query, Function const & function)
+{
+  ASSERT(!IsWritingFromJob(), "ParallelForEach can not be nested");
+  ASSERT(!RunningScheduledSystem(), "Systems can't call ParallelForEach");
+  ASSERT(!pool.IsRunningJob(), "ParallelForEach can't run in its own pool");
+
+  int const rowCount = query.EntityIds().Size();
+
+  if (rowCount == 0)
+    return;
+
+  int const jobCount = std::min(
+    (pool.WorkerCount() + 1) * ParallelJobsPerThread,
+    (rowCount + MinRowsPerParallelJob - 1) / MinRowsPerParallelJob);
+
+  //Buffer 0 is the serial buffer, each job gets its own after that
+  ReserveWriteBuffersInternal(jobCount + 1, TypeSet<Components...>());
+
+  for (RuntimeComponentPtr & runtimeComponent : runtimeComponents_)
+    runtimeComponent->ReserveWriteBuffers(jobCount + 1, this);
+
+  if (commandBuffers_.Size() < jobCount + 1)
+    commandBuffers_.Resize(jobCount + 1);
+
+  for (int job = 0; job < jobCount; ++job)
+  {
+    pool.Submit(
+      [this, &function, rowCount, jobCount, job](void)
+      {
+        int const begin = int(i64(rowCount) * job / jobCount);
+        int const end   = int(i64(rowCount) * (job + 1) / jobCount);
+
+        ScopedWriteBuffer const writeBuffer(this, job + 1);
+
+        for (int row = begin; row < end; ++row)
+          function(row);
+      });
+  }
+
+  pool.Wait();
+
+  PlayBackCommands();
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Components...>::DestroyEntity(int entityId)
+{
+  if (CommandBuffer * commands = GetCommandBuffer())
+  {
+    ASSERT(IsCommandEntityId(*commands, entityId));
+
+    commands->destroyedIds.EmplaceBack(entityId);
+    return;
+  }
+
+  ASSERT(DoesEntityExist(entityId));
+
+  int const entityIndex = GetEntityIndex(entityId);
+
+  if (!destroyMarks_.Get(entityIndex))
+  {
+    destroyMarks_.Set(entityIndex);
+    enititiesToDestroy_.EmplaceBack(entityId);
+    changedEntityIds_.EmplaceBack(entityId);
+
+    DestroyInternal(entityId, TypeSet<Components...>());
+
+    for (RuntimeComponentPtr & runtimeComponent : runtimeComponents_)
+      runtimeComponent->DestroyComponent(entityId);
+  }
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Components...>::DestroyEntities(
+  Array<int> const & entityIds)
+{
+  if (!GetCommandBuffer())
+    enititiesToDestroy_.Reserve(enititiesToDestroy_.Size() + entityIds.Size());
+
+  for (int entityId : entityIds)
+    DestroyEntity(entityId);
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Components...>::DestroyEntities(int firstEntityId,
+  int count)
+{
+  if (!GetCommandBuffer())
+    enititiesToDestroy_.Reserve(enititiesToDestroy_.Size() + count);
+
+  for (int i = 0; i < count; ++i)
+    DestroyEntity(firstEntityId + i);
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename U>
+bool EntityManager<Components...>::ContainsComponent(int entityId) const
+{
+  ASSERT(DoesEntityExist(entityId));
+
+  return
+    componentManagers_.Get<ComponentManager<U>>().ContainsComponent(entityId);
+}
+
+//##############################################################################
+template <typename ... Components>
+bool EntityManager<Components...>::DoesEntityExist(int entityId) const
+{
+  return entitySlots_.IsAlive(entityId);
+}
+
+//##############################################################################
+// Makes the child entity a child of the parent on the next Advance(), after
+// its existing children. A parent of 0 detaches it. Destroying an entity hands
+// its children to its own parent, so chains stay linked.
+template <typename ... Components>
+void EntityManager<Components...>::SetParent(int childId, int parentId)
+{
+  if (CommandBuffer * commands = GetCommandBuffer())
+  {
+    ASSERT(IsCommandEntityId(*commands, childId));
+    ASSERT(!parentId || IsCommandEntityId(*commands, parentId));
+
+    commands->relations.EmplaceBack(PendingRelation{ childId, parentId });
+    return;
+  }
+
+  ASSERT(DoesEntityExist(childId) || std::count(newEntityIds_.Begin(),
+    newEntityIds_.End(), childId));
+  ASSERT(!parentId || DoesEntityExist(parentId) || std::count(
+    newEntityIds_.Begin(), newEntityIds_.End(), parentId));
+
+  pendingRelations_.EmplaceBack(PendingRelation{ childId, parentId });
+}
+
+//##############################################################################
+template <typename ... Components>
+EntityRelations const & EntityManager<Components...>::GetRelations(void) const
+{
+  return relations_;
+}
+
+//##############################################################################
+// Components of the related entities in the order of GetRelations().EntityIds()
+// so parents can be read by row, null where an entity has none.
+template <typename ... Components>
+template <typename U>
+void EntityManager<Components...>::GetRelatedComponents(
+  Array<U const *> * components) const
+{
+  Array<int> const & entityIds = relations_.EntityIds();
+
+  componentManagers_.Get<ComponentManager<U>>().GetComponents(components,
+    entityIds.Begin(), entityIds.Size());
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Components...>::Advance()
+{
+  BeginAdvance();
+  CommitEntities();
+  AdvanceInternal(TypeSet<Components...>());
+
+  for (RuntimeComponentPtr & runtimeComponent : runtimeComponents_)
+    runtimeComponent->Advance(frame_);
+
+  EndAdvance();
+}
+
+//##############################################################################
+// Same as Advance(), but every component type is committed as its own job on
+// the pool, next to a job that commits the created and destroyed entities.
+// Component managers only touch their own storage, so the jobs share nothing.
+// Like ParallelForEach, it can't be called from a job of the same pool.
+template <typename ... Components>
+void EntityManager<Components...>::Advance(ThreadPool & pool)
+{
+  ASSERT(!pool.IsRunningJob(), "Advance can't run in a job of its pool");
+
+  BeginAdvance();
+
+  pool.Submit(
+    [this]()
+    {
+      CommitEntities();
+    });
+
+  AdvanceInternal(pool, TypeSet<Components...>());
+
+  for (RuntimeComponentPtr & runtimeComponent : runtimeComponents_)
+  {
+    RuntimeComponentManager * compMan = runtimeComponent.get();
+    int const frame = frame_;
+
+    pool.Submit(
+      [compMan, frame]()
+      {
+        compMan->Advance(frame);
+      });
+  }
+
+  pool.Wait();
+
+  EndAdvance();
+}
+
+//##############################################################################
+// Keeps what the last frameCount calls to Advance() changed so they can be
+// rewound and replayed, 0 turns history off. The cost is proportional to the
+// number of changes, not entities. Drops whatever was recorded so far.
+template <typename ... Components>
+void EntityManager<Components...>::SetHistoryFrames(int frameCount)
+{
+  ASSERT(frameCount >= 0);
+  ASSERT(!HasPendingChanges(), "Can't change history with changes pending");
+
+  history_.Clear();
+  history_.Resize(frameCount);
+  historyBegin_     = frame_;
+  historyEnd_       = frame_;
+  historySlotCount_ = entitySlots_.SlotCount();
+
+  SetHistoryFramesInternal(frameCount, TypeSet<Components...>());
+}
+
+//##############################################################################
+template <typename ... Components>
+int EntityManager<Components...>::RewindableFrames(void) const
+{
+  return frame_ - historyBegin_;
+}
+
+//##############################################################################
+// Frames that were rewound and not overwritten by a new Advance() yet.
+template <typename ... Components>
+int EntityManager<Components...>::ReplayableFrames(void) const
+{
+  return historyEnd_ - frame_;
+}
+
+//##############################################################################
+// Undoes the last frameCount frames, entities and components return to their
+// committed state and ids of that time. Has to be called between Advance()
+// calls with nothing pending. Advancing afterwards discards the rewound frames,
+// the same changes then hand out the same ids again.
+template <typename ... Components>
+void EntityManager<Components...>::Rewind(int frameCount)
+{
+  ASSERT(frameCount >= 0 && frameCount <= RewindableFrames());
+  ASSERT(!HasPendingChanges(), "Can't rewind over pending changes");
+  ASSERT(runtimeComponents_.Empty(), "Runtime components have no history");
+
+  for (int i = 0; i < frameCount; ++i)
+  {
+    HistoryFrame const & record = history_[frame_ % history_.Size()];
+
+    RewindInternal(frame_, TypeSet<Components...>());
+
+    relations_.Undo(record.relationChanges);
+
+    for (int j = record.destroyedIds.Size() - 1; j >= 0; --j)
+      entitySlots_.Revive(record.destroyedIds[j]);
+
+    for (int j = record.createdIds.Size() - 1; j >= 0; --j)
+      entitySlots_.Retract(record.createdIds[j]);
+
+    entitySlots_.Truncate(record.slotCount);
+
+    Array<int> createdIds = record.createdIds;
+    std::sort(createdIds.Begin(), createdIds.End());
+
+    entityIds_.EraseIf(
+      [&createdIds](int entityId)
+      {
+        return std::binary_search(createdIds.Begin(), createdIds.End(),
+          entityId);
+      });
+
+    Array<int> destroyedIds = record.destroyedIds;
+    std::sort(destroyedIds.Begin(), destroyedIds.End());
+    entityIds_.Merge(destroyedIds.Begin(), destroyedIds.Size());
+
+    for (int entityId : record.changedIds)
+      changedEntityIds_.EmplaceBack(entityId);
+
+    historySlotCount_ = record.slotCount;
+    --frame_;
+  }
+
+  relations_.UpdateOrder();
+  UpdateSignatures(changedEntityIds_);
+
+  for (QueryPtr & query : queries_)
+    query->Restore(*this, changedEntityIds_);
+
+  changedEntityIds_.Clear();
+}
+
+//##############################################################################
+// Redoes frameCount rewound frames exactly as they were first committed.
+template <typename ... Components>
+void EntityManager<Components...>::Replay(int frameCount)
+{
+  ASSERT(frameCount >= 0 && frameCount <= ReplayableFrames());
+  ASSERT(!HasPendingChanges(), "Can't replay over pending changes");
+  ASSERT(runtimeComponents_.Empty(), "Runtime components have no history");
+
+  for (int i = 0; i < frameCount; ++i)
+  {
+    ++frame_;
+
+    HistoryFrame const & record = history_[frame_ % history_.Size()];
+
+    for (int entityId : record.createdIds)
+    {
+      entitySlots_.Claim(entityId);
+      entitySlots_.Activate(entityId);
+    }
+
+    ASSERT(entitySlots_.SlotCount() == record.newSlotCount);
+
+    entitySlots_.Release(record.destroyedIds.Begin(),
+      record.destroyedIds.Size());
+
+    Array<int> destroyedIds = record.destroyedIds;
+    std::sort(destroyedIds.Begin(), destroyedIds.End());
+
+    entityIds_.EraseIf(
+      [&destroyedIds](int entityId)
+      {
+        return std::binary_search(destroyedIds.Begin(), destroyedIds.End(),
+          entityId);
+      });
+
+    Array<int> createdIds = record.createdIds;
+    std::sort(createdIds.Begin(), createdIds.End());
+    entityIds_.Merge(createdIds.Begin(), createdIds.Size());
+
+    ReplayInternal(frame_, TypeSet<Components...>());
+
+    relations_.Redo(record.relationChanges);
+
+    for (int entityId : record.changedIds)
+      changedEntityIds_.EmplaceBack(entityId);
+
+    historySlotCount_ = record.newSlotCount;
+  }
+
+  relations_.UpdateOrder();
+  UpdateSignatures(changedEntityIds_);
+
+  for (QueryPtr & query : queries_)
+    query->Restore(*this, changedEntityIds_);
+
+  changedEntityIds_.Clear();
+}
+
+//##############################################################################
+// Writes every committed entity and component to a single file. Changes made
+// since the last Advance() are not included.
+template <typename ... Components>
+bool EntityManager<Components...>::SaveSnapshot(char const * path) const
+{
+  ASSERT(path);
+
+  //Component sizes guard against loading a file written by another build
+  Array<u32> const layout = {u32(sizeof(Components))...};
+
+  SnapshotWriter writer;
+  writer.AddArray(layout);
+  writer.AddValue(frame_);
+  entitySlots_.SaveSnapshot(&writer);
+  writer.AddArray(entityIds_.Begin(), entityIds_.Size());
+  relations_.SaveSnapshot(&writer);
+
+  SaveSnapshotInternal(&writer, TypeSet<Components...>());
+
+  writer.AddValue(runtimeComponents_.Size());
+
+  for (RuntimeComponentPtr const & runtimeComponent : runtimeComponents_)
+    runtimeComponent->SaveSnapshot(&writer);
+
+  return writer.Save(path);
+}
+
+//##############################################################################
+// Replaces the whole manager with the contents of a snapshot. The manager is
+// left untouched if the file can't be read or doesn't match its components.
+// Registered queries are rebuilt, the change history starts over.
+template <typename ... Components>
+bool EntityManager<Components...>::LoadSnapshot(char const * path)
+{
+  ASSERT(path);
+
+  SnapshotReader reader;
+
+  if (!reader.Load(path))
+    return false;
+
+  Array<u32> const expectedLayout = {u32(sizeof(Components))...};
+  Array<u32> layout;
+
+  if (!reader.ReadArray(&layout) || !(layout == expectedLayout))
+    return false;
+
+  int               frame = 0;
+  EntitySlotTable   entitySlots;
+  Array<int>        entityIds;
+  EntityRelations   relations;
+  ComponentManagers componentManagers;
+
+  if (!reader.ReadValue(&frame) || !entitySlots.LoadSnapshot(&reader) ||
+    !reader.ReadArray(&entityIds) || !relations.LoadSnapshot(&reader))
+  {
+    return false;
+  }
+
+  if (!LoadSnapshotInternal(&componentManagers, &reader,
+    TypeSet<Components...>()))
+  {
+    return false;
+  }
+
+  //Runtime components have to be registered the same way before loading
+  int runtimeCount = 0;
+  Array<RuntimeComponentManager> runtimeComponents;
+
+  if (!reader.ReadValue(&runtimeCount) ||
+    runtimeCount != runtimeComponents_.Size())
+  {
+    return false;
+  }
+
+  for (RuntimeComponentPtr const & runtimeComponent : runtimeComponents_)
+  {
+    runtimeComponents.EmplaceBack(runtimeComponent->GetName(),
+      runtimeComponent->GetLayout(), runtimeComponent->ComponentSize());
+
+    if (!runtimeComponents.GetBack().LoadSnapshot(&reader))
+      return false;
+  }
+
+  for (int entityId : enititiesToDestroy_)
+    destroyMarks_.Unset(GetEntityIndex(entityId));
+
+  componentManagers_ = std::move(componentManagers);
+  entitySlots_       = std::move(entitySlots);
+  relations_         = std::move(relations);
+  frame_             = frame;
+
+  for (int i = 0; i < runtimeComponents.Size(); ++i)
+    *runtimeComponents_[i] = std::move(runtimeComponents[i]);
+
+  //History doesn't carry over, it restarts from the loaded frame
+  historyBegin_     = frame_;
+  historyEnd_       = frame_;
+  historySlotCount_ = entitySlots_.SlotCount();
+  SetHistoryFramesInternal(history_.Size(), TypeSet<Components...>());
+
+  entityIds_.Clear();
+  entityIds_.Merge(entityIds.Begin(), entityIds.Size());
+
+  newEntityIds_.Clear();
+  enititiesToDestroy_.Clear();
+  changedEntityIds_.Clear();
+  pendingRelations_.Clear();
+
+  signatures_.Clear();
+  UpdateSignatures(entityIds);
+
+  for (QueryPtr & query : queries_)
+    query->Rebuild(*this);
+
+  return true;
+}
+
+#if PROFILING_ENABLED
+//##############################################################################
+// Counters of the last ProfileFrames frames since profiling started or was
+// last cleared, oldest first.
+template <typename ... Components>
+template <typename U>
+Array<ComponentFrameProfile> EntityManager<Components...>::GetProfile(void)
+  const
+{
+  Array<ComponentFrameProfile> frames;
+  componentManagers_.Get<ComponentManager<U>>().GetProfiler().GetFrames(
+    &frames);
+
+  return frames;
+}
+
+//##############################################################################
+// Writes the counters of every component as comma separated values, one line
+// per component and frame, for comparing runs offline.
+template <typename ... Components>
+bool EntityManager<Components...>::SaveProfile(char const * path) const
+{
+  ASSERT(path);
+
+  std::FILE * file = std::fopen(path, "w");
+
+  if (!file)
+    return false;
+
+  bool const written = ComponentProfiler::WriteHeader(file) &&
+    SaveProfileInternal(file, TypeSet<Components...>());
+
+  return std::fclose(file) == 0 && written;
+}
+
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Components...>::ClearProfile(void)
+{
+  ClearProfileInternal(TypeSet<Components...>());
+}
+#endif
+
+//##############################################################################
+template <typename ... Components>
+bool EntityManager<Components...>::HasPendingChanges(void) const
+{
+  return !newEntityIds_.Empty() || !enititiesToDestroy_.Empty() ||
+    !changedEntityIds_.Empty() || !pendingRelations_.Empty();
+}
+
+//##############################################################################
+// Steps that have to see the entities as they were before the frame commits.
+template <typename ... Components>
+void EntityManager<Components...>::BeginAdvance(void)
+{
+  ASSERT(!RunningScheduledSystem(), "Systems can't advance the manager");
+
+  ++frame_;
+
+  if (!history_.Empty())
+    RecordHistoryFrame();
+
+  CommitRelations();
+}
+
+//##############################################################################
+// Applies the created and destroyed entities to the entity list and slots.
+template <typename ... Components>
+void EntityManager<Components...>::CommitEntities(void)
+{
+  if (!enititiesToDestroy_.Empty())
+  {
+    ON_DEBUG(int const erased =)
+      entityIds_.EraseIf(
+        [this](int entityId)
+        {
+          return destroyMarks_.Get(GetEntityIndex(entityId));
+        });
+
+    ASSERT(erased == enititiesToDestroy_.Size());
+
+    for (int entityId : enititiesToDestroy_)
+      destroyMarks_.Unset(GetEntityIndex(entityId));
+
+    entitySlots_.Release(enititiesToDestroy_.Begin(),
+      enititiesToDestroy_.Size());
+
+    enititiesToDestroy_.Clear();
+  }
+
+  for (int entityId : newEntityIds_)
+    entitySlots_.Activate(entityId);
+
+  //Fresh slots are handed out in increasing order, ids of reused slots carry
+  //a newer generation and sort after them
+  if (!std::is_sorted(newEntityIds_.Begin(), newEntityIds_.End()))
+    std::sort(newEntityIds_.Begin(), newEntityIds_.End());
+
+  entityIds_.Merge(newEntityIds_.Begin(), newEntityIds_.Size());
+
+  newEntityIds_.Clear();
+}
+
+//##############################################################################
+// Brings the signatures and queries up to date once everything is committed.
+template <typename ... Components>
+void EntityManager<Components...>::EndAdvance(void)
+{
+  UpdateSignatures(changedEntityIds_);
+
+  for (QueryPtr & query : queries_)
+    query->Update(*this, changedEntityIds_);
+
+  changedEntityIds_.Clear();
+}
+
+//##############################################################################
+// Called by Advance() before anything is committed, newEntityIds_ is still in
+// creation order.
+template <typename ... Components>
+void EntityManager<Components...>::RecordHistoryFrame(void)
+{
+  HistoryFrame & record = history_[frame_ % history_.Size()];
+
+  record.createdIds   = newEntityIds_;
+  record.destroyedIds = enititiesToDestroy_;
+  record.changedIds   = changedEntityIds_;
+  record.slotCount    = historySlotCount_;
+  record.newSlotCount = entitySlots_.SlotCount();
+  record.relationChanges.Clear();
+
+  historySlotCount_ = record.newSlotCount;
+  historyEnd_       = frame_;
+  historyBegin_     = std::max(historyBegin_, frame_ - history_.Size());
+}
+
+//##############################################################################
+// Command buffer of the running parallel job, null outside of jobs.
+template <typename ... Components>
+typename EntityManager<Components...>::CommandBuffer *
+  EntityManager<Components...>::GetCommandBuffer(void)
+{
+  int const writeBuffer = ActiveWriteBuffer(this);
+
+  if (writeBuffer == 0)
+    return nullptr;
+
+  ASSERT(writeBuffer < commandBuffers_.Size());
+
+  return &commandBuffers_[writeBuffer];
+}
+
+//##############################################################################
+template <typename ... Components>
+Array<int> & EntityManager<Components...>::GetChangedIds(void)
+{
+  CommandBuffer * commands = GetCommandBuffer();
+
+  return commands ? commands->changedIds : changedEntityIds_;
+}
+
+//##############################################################################
+// Whether a job's commands may name the id, a live entity or a placeholder the
+// same job handed out.
+template <typename ... Components>
+bool EntityManager<Components...>::IsCommandEntityId(
+  CommandBuffer const & commands, int entityId) const
+{
+  if (entityId >= 0)
+    return DoesEntityExist(entityId);
+
+  return entityId - ProvisionalEntityId < commands.createdIds.Size();
+}
+
+//##############################################################################
+// Real id of an id recorded in a job's command buffer, 0 for an entity the job
+// destroyed again.
+template <typename ... Components>
+int EntityManager<Components...>::ResolveEntityId(
+  CommandBuffer const & commands, int entityId) const
+{
+  if (entityId >= 0)
+    return entityId;
+
+  return commands.createdIds[entityId - ProvisionalEntityId];
+}
+
+//##############################################################################
+// Turns the recorded commands into pending changes, one buffer after the
+// other. The entities a job created get their slots here, in job order and
+// through the same reuse as serial creation. Within a buffer entities are
+// created first and destroyed last. An entity its own job destroyed again is
+// never created, and everything the job did to it is dropped.
+template <typename ... Components>
+void EntityManager<Components...>::PlayBackCommands(void)
+{
+  for (int i = 1; i < commandBuffers_.Size(); ++i)
+  {
+    CommandBuffer & commands = commandBuffers_[i];
+
+    for (int entityId : commands.destroyedIds)
+    {
+      if (entityId < 0)
+        commands.createdIds[entityId - ProvisionalEntityId] = 0;
+    }
+
+    for (int & entityId : commands.createdIds)
+    {
+      if (entityId != 0)
+      {
+        entityId = entitySlots_.Create();
+        newEntityIds_.EmplaceBack(entityId);
+      }
+    }
+
+    PlayBackInternal(&commands, TypeSet<Components...>());
+
+    for (int entityId : commands.changedIds)
+    {
+      if (int const resolvedId = ResolveEntityId(commands, entityId))
+        changedEntityIds_.EmplaceBack(resolvedId);
+    }
+
+    for (PendingRelation const & relation : commands.relations)
+    {
+      int const childId  = ResolveEntityId(commands, relation.childId);
+      int const parentId = ResolveEntityId(commands, relation.parentId);
+
+      if (childId && (parentId || !relation.parentId))
+        pendingRelations_.EmplaceBack(PendingRelation{ childId, parentId });
+    }
+
+    for (int entityId : commands.destroyedIds)
+    {
+      if (entityId >= 0)
+        DestroyEntity(entityId);
+    }
+
+    commands.createdIds.Clear();
+    commands.destroyedIds.Clear();
+    commands.changedIds.Clear();
+    commands.relations.Clear();
+  }
+}
+
+//##############################################################################
+// Applies the parents set this frame and unlinks destroyed entities. Frames
+// that change relations record the links of the entities they touched, from
+// before and after.
+template <typename ... Components>
+void EntityManager<Components...>::CommitRelations(void)
+{
+  bool changed = !pendingRelations_.Empty();
+
+  for (int i = 0; !changed && i < enititiesToDestroy_.Size(); ++i)
+    changed = relations_.Contains(enititiesToDestroy_[i]);
+
+  if (!changed)
+    return;
+
+  HistoryFrame * record =
+    history_.Empty() ? nullptr : &history_[frame_ % history_.Size()];
+
+  if (record)
+    relations_.BeginRecording();
+
+  for (PendingRelation const & relation : pendingRelations_)
+    relations_.SetParent(relation.childId, relation.parentId);
+
+  for (int entityId : enititiesToDestroy_)
+    relations_.Remove(entityId);
+
+  if (record)
+    relations_.EndRecording(&record->relationChanges);
+
+  relations_.UpdateOrder();
+
+  pendingRelations_.Clear();
+}
+
+//##############################################################################
+// Recomputes the signatures of the given entities after a commit. Ids that
+// are no longer alive are skipped, their slots get a new signature when they
+// are reused.
+template <typename ... Components>
+void EntityManager<Components...>::UpdateSignatures(
+  Array<int> const & entityIds)
+{
+  signatures_.Resize(entitySlots_.SlotCount());
+
+  for (int entityId : entityIds)
+  {
+    if (DoesEntityExist(entityId))
+    {
+      signatures_[GetEntityIndex(entityId)] =
+        GetSignatureInternal(entityId, TypeSet<Components...>());
+    }
+  }
+}
+
+//##############################################################################
+template <typename ... Components>
+int EntityManager<Components...>::GetNewEntityId(void)
+{
+  if (CommandBuffer * commands = GetCommandBuffer())
+  {
+    int const entityId = ProvisionalEntityId + commands->createdIds.Size();
+
+    commands->createdIds.EmplaceBack(entityId);
+
+    return entityId;
+  }
+
+  int const entityId = entitySlots_.Create();
+
+  newEntityIds_.EmplaceBack(entityId);
+
+  return entityId;
+}
+
+//##############################################################################
+template <typename ... Components>
+int EntityManager<Components...>::GetNewEntityIds(int count)
+{
+  if (CommandBuffer * commands = GetCommandBuffer())
+  {
+    int const firstEntityId =
+      ProvisionalEntityId + commands->createdIds.Size();
+
+    for (int i = 0; i < count; ++i)
+      commands->createdIds.EmplaceBack(firstEntityId + i);
+
+    return firstEntityId;
+  }
+
+  int const firstEntityId = entitySlots_.CreateRange(count);
+
+  newEntityIds_.Reserve(newEntityIds_.Size() + count);
+
+  for (int i = 0; i < count; ++i)
+    newEntityIds_.EmplaceBack(firstEntityId + i);
+
+  return firstEntityId;
+}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::AddComponents(int entityId,
+  Component const & component, Remainder const & ... remainder)
+{
+  if (CommandBuffer * commands = GetCommandBuffer())
+  {
+    ComponentCommands<Component> & componentCommands =
+      commands->components.Get<ComponentCommands<Component>>();
 
-  if (!compArray.Empty())
-    compArray.Erase(entityIndex);
+    componentCommands.added.EmplaceBack(
+      typename ComponentCommands<Component>::Added{ entityId, component });
+  }
+  else
+  {
+    componentManagers_.Get<ComponentManager<Component>>().AddComponent(
+      entityId, component);
+  }
 
-  RemoveEntityInternal(entityIndex, TypeList<Remainder...>());
+  AddComponents(entityId, remainder...);
 }
 
 //##############################################################################
-template <typename ... EntityComponents>
-void ComponentArray<EntityComponents...>::RemoveEntityInternal(int,
-  TypeList<> const &)
+template <typename ... Components>
+void EntityManager<Components...>::AddComponents(int)
 {}
 
 //##############################################################################
-template <typename ... EntityComponents>
+template <typename ... Components>
 template <typename Component, typename ... Remainder>
-void ComponentArray<EntityComponents...>::FillWithNullsInternal(
-  TypeList<Component, Remainder...> const &)
+void EntityManager<Components...>::AddComponentArrays(int firstEntityId,
+  int count, Array<Component> const & components,
+  Array<Remainder> const & ... remainder)
 {
-  Array<Component const *> & compArray =
-    components_.Get<Array<Component const *>>();
+  ASSERT(components.Size() == count);
 
-  if (compArray.Empty())
-    compArray.Resize(entityIds_.Size());
+  if (CommandBuffer * commands = GetCommandBuffer())
+  {
+    ComponentCommands<Component> & componentCommands =
+      commands->components.Get<ComponentCommands<Component>>();
 
-  FillWithNullsInternal(TypeList<Remainder...>());
+    typedef typename ComponentCommands<Component>::Added Added;
+
+    for (int i = 0; i < count; ++i)
+      componentCommands.added.EmplaceBack(Added{ firstEntityId + i,
+        components[i] });
+  }
+  else
+  {
+    componentManagers_.Get<ComponentManager<Component>>().AddComponents(
+      firstEntityId, components.Begin(), count);
+  }
+
+  AddComponentArrays(firstEntityId, count, remainder...);
 }
 
 //##############################################################################
 template <typename ... Components>
-void ComponentArray<Components...>::FillWithNullsInternal(TypeList<> const &)
-{}
-
-//##############################################################################
-template <typename T>
-ComponentManager<T>::FutureData::FutureData(int entityId, T const & component) :
-  entityId(entityId),
-  component(component)
+void EntityManager<Components...>::AddComponentArrays(int, int)
 {}
 
 //##############################################################################
 template <typename ... Components>
-template <typename ... EntityComponents>
-int EntityManager<Components...>::AddEntity(
-  EntityComponents const & ... components)
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::AddComponentCopies(int firstEntityId,
+  int count, Component const & component, Remainder const & ... remainder)
 {
-  static_assert(TypeSetIsSubset<
-    TypeSet<EntityComponents...>,
-    TypeSet<Components...>
-  >::value);
-
-  static_assert(sizeof...(EntityComponents) > 0);
+  if (CommandBuffer * commands = GetCommandBuffer())
+  {
+    ComponentCommands<Component> & componentCommands =
+      commands->components.Get<ComponentCommands<Component>>();
 
-  int const entityId = GetNewEntityId();
+    typedef typename ComponentCommands<Component>::Filled Filled;
 
-  AddComponents(entityId, components...);
+    componentCommands.filled.EmplaceBack(
+      Filled{ firstEntityId, count, component });
+  }
+  else
+  {
+    componentManagers_.Get<ComponentManager<Component>>().FillComponents(
+      firstEntityId, component, count);
+  }
 
-  return entityId;
+  AddComponentCopies(firstEntityId, count, remainder...);
 }
 
 //##############################################################################
 template <typename ... Components>
-template <typename U>
-void EntityManager<Components...>::AddComponent(int entityId,
-  U const & component)
-{
-  AddComponents(entityId, component);
-}
+void EntityManager<Components...>::AddComponentCopies(int, int)
+{}
 
 //##############################################################################
 template <typename ... Components>
-template <typename U>
-void EntityManager<Components...>::RemoveComponent(int entityId)
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::AdvanceInternal(
+  TypeList<Component, Remainder...> const &)
 {
-  DestroyInternal(entityId, TypeList<U>());
+  componentManagers_.Get<ComponentManager<Component>>().Advance(frame_);
+
+  AdvanceInternal(TypeSet<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-int EntityManager<Components...>::EntityCount(void) const
-{
-  return entityIds_.Size();
-}
+void EntityManager<Components...>::AdvanceInternal(TypeList<> const &)
+{}
 
 //##############################################################################
 template <typename ... Components>
-int EntityManager<Components...>::GetEntityId(int entityIndex) const
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::AdvanceInternal(ThreadPool & pool,
+  TypeList<Component, Remainder...> const &)
 {
-  ASSERT(entityIndex < entityIds_.Size());
-  ASSERT(entityIndex >= 0);
+  ComponentManager<Component> & compMan =
+    componentManagers_.Get<ComponentManager<Component>>();
+  int const frame = frame_;
 
-  return entityIds_[entityIndex];
+  pool.Submit(
+    [&compMan, frame]()
+    {
+      compMan.Advance(frame);
+    });
+
+  AdvanceInternal(pool, TypeSet<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-template <typename U>
-int EntityManager<Components...>::GetEntityId(U const * component) const
+void EntityManager<Components...>::AdvanceInternal(ThreadPool &,
+  TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::GetComponentsInternal(
+  ComponentArray<Components ...> * compArray,
+  TypeList<Component, Remainder...> const &) const
 {
-  return componentManagers_.Get<ComponentManager<U>>().GetEntityId(component);
+  ASSERT(compArray);
+
+  ComponentManager<Component> const & compMan =
+    componentManagers_.Get<ComponentManager<Component>>();
+
+  ON_PROFILING(ProfileTimer timer;)
+
+  compArray->AddComponents(compMan);
+
+  ON_PROFILING(compMan.GetProfiler().AddJoin(timer.Lap(),
+    compArray->EntityIds().Size());)
+
+  GetComponentsInternal(compArray, TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-template <typename U>
-U const & EntityManager<Components...>::GetComponent(int entityId) const
+void EntityManager<Components...>::GetComponentsInternal(
+  ComponentArray<Components ...> *, TypeList<> const &) const
+{}
+
+//##############################################################################
+// Looks the component up for every entity already in the array, unlike
+// GetComponentsInternal() it doesn't drop entities without one.
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::GatherComponentsInternal(
+  ComponentArray<Components ...> * compArray,
+  TypeList<Component, Remainder...> const &) const
 {
-  return componentManagers_.Get<ComponentManager<U>>().GetComponent(entityId);
+  ASSERT(compArray);
+
+  componentManagers_.Get<ComponentManager<Component>>().GetComponents(
+    &compArray->components_.Get<Array<Component const *>>(),
+    compArray->entityIds_.Begin(), compArray->entityIds_.Size());
+
+  GatherComponentsInternal(compArray, TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-template <typename U>
-void
-  EntityManager<Components...>::SetComponent(int entityId, U const & component)
+void EntityManager<Components...>::GatherComponentsInternal(
+  ComponentArray<Components ...> *, TypeList<> const &) const
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+ComponentMask EntityManager<Components...>::GetSignatureInternal(int entityId,
+  TypeList<Component, Remainder...> const &) const
 {
-  componentManagers_.Get<ComponentManager<U>>().SetComponent(
-    entityId, component);
+  ComponentMask const bit =
+    componentManagers_.Get<ComponentManager<Component>>().ContainsComponent(
+      entityId) ? ComponentBit<Component, Components...>::value : 0;
+
+  return bit | GetSignatureInternal(entityId, TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-template <typename U>
-U & EntityManager<Components...>::UpdateComponent(int entityId)
+ComponentMask EntityManager<Components...>::GetSignatureInternal(int,
+  TypeList<> const &) const
 {
-  return
-    componentManagers_.Get<ComponentManager<U>>().UpdateComponent(entityId);
+  return 0;
 }
 
 //##############################################################################
 template <typename ... Components>
-template <typename ... EntityComponents>
-ComponentArray<Components ...>
-  EntityManager<Components...>::GetComponents(void) const
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::ReserveWriteBuffersInternal(int bufferCount,
+  TypeList<Component, Remainder...> const &)
 {
-  ComponentArray<Components ...> result;
-
-  GetComponentsInternal(&result, TypeList<EntityComponents...>());
-
-  result.FillWithNulls();
+  componentManagers_.Get<ComponentManager<Component>>().ReserveWriteBuffers(
+    bufferCount, this);
 
-  return result;
+  ReserveWriteBuffersInternal(bufferCount, TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-void EntityManager<Components...>::DestroyEntity(int entityId)
+void EntityManager<Components...>::ReserveWriteBuffersInternal(int,
+  TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::PlayBackInternal(CommandBuffer * commands,
+  TypeList<Component, Remainder...> const &)
 {
-  ASSERT(entityIds_.Contains(entityId));
+  ASSERT(commands);
 
-  if (!enititiesToDestroy_.Contains(entityId))
+  ComponentCommands<Component> & componentCommands =
+    commands->components.Get<ComponentCommands<Component>>();
+  ComponentManager<Component> & compMan =
+    componentManagers_.Get<ComponentManager<Component>>();
+
+  for (auto const & added : componentCommands.added)
   {
-    enititiesToDestroy_.EmplaceBack(entityId);
+    if (int const entityId = ResolveEntityId(*commands, added.entityId))
+      compMan.AddComponent(entityId, added.component);
+  }
 
-    DestroyInternal(entityId, TypeSet<Components...>());
+  //Placeholders resolve to consecutive ids unless a destroyed one or a reused
+  //slot breaks the run, each run becomes one fill
+  for (auto const & filled : componentCommands.filled)
+  {
+    int runStart = 0;
+    int runCount = 0;
+
+    for (int i = 0; i < filled.count; ++i)
+    {
+      int const entityId =
+        ResolveEntityId(*commands, filled.firstEntityId + i);
+
+      if (runCount > 0 && entityId == runStart + runCount)
+      {
+        ++runCount;
+        continue;
+      }
+
+      if (runCount > 0)
+        compMan.FillComponents(runStart, filled.component, runCount);
+
+      runStart = entityId;
+      runCount = entityId ? 1 : 0;
+    }
+
+    if (runCount > 0)
+      compMan.FillComponents(runStart, filled.component, runCount);
+  }
+
+  for (int entityId : componentCommands.removedIds)
+  {
+    if (int const resolvedId = ResolveEntityId(*commands, entityId))
+      compMan.DestroyComponent(resolvedId);
   }
+
+  componentCommands.added.Clear();
+  componentCommands.filled.Clear();
+  componentCommands.removedIds.Clear();
+
+  PlayBackInternal(commands, TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-template <typename U>
-bool EntityManager<Components...>::ContainsComponent(int entityId) const
+void EntityManager<Components...>::PlayBackInternal(CommandBuffer *,
+  TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::SetCompactionBudgetInternal(int budget,
+  TypeList<Component, Remainder...> const &)
 {
-  ASSERT(entityIds_.Contains(entityId));
+  componentManagers_.Get<ComponentManager<Component>>().SetCompactionBudget(
+    budget);
 
-  return
-    componentManagers_.Get<ComponentManager<U>>().ContainsComponent(entityId);
+  SetCompactionBudgetInternal(budget, TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-bool EntityManager<Components...>::DoesEntityExist(int entityId) const
+void EntityManager<Components...>::SetCompactionBudgetInternal(int,
+  TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::SetHistoryFramesInternal(int frameCount,
+  TypeList<Component, Remainder...> const &)
 {
-  return entityIds_.Contains(entityId);
+  componentManagers_.Get<ComponentManager<Component>>().SetHistoryFrames(
+    frameCount);
+
+  SetHistoryFramesInternal(frameCount, TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-void EntityManager<Components...>::Advance()
-{
-  for (int entityId : enititiesToDestroy_)
-  {
-    ASSERT(entityIds_.Contains(entityId));
-    entityIds_.Erase(entityIds_.Find(entityId));
-  }
+void EntityManager<Components...>::SetHistoryFramesInternal(int,
+  TypeList<> const &)
+{}
 
-  enititiesToDestroy_.Clear();
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::RewindInternal(int frame,
+  TypeList<Component, Remainder...> const &)
+{
+  componentManagers_.Get<ComponentManager<Component>>().Rewind(frame);
 
-  entityIds_.Reserve(entityIds_.Size() + newEntityIds_.Size());
+  RewindInternal(frame, TypeList<Remainder...>());
+}
 
-  for (int entityId : newEntityIds_)
-    entityIds_.Emplace(entityId);
+//##############################################################################
+template <typename ... Components>
+void EntityManager<Components...>::RewindInternal(int, TypeList<> const &)
+{}
 
-  newEntityIds_.Clear();
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+void EntityManager<Components...>::ReplayInternal(int frame,
+  TypeList<Component, Remainder...> const &)
+{
+  componentManagers_.Get<ComponentManager<Component>>().Replay(frame);
 
-  AdvanceInternal(TypeSet<Components...>());
+  ReplayInternal(frame, TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-int EntityManager<Components...>::GetNewEntityId(void)
+void EntityManager<Components...>::ReplayInternal(int, TypeList<> const &)
+{}
+
+#if PROFILING_ENABLED
+//##############################################################################
+template <typename ... Components>
+template <typename Component, typename ... Remainder>
+bool EntityManager<Components...>::SaveProfileInternal(std::FILE * file,
+  TypeList<Component, Remainder...> const &) const
 {
-  if (nextEntityId_ == 0)
-    ++nextEntityId_;
+  ComponentProfiler const & profiler =
+    componentManagers_.Get<ComponentManager<Component>>().GetProfiler();
 
-  newEntityIds_.EmplaceBack(nextEntityId_);
+  return profiler.Write(file, GetTypeIndex<Component>().name()) &&
+    SaveProfileInternal(file, TypeList<Remainder...>());
+}
 
-  return nextEntityId_++;
+//##############################################################################
+template <typename ... Components>
+bool EntityManager<Components...>::SaveProfileInternal(std::FILE *,
+  TypeList<> const &) const
+{
+  return true;
 }
 
 //##############################################################################
 template <typename ... Components>
 template <typename Component, typename ... Remainder>
-void EntityManager<Components...>::AddComponents(int entityId,
-  Component const & component, Remainder const & ... remainder)
+void EntityManager<Components...>::ClearProfileInternal(
+  TypeList<Component, Remainder...> const &)
 {
-  componentManagers_.Get<ComponentManager<Component>>().AddComponent(entityId,
-    component);
+  componentManagers_.Get<ComponentManager<Component>>().GetProfiler().Clear();
 
-  AddComponents(entityId, remainder...);
+  ClearProfileInternal(TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-void EntityManager<Components...>::AddComponents(int)
+void EntityManager<Components...>::ClearProfileInternal(TypeList<> const &)
 {}
+#endif
 
 //##############################################################################
 template <typename ... Components>
 template <typename Component, typename ... Remainder>
-void EntityManager<Components...>::AdvanceInternal(
-  TypeList<Component, Remainder...> const &)
+void EntityManager<Components...>::SaveSnapshotInternal(
+  SnapshotWriter * writer, TypeList<Component, Remainder...> const &) const
 {
-  componentManagers_.Get<ComponentManager<Component>>().Advance();
+  componentManagers_.Get<ComponentManager<Component>>().SaveSnapshot(writer);
 
-  AdvanceInternal(TypeSet<Remainder...>());
+  SaveSnapshotInternal(writer, TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-void EntityManager<Components...>::AdvanceInternal(TypeList<> const &)
+void EntityManager<Components...>::SaveSnapshotInternal(SnapshotWriter *,
+  TypeList<> const &) const
 {}
 
 //##############################################################################
 template <typename ... Components>
 template <typename Component, typename ... Remainder>
-void EntityManager<Components...>::GetComponentsInternal(
-  ComponentArray<Components ...> * compArray,
-  TypeList<Component, Remainder...> const &) const
+bool EntityManager<Components...>::LoadSnapshotInternal(
+  ComponentManagers * componentManagers, SnapshotReader * reader,
+  TypeList<Component, Remainder...> const &)
 {
-  ASSERT(compArray);
-
-  compArray->AddComponents(
-    componentManagers_.Get<ComponentManager<Component>>());
+  if (!componentManagers->Get<ComponentManager<Component>>().LoadSnapshot(
+    reader))
+  {
+    return false;
+  }
 
-  GetComponentsInternal(compArray, TypeList<Remainder...>());
+  return LoadSnapshotInternal(componentManagers, reader,
+    TypeList<Remainder...>());
 }
 
 //##############################################################################
 template <typename ... Components>
-void EntityManager<Components...>::GetComponentsInternal(
-  ComponentArray<Components ...> *, TypeList<> const &) const
-{}
+bool EntityManager<Components...>::LoadSnapshotInternal(ComponentManagers *,
+  SnapshotReader *, TypeList<> const &)
+{
+  return true;
+}
 
 //##############################################################################
 template <typename ... Components>
@@ -716,8 +3360,16 @@ template <typename Component, typename ... Remainder>
 void EntityManager<Components...>::DestroyInternal(int entityId,
   TypeList<Component, Remainder...> const &)
 {
-  componentManagers_.Get<ComponentManager<Component>>().DestroyComponent(
-    entityId);
+  if (CommandBuffer * commands = GetCommandBuffer())
+  {
+    commands->components.Get<ComponentCommands<Component>>().removedIds
+      .EmplaceBack(entityId);
+  }
+  else
+  {
+    componentManagers_.Get<ComponentManager<Component>>().DestroyComponent(
+      entityId);
+  }
 
   DestroyInternal(entityId, TypeSet<Remainder...>());
 }
@@ -0,0 +1,352 @@
+#ifndef ENGINE_SYSTEM_ENTITYQUERY_H
+#define ENGINE_SYSTEM_ENTITYQUERY_H
+
+#include "system/EntityId.h"
+#include "utility/containers/Array.h"
+#include "utility/containers/SparseSet.h"
+#include "utility/containers/Tuple.h"
+#include "utility/Debug.h"
+#include "utility/TemplateTools.h"
+
+//##############################################################################
+template <typename Manager>
+struct IEntityQuery;
+
+template <typename Manager, typename ... QueryComponents>
+class EntityQuery;
+
+//##############################################################################
+template <typename Manager>
+struct IEntityQuery
+{
+public:
+  virtual ~IEntityQuery(void) {}
+
+private:
+  friend Manager;
+
+  //Same query without any rows, for a copy of the manager to rebuild
+  virtual IEntityQuery * Clone(void) const = 0;
+
+  virtual void Rebuild(Manager const & manager) = 0;
+  virtual void Update(Manager const & manager,
+    Array<int> const & changedEntityIds) = 0;
+
+  //Called instead of Update() after history was rewound or replayed, when
+  //only the changed entities are known and not what changed about them
+  virtual void Restore(Manager const & manager,
+    Array<int> const & changedEntityIds)
+  {
+    Update(manager, changedEntityIds);
+  }
+};
+
+//##############################################################################
+// Persistent result of a component join, owned by the entity manager that
+// registered it. Rows are patched on every Advance() with only the entities
+// whose component set changed, so rows are not kept in entity id order.
+template <typename Manager, typename ... QueryComponents>
+class EntityQuery : public IEntityQuery<Manager>
+{
+public:
+  EntityQuery(void) = default;
+
+  virtual ~EntityQuery(void) override = default;
+
+  int Size(void) const;
+  bool Contains(int entityId) const;
+
+  Array<int> const & EntityIds(void) const;
+
+  template <typename U>
+  Array<U const *> const & Components(void) const;
+
+private:
+  virtual IEntityQuery<Manager> * Clone(void) const override;
+
+  virtual void Rebuild(Manager const & manager) override;
+  virtual void Update(Manager const & manager,
+    Array<int> const & changedEntityIds) override;
+
+  bool Matches(Manager const & manager, int entityId) const;
+
+  void AddRow(Manager const & manager, int entityId);
+  void RemoveRow(int entityId);
+
+  template <typename Component, typename ... Remainder>
+  bool MatchesInternal(Manager const & manager, int entityId,
+    TypeList<Component, Remainder...> const &) const;
+
+  bool MatchesInternal(Manager const &, int, TypeList<> const &) const;
+
+  template <typename Component, typename ... Remainder>
+  void AddRowInternal(Manager const & manager, int entityId,
+    TypeList<Component, Remainder...> const &);
+
+  void AddRowInternal(Manager const &, int, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void SetRowInternal(Manager const & manager, int row,
+    TypeList<Component, Remainder...> const &);
+
+  void SetRowInternal(Manager const &, int, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void RemoveRowInternal(int row, TypeList<Component, Remainder...> const &);
+
+  void RemoveRowInternal(int, TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  void RefreshMovedComponents(Manager const & manager,
+    TypeList<Component, Remainder...> const &);
+
+  void RefreshMovedComponents(Manager const &, TypeList<> const &);
+
+  SparseSet<int>                                 rows_;
+  Array<int>                                     entityIds_;
+  UniqueTuple<Array<QueryComponents const *>...> components_;
+  Array<int>                                     storageVersions_;
+};
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+int EntityQuery<Manager, QueryComponents...>::Size(void) const
+{
+  return entityIds_.Size();
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+bool EntityQuery<Manager, QueryComponents...>::Contains(int entityId) const
+{
+  int const * row = rows_.Find(GetEntityIndex(entityId));
+
+  return row && entityIds_[*row] == entityId;
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+Array<int> const & EntityQuery<Manager, QueryComponents...>::EntityIds(void)
+  const
+{
+  return entityIds_;
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+template <typename U>
+Array<U const *> const &
+  EntityQuery<Manager, QueryComponents...>::Components(void) const
+{
+  return components_.Get<Array<U const *>>();
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+IEntityQuery<Manager> * EntityQuery<Manager, QueryComponents...>::Clone(void)
+  const
+{
+  return new EntityQuery();
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+void EntityQuery<Manager, QueryComponents...>::Rebuild(Manager const & manager)
+{
+  while (!entityIds_.Empty())
+    RemoveRow(entityIds_.GetBack());
+
+  storageVersions_ = Array<int>(0, int(sizeof...(QueryComponents)));
+  RefreshMovedComponents(manager, TypeList<QueryComponents...>());
+
+  for (int i = 0; i < manager.EntityCount(); ++i)
+  {
+    int const entityId = manager.GetEntityId(i);
+
+    if (Matches(manager, entityId))
+      AddRow(manager, entityId);
+  }
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+void EntityQuery<Manager, QueryComponents...>::Update(Manager const & manager,
+  Array<int> const & changedEntityIds)
+{
+  for (int entityId : changedEntityIds)
+  {
+    bool const matches = Matches(manager, entityId);
+    int const * row = rows_.Find(GetEntityIndex(entityId));
+
+    if (matches && row)
+      SetRowInternal(manager, *row, TypeList<QueryComponents...>());
+    else if (matches)
+      AddRow(manager, entityId);
+    else if (row)
+      RemoveRow(entityId);
+  }
+
+  RefreshMovedComponents(manager, TypeList<QueryComponents...>());
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+bool EntityQuery<Manager, QueryComponents...>::Matches(
+  Manager const & manager, int entityId) const
+{
+  return manager.DoesEntityExist(entityId) &&
+    MatchesInternal(manager, entityId, TypeList<QueryComponents...>());
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+void EntityQuery<Manager, QueryComponents...>::AddRow(Manager const & manager,
+  int entityId)
+{
+  rows_.Emplace(GetEntityIndex(entityId), entityIds_.Size());
+  entityIds_.EmplaceBack(entityId);
+
+  AddRowInternal(manager, entityId, TypeList<QueryComponents...>());
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+void EntityQuery<Manager, QueryComponents...>::RemoveRow(int entityId)
+{
+  int const entityIndex = GetEntityIndex(entityId);
+  int const row = *rows_.Find(entityIndex);
+  int const lastRow = entityIds_.Size() - 1;
+
+  if (row != lastRow)
+  {
+    entityIds_[row] = entityIds_[lastRow];
+    *rows_.Find(GetEntityIndex(entityIds_[row])) = row;
+  }
+
+  entityIds_.PopBack();
+  rows_.Erase(entityIndex);
+
+  RemoveRowInternal(row, TypeList<QueryComponents...>());
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+template <typename Component, typename ... Remainder>
+bool EntityQuery<Manager, QueryComponents...>::MatchesInternal(
+  Manager const & manager, int entityId,
+  TypeList<Component, Remainder...> const &) const
+{
+  return manager.ContainsComponent<Component>(entityId) &&
+    MatchesInternal(manager, entityId, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+bool EntityQuery<Manager, QueryComponents...>::MatchesInternal(
+  Manager const &, int, TypeList<> const &) const
+{
+  return true;
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+template <typename Component, typename ... Remainder>
+void EntityQuery<Manager, QueryComponents...>::AddRowInternal(
+  Manager const & manager, int entityId,
+  TypeList<Component, Remainder...> const &)
+{
+  components_.Get<Array<Component const *>>().EmplaceBack(
+    &manager.GetComponent<Component>(entityId));
+
+  AddRowInternal(manager, entityId, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+void EntityQuery<Manager, QueryComponents...>::AddRowInternal(
+  Manager const &, int, TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+template <typename Component, typename ... Remainder>
+void EntityQuery<Manager, QueryComponents...>::SetRowInternal(
+  Manager const & manager, int row, TypeList<Component, Remainder...> const &)
+{
+  components_.Get<Array<Component const *>>()[row] =
+    &manager.GetComponent<Component>(entityIds_[row]);
+
+  SetRowInternal(manager, row, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+void EntityQuery<Manager, QueryComponents...>::SetRowInternal(
+  Manager const &, int, TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+template <typename Component, typename ... Remainder>
+void EntityQuery<Manager, QueryComponents...>::RemoveRowInternal(int row,
+  TypeList<Component, Remainder...> const &)
+{
+  Array<Component const *> & compArray =
+    components_.Get<Array<Component const *>>();
+
+  compArray[row] = compArray.GetBack();
+  compArray.PopBack();
+
+  RemoveRowInternal(row, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+void EntityQuery<Manager, QueryComponents...>::RemoveRowInternal(int,
+  TypeList<> const &)
+{}
+
+//##############################################################################
+// A new storage version means the storage was reallocated and every row is
+// fetched again. Otherwise only the rows of entities the manager reports as
+// moved are patched.
+template <typename Manager, typename ... QueryComponents>
+template <typename Component, typename ... Remainder>
+void EntityQuery<Manager, QueryComponents...>::RefreshMovedComponents(
+  Manager const & manager, TypeList<Component, Remainder...> const &)
+{
+  int const storageVersion = manager.GetStorageVersion<Component>();
+  int & knownVersion = storageVersions_[
+    TypeIndexInTypes<Component, QueryComponents...>::value];
+
+  Array<Component const *> & compArray =
+    components_.Get<Array<Component const *>>();
+
+  if (knownVersion != storageVersion)
+  {
+    for (int i = 0; i < entityIds_.Size(); ++i)
+      compArray[i] = &manager.GetComponent<Component>(entityIds_[i]);
+
+    knownVersion = storageVersion;
+  }
+  else
+  {
+    for (int entityId : manager.GetMovedEntityIds<Component>())
+    {
+      int const * row = rows_.Find(GetEntityIndex(entityId));
+
+      if (row && entityIds_[*row] == entityId)
+        compArray[*row] = &manager.GetComponent<Component>(entityId);
+    }
+  }
+
+  RefreshMovedComponents(manager, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename Manager, typename ... QueryComponents>
+void EntityQuery<Manager, QueryComponents...>::RefreshMovedComponents(
+  Manager const &, TypeList<> const &)
+{}
+
+#endif
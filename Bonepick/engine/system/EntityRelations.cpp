@@ -0,0 +1,438 @@
+#include "system/EntityRelations.h"
+
+#include "system/EntityId.h"
+#include "utility/Debug.h"
+#include "utility/Snapshot.h"
+
+//##############################################################################
+namespace
+{
+  //############################################################################
+  bool SameLinks(EntityRelations::Links const & links0,
+    EntityRelations::Links const & links1)
+  {
+    return links0.entityId == links1.entityId &&
+      links0.parent == links1.parent &&
+      links0.firstChild == links1.firstChild &&
+      links0.lastChild == links1.lastChild &&
+      links0.prevSibling == links1.prevSibling &&
+      links0.nextSibling == links1.nextSibling;
+  }
+}
+
+//##############################################################################
+// Appends the child to the children of the parent, a parent of 0 just
+// detaches it. An entity can't become its own ancestor.
+void EntityRelations::SetParent(int childId, int parentId)
+{
+  ASSERT(childId);
+  ASSERT(childId != parentId);
+  ASSERT(!parentId || !IsAncestor(childId, parentId),
+    "Relations can't contain cycles");
+
+  //Both entries have to exist before holding references into the set
+  if (parentId)
+    GetLinks(parentId);
+
+  Links & child = GetLinks(childId);
+  Detach(child);
+
+  orderDirty_ = true;
+
+  if (!parentId)
+    return;
+
+  Links & parent = *links_.Find(GetEntityIndex(parentId));
+
+  child.parent      = parentId;
+  child.prevSibling = parent.lastChild;
+
+  if (parent.lastChild)
+    links_.Find(GetEntityIndex(parent.lastChild))->nextSibling = childId;
+  else
+    parent.firstChild = childId;
+
+  parent.lastChild = childId;
+}
+
+//##############################################################################
+// Drops the entity from the relations. Its children take its place under its
+// parent in the same order, so removing a link from the middle of a chain
+// joins the two ends. Children of a removed root become roots.
+void EntityRelations::Remove(int entityId)
+{
+  Links const * found = FindLinks(entityId);
+
+  if (!found)
+    return;
+
+  Links const removed = *found;
+
+  if (!removed.firstChild)
+    Detach(GetLinks(entityId));
+  else if (!removed.parent)
+  {
+    int childId = removed.firstChild;
+
+    while (childId)
+    {
+      Links & child = GetLinks(childId);
+      childId = child.nextSibling;
+
+      child.parent      = 0;
+      child.prevSibling = 0;
+      child.nextSibling = 0;
+    }
+  }
+  else
+  {
+    for (int childId = removed.firstChild; childId;
+      childId = GetLinks(childId).nextSibling)
+    {
+      GetLinks(childId).parent = removed.parent;
+    }
+
+    GetLinks(removed.firstChild).prevSibling = removed.prevSibling;
+    GetLinks(removed.lastChild).nextSibling  = removed.nextSibling;
+
+    Links & parent = GetLinks(removed.parent);
+
+    if (removed.prevSibling)
+      GetLinks(removed.prevSibling).nextSibling = removed.firstChild;
+    else
+      parent.firstChild = removed.firstChild;
+
+    if (removed.nextSibling)
+      GetLinks(removed.nextSibling).prevSibling = removed.lastChild;
+    else
+      parent.lastChild = removed.lastChild;
+  }
+
+  Touch(GetEntityIndex(entityId));
+  links_.Erase(GetEntityIndex(entityId));
+  orderDirty_ = true;
+}
+
+//##############################################################################
+void EntityRelations::Clear(void)
+{
+  links_.Clear();
+  order_.Clear();
+  parentRows_.Clear();
+  orderDirty_ = false;
+}
+
+//##############################################################################
+bool EntityRelations::Contains(int entityId) const
+{
+  return FindLinks(entityId) != nullptr;
+}
+
+//##############################################################################
+int EntityRelations::GetParent(int entityId) const
+{
+  Links const * links = FindLinks(entityId);
+
+  return links ? links->parent : 0;
+}
+
+//##############################################################################
+int EntityRelations::GetFirstChild(int entityId) const
+{
+  Links const * links = FindLinks(entityId);
+
+  return links ? links->firstChild : 0;
+}
+
+//##############################################################################
+int EntityRelations::GetLastChild(int entityId) const
+{
+  Links const * links = FindLinks(entityId);
+
+  return links ? links->lastChild : 0;
+}
+
+//##############################################################################
+int EntityRelations::GetNextSibling(int entityId) const
+{
+  Links const * links = FindLinks(entityId);
+
+  return links ? links->nextSibling : 0;
+}
+
+//##############################################################################
+int EntityRelations::GetPrevSibling(int entityId) const
+{
+  Links const * links = FindLinks(entityId);
+
+  return links ? links->prevSibling : 0;
+}
+
+//##############################################################################
+bool EntityRelations::IsAncestor(int ancestorId, int entityId) const
+{
+  for (int parentId = GetParent(entityId); parentId;
+    parentId = GetParent(parentId))
+  {
+    if (parentId == ancestorId)
+      return true;
+  }
+
+  return false;
+}
+
+//##############################################################################
+// Lays the entities out depth first, roots in id order and children in the
+// order they were attached. Only does work after the relations changed.
+void EntityRelations::UpdateOrder(void)
+{
+  if (!orderDirty_)
+    return;
+
+  orderDirty_ = false;
+
+  order_.Clear();
+  parentRows_.Clear();
+  order_.Reserve(links_.Size());
+  parentRows_.Reserve(links_.Size());
+
+  links_.Sort();
+
+  //Rows of the ancestors of the current entity
+  Array<int> ancestorRows;
+
+  for (int i = 0; i < links_.Size(); ++i)
+  {
+    if (links_.GetValue(i).parent)
+      continue;
+
+    int entityId = links_.GetValue(i).entityId;
+
+    while (entityId)
+    {
+      order_.EmplaceBack(entityId);
+      parentRows_.EmplaceBack(
+        ancestorRows.Empty() ? -1 : ancestorRows.GetBack());
+
+      Links const * links = FindLinks(entityId);
+
+      if (links->firstChild)
+      {
+        ancestorRows.EmplaceBack(order_.Size() - 1);
+        entityId = links->firstChild;
+        continue;
+      }
+
+      //Climb until an ancestor has a sibling left, or the root is done
+      entityId = 0;
+
+      while (links->parent && !links->nextSibling)
+      {
+        ancestorRows.PopBack();
+        links = FindLinks(links->parent);
+      }
+
+      if (links->parent)
+        entityId = links->nextSibling;
+    }
+
+    ASSERT(ancestorRows.Empty());
+  }
+}
+
+//##############################################################################
+// Starts remembering the links of every entity the following changes touch,
+// until EndRecording().
+void EntityRelations::BeginRecording(void)
+{
+  ASSERT(!recording_);
+
+  recording_ = true;
+}
+
+//##############################################################################
+// Hands out how the links changed since BeginRecording(), only for entities
+// whose links actually differ.
+void EntityRelations::EndRecording(Array<Change> * changes)
+{
+  ASSERT(changes);
+  ASSERT(recording_);
+
+  changes->Clear();
+
+  for (int i = 0; i < recorded_.Size(); ++i)
+  {
+    Change change = recorded_.GetValue(i);
+
+    if (Links const * links = links_.Find(change.entityIndex))
+    {
+      change.exists = true;
+      change.after  = *links;
+    }
+
+    if (change.existed != change.exists ||
+      (change.exists && !SameLinks(change.before, change.after)))
+    {
+      changes->EmplaceBack(change);
+    }
+  }
+
+  recorded_.Clear();
+  recording_ = false;
+}
+
+//##############################################################################
+// Puts back the links from before a recorded batch of changes. Batches have to
+// be undone newest first, and UpdateOrder() called afterwards.
+void EntityRelations::Undo(Array<Change> const & changes)
+{
+  for (Change const & change : changes)
+    SetLinks(change.entityIndex, change.existed, change.before);
+}
+
+//##############################################################################
+// Applies a recorded batch of changes again, after it was undone.
+void EntityRelations::Redo(Array<Change> const & changes)
+{
+  for (Change const & change : changes)
+    SetLinks(change.entityIndex, change.exists, change.after);
+}
+
+//##############################################################################
+// Every related entity in depth first order, as of the last UpdateOrder().
+Array<int> const & EntityRelations::EntityIds(void) const
+{
+  ASSERT(!orderDirty_, "Order is out of date");
+
+  return order_;
+}
+
+//##############################################################################
+// Row of the parent of every entity in EntityIds(), -1 for roots. Parents
+// always come before their children.
+Array<int> const & EntityRelations::ParentRows(void) const
+{
+  ASSERT(!orderDirty_, "Order is out of date");
+
+  return parentRows_;
+}
+
+//##############################################################################
+void EntityRelations::SaveSnapshot(SnapshotWriter * writer) const
+{
+  ASSERT(writer);
+
+  writer->AddArray(links_.Keys(), links_.Size());
+  writer->AddArray(links_.Values(), links_.Size());
+}
+
+//##############################################################################
+bool EntityRelations::LoadSnapshot(SnapshotReader * reader)
+{
+  ASSERT(reader);
+
+  Array<int>   keys;
+  Array<Links> values;
+
+  if (!reader->ReadArray(&keys) || !reader->ReadArray(&values))
+    return false;
+
+  if (keys.Size() != values.Size())
+    return false;
+
+  links_.Assign(keys.Begin(), values.Begin(), keys.Size());
+  orderDirty_ = true;
+  UpdateOrder();
+
+  return true;
+}
+
+//##############################################################################
+EntityRelations::Links & EntityRelations::GetLinks(int entityId)
+{
+  ASSERT(entityId);
+
+  int const entityIndex = GetEntityIndex(entityId);
+  Touch(entityIndex);
+
+  if (Links * links = links_.Find(entityIndex))
+  {
+    ASSERT(links->entityId == entityId, "Relation of a destroyed entity");
+    return *links;
+  }
+
+  Links & links = links_.Emplace(entityIndex);
+  links.entityId = entityId;
+
+  return links;
+}
+
+//##############################################################################
+EntityRelations::Links const * EntityRelations::FindLinks(int entityId) const
+{
+  Links const * links = links_.Find(GetEntityIndex(entityId));
+
+  if (links && links->entityId != entityId)
+    return nullptr;
+
+  return links;
+}
+
+//##############################################################################
+void EntityRelations::Detach(Links & links)
+{
+  if (!links.parent)
+    return;
+
+  Links & parent = GetLinks(links.parent);
+
+  if (links.prevSibling)
+    GetLinks(links.prevSibling).nextSibling = links.nextSibling;
+  else
+    parent.firstChild = links.nextSibling;
+
+  if (links.nextSibling)
+    GetLinks(links.nextSibling).prevSibling = links.prevSibling;
+  else
+    parent.lastChild = links.prevSibling;
+
+  links.parent      = 0;
+  links.prevSibling = 0;
+  links.nextSibling = 0;
+}
+
+//##############################################################################
+// Remembers the links of the entity from before the first change to it while
+// recording.
+void EntityRelations::Touch(int entityIndex)
+{
+  if (!recording_ || recorded_.Contains(entityIndex))
+    return;
+
+  Change & change = recorded_.Emplace(entityIndex);
+  change.entityIndex = entityIndex;
+
+  if (Links const * links = links_.Find(entityIndex))
+  {
+    change.existed = true;
+    change.before  = *links;
+  }
+}
+
+//##############################################################################
+void EntityRelations::SetLinks(int entityIndex, bool exists,
+  Links const & links)
+{
+  ASSERT(!recording_);
+
+  Links * found = links_.Find(entityIndex);
+
+  if (exists && found)
+    *found = links;
+  else if (exists)
+    links_.Emplace(entityIndex, links);
+  else if (found)
+    links_.Erase(entityIndex);
+
+  orderDirty_ = true;
+}
@@ -0,0 +1,82 @@
+#ifndef ENGINE_SYSTEM_ENTITYRELATIONS_H
+#define ENGINE_SYSTEM_ENTITYRELATIONS_H
+
+#include "utility/containers/Array.h"
+#include "utility/containers/SparseSet.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+//##############################################################################
+// Parent/child links between entities. Children keep the order they were
+// attached in, which makes a chain a parent/child path and lets one parent
+// own any number of children. Entities are also laid out in depth first order
+// with the row of their parent, so solvers can walk a hierarchy front to back
+// without looking entities up by id.
+class EntityRelations
+{
+public:
+  struct Links
+  {
+    int entityId    = 0;
+    int parent      = 0;
+    int firstChild  = 0;
+    int lastChild   = 0;
+    int prevSibling = 0;
+    int nextSibling = 0;
+  };
+
+  //Links of one entity before and after a recorded batch of changes
+  struct Change
+  {
+    int   entityIndex = 0;
+    bool  existed     = false;
+    bool  exists      = false;
+    Links before;
+    Links after;
+  };
+
+  void SetParent(int childId, int parentId);
+  void Remove(int entityId);
+  void Clear(void);
+
+  bool Contains(int entityId) const;
+
+  int GetParent(int entityId) const;
+  int GetFirstChild(int entityId) const;
+  int GetLastChild(int entityId) const;
+  int GetNextSibling(int entityId) const;
+  int GetPrevSibling(int entityId) const;
+
+  bool IsAncestor(int ancestorId, int entityId) const;
+
+  void UpdateOrder(void);
+
+  void BeginRecording(void);
+  void EndRecording(Array<Change> * changes);
+  void Undo(Array<Change> const & changes);
+  void Redo(Array<Change> const & changes);
+
+  Array<int> const & EntityIds(void) const;
+  Array<int> const & ParentRows(void) const;
+
+  void SaveSnapshot(SnapshotWriter * writer) const;
+  bool LoadSnapshot(SnapshotReader * reader);
+
+private:
+  Links & GetLinks(int entityId);
+  Links const * FindLinks(int entityId) const;
+
+  void Detach(Links & links);
+  void Touch(int entityIndex);
+  void SetLinks(int entityIndex, bool exists, Links const & links);
+
+  SparseSet<Links>  links_;
+  Array<int>        order_;
+  Array<int>        parentRows_;
+  bool              orderDirty_ = false;
+  bool              recording_  = false;
+  SparseSet<Change> recorded_;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef ENGINE_SYSTEM_PREFAB_H
+#define ENGINE_SYSTEM_PREFAB_H
+
+#include "utility/containers/Tuple.h"
+
+//##############################################################################
+template <typename ... PrefabComponents>
+class Prefab;
+
+//##############################################################################
+// A bundle of component values to stamp out many entities with. Every entity
+// EntityManager::Instantiate() makes from it starts with copies of these.
+template <typename ... PrefabComponents>
+class Prefab
+{
+public:
+  Prefab(PrefabComponents const & ... components);
+
+  template <typename U>
+  U const & GetComponent(void) const;
+
+  template <typename U>
+  void SetComponent(U const & component);
+
+private:
+  static_assert(sizeof...(PrefabComponents) > 0);
+
+  UniqueTuple<PrefabComponents...> components_;
+};
+
+//##############################################################################
+template <typename ... PrefabComponents>
+Prefab<PrefabComponents...>::Prefab(
+  PrefabComponents const & ... components) :
+  components_(PrefabComponents(components)...)
+{}
+
+//##############################################################################
+template <typename ... PrefabComponents>
+template <typename U>
+U const & Prefab<PrefabComponents...>::GetComponent(void) const
+{
+  return components_.Get<U>();
+}
+
+//##############################################################################
+template <typename ... PrefabComponents>
+template <typename U>
+void Prefab<PrefabComponents...>::SetComponent(U const & component)
+{
+  components_.Get<U>() = component;
+}
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef ENGINE_SYSTEM_QUERYVIEW_H
+#define ENGINE_SYSTEM_QUERYVIEW_H
+
+#include <tuple>
+#include <type_traits>
+
+#include "system/ComponentStorage.h"
+#include "utility/containers/Tuple.h"
+#include "utility/Debug.h"
+#include "utility/TemplateTools.h"
+
+//##############################################################################
+template <typename ... QueryComponents>
+class QueryView;
+
+//##############################################################################
+// Lazy join of the committed components of several types. Walks the
+// components of the type with the fewest of them in their storage's slot
+// order and looks the other types up by entity id, skipping entities that
+// lack one of them, so nothing is gathered up front. Writes only land on
+// Advance(), components can be written while walking but the view has to be
+// made again after Advance().
+//
+//   for (auto [transform, body] : manager.Query<Transform, Body>())
+//     ...
+template <typename ... QueryComponents>
+class QueryView
+{
+public:
+  typedef std::tuple<QueryComponents const & ...> Row;
+
+  class Iterator
+  {
+  public:
+    Row operator *(void) const;
+    Iterator & operator ++(void);
+
+    bool operator ==(Iterator const & iterator) const;
+    bool operator !=(Iterator const & iterator) const;
+
+  private:
+    friend class QueryView;
+
+    Iterator(QueryView const & view, int index);
+
+    void FindRow(void);
+
+    template <typename Component, typename ... Remainder>
+    bool FindRowInternal(int entityId,
+      TypeList<Component, Remainder...> const &);
+
+    bool FindRowInternal(int, TypeList<> const &);
+
+    QueryView const *                       view_;
+    int                                     index_;
+    UniqueTuple<QueryComponents const *...> row_;
+  };
+
+  QueryView(ComponentManager<QueryComponents> const & ... compMans);
+
+  Iterator begin(void) const;
+  Iterator end(void) const;
+
+private:
+  //Rows looked at ahead of the iterator, enough to hide a cache miss behind
+  //the lookups of the rows in between
+  static int const PrefetchDistance = 8;
+
+  template <typename Component>
+  bool IsDriver(void) const;
+
+  template <typename Component, typename ... Remainder>
+  void SelectDriver(TypeList<Component, Remainder...> const &);
+
+  void SelectDriver(TypeList<> const &);
+
+  template <typename Component, typename ... Remainder>
+  int GetDriverEntityId(int index,
+    TypeList<Component, Remainder...> const &) const;
+
+  int GetDriverEntityId(int, TypeList<> const &) const;
+
+  void Prefetch(int index) const;
+
+  template <typename Component, typename ... Remainder>
+  void PrefetchInternal(int index, int entityId,
+    TypeList<Component, Remainder...> const &) const;
+
+  void PrefetchInternal(int, int, TypeList<> const &) const;
+
+  UniqueTuple<ComponentManager<QueryComponents> const *...> compMans_;
+
+  //Position in QueryComponents of the type that is walked
+  int driver_      = 0;
+  int driverCount_ = 0;
+};
+
+//##############################################################################
+template <typename ... QueryComponents>
+typename QueryView<QueryComponents...>::Row
+  QueryView<QueryComponents...>::Iterator::operator *(void) const
+{
+  return Row(*row_.Get<QueryComponents const *>()...);
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+typename QueryView<QueryComponents...>::Iterator &
+  QueryView<QueryComponents...>::Iterator::operator ++(void)
+{
+  ++index_;
+  FindRow();
+
+  return *this;
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+bool QueryView<QueryComponents...>::Iterator::operator ==(
+  Iterator const & iterator) const
+{
+  return index_ == iterator.index_;
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+bool QueryView<QueryComponents...>::Iterator::operator !=(
+  Iterator const & iterator) const
+{
+  return index_ != iterator.index_;
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+QueryView<QueryComponents...>::Iterator::Iterator(QueryView const & view,
+  int index) :
+  view_(&view),
+  index_(index)
+{
+  FindRow();
+}
+
+//##############################################################################
+// Moves to the first index at or after the current one whose entity has every
+// component.
+template <typename ... QueryComponents>
+void QueryView<QueryComponents...>::Iterator::FindRow(void)
+{
+  for (; index_ < view_->driverCount_; ++index_)
+  {
+    view_->Prefetch(index_ + PrefetchDistance);
+
+    int const entityId =
+      view_->GetDriverEntityId(index_, TypeList<QueryComponents...>());
+
+    if (FindRowInternal(entityId, TypeList<QueryComponents...>()))
+      return;
+  }
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+template <typename Component, typename ... Remainder>
+bool QueryView<QueryComponents...>::Iterator::FindRowInternal(int entityId,
+  TypeList<Component, Remainder...> const &)
+{
+  ComponentManager<Component> const & compMan =
+    *view_->compMans_.Get<ComponentManager<Component> const *>();
+
+  Component const * component = view_->IsDriver<Component>() ?
+    compMan.GetComponentAt(index_) : compMan.FindComponent(entityId);
+
+  if (!component)
+    return false;
+
+  row_.Get<Component const *>() = component;
+
+  return FindRowInternal(entityId, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+bool QueryView<QueryComponents...>::Iterator::FindRowInternal(int,
+  TypeList<> const &)
+{
+  return true;
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+QueryView<QueryComponents...>::QueryView(
+  ComponentManager<QueryComponents> const & ... compMans) :
+  compMans_(&compMans...)
+{
+  SelectDriver(TypeList<QueryComponents...>());
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+typename QueryView<QueryComponents...>::Iterator
+  QueryView<QueryComponents...>::begin(void) const
+{
+  return Iterator(*this, 0);
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+typename QueryView<QueryComponents...>::Iterator
+  QueryView<QueryComponents...>::end(void) const
+{
+  return Iterator(*this, driverCount_);
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+template <typename Component>
+bool QueryView<QueryComponents...>::IsDriver(void) const
+{
+  return TypeIndexInTypes<Component, QueryComponents...>::value == driver_;
+}
+
+//##############################################################################
+// Every entity in the join has all of the types, so walking the type with the
+// fewest components does the fewest lookups that find nothing.
+template <typename ... QueryComponents>
+template <typename Component, typename ... Remainder>
+void QueryView<QueryComponents...>::SelectDriver(
+  TypeList<Component, Remainder...> const &)
+{
+  int const index = TypeIndexInTypes<Component, QueryComponents...>::value;
+  int const count =
+    compMans_.Get<ComponentManager<Component> const *>()->ComponentCount();
+
+  if (index == 0 || count < driverCount_)
+  {
+    driver_      = index;
+    driverCount_ = count;
+  }
+
+  SelectDriver(TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+void QueryView<QueryComponents...>::SelectDriver(TypeList<> const &)
+{}
+
+//##############################################################################
+template <typename ... QueryComponents>
+template <typename Component, typename ... Remainder>
+int QueryView<QueryComponents...>::GetDriverEntityId(int index,
+  TypeList<Component, Remainder...> const &) const
+{
+  if (IsDriver<Component>())
+  {
+    ComponentManager<Component> const & compMan =
+      *compMans_.Get<ComponentManager<Component> const *>();
+
+    return compMan.GetEntityIdAt(index);
+  }
+
+  return GetDriverEntityId(index, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+int QueryView<QueryComponents...>::GetDriverEntityId(int,
+  TypeList<> const &) const
+{
+  ASSERT(false, "Query has no driver");
+
+  return 0;
+}
+
+//##############################################################################
+// Only fetches what doesn't depend on another miss, the driver's row and the
+// sparse entries the other types find the entity's component through.
+template <typename ... QueryComponents>
+void QueryView<QueryComponents...>::Prefetch(int index) const
+{
+  if (index >= driverCount_)
+    return;
+
+  PrefetchInternal(index, GetDriverEntityId(index,
+    TypeList<QueryComponents...>()), TypeList<QueryComponents...>());
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+template <typename Component, typename ... Remainder>
+void QueryView<QueryComponents...>::PrefetchInternal(int index, int entityId,
+  TypeList<Component, Remainder...> const &) const
+{
+  ComponentManager<Component> const & compMan =
+    *compMans_.Get<ComponentManager<Component> const *>();
+
+  if (IsDriver<Component>())
+    PREFETCH(compMan.GetComponentAt(index));
+  else
+    compMan.PrefetchLookup(entityId);
+
+  PrefetchInternal(index, entityId, TypeList<Remainder...>());
+}
+
+//##############################################################################
+template <typename ... QueryComponents>
+void QueryView<QueryComponents...>::PrefetchInternal(int, int,
+  TypeList<> const &) const
+{}
+
+#endif
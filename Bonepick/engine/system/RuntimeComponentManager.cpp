@@ -0,0 +1,418 @@
+#include "system/RuntimeComponentManager.h"
+
+#include <cstring>
+#include <utility>
+
+#include "system/ComponentStorage.h"
+#include "system/EntityId.h"
+#include "utility/Snapshot.h"
+
+#if DEBUG_ENABLED
+namespace
+{
+  //############################################################################
+  // Only compiled where asserts are, the check has no other use.
+  bool FieldsFitComponent(DataLayout const & layout, unsigned componentSize)
+  {
+    for (auto const & field : layout)
+    {
+      if (field.value.size == 0 ||
+          field.value.offset + field.value.size > componentSize)
+        return false;
+    }
+
+    return true;
+  }
+}
+#endif
+
+//##############################################################################
+// componentSize is the row stride and has to cover every field, like sizeof of
+// the matching struct would, so every field needs its size in the layout.
+RuntimeComponentManager::RuntimeComponentManager(Token name,
+  DataLayout const & layout, unsigned componentSize) :
+  name_(name),
+  layout_(layout),
+  componentSize_(componentSize)
+{
+  ASSERT(componentSize > 0, "Runtime components need at least one byte");
+  ASSERT(FieldsFitComponent(layout_, componentSize),
+    "Field lies outside of the component");
+}
+
+//##############################################################################
+Token RuntimeComponentManager::GetName(void) const
+{
+  return name_;
+}
+
+//##############################################################################
+DataLayout const & RuntimeComponentManager::GetLayout(void) const
+{
+  return layout_;
+}
+
+//##############################################################################
+unsigned RuntimeComponentManager::ComponentSize(void) const
+{
+  return componentSize_;
+}
+
+//##############################################################################
+// Adds a component with every byte zeroed.
+void RuntimeComponentManager::AddComponent(int entityId)
+{
+  ASSERT(!IsWritingFromJob(), "Runtime components can't be added in jobs");
+  ASSERT(!ContainsComponent(entityId));
+
+  newIds_.EmplaceBack(entityId);
+  newData_.Resize(newData_.Size() + int(componentSize_), byte(0));
+}
+
+//##############################################################################
+void RuntimeComponentManager::AddComponent(int entityId,
+  void const * component)
+{
+  ASSERT(component);
+
+  AddComponent(entityId);
+  std::memcpy(newData_.End() - componentSize_, component, componentSize_);
+}
+
+//##############################################################################
+void RuntimeComponentManager::AddComponent(int entityId, Blob const & component)
+{
+  ASSERT(component.Size() == componentSize_, "Blob doesn't fit the component");
+
+  AddComponent(entityId, component.Data());
+}
+
+//##############################################################################
+void const * RuntimeComponentManager::GetComponent(int entityId) const
+{
+  int const * row = FindRow(entityId);
+  ASSERT(row);
+
+  return current_.Begin() + *row * componentSize_;
+}
+
+//##############################################################################
+void RuntimeComponentManager::SetComponent(int entityId,
+  void const * component)
+{
+  ASSERT(component);
+
+  std::memcpy(UpdateComponent(entityId), component, componentSize_);
+}
+
+//##############################################################################
+// Starts from the committed value, so single fields can be changed. Writing
+// the same component again in a frame keeps the earlier writes.
+void * RuntimeComponentManager::UpdateComponent(int entityId)
+{
+  int const * row = FindRow(entityId);
+  ASSERT(row);
+
+  return MarkWritten(*row);
+}
+
+//##############################################################################
+void RuntimeComponentManager::DestroyComponent(int entityId)
+{
+  if (int const * row = FindRow(entityId))
+  {
+    if (!destroyMarks_[*row])
+    {
+      destroyMarks_[*row] = byte(1);
+      entitiesToDestroy_.EmplaceBack(entityId);
+    }
+  }
+}
+
+//##############################################################################
+bool RuntimeComponentManager::ContainsComponent(int entityId) const
+{
+  return FindRow(entityId) != nullptr;
+}
+
+//##############################################################################
+Blob RuntimeComponentManager::CopyComponent(int entityId) const
+{
+  return Blob(GetComponent(entityId), componentSize_);
+}
+
+//##############################################################################
+int RuntimeComponentManager::ComponentCount(void) const
+{
+  return entityIds_.Size();
+}
+
+//##############################################################################
+// Rows are packed but not kept in entity id order.
+int RuntimeComponentManager::GetEntityIdAt(int index) const
+{
+  return entityIds_[index];
+}
+
+//##############################################################################
+void const * RuntimeComponentManager::GetComponentAt(int index) const
+{
+  ASSERT(index >= 0);
+  ASSERT(index < ComponentCount());
+
+  return current_.Begin() + index * componentSize_;
+}
+
+//##############################################################################
+void const * RuntimeComponentManager::FindComponent(int entityId) const
+{
+  int const * row = FindRow(entityId);
+
+  return row ? current_.Begin() + *row * componentSize_ : nullptr;
+}
+
+//##############################################################################
+void RuntimeComponentManager::ReserveWriteBuffers(int bufferCount,
+  void const * owner)
+{
+  if (writtenRows_.Size() < bufferCount)
+    writtenRows_.Resize(bufferCount);
+
+  writeBufferOwner_ = owner;
+}
+
+//##############################################################################
+ComponentChangeLog const & RuntimeComponentManager::GetChangeLog(void) const
+{
+  return changeLog_;
+}
+
+//##############################################################################
+// Commits writes, then destroys, then adds, like the typed component managers.
+void RuntimeComponentManager::Advance(int frame)
+{
+  changeLog_.BeginFrame(frame);
+
+  CommitWrites();
+
+  for (int entityId : entitiesToDestroy_)
+  {
+    int const * row = FindRow(entityId);
+    ASSERT(row);
+
+    changeLog_.AddRemoved(entityId);
+    RemoveRow(*row);
+  }
+
+  entitiesToDestroy_.Clear();
+
+  if (newIds_.Empty())
+    return;
+
+  int const firstRow = entityIds_.Size();
+  int const rowCount = firstRow + newIds_.Size();
+
+  current_.Resize(rowCount * int(componentSize_));
+  next_.Resize(rowCount * int(componentSize_));
+  written_.Resize(rowCount, byte(0));
+  destroyMarks_.Resize(rowCount, byte(0));
+
+  std::memcpy(current_.Begin() + firstRow * componentSize_, newData_.Begin(),
+    newData_.Size());
+
+  for (int i = 0; i < newIds_.Size(); ++i)
+  {
+    int const entityId = newIds_[i];
+    ASSERT(!ContainsComponent(entityId), "Component was added twice");
+
+    rows_.Emplace(GetEntityIndex(entityId), firstRow + i);
+    entityIds_.EmplaceBack(entityId);
+    changeLog_.AddAdded(entityId);
+  }
+
+  newIds_.Clear();
+  newData_.Clear();
+}
+
+//##############################################################################
+bool RuntimeComponentManager::HasPendingChanges(void) const
+{
+  if (!newIds_.Empty() || !entitiesToDestroy_.Empty())
+    return true;
+
+  for (Array<int> const & writtenRows : writtenRows_)
+  {
+    if (!writtenRows.Empty())
+      return true;
+  }
+
+  return false;
+}
+
+//##############################################################################
+// Pending changes aren't saved, like with the typed component managers.
+void RuntimeComponentManager::SaveSnapshot(SnapshotWriter * writer) const
+{
+  ASSERT(writer);
+
+  writer->AddValue(name_);
+  writer->AddValue(u32(componentSize_));
+  writer->AddArray(current_);
+  writer->AddArray(entityIds_);
+}
+
+//##############################################################################
+// Fails without changing anything if the snapshot was saved for a different
+// name or component size.
+bool RuntimeComponentManager::LoadSnapshot(SnapshotReader * reader)
+{
+  ASSERT(reader);
+
+  Token       name;
+  u32         componentSize = 0;
+  Array<byte> current;
+  Array<int>  entityIds;
+
+  if (!reader->ReadValue(&name) || !reader->ReadValue(&componentSize) ||
+    !reader->ReadArray(&current) || !reader->ReadArray(&entityIds))
+  {
+    return false;
+  }
+
+  if (name != name_ || componentSize != componentSize_ ||
+    unsigned(current.Size()) != entityIds.Size() * componentSize_)
+  {
+    return false;
+  }
+
+  Array<int> keys;
+  Array<int> rows;
+  keys.Reserve(entityIds.Size());
+  rows.Reserve(entityIds.Size());
+
+  for (int i = 0; i < entityIds.Size(); ++i)
+  {
+    keys.EmplaceBack(GetEntityIndex(entityIds[i]));
+    rows.EmplaceBack(i);
+  }
+
+  current_      = std::move(current);
+  next_         = current_;
+  written_      = Array<byte>(byte(0), entityIds.Size());
+  destroyMarks_ = Array<byte>(byte(0), entityIds.Size());
+  entityIds_    = std::move(entityIds);
+
+  rows_.Assign(keys.Begin(), rows.Begin(), keys.Size());
+
+  newIds_.Clear();
+  newData_.Clear();
+  entitiesToDestroy_.Clear();
+
+  for (Array<int> & writtenRows : writtenRows_)
+    writtenRows.Clear();
+
+  changeLog_ = ComponentChangeLog();
+
+  return true;
+}
+
+//##############################################################################
+int const * RuntimeComponentManager::FindRow(int entityId) const
+{
+  int const * row = rows_.Find(GetEntityIndex(entityId));
+
+  if (!row || entityIds_[*row] != entityId)
+    return nullptr;
+
+  return row;
+}
+
+//##############################################################################
+unsigned RuntimeComponentManager::GetFieldOffset(Token field,
+  [[maybe_unused]] std::type_index type) const
+{
+  ASSERT(layout_.Contains(field), "Component has no such field");
+  ASSERT(layout_.GetType(field) == type, "Field has a different type");
+
+  return layout_.GetOffset(field);
+}
+
+//##############################################################################
+// The first write of a frame copies the committed row into the write buffer.
+byte * RuntimeComponentManager::MarkWritten(int row)
+{
+  ASSERT(row >= 0);
+  ASSERT(row < ComponentCount());
+
+  byte * component = next_.Begin() + row * componentSize_;
+
+  if (!written_[row])
+  {
+    written_[row] = byte(1);
+    GetWrittenRows().EmplaceBack(row);
+    std::memcpy(component, current_.Begin() + row * componentSize_,
+      componentSize_);
+  }
+
+  return component;
+}
+
+//##############################################################################
+Array<int> & RuntimeComponentManager::GetWrittenRows(void)
+{
+  int const writeBuffer = ActiveWriteBuffer(writeBufferOwner_);
+
+  if (writtenRows_.Empty())
+    writtenRows_.Resize(1);
+
+  ASSERT(writeBuffer < writtenRows_.Size());
+
+  return writtenRows_[writeBuffer];
+}
+
+//##############################################################################
+void RuntimeComponentManager::CommitWrites(void)
+{
+  for (Array<int> & writtenRows : writtenRows_)
+  {
+    for (int row : writtenRows)
+    {
+      std::memcpy(current_.Begin() + row * componentSize_,
+        next_.Begin() + row * componentSize_, componentSize_);
+
+      written_[row] = byte(0);
+
+      if (!destroyMarks_[row])
+        changeLog_.AddChanged(entityIds_[row]);
+    }
+
+    writtenRows.Clear();
+  }
+}
+
+//##############################################################################
+// Moves the last row into the hole. Only called after the writes were
+// committed, so the write buffer has nothing to move.
+void RuntimeComponentManager::RemoveRow(int row)
+{
+  int const lastRow = entityIds_.Size() - 1;
+
+  rows_.Erase(GetEntityIndex(entityIds_[row]));
+
+  if (row != lastRow)
+  {
+    std::memcpy(current_.Begin() + row * componentSize_,
+      current_.Begin() + lastRow * componentSize_, componentSize_);
+
+    entityIds_[row]    = entityIds_[lastRow];
+    destroyMarks_[row] = destroyMarks_[lastRow];
+
+    *rows_.Find(GetEntityIndex(entityIds_[row])) = row;
+  }
+
+  current_.Resize(lastRow * int(componentSize_));
+  next_.Resize(lastRow * int(componentSize_));
+  written_.PopBack();
+  destroyMarks_.PopBack();
+  entityIds_.PopBack();
+}
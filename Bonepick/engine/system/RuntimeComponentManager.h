@@ -0,0 +1,120 @@
+#ifndef ENGINE_SYSTEM_RUNTIMECOMPONENTMANAGER_H
+#define ENGINE_SYSTEM_RUNTIMECOMPONENTMANAGER_H
+
+#include <typeindex>
+#include <typeinfo>
+
+#include "system/ComponentChanges.h"
+#include "utility/Blob.h"
+#include "utility/containers/Array.h"
+#include "utility/containers/SparseSet.h"
+#include "utility/DataLayout.h"
+#include "utility/Debug.h"
+#include "utility/Token.h"
+#include "utility/Typedefs.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+//##############################################################################
+// Component type defined at runtime by a DataLayout instead of a C++ type.
+// Components are rows of componentSize bytes packed into one column, fields
+// are read and written through their layout offsets. Like double buffered
+// storage, writes go to a second column and land on Advance(), and jobs can
+// write different entities at the same time. Rows stay packed, destroying a
+// component moves the last row into its place.
+class RuntimeComponentManager
+{
+public:
+  RuntimeComponentManager(Token name, DataLayout const & layout,
+    unsigned componentSize);
+
+  Token GetName(void) const;
+  DataLayout const & GetLayout(void) const;
+  unsigned ComponentSize(void) const;
+
+  void AddComponent(int entityId);
+  void AddComponent(int entityId, void const * component);
+  void AddComponent(int entityId, Blob const & component);
+
+  void const * GetComponent(int entityId) const;
+  void SetComponent(int entityId, void const * component);
+  void * UpdateComponent(int entityId);
+  void DestroyComponent(int entityId);
+  bool ContainsComponent(int entityId) const;
+
+  Blob CopyComponent(int entityId) const;
+
+  template <typename T>
+  T const & GetField(int entityId, Token field) const;
+
+  template <typename T>
+  void SetField(int entityId, Token field, T const & value);
+
+  int ComponentCount(void) const;
+  int GetEntityIdAt(int index) const;
+  void const * GetComponentAt(int index) const;
+  void const * FindComponent(int entityId) const;
+
+  void ReserveWriteBuffers(int bufferCount, void const * owner);
+
+  ComponentChangeLog const & GetChangeLog(void) const;
+
+  void Advance(int frame);
+
+  bool HasPendingChanges(void) const;
+
+  void SaveSnapshot(SnapshotWriter * writer) const;
+  bool LoadSnapshot(SnapshotReader * reader);
+
+private:
+  int const * FindRow(int entityId) const;
+  unsigned GetFieldOffset(Token field, std::type_index type) const;
+
+  byte * MarkWritten(int row);
+  Array<int> & GetWrittenRows(void);
+
+  void CommitWrites(void);
+  void RemoveRow(int row);
+
+  Token             name_;
+  DataLayout        layout_;
+  unsigned          componentSize_ = 0;
+  Array<byte>       current_;
+  Array<byte>       next_;
+  Array<byte>       written_;
+  Array<Array<int>> writtenRows_;
+  void const *      writeBufferOwner_ = nullptr;
+  Array<int>        entityIds_;
+  Array<int>        newIds_;
+  Array<byte>       newData_;
+  Array<int>        entitiesToDestroy_;
+  Array<byte>       destroyMarks_;
+  SparseSet<int>    rows_;
+  ComponentChangeLog changeLog_;
+};
+
+//##############################################################################
+// T has to be the type the layout gives the field.
+template <typename T>
+T const & RuntimeComponentManager::GetField(int entityId, Token field) const
+{
+  unsigned const offset = GetFieldOffset(field, typeid(T));
+
+  return *reinterpret_cast<T const *>(
+    static_cast<byte const *>(GetComponent(entityId)) + offset);
+}
+
+//##############################################################################
+// Only changes the field, the rest of the component keeps its value.
+template <typename T>
+void RuntimeComponentManager::SetField(int entityId, Token field,
+  T const & value)
+{
+  unsigned const offset = GetFieldOffset(field, typeid(T));
+
+  *reinterpret_cast<T *>(
+    static_cast<byte *>(UpdateComponent(entityId)) + offset) = value;
+}
+
+#endif
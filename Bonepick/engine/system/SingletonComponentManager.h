@@ -0,0 +1,393 @@
+#ifndef ENGINE_SYSTEM_SINGLETONCOMPONENTMANAGER_H
+#define ENGINE_SYSTEM_SINGLETONCOMPONENTMANAGER_H
+
+#include "system/ComponentChanges.h"
+#include "system/ComponentHistory.h"
+#include "system/ComponentProfile.h"
+#include "system/ComponentStorage.h"
+#include "utility/containers/Array.h"
+#include "utility/containers/Optional.h"
+#include "utility/Debug.h"
+#include "utility/Profiling.h"
+#include "utility/Snapshot.h"
+
+//##############################################################################
+// One value for the whole entity manager instead of one per entity. Writes
+// are committed on Advance() and kept in history like component writes. The
+// per entity interface is only there for the entity manager's bookkeeping, no
+// entity ever has a singleton.
+template <typename T>
+class ComponentManager<T, SingletonStorage>
+{
+public:
+  ComponentManager(void) = default;
+  ComponentManager(ComponentManager const &) = default;
+  ComponentManager(ComponentManager &&) = default;
+
+  ~ComponentManager(void) = default;
+
+  ComponentManager & operator =(ComponentManager const &) = default;
+  ComponentManager & operator =(ComponentManager &&) = default;
+
+  bool HasValue(void) const;
+  T const & GetValue(void) const;
+  void SetValue(T const & value);
+
+  void AddComponent(int entityId, T const & component);
+  void AddComponents(int firstEntityId, T const * components, int count);
+  void FillComponents(int firstEntityId, T const & component, int count);
+
+  T const & GetComponent(int entityId) const;
+  void SetComponent(int entityId, T const & component);
+  T & UpdateComponent(int entityId);
+  void DestroyComponent(int entityId);
+  bool ContainsComponent(int entityId) const;
+
+  int GetEntityId(T const * component) const;
+
+  int ComponentCount(void) const;
+  int GetEntityIdAt(int index) const;
+  T const * GetComponentAt(int index) const;
+  T const * FindComponent(int entityId) const;
+  void PrefetchLookup(int entityId) const;
+
+  int StorageVersion(void) const;
+  Array<int> const & MovedEntityIds(void) const;
+
+  void ReserveWriteBuffers(int bufferCount, void const * owner);
+
+  void SetCompactionBudget(int budget);
+  CompactionStats const & GetCompactionStats(void) const;
+
+  ComponentChangeLog const & GetChangeLog(void) const;
+
+  void SetHistoryFrames(int frameCount);
+
+  void Advance(int frame);
+
+  void Rewind(int frame);
+  void Replay(int frame);
+
+  void GetComponents(Array<T const *> * components, int const * filterIds,
+    int filterCount) const;
+
+  void GetAllComponents(Array<T const *> * components,
+    Array<int> * entityIds) const;
+
+  void SaveSnapshot(SnapshotWriter * writer) const;
+  bool LoadSnapshot(SnapshotReader * reader);
+
+#if PROFILING_ENABLED
+  ComponentProfiler & GetProfiler(void) const;
+#endif
+
+private:
+  typedef typename ComponentHistory<T>::Change HistoryChange;
+
+  Optional<T>         value_;
+  Optional<T>         nextValue_;
+  CompactionStats     compactionStats_;
+  ComponentChangeLog  changeLog_;
+  ComponentHistory<T> history_;
+#if PROFILING_ENABLED
+  mutable ComponentProfiler profiler_;
+#endif
+};
+
+//##############################################################################
+template <typename T>
+bool ComponentManager<T, SingletonStorage>::HasValue(void) const
+{
+  return value_.Ptr() != nullptr;
+}
+
+//##############################################################################
+template <typename T>
+T const & ComponentManager<T, SingletonStorage>::GetValue(void) const
+{
+  ASSERT(HasValue(), "Singleton was never set");
+
+  return *value_;
+}
+
+//##############################################################################
+// Becomes visible on the next Advance(). Parallel jobs would race on the one
+// pending value, so only serial code can write it.
+template <typename T>
+void ComponentManager<T, SingletonStorage>::SetValue(T const & value)
+{
+  ASSERT(!IsWritingFromJob(), "Singletons can't be set from jobs");
+  ASSERT(!nextValue_.Ptr(), "Singleton was already set this frame");
+
+  nextValue_.Emplace(value);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::AddComponent(int, T const &)
+{
+  ASSERT(false, "Singletons don't belong to entities");
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::AddComponents(int, T const *,
+  int count)
+{
+  ASSERT(count == 0, "Singletons don't belong to entities");
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::FillComponents(int, T const &,
+  int count)
+{
+  ASSERT(count == 0, "Singletons don't belong to entities");
+}
+
+//##############################################################################
+template <typename T>
+T const & ComponentManager<T, SingletonStorage>::GetComponent(int) const
+{
+  ASSERT(false, "Singletons don't belong to entities");
+
+  return GetValue();
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::SetComponent(int, T const &)
+{
+  ASSERT(false, "Singletons don't belong to entities");
+}
+
+//##############################################################################
+template <typename T>
+T & ComponentManager<T, SingletonStorage>::UpdateComponent(int)
+{
+  ASSERT(false, "Singletons don't belong to entities");
+
+  return *value_;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::DestroyComponent(int)
+{}
+
+//##############################################################################
+template <typename T>
+bool ComponentManager<T, SingletonStorage>::ContainsComponent(int) const
+{
+  return false;
+}
+
+//##############################################################################
+template <typename T>
+int ComponentManager<T, SingletonStorage>::GetEntityId(T const *) const
+{
+  ASSERT(false, "Singletons don't belong to entities");
+
+  return 0;
+}
+
+//##############################################################################
+template <typename T>
+int ComponentManager<T, SingletonStorage>::ComponentCount(void) const
+{
+  return 0;
+}
+
+//##############################################################################
+template <typename T>
+int ComponentManager<T, SingletonStorage>::GetEntityIdAt(int) const
+{
+  ASSERT(false, "Singletons don't belong to entities");
+
+  return 0;
+}
+
+//##############################################################################
+template <typename T>
+T const * ComponentManager<T, SingletonStorage>::GetComponentAt(int) const
+{
+  ASSERT(false, "Singletons don't belong to entities");
+
+  return nullptr;
+}
+
+//##############################################################################
+template <typename T>
+T const *
+  ComponentManager<T, SingletonStorage>::FindComponent(int) const
+{
+  return nullptr;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::PrefetchLookup(int) const
+{}
+
+//##############################################################################
+template <typename T>
+int ComponentManager<T, SingletonStorage>::StorageVersion(void) const
+{
+  return 0;
+}
+
+//##############################################################################
+template <typename T>
+Array<int> const &
+  ComponentManager<T, SingletonStorage>::MovedEntityIds(void) const
+{
+  static Array<int> const noEntityIds;
+
+  return noEntityIds;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::ReserveWriteBuffers(int,
+  void const *)
+{}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::SetCompactionBudget(int budget)
+{
+  ASSERT(budget >= 0);
+}
+
+//##############################################################################
+template <typename T>
+CompactionStats const &
+  ComponentManager<T, SingletonStorage>::GetCompactionStats(void) const
+{
+  return compactionStats_;
+}
+
+//##############################################################################
+// Stays empty, there are no entities to report.
+template <typename T>
+ComponentChangeLog const &
+  ComponentManager<T, SingletonStorage>::GetChangeLog(void) const
+{
+  return changeLog_;
+}
+
+#if PROFILING_ENABLED
+//##############################################################################
+template <typename T>
+ComponentProfiler &
+  ComponentManager<T, SingletonStorage>::GetProfiler(void) const
+{
+  return profiler_;
+}
+#endif
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::SetHistoryFrames(int frameCount)
+{
+  history_.SetFrameCount(frameCount);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::Advance(int frame)
+{
+  changeLog_.BeginFrame(frame);
+
+  ON_PROFILING(ComponentFrameProfile & profile = profiler_.BeginFrame(frame);)
+  ON_PROFILING(profile.writes = nextValue_.Ptr() ? 1 : 0;)
+  ON_PROFILING(profile.components = nextValue_.Ptr() || HasValue() ? 1 : 0;)
+
+  if (history_.FrameCount() > 0)
+  {
+    Array<HistoryChange> & changes = history_.BeginFrame(frame);
+
+    if (nextValue_.Ptr())
+      changes.EmplaceBack(HistoryChange{ 0, value_, nextValue_ });
+  }
+
+  if (!nextValue_.Ptr())
+    return;
+
+  value_ = std::move(nextValue_);
+  nextValue_.Clear();
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::Rewind(int frame)
+{
+  ASSERT(!nextValue_.Ptr(), "Can't rewind over pending changes");
+
+  for (HistoryChange const & change : history_.GetFrame(frame))
+    value_ = change.before;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::Replay(int frame)
+{
+  ASSERT(!nextValue_.Ptr(), "Can't replay over pending changes");
+
+  for (HistoryChange const & change : history_.GetFrame(frame))
+    value_ = change.after;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::GetComponents(
+  Array<T const *> * components, int const *, int filterCount) const
+{
+  ASSERT(components);
+
+  components->Clear();
+  components->Resize(filterCount);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::GetAllComponents(
+  Array<T const *> * components, Array<int> * entityIds) const
+{
+  ASSERT(components);
+  ASSERT(entityIds);
+
+  components->Clear();
+  entityIds->Clear();
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, SingletonStorage>::SaveSnapshot(
+  SnapshotWriter * writer) const
+{
+  ASSERT(writer);
+
+  writer->AddValue(value_);
+}
+
+//##############################################################################
+template <typename T>
+bool ComponentManager<T, SingletonStorage>::LoadSnapshot(
+  SnapshotReader * reader)
+{
+  ASSERT(reader);
+
+  Optional<T> value;
+
+  if (!reader->ReadValue(&value))
+    return false;
+
+  value_ = std::move(value);
+  nextValue_.Clear();
+  changeLog_ = ComponentChangeLog();
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,385 @@
+#include "system/SpatialHash.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "system/EntityId.h"
+#include "utility/Debug.h"
+#include "utility/math/VectorMath.h"
+
+//##############################################################################
+// Cells wrap onto a cellCount by cellCount grid of buckets. Pair queries look
+// at the neighbouring buckets, so there have to be at least three per side.
+SpatialHash::SpatialHash(float cellSize, int cellCount) :
+  cellSize_(cellSize),
+  buckets_(unsigned(cellCount), unsigned(cellCount))
+{
+  ASSERT(cellSize > 0.0f);
+  ASSERT(cellCount >= 3, "Spatial hash needs at least 3 cells per side");
+}
+
+//##############################################################################
+float SpatialHash::GetCellSize(void) const
+{
+  return cellSize_;
+}
+
+//##############################################################################
+int SpatialHash::GetCellCount(void) const
+{
+  return int(buckets_.GetWidth());
+}
+
+//##############################################################################
+// Adds the entity or moves it. Staying in the same cell doesn't touch the
+// bucket layout.
+void SpatialHash::Set(int entityId, Vec2 const & position)
+{
+  ASSERT(entityId);
+
+  int const bucket = GetBucket(position);
+
+  if (Item * item = items_.Find(GetEntityIndex(entityId)))
+  {
+    ASSERT(item->entityId == entityId, "Position of a destroyed entity");
+
+    item->position = position;
+
+    if (item->bucket != bucket)
+    {
+      item->bucket = bucket;
+      dirty_ = true;
+    }
+    else if (!dirty_)
+      entries_[item->row].position = position;
+
+    return;
+  }
+
+  Item & item = items_.Emplace(GetEntityIndex(entityId));
+  item.entityId = entityId;
+  item.bucket   = bucket;
+  item.position = position;
+
+  dirty_ = true;
+}
+
+//##############################################################################
+void SpatialHash::Remove(int entityId)
+{
+  if (!FindItem(entityId))
+    return;
+
+  items_.Erase(GetEntityIndex(entityId));
+  dirty_ = true;
+}
+
+//##############################################################################
+void SpatialHash::Clear(void)
+{
+  items_.Clear();
+  entries_.Clear();
+  buckets_.Clear(Bucket());
+  dirty_ = false;
+}
+
+//##############################################################################
+// Counting sort of the entries by bucket, only done after entities were added,
+// removed or changed cells.
+void SpatialHash::Commit(void)
+{
+  if (!dirty_)
+    return;
+
+  dirty_ = false;
+
+  buckets_.Clear(Bucket());
+
+  for (int i = 0; i < items_.Size(); ++i)
+    ++buckets_[unsigned(items_.GetValue(i).bucket)].count;
+
+  int begin = 0;
+
+  for (Bucket & bucket : buckets_)
+  {
+    bucket.begin = begin;
+    begin += bucket.count;
+    bucket.count = 0;
+  }
+
+  entries_.Resize(items_.Size());
+
+  for (int i = 0; i < items_.Size(); ++i)
+  {
+    Item & item = items_.GetValue(i);
+    Bucket & bucket = buckets_[unsigned(item.bucket)];
+
+    item.row = bucket.begin + bucket.count++;
+    entries_[item.row] = Entry{ item.entityId, item.position };
+  }
+}
+
+//##############################################################################
+int SpatialHash::Size(void) const
+{
+  return items_.Size();
+}
+
+//##############################################################################
+bool SpatialHash::Contains(int entityId) const
+{
+  return FindItem(entityId) != nullptr;
+}
+
+//##############################################################################
+Vec2 const & SpatialHash::GetPosition(int entityId) const
+{
+  Item const * item = FindItem(entityId);
+
+  ASSERT(item, "Entity is not in the spatial hash");
+
+  return item->position;
+}
+
+//##############################################################################
+void SpatialHash::QueryRadius(Vec2 const & center, float radius,
+  Array<int> * entityIds) const
+{
+  ASSERT(entityIds);
+  ASSERT(!dirty_, "Spatial hash has uncommitted changes");
+
+  entityIds->Clear();
+
+  float const radiusSq = radius * radius;
+
+  ForEachEntryIn(center - radius, center + radius,
+    [&](Entry const & entry)
+    {
+      if (VectorLengthSquared(entry.position - center) <= radiusSq)
+        entityIds->EmplaceBack(entry.entityId);
+    });
+}
+
+//##############################################################################
+void SpatialHash::QueryBox(Vec2 const & min, Vec2 const & max,
+  Array<int> * entityIds) const
+{
+  ASSERT(entityIds);
+  ASSERT(!dirty_, "Spatial hash has uncommitted changes");
+
+  entityIds->Clear();
+
+  ForEachEntryIn(min, max,
+    [&](Entry const & entry)
+    {
+      Vec2 const & position = entry.position;
+
+      if (position.x >= min.x && position.x <= max.x &&
+        position.y >= min.y && position.y <= max.y)
+      {
+        entityIds->EmplaceBack(entry.entityId);
+      }
+    });
+}
+
+//##############################################################################
+// The count closest entities, nearest first and ties in id order. Searches a
+// radius that doubles until it holds enough entities.
+void SpatialHash::QueryNearest(Vec2 const & position, int count,
+  Array<int> * entityIds) const
+{
+  ASSERT(entityIds);
+  ASSERT(!dirty_, "Spatial hash has uncommitted changes");
+
+  entityIds->Clear();
+
+  if (count <= 0 || entries_.Empty())
+    return;
+
+  Array<Candidate> candidates;
+  float const gridSpan = cellSize_ * float(GetCellCount());
+
+  for (float radius = cellSize_; ; radius *= 2.0f)
+  {
+    candidates.Clear();
+
+    //Once the search box covers every bucket all entries are candidates
+    if (radius * 2.0f >= gridSpan)
+    {
+      for (Entry const & entry : entries_)
+      {
+        candidates.EmplaceBack(Candidate{
+          VectorLengthSquared(entry.position - position), entry.entityId });
+      }
+
+      break;
+    }
+
+    float const radiusSq = radius * radius;
+
+    ForEachEntryIn(position - radius, position + radius,
+      [&](Entry const & entry)
+      {
+        float const distanceSq =
+          VectorLengthSquared(entry.position - position);
+
+        if (distanceSq <= radiusSq)
+          candidates.EmplaceBack(Candidate{ distanceSq, entry.entityId });
+      });
+
+    if (candidates.Size() >= count)
+      break;
+  }
+
+  int const found = std::min(count, candidates.Size());
+
+  std::partial_sort(candidates.Begin(), candidates.Begin() + found,
+    candidates.End(),
+    [](Candidate const & lhs, Candidate const & rhs)
+    {
+      if (lhs.distanceSq != rhs.distanceSq)
+        return lhs.distanceSq < rhs.distanceSq;
+
+      return lhs.entityId < rhs.entityId;
+    });
+
+  entityIds->Reserve(found);
+
+  for (int i = 0; i < found; ++i)
+    entityIds->EmplaceBack(candidates[i].entityId);
+}
+
+//##############################################################################
+// Every pair of entities at most distance apart, lower id first. Each bucket
+// is only checked against its neighbours, so the distance can't be larger
+// than a cell.
+void SpatialHash::QueryPairs(float distance, Array<Pair> * pairs) const
+{
+  ASSERT(pairs);
+  ASSERT(!dirty_, "Spatial hash has uncommitted changes");
+  ASSERT(distance <= cellSize_, "Pair distance is larger than a cell");
+
+  pairs->Clear();
+
+  int const cellCount = GetCellCount();
+  float const distanceSq = distance * distance;
+
+  for (int y = 0; y < cellCount; ++y)
+  {
+    for (int x = 0; x < cellCount; ++x)
+    {
+      Bucket const & bucket = buckets_.GetValue(unsigned(x), unsigned(y));
+
+      if (!bucket.count)
+        continue;
+
+      for (int offsetY = -1; offsetY <= 1; ++offsetY)
+      {
+        for (int offsetX = -1; offsetX <= 1; ++offsetX)
+        {
+          Bucket const & other = buckets_.GetValue(
+            unsigned(WrapCell(x + offsetX)), unsigned(WrapCell(y + offsetY)));
+
+          for (int i = bucket.begin; i < bucket.begin + bucket.count; ++i)
+          {
+            Entry const & entry = entries_[i];
+
+            for (int j = other.begin; j < other.begin + other.count; ++j)
+            {
+              Entry const & otherEntry = entries_[j];
+
+              if (entry.entityId < otherEntry.entityId &&
+                VectorLengthSquared(entry.position - otherEntry.position) <=
+                distanceSq)
+              {
+                pairs->EmplaceBack(Pair{ entry.entityId, otherEntry.entityId });
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+//##############################################################################
+// Every entry grouped by bucket, as of the last Commit().
+Array<SpatialHash::Entry> const & SpatialHash::Entries(void) const
+{
+  ASSERT(!dirty_, "Spatial hash has uncommitted changes");
+
+  return entries_;
+}
+
+//##############################################################################
+int SpatialHash::GetCell(float coord) const
+{
+  return int(std::floor(coord / cellSize_));
+}
+
+//##############################################################################
+int SpatialHash::GetBucket(Vec2 const & position) const
+{
+  return int(buckets_.GetIndexFromPos(
+    unsigned(WrapCell(GetCell(position.x))),
+    unsigned(WrapCell(GetCell(position.y)))));
+}
+
+//##############################################################################
+int SpatialHash::WrapCell(int cell) const
+{
+  int const cellCount = GetCellCount();
+
+  return (cell % cellCount + cellCount) % cellCount;
+}
+
+//##############################################################################
+SpatialHash::Item const * SpatialHash::FindItem(int entityId) const
+{
+  Item const * item = items_.Find(GetEntityIndex(entityId));
+
+  if (item && item->entityId != entityId)
+    return nullptr;
+
+  return item;
+}
+
+//##############################################################################
+// Visits the entries of every bucket the box overlaps. Buckets hold all the
+// cells that wrap onto them, so callers still have to test each entry.
+template <typename Visit>
+void SpatialHash::ForEachEntryIn(Vec2 const & min, Vec2 const & max,
+  Visit const & visit) const
+{
+  int const cellCount = GetCellCount();
+
+  int minX = GetCell(min.x);
+  int maxX = GetCell(max.x);
+  int minY = GetCell(min.y);
+  int maxY = GetCell(max.y);
+
+  //Boxes wider than the grid would visit buckets more than once
+  if (maxX - minX >= cellCount)
+  {
+    minX = 0;
+    maxX = cellCount - 1;
+  }
+
+  if (maxY - minY >= cellCount)
+  {
+    minY = 0;
+    maxY = cellCount - 1;
+  }
+
+  for (int y = minY; y <= maxY; ++y)
+  {
+    for (int x = minX; x <= maxX; ++x)
+    {
+      Bucket const & bucket =
+        buckets_.GetValue(unsigned(WrapCell(x)), unsigned(WrapCell(y)));
+
+      for (int i = bucket.begin; i < bucket.begin + bucket.count; ++i)
+        visit(entries_[i]);
+    }
+  }
+}
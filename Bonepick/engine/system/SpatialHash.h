@@ -0,0 +1,92 @@
+#ifndef ENGINE_SYSTEM_SPATIALHASH_H
+#define ENGINE_SYSTEM_SPATIALHASH_H
+
+#include "utility/containers/Array.h"
+#include "utility/containers/Grid.h"
+#include "utility/containers/SparseSet.h"
+#include "utility/math/Vector.h"
+
+//##############################################################################
+// Uniform hash grid of entity positions for near queries and collision
+// broadphase. The world is cut into square cells that wrap onto a fixed grid
+// of buckets, so it has no bounds. Entries of a bucket are stored next to each
+// other; moves that stay in their cell are patched in place, everything else
+// re-sorts the entries on the next Commit().
+class SpatialHash
+{
+public:
+  struct Entry
+  {
+    int  entityId = 0;
+    Vec2 position;
+  };
+
+  struct Pair
+  {
+    int entityId0 = 0;
+    int entityId1 = 0;
+  };
+
+  SpatialHash(float cellSize, int cellCount);
+
+  float GetCellSize(void) const;
+  int GetCellCount(void) const;
+
+  void Set(int entityId, Vec2 const & position);
+  void Remove(int entityId);
+  void Clear(void);
+  void Commit(void);
+
+  int Size(void) const;
+  bool Contains(int entityId) const;
+  Vec2 const & GetPosition(int entityId) const;
+
+  void QueryRadius(Vec2 const & center, float radius,
+    Array<int> * entityIds) const;
+  void QueryBox(Vec2 const & min, Vec2 const & max,
+    Array<int> * entityIds) const;
+  void QueryNearest(Vec2 const & position, int count,
+    Array<int> * entityIds) const;
+  void QueryPairs(float distance, Array<Pair> * pairs) const;
+
+  Array<Entry> const & Entries(void) const;
+
+private:
+  struct Item
+  {
+    int  entityId = 0;
+    int  bucket   = 0;
+    int  row      = 0;
+    Vec2 position;
+  };
+
+  struct Bucket
+  {
+    int begin = 0;
+    int count = 0;
+  };
+
+  struct Candidate
+  {
+    float distanceSq = 0.0f;
+    int   entityId   = 0;
+  };
+
+  int GetCell(float coord) const;
+  int GetBucket(Vec2 const & position) const;
+  int WrapCell(int cell) const;
+
+  Item const * FindItem(int entityId) const;
+
+  template <typename Visit>
+  void ForEachEntryIn(Vec2 const & min, Vec2 const & max,
+    Visit const & visit) const;
+
+  float             cellSize_  = 1.0f;
+  Grid<Bucket>      buckets_;
+  SparseSet<Item>   items_;
+  Array<Entry>      entries_;
+  bool              dirty_     = false;
+};
+
+#endif
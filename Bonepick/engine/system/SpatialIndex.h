@@ -0,0 +1,134 @@
+#ifndef ENGINE_SYSTEM_SPATIALINDEX_H
+#define ENGINE_SYSTEM_SPATIALINDEX_H
+
+#include "system/ComponentChanges.h"
+#include "system/EntityQuery.h"
+#include "system/SpatialHash.h"
+#include "utility/containers/Array.h"
+#include "utility/math/Vector.h"
+
+//##############################################################################
+template <typename T>
+struct SpatialPosition;
+
+template <typename Manager, typename U>
+class SpatialIndex;
+
+//##############################################################################
+// Where a component puts its entity for spatial indices. Reads a Vec2 position
+// member by default, specialize for components laid out differently:
+//
+//   template <>
+//   struct SpatialPosition<Body>
+//   {
+//     static Vec2 Get(Body const & body) { return body.center; }
+//   };
+template <typename T>
+struct SpatialPosition
+{
+  static Vec2 Get(T const & component)
+  {
+    return component.position;
+  }
+};
+
+//##############################################################################
+// Spatial hash of every entity with a U component, owned by the entity manager
+// that registered it. Each Advance() only moves the entities whose U component
+// was added, written or removed.
+template <typename Manager, typename U>
+class SpatialIndex : public IEntityQuery<Manager>
+{
+public:
+  SpatialIndex(float cellSize, int cellCount);
+
+  virtual ~SpatialIndex(void) override = default;
+
+  SpatialHash const & GetHash(void) const;
+
+private:
+  virtual IEntityQuery<Manager> * Clone(void) const override;
+
+  virtual void Rebuild(Manager const & manager) override;
+  virtual void Update(Manager const & manager,
+    Array<int> const & changedEntityIds) override;
+  virtual void Restore(Manager const & manager,
+    Array<int> const & changedEntityIds) override;
+
+  SpatialHash hash_;
+};
+
+//##############################################################################
+template <typename Manager, typename U>
+SpatialIndex<Manager, U>::SpatialIndex(float cellSize, int cellCount) :
+  hash_(cellSize, cellCount)
+{}
+
+//##############################################################################
+template <typename Manager, typename U>
+SpatialHash const & SpatialIndex<Manager, U>::GetHash(void) const
+{
+  return hash_;
+}
+
+//##############################################################################
+template <typename Manager, typename U>
+IEntityQuery<Manager> * SpatialIndex<Manager, U>::Clone(void) const
+{
+  return new SpatialIndex(hash_.GetCellSize(), hash_.GetCellCount());
+}
+
+//##############################################################################
+template <typename Manager, typename U>
+void SpatialIndex<Manager, U>::Rebuild(Manager const & manager)
+{
+  hash_.Clear();
+
+  for (int i = 0; i < manager.EntityCount(); ++i)
+  {
+    int const entityId = manager.GetEntityId(i);
+
+    if (manager.ContainsComponent<U>(entityId))
+    {
+      hash_.Set(entityId,
+        SpatialPosition<U>::Get(manager.GetComponent<U>(entityId)));
+    }
+  }
+
+  hash_.Commit();
+}
+
+//##############################################################################
+// Reads the component changes of the frame that was just committed, which
+// also covers components written without changing the entity's signature.
+template <typename Manager, typename U>
+void SpatialIndex<Manager, U>::Update(Manager const & manager,
+  Array<int> const &)
+{
+  ComponentChanges const changes = manager.GetChangedComponents<U>();
+
+  for (int entityId : changes.removed)
+    hash_.Remove(entityId);
+
+  for (Array<int> const * entityIds : { &changes.added, &changes.changed })
+  {
+    for (int entityId : *entityIds)
+    {
+      hash_.Set(entityId,
+        SpatialPosition<U>::Get(manager.GetComponent<U>(entityId)));
+    }
+  }
+
+  hash_.Commit();
+}
+
+//##############################################################################
+// Restoring history resets the change logs, so the hash is built again.
+template <typename Manager, typename U>
+void SpatialIndex<Manager, U>::Restore(Manager const & manager,
+  Array<int> const &)
+{
+  Rebuild(manager);
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef ENGINE_SYSTEM_SYSTEMSCHEDULER_H
+#define ENGINE_SYSTEM_SYSTEMSCHEDULER_H
+
+#include <functional>
+#include <mutex>
+
+#include "system/ComponentMask.h"
+#include "system/EntityManager.h"
+#include "utility/containers/Array.h"
+#include "utility/Debug.h"
+#include "utility/TemplateTools.h"
+#include "utility/ThreadPool.h"
+
+//##############################################################################
+template <typename ... Components>
+class SystemScheduler;
+
+//##############################################################################
+// Runs the systems of one frame on a thread pool. Every system declares the
+// components it reads and writes. Writes are double buffered by the entity
+// manager, so reads always see last frame's state and never race with a
+// write. Systems only wait on earlier systems that write one of the same
+// components, which keeps the order of pending writes deterministic.
+//
+// Systems may only read components and set or update the components they
+// declared as written. Adding or destroying entities and components is not
+// thread safe. Systems can't call ParallelForEach() or Advance() at all, not
+// even with another pool, since those change buffers shared by every system.
+//
+//   scheduler.AddSystem<TypeSet<Velocity>, TypeSet<Position>>(Move);
+//   scheduler.Run(manager, pool);
+//   manager.Advance();
+template <typename ... Components>
+class SystemScheduler
+{
+public:
+  typedef EntityManager<Components...>       Manager;
+  typedef std::function<void(Manager &)>     System;
+
+  SystemScheduler(void) = default;
+  SystemScheduler(SystemScheduler const &) = delete;
+  SystemScheduler(SystemScheduler &&) = delete;
+
+  ~SystemScheduler(void) = default;
+
+  template <typename ReadSet, typename WriteSet>
+  int AddSystem(System const & system);
+
+  int SystemCount(void) const;
+  Array<int> const & GetDependencies(int systemIndex) const;
+
+  void Run(Manager & manager, ThreadPool & pool);
+
+private:
+  struct SystemData
+  {
+    System        system;
+    ComponentMask writes;
+    Array<int>    dependencies;
+    Array<int>    dependents;
+  };
+
+  void RunSystem(Manager & manager, ThreadPool & pool, int systemIndex);
+
+  Array<SystemData> systems_;
+  Array<int>        remainingDependencies_;
+  std::mutex        mutex_;
+};
+
+//##############################################################################
+template <typename ... Components>
+template <typename ReadSet, typename WriteSet>
+int SystemScheduler<Components...>::AddSystem(System const & system)
+{
+  static_assert(TypeSetIsSubset<ReadSet, TypeSet<Components...>>::value);
+  static_assert(TypeSetIsSubset<WriteSet, TypeSet<Components...>>::value);
+
+  int const systemIndex = systems_.Size();
+
+  SystemData data;
+  data.system = system;
+  data.writes = ComponentMaskOf<WriteSet, Components...>::value;
+
+  for (int i = 0; i < systemIndex; ++i)
+  {
+    SystemData & earlier = systems_[i];
+
+    if (earlier.writes & data.writes)
+    {
+      data.dependencies.EmplaceBack(i);
+      earlier.dependents.EmplaceBack(systemIndex);
+    }
+  }
+
+  systems_.EmplaceBack(std::move(data));
+
+  return systemIndex;
+}
+
+//##############################################################################
+template <typename ... Components>
+int SystemScheduler<Components...>::SystemCount(void) const
+{
+  return systems_.Size();
+}
+
+//##############################################################################
+template <typename ... Components>
+Array<int> const &
+  SystemScheduler<Components...>::GetDependencies(int systemIndex) const
+{
+  return systems_[systemIndex].dependencies;
+}
+
+//##############################################################################
+template <typename ... Components>
+void SystemScheduler<Components...>::Run(Manager & manager, ThreadPool & pool)
+{
+  remainingDependencies_.Clear();
+  remainingDependencies_.Reserve(systems_.Size());
+
+  for (SystemData const & data : systems_)
+    remainingDependencies_.EmplaceBack(data.dependencies.Size());
+
+  for (int i = 0; i < systems_.Size(); ++i)
+  {
+    if (systems_[i].dependencies.Empty())
+    {
+      pool.Submit(
+        [this, &manager, &pool, i](void)
+        {
+          RunSystem(manager, pool, i);
+        });
+    }
+  }
+
+  pool.Wait();
+}
+
+//##############################################################################
+template <typename ... Components>
+void SystemScheduler<Components...>::RunSystem(Manager & manager,
+  ThreadPool & pool, int systemIndex)
+{
+  bool const wasRunning = RunningScheduledSystem();
+  RunningScheduledSystem() = true;
+
+  try
+  {
+    systems_[systemIndex].system(manager);
+  }
+  catch (...)
+  {
+    RunningScheduledSystem() = wasRunning;
+    throw;
+  }
+
+  RunningScheduledSystem() = wasRunning;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (int dependent : systems_[systemIndex].dependents)
+  {
+    if (--remainingDependencies_[dependent] == 0)
+    {
+      pool.Submit(
+        [this, &manager, &pool, dependent](void)
+        {
+          RunSystem(manager, pool, dependent);
+        });
+    }
+  }
+}
+
+#endif
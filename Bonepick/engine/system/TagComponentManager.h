@@ -0,0 +1,533 @@
+#ifndef ENGINE_SYSTEM_TAGCOMPONENTMANAGER_H
+#define ENGINE_SYSTEM_TAGCOMPONENTMANAGER_H
+
+#include <algorithm>
+#include <type_traits>
+
+#include "system/ComponentChanges.h"
+#include "system/ComponentHistory.h"
+#include "system/ComponentProfile.h"
+#include "system/ComponentStorage.h"
+#include "system/EntityId.h"
+#include "utility/Bitset.h"
+#include "utility/containers/Array.h"
+#include "utility/containers/Optional.h"
+#include "utility/Debug.h"
+#include "utility/Profiling.h"
+#include "utility/Snapshot.h"
+
+//##############################################################################
+// Membership of an empty marker type. Keeps the tagged id of every entity slot
+// and the sorted ids of the tagged entities, every entity shares the same
+// instance.
+template <typename T>
+class ComponentManager<T, TagStorage>
+{
+  static_assert(std::is_empty<T>::value, "Tags can't hold any data");
+
+public:
+  ComponentManager(void) = default;
+  ComponentManager(ComponentManager const &) = default;
+  ComponentManager(ComponentManager &&) = default;
+
+  ~ComponentManager(void) = default;
+
+  ComponentManager & operator =(ComponentManager const &) = default;
+  ComponentManager & operator =(ComponentManager &&) = default;
+
+  void AddComponent(int entityId, T const & component);
+  void AddComponents(int firstEntityId, T const * components, int count);
+  void FillComponents(int firstEntityId, T const & component, int count);
+
+  T const & GetComponent(int entityId) const;
+  void SetComponent(int entityId, T const & component);
+  T & UpdateComponent(int entityId);
+  void DestroyComponent(int entityId);
+  bool ContainsComponent(int entityId) const;
+
+  int GetEntityId(T const * component) const;
+
+  int ComponentCount(void) const;
+  int GetEntityIdAt(int index) const;
+  T const * GetComponentAt(int index) const;
+  T const * FindComponent(int entityId) const;
+  void PrefetchLookup(int entityId) const;
+
+  int StorageVersion(void) const;
+  Array<int> const & MovedEntityIds(void) const;
+
+  void ReserveWriteBuffers(int bufferCount, void const * owner);
+
+  void SetCompactionBudget(int budget);
+  CompactionStats const & GetCompactionStats(void) const;
+
+  ComponentChangeLog const & GetChangeLog(void) const;
+
+  void SetHistoryFrames(int frameCount);
+
+  void Advance(int frame);
+
+  void Rewind(int frame);
+  void Replay(int frame);
+
+  void GetComponents(Array<T const *> * components, int const * filterIds,
+    int filterCount) const;
+
+  void GetAllComponents(Array<T const *> * components,
+    Array<int> * entityIds) const;
+
+  void SaveSnapshot(SnapshotWriter * writer) const;
+  bool LoadSnapshot(SnapshotReader * reader);
+
+#if PROFILING_ENABLED
+  ComponentProfiler & GetProfiler(void) const;
+#endif
+
+private:
+  typedef typename ComponentHistory<T>::Change HistoryChange;
+
+  bool HasPendingChanges(void) const;
+
+  void BeginHistoryFrame(int frame);
+  void EndHistoryFrame(int frame);
+
+  void ApplyMembership(Array<int> & addedIds, Array<int> & removedIds);
+  void SetMember(int entityIndex, int entityId);
+
+  T                   tag_;
+  Array<int>          memberIds_;
+  Array<int>          entityIds_;
+  Array<int>          newIds_;
+  Array<int>          entitiesToDestroy_;
+  Bitset              destroyMarks_;
+  CompactionStats     compactionStats_;
+  ComponentChangeLog  changeLog_;
+  ComponentHistory<T> history_;
+#if PROFILING_ENABLED
+  mutable ComponentProfiler profiler_;
+#endif
+};
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::AddComponent(int entityId, T const &)
+{
+  ASSERT(!ContainsComponent(entityId));
+  newIds_.EmplaceBack(entityId);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::AddComponents(int firstEntityId,
+  T const *, int count)
+{
+  newIds_.Reserve(newIds_.Size() + count);
+
+  for (int i = 0; i < count; ++i)
+    AddComponent(firstEntityId + i, tag_);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::FillComponents(int firstEntityId,
+  T const &, int count)
+{
+  AddComponents(firstEntityId, &tag_, count);
+}
+
+//##############################################################################
+template <typename T>
+T const & ComponentManager<T, TagStorage>::GetComponent(int entityId) const
+{
+  ASSERT(ContainsComponent(entityId));
+
+  return tag_;
+}
+
+//##############################################################################
+// Tags have nothing to write, so writes only check the entity has the tag.
+template <typename T>
+void ComponentManager<T, TagStorage>::SetComponent(int entityId, T const &)
+{
+  ASSERT(ContainsComponent(entityId));
+}
+
+//##############################################################################
+template <typename T>
+T & ComponentManager<T, TagStorage>::UpdateComponent(int entityId)
+{
+  ASSERT(ContainsComponent(entityId));
+
+  return tag_;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::DestroyComponent(int entityId)
+{
+  int const entityIndex = GetEntityIndex(entityId);
+
+  if (ContainsComponent(entityId) && !destroyMarks_.Get(entityIndex))
+  {
+    destroyMarks_.Set(entityIndex);
+    entitiesToDestroy_.EmplaceBack(entityId);
+  }
+}
+
+//##############################################################################
+// The slot holds the tagged id, so ids of other generations don't match.
+template <typename T>
+bool ComponentManager<T, TagStorage>::ContainsComponent(int entityId) const
+{
+  int const entityIndex = GetEntityIndex(entityId);
+
+  return entityIndex < memberIds_.Size() && memberIds_[entityIndex] == entityId;
+}
+
+//##############################################################################
+template <typename T>
+int ComponentManager<T, TagStorage>::GetEntityId(T const *) const
+{
+  ASSERT(false, "Tagged entities share one instance");
+
+  return 0;
+}
+
+//##############################################################################
+// Tagged entities by index in entity id order.
+template <typename T>
+int ComponentManager<T, TagStorage>::ComponentCount(void) const
+{
+  return entityIds_.Size();
+}
+
+//##############################################################################
+template <typename T>
+int ComponentManager<T, TagStorage>::GetEntityIdAt(int index) const
+{
+  return entityIds_[index];
+}
+
+//##############################################################################
+template <typename T>
+T const * ComponentManager<T, TagStorage>::GetComponentAt(int index) const
+{
+  ASSERT(index >= 0 && index < entityIds_.Size());
+
+  return &tag_;
+}
+
+//##############################################################################
+template <typename T>
+T const * ComponentManager<T, TagStorage>::FindComponent(int entityId) const
+{
+  return ContainsComponent(entityId) ? &tag_ : nullptr;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::PrefetchLookup(int entityId) const
+{
+  int const entityIndex = GetEntityIndex(entityId);
+
+  if (entityIndex < memberIds_.Size())
+    PREFETCH(&memberIds_[entityIndex]);
+}
+
+//##############################################################################
+// The shared instance never moves.
+template <typename T>
+int ComponentManager<T, TagStorage>::StorageVersion(void) const
+{
+  return 0;
+}
+
+//##############################################################################
+template <typename T>
+Array<int> const & ComponentManager<T, TagStorage>::MovedEntityIds(void) const
+{
+  static Array<int> const noEntityIds;
+
+  return noEntityIds;
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::ReserveWriteBuffers(int,
+  void const *)
+{}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::SetCompactionBudget(int budget)
+{
+  ASSERT(budget >= 0);
+}
+
+//##############################################################################
+template <typename T>
+CompactionStats const &
+  ComponentManager<T, TagStorage>::GetCompactionStats(void) const
+{
+  return compactionStats_;
+}
+
+//##############################################################################
+template <typename T>
+ComponentChangeLog const &
+  ComponentManager<T, TagStorage>::GetChangeLog(void) const
+{
+  return changeLog_;
+}
+
+#if PROFILING_ENABLED
+//##############################################################################
+template <typename T>
+ComponentProfiler & ComponentManager<T, TagStorage>::GetProfiler(void) const
+{
+  return profiler_;
+}
+#endif
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::SetHistoryFrames(int frameCount)
+{
+  history_.SetFrameCount(frameCount);
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::Advance(int frame)
+{
+  changeLog_.BeginFrame(frame);
+
+  if (history_.FrameCount() > 0)
+    BeginHistoryFrame(frame);
+
+  ON_PROFILING(ComponentFrameProfile & profile = profiler_.BeginFrame(frame);)
+  ON_PROFILING(ProfileTimer timer;)
+  ON_PROFILING(profile.destroys = entitiesToDestroy_.Size();)
+  ON_PROFILING(profile.adds = newIds_.Size();)
+
+  for (int entityId : entitiesToDestroy_)
+  {
+    destroyMarks_.Unset(GetEntityIndex(entityId));
+    changeLog_.AddRemoved(entityId);
+  }
+
+  for (int entityId : newIds_)
+    changeLog_.AddAdded(entityId);
+
+  ApplyMembership(newIds_, entitiesToDestroy_);
+
+  newIds_.Clear();
+  entitiesToDestroy_.Clear();
+
+  ON_PROFILING(profile.insertTime = timer.Lap();)
+  ON_PROFILING(profile.components = entityIds_.Size();)
+
+  if (history_.FrameCount() > 0)
+    EndHistoryFrame(frame);
+}
+
+//##############################################################################
+// Takes back the tags the given frame added and puts back the ones it
+// removed. Frames have to be rewound newest first with no changes pending.
+template <typename T>
+void ComponentManager<T, TagStorage>::Rewind(int frame)
+{
+  ASSERT(!HasPendingChanges(), "Can't rewind over pending changes");
+
+  Array<int> addedIds;
+  Array<int> removedIds;
+
+  for (HistoryChange const & change : history_.GetFrame(frame))
+  {
+    if (change.before.Ptr() && !change.after.Ptr())
+      addedIds.EmplaceBack(change.entityId);
+    else if (!change.before.Ptr() && change.after.Ptr())
+      removedIds.EmplaceBack(change.entityId);
+  }
+
+  ApplyMembership(addedIds, removedIds);
+  changeLog_ = ComponentChangeLog();
+}
+
+//##############################################################################
+// Redoes a rewound frame.
+template <typename T>
+void ComponentManager<T, TagStorage>::Replay(int frame)
+{
+  ASSERT(!HasPendingChanges(), "Can't replay over pending changes");
+
+  Array<int> addedIds;
+  Array<int> removedIds;
+
+  for (HistoryChange const & change : history_.GetFrame(frame))
+  {
+    if (!change.before.Ptr() && change.after.Ptr())
+      addedIds.EmplaceBack(change.entityId);
+    else if (change.before.Ptr() && !change.after.Ptr())
+      removedIds.EmplaceBack(change.entityId);
+  }
+
+  ApplyMembership(addedIds, removedIds);
+  changeLog_ = ComponentChangeLog();
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::GetComponents(
+  Array<T const *> * components, int const * filterIds, int filterCount) const
+{
+  ASSERT(components);
+
+  components->Clear();
+  components->Resize(filterCount);
+
+  for (int i = 0; i < filterCount; ++i)
+  {
+    if (ContainsComponent(filterIds[i]))
+      (*components)[i] = &tag_;
+  }
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::GetAllComponents(
+  Array<T const *> * components, Array<int> * entityIds) const
+{
+  ASSERT(components);
+  ASSERT(entityIds);
+
+  *entityIds = entityIds_;
+  *components = Array<T const *>(&tag_, entityIds_.Size());
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::SaveSnapshot(
+  SnapshotWriter * writer) const
+{
+  ASSERT(writer);
+
+  writer->AddArray(entityIds_);
+}
+
+//##############################################################################
+template <typename T>
+bool ComponentManager<T, TagStorage>::LoadSnapshot(SnapshotReader * reader)
+{
+  ASSERT(reader);
+
+  Array<int> entityIds;
+
+  if (!reader->ReadArray(&entityIds))
+    return false;
+
+  if (!std::is_sorted(entityIds.Begin(), entityIds.End()))
+    return false;
+
+  memberIds_.Clear();
+
+  for (int entityId : entityIds)
+    SetMember(GetEntityIndex(entityId), entityId);
+
+  entityIds_ = std::move(entityIds);
+
+  newIds_.Clear();
+  entitiesToDestroy_.Clear();
+  destroyMarks_.Clear();
+
+  changeLog_ = ComponentChangeLog();
+
+  return true;
+}
+
+//##############################################################################
+template <typename T>
+bool ComponentManager<T, TagStorage>::HasPendingChanges(void) const
+{
+  return !newIds_.Empty() || !entitiesToDestroy_.Empty();
+}
+
+//##############################################################################
+// Remembers whether every entity the frame is about to touch was tagged,
+// EndHistoryFrame() fills in whether it still is.
+template <typename T>
+void ComponentManager<T, TagStorage>::BeginHistoryFrame(int frame)
+{
+  Array<HistoryChange> & changes = history_.BeginFrame(frame);
+  changes.Reserve(newIds_.Size() + entitiesToDestroy_.Size());
+
+  for (int entityId : entitiesToDestroy_)
+    changes.EmplaceBack(HistoryChange{ entityId, tag_, Optional<T>() });
+
+  for (int entityId : newIds_)
+  {
+    changes.EmplaceBack(HistoryChange{ entityId, Optional<T>(),
+      Optional<T>() });
+  }
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::EndHistoryFrame(int frame)
+{
+  for (HistoryChange & change : history_.GetFrame(frame))
+  {
+    if (ContainsComponent(change.entityId))
+      change.after.Emplace(tag_);
+  }
+}
+
+//##############################################################################
+// Removes then adds the given entities, both lists end up sorted.
+template <typename T>
+void ComponentManager<T, TagStorage>::ApplyMembership(Array<int> & addedIds,
+  Array<int> & removedIds)
+{
+  if (!removedIds.Empty())
+  {
+    std::sort(removedIds.Begin(), removedIds.End());
+
+    for (int entityId : removedIds)
+      SetMember(GetEntityIndex(entityId), 0);
+
+    entityIds_.Resize(int(std::remove_if(entityIds_.Begin(), entityIds_.End(),
+      [&removedIds](int entityId)
+      {
+        return std::binary_search(removedIds.Begin(), removedIds.End(),
+          entityId);
+      }) - entityIds_.Begin()));
+  }
+
+  if (!addedIds.Empty())
+  {
+    std::sort(addedIds.Begin(), addedIds.End());
+
+    int const oldSize = entityIds_.Size();
+
+    for (int entityId : addedIds)
+    {
+      SetMember(GetEntityIndex(entityId), entityId);
+      entityIds_.EmplaceBack(entityId);
+    }
+
+    std::inplace_merge(entityIds_.Begin(), entityIds_.Begin() + oldSize,
+      entityIds_.End());
+  }
+}
+
+//##############################################################################
+template <typename T>
+void ComponentManager<T, TagStorage>::SetMember(int entityIndex, int entityId)
+{
+  if (entityIndex >= memberIds_.Size())
+    memberIds_.Resize(entityIndex + 1, 0);
+
+  memberIds_[entityIndex] = entityId;
+}
+
+#endif
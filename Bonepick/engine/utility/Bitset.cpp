@@ -79,10 +79,12 @@ void Bitset::Set(int index)
 {
   ASSERT(index >= 0);
 
-  int const size = GetValueCountForBitIndex(index);
+  int const neededSize = GetValueCountForBitIndex(index);
 
-  if (size > size_)
+  if (neededSize > size_)
   {
+    //Grow geometrically, bits are commonly set in increasing index order
+    int const size = std::max(neededSize, size_ * 2);
     unsigned * newData = new unsigned[size];
 
     std::memcpy(newData, data_, size_ * sizeof(unsigned));
@@ -1,6 +1,7 @@
 #include "utility/Blob.h"
 
 #include <cstdlib>
+#include <cstring>
 
 //##############################################################################
 Blob::Blob(unsigned size) :
@@ -52,7 +52,7 @@ private:
 template <typename T>
 T & Blob::Get(unsigned offset)
 {
-  ASSERT(offset + sizeof(T) <= size_);
+  ASSERT(offset + sizeof(T) <= Size());
 
   return *reinterpret_cast<T *>(Get(offset));
 }
@@ -70,7 +70,7 @@ void Blob::Set(unsigned offset, T const & value)
 {
   static_assert(std::is_trivially_destructible<T>::value);
 
-  ASSERT(offset + sizeof(T) <= size_);
+  ASSERT(offset + sizeof(T) <= Size());
 
   Set(offset, &value, sizeof(value));
 }
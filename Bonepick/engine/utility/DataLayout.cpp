@@ -4,16 +4,18 @@
 #include "utility/TemplateTools.h"
 
 //##############################################################################
-DataLayout::LayoutInfo::LayoutInfo(std::type_index type, unsigned offset) :
-  type(type), offset(offset)
+DataLayout::LayoutInfo::LayoutInfo(std::type_index type, unsigned offset,
+  unsigned size) :
+  type(type), offset(offset), size(size)
 {}
 
 //##############################################################################
-void DataLayout::Add(Token key, std::type_index type, unsigned offset)
+void DataLayout::Add(Token key, std::type_index type, unsigned offset,
+  unsigned size)
 {
   ASSERT(layout_.Find(key) == 0);
 
-  layout_.Emplace(key, LayoutInfo(type, offset));
+  layout_.Emplace(key, LayoutInfo(type, offset, size));
 
 }
 
@@ -39,6 +41,14 @@ unsigned DataLayout::GetOffset(Token key) const
   return layout_.Find(key)->value.offset;
 }
 
+//##############################################################################
+unsigned DataLayout::GetSize(Token key) const
+{
+  ASSERT(layout_.Contains(key));
+
+  return layout_.Find(key)->value.size;
+}
+
 //##############################################################################
 unsigned DataLayout::Size(void) const
 {
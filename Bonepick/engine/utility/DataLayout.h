@@ -12,17 +12,25 @@ class DataLayout
 public:
   struct LayoutInfo
   {
-    LayoutInfo(std::type_index type, unsigned offset);
+    LayoutInfo(std::type_index type, unsigned offset, unsigned size);
 
     std::type_index type;
     unsigned offset;
+    unsigned size;
   };
 
-  void Add(Token key, std::type_index type, unsigned offset);
+  DataLayout(void) = default;
+  DataLayout(DataLayout const & layout) = default;
+  DataLayout(DataLayout && layout) = default;
+
+  // The size is 0 where the caller does not know it.
+  void Add(Token key, std::type_index type, unsigned offset,
+    unsigned size = 0);
 
   bool Contains(Token key) const;
   std::type_index GetType(Token key) const;
   unsigned GetOffset(Token key) const;
+  unsigned GetSize(Token key) const;
 
   unsigned Size(void) const;
 
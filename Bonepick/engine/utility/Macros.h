@@ -13,6 +13,15 @@
 //macro for getting the number of elelments in an array
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof(*arr))
 
+//macro for hinting that memory is about to be read
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#define PREFETCH(address) \
+  _mm_prefetch(reinterpret_cast<char const *>(address), _MM_HINT_T0)
+#else
+#define PREFETCH(address) __builtin_prefetch(address)
+#endif
+
 //macro for geting the C string of a macro call
 #define CSTRING(string) CStringInner(string)
 #define CSTRING_INNER(string) #string
@@ -0,0 +1,21 @@
+#include "utility/Profiling.h"
+
+//##############################################################################
+ProfileTimer::ProfileTimer(void) :
+  start_(std::chrono::steady_clock::now())
+{}
+
+//##############################################################################
+// Nanoseconds since the last lap, starts the next one.
+u64 ProfileTimer::Lap(void)
+{
+  std::chrono::steady_clock::time_point const now =
+    std::chrono::steady_clock::now();
+
+  u64 const elapsed = u64(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count());
+
+  start_ = now;
+
+  return elapsed;
+}
@@ -0,0 +1,30 @@
+#ifndef ENGINE_UTILITY_PROFILING_H
+#define ENGINE_UTILITY_PROFILING_H
+
+#include <chrono>
+
+#include "utility/Typedefs.h"
+
+//##############################################################################
+// Instrumentation is only compiled with PROFILING_ENABLED set, code wrapped in
+// ON_PROFILING() disappears otherwise.
+#if PROFILING_ENABLED
+#define ON_PROFILING(...) __VA_ARGS__
+#else
+#define ON_PROFILING(...)
+#endif
+
+//##############################################################################
+// Wall clock time since construction or the last Lap().
+class ProfileTimer
+{
+public:
+  ProfileTimer(void);
+
+  u64 Lap(void);
+
+private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+#endif
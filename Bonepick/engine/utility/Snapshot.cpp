@@ -0,0 +1,175 @@
+#include "utility/Snapshot.h"
+
+#include <cstdio>
+#include <cstring>
+
+//##############################################################################
+namespace
+{
+  //############################################################################
+  struct SnapshotHeader
+  {
+    u32 magic;
+    u32 version;
+    u32 sectionCount;
+    u32 padding;
+  };
+
+  //############################################################################
+  struct SnapshotSection
+  {
+    u64 offset;
+    u64 size;
+  };
+
+  //############################################################################
+  u64 AlignOffset(u64 offset)
+  {
+    return (offset + SnapshotAlignment - 1) / SnapshotAlignment *
+      SnapshotAlignment;
+  }
+
+  //############################################################################
+  // Empty arrays may hand out null, which fwrite must not be given even for
+  // zero bytes.
+  bool WriteBytes(void const * data, u64 size, std::FILE * file)
+  {
+    if (size == 0)
+      return true;
+
+    return std::fwrite(data, 1, size, file) == size;
+  }
+}
+
+//##############################################################################
+bool SnapshotWriter::Save(char const * path) const
+{
+  ASSERT(path);
+
+  Array<SnapshotSection> table;
+  table.Reserve(sections_.Size());
+
+  u64 offset = AlignOffset(sizeof(SnapshotHeader) +
+    sections_.Size() * sizeof(SnapshotSection));
+
+  for (Section const & section : sections_)
+  {
+    table.EmplaceBack(SnapshotSection{ offset, section.size });
+    offset = AlignOffset(offset + section.size);
+  }
+
+  std::FILE * file = std::fopen(path, "wb");
+
+  if (!file)
+    return false;
+
+  SnapshotHeader const header =
+    { SnapshotMagic, SnapshotVersion, u32(sections_.Size()), 0 };
+
+  bool written =
+    std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+    WriteBytes(table.Begin(), table.Size() * sizeof(SnapshotSection), file);
+
+  u64 position = sizeof(header) + table.Size() * sizeof(SnapshotSection);
+  byte const padding[SnapshotAlignment] = {};
+
+  for (int i = 0; written && i < sections_.Size(); ++i)
+  {
+    written =
+      WriteBytes(padding, table[i].offset - position, file) &&
+      WriteBytes(sections_[i].data, sections_[i].size, file);
+
+    position = table[i].offset + sections_[i].size;
+  }
+
+  return std::fclose(file) == 0 && written;
+}
+
+//##############################################################################
+bool SnapshotReader::Load(char const * path)
+{
+  ASSERT(path);
+
+  valid_ = false;
+  nextSection_ = 0;
+
+  std::FILE * file = std::fopen(path, "rb");
+
+  if (!file)
+    return false;
+
+  std::fseek(file, 0, SEEK_END);
+  long const fileSize = std::ftell(file);
+  std::fseek(file, 0, SEEK_SET);
+
+  if (fileSize < long(sizeof(SnapshotHeader)))
+  {
+    std::fclose(file);
+    return false;
+  }
+
+  //u64 storage keeps every aligned section aligned in memory as well
+  imageSize_ = u64(fileSize);
+  image_.Clear();
+  image_.Resize(int((imageSize_ + sizeof(u64) - 1) / sizeof(u64)));
+
+  bool const read =
+    std::fread(image_.Begin(), 1, imageSize_, file) == imageSize_;
+
+  std::fclose(file);
+
+  if (!read)
+    return false;
+
+  SnapshotHeader header;
+  std::memcpy(&header, image_.Begin(), sizeof(header));
+
+  if (header.magic != SnapshotMagic || header.version != SnapshotVersion)
+    return false;
+
+  if (sizeof(header) + u64(header.sectionCount) * sizeof(SnapshotSection) >
+    imageSize_)
+  {
+    return false;
+  }
+
+  sectionCount_ = header.sectionCount;
+  valid_ = true;
+
+  return true;
+}
+
+//##############################################################################
+bool SnapshotReader::IsValid(void) const
+{
+  return valid_;
+}
+
+//##############################################################################
+// Next section in file order, or null once the sections ran out or the file
+// is damaged.
+void const * SnapshotReader::ReadSection(u64 * size)
+{
+  ASSERT(size);
+
+  if (!valid_ || nextSection_ >= sectionCount_)
+    return nullptr;
+
+  byte const * image = reinterpret_cast<byte const *>(image_.Begin());
+
+  SnapshotSection section;
+  std::memcpy(&section, image + sizeof(SnapshotHeader) +
+    nextSection_ * sizeof(SnapshotSection), sizeof(section));
+
+  if (section.offset % SnapshotAlignment != 0 ||
+    section.offset > imageSize_ || section.size > imageSize_ - section.offset)
+  {
+    valid_ = false;
+    return nullptr;
+  }
+
+  ++nextSection_;
+  *size = section.size;
+
+  return image + section.offset;
+}
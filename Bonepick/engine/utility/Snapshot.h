@@ -0,0 +1,143 @@
+#ifndef ENGINE_UTILITY_SNAPSHOT_H
+#define ENGINE_UTILITY_SNAPSHOT_H
+
+#include <type_traits>
+
+#include "utility/containers/Array.h"
+#include "utility/Debug.h"
+#include "utility/Typedefs.h"
+
+//##############################################################################
+// Snapshot files are a header, a table of sections and the sections
+// themselves, each starting on a SnapshotAlignment boundary. Sections are raw
+// copies of arrays of trivially copyable values, so loading one is a single
+// block copy out of the file image.
+u32 const SnapshotMagic     = 0x53535042;
+u32 const SnapshotVersion   = 2;
+u64 const SnapshotAlignment = 64;
+
+//##############################################################################
+// Collects sections and writes them out in one go. Arrays are referenced, not
+// copied, and have to stay alive and unchanged until Save() returns.
+class SnapshotWriter
+{
+public:
+  template <typename T>
+  void AddValue(T const & value);
+
+  template <typename T>
+  void AddArray(Array<T> const & values);
+
+  template <typename T>
+  void AddArray(T const * values, int count);
+
+  bool Save(char const * path) const;
+
+private:
+  struct Section
+  {
+    void const * data;
+    u64          size;
+  };
+
+  Array<Section>     sections_;
+  Array<Array<byte>> ownedData_;
+};
+
+//##############################################################################
+// Reads a whole snapshot file with a single read and hands the sections out in
+// the order they were written. The file isn't memory mapped, the engine has no
+// portable layer for that, so loading costs one read of the file plus a block
+// copy per section, still without any per-entity parsing.
+class SnapshotReader
+{
+public:
+  bool Load(char const * path);
+
+  bool IsValid(void) const;
+
+  template <typename T>
+  bool ReadValue(T * value);
+
+  template <typename T>
+  bool ReadArray(Array<T> * values);
+
+  void const * ReadSection(u64 * size);
+
+private:
+  Array<u64> image_;
+  u64        imageSize_    = 0;
+  u32        sectionCount_ = 0;
+  u32        nextSection_  = 0;
+  bool       valid_        = false;
+};
+
+//##############################################################################
+template <typename T>
+void SnapshotWriter::AddValue(T const & value)
+{
+  static_assert(std::is_trivially_copyable_v<T>);
+
+  byte const * bytes = reinterpret_cast<byte const *>(&value);
+
+  ownedData_.EmplaceBack(bytes, int(sizeof(T)));
+  sections_.EmplaceBack(Section{ ownedData_.GetBack().Begin(), sizeof(T) });
+}
+
+//##############################################################################
+template <typename T>
+void SnapshotWriter::AddArray(Array<T> const & values)
+{
+  AddArray(values.Begin(), values.Size());
+}
+
+//##############################################################################
+template <typename T>
+void SnapshotWriter::AddArray(T const * values, int count)
+{
+  static_assert(std::is_trivially_copyable_v<T>,
+    "Only trivially copyable values can be stored in a snapshot");
+
+  ASSERT(count >= 0);
+
+  sections_.EmplaceBack(Section{ values, u64(count) * sizeof(T) });
+}
+
+//##############################################################################
+template <typename T>
+bool SnapshotReader::ReadValue(T * value)
+{
+  static_assert(std::is_trivially_copyable_v<T>);
+
+  ASSERT(value);
+
+  u64 size = 0;
+  void const * data = ReadSection(&size);
+
+  if (!data || size != sizeof(T))
+    return false;
+
+  *value = *static_cast<T const *>(data);
+  return true;
+}
+
+//##############################################################################
+template <typename T>
+bool SnapshotReader::ReadArray(Array<T> * values)
+{
+  static_assert(std::is_trivially_copyable_v<T>,
+    "Only trivially copyable values can be stored in a snapshot");
+
+  ASSERT(values);
+
+  u64 size = 0;
+  void const * data = ReadSection(&size);
+
+  if (!data || size % sizeof(T) != 0)
+    return false;
+
+  *values = Array<T>(static_cast<T const *>(data), int(size / sizeof(T)));
+  return true;
+}
+
+#endif
@@ -25,6 +25,9 @@ struct TypeIsInTypes;
 template <typename T, typename ... Types>
 struct TypeIsDecayedTypes;
 
+template <typename T, typename ... Types>
+struct TypeIndexInTypes;
+
 template <typename ... Types>
 struct TypesAreUnique;
 
@@ -168,6 +171,22 @@ struct TypeIsDecayedTypes<std::decay_t<T>, T>
   static bool const value = true;
 };
 
+//##############################################################################
+template <typename T, typename ... Types>
+struct TypeIndexInTypes<T, T, Types...>
+{
+  static int const value = 0;
+};
+
+//##############################################################################
+template <typename T, typename Type0, typename ... Types>
+struct TypeIndexInTypes<T, Type0, Types...>
+{
+  static_assert(TypeIsInTypes<T, Types...>::value);
+
+  static int const value = TypeIndexInTypes<T, Types...>::value + 1;
+};
+
 //##############################################################################
 template <typename Type0, typename ... Types>
 struct TypesAreUnique<Type0, Types...>
@@ -0,0 +1,149 @@
+#include "utility/ThreadPool.h"
+
+#include <utility>
+
+#include "utility/Debug.h"
+
+namespace
+{
+  //############################################################################
+  // Pool whose job the calling thread is running, null outside of jobs.
+  thread_local ThreadPool const * runningPool = nullptr;
+}
+
+//##############################################################################
+ThreadPool::ThreadPool(void) :
+  ThreadPool(int(std::thread::hardware_concurrency()) - 1)
+{}
+
+//##############################################################################
+ThreadPool::ThreadPool(int workerCount)
+{
+  workers_.Reserve(workerCount > 0 ? workerCount : 0);
+
+  for (int i = 0; i < workerCount; ++i)
+    workers_.EmplaceBack(&ThreadPool::WorkerLoop, this);
+}
+
+//##############################################################################
+// Errors of jobs nobody waited for are dropped, destructors can't throw.
+ThreadPool::~ThreadPool(void)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    WaitForJobs(lock);
+    stopping_ = true;
+  }
+
+  jobAdded_.notify_all();
+
+  for (std::thread & worker : workers_)
+    worker.join();
+}
+
+//##############################################################################
+int ThreadPool::WorkerCount(void) const
+{
+  return workers_.Size();
+}
+
+//##############################################################################
+// True on a thread that is inside one of this pool's jobs, either on a worker
+// or run inline by Wait().
+bool ThreadPool::IsRunningJob(void) const
+{
+  return runningPool == this;
+}
+
+//##############################################################################
+void ThreadPool::Submit(Job const & job)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.emplace_back(job);
+    ++pendingJobs_;
+  }
+
+  jobAdded_.notify_one();
+}
+
+//##############################################################################
+void ThreadPool::Wait(void)
+{
+  ASSERT(!IsRunningJob(), "Jobs can't wait for their own pool");
+
+  std::exception_ptr jobError;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    WaitForJobs(lock);
+    std::swap(jobError, jobError_);
+  }
+
+  if (jobError)
+    std::rethrow_exception(jobError);
+}
+
+//##############################################################################
+void ThreadPool::WorkerLoop(void)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true)
+  {
+    jobAdded_.wait(lock,
+      [this](void)
+      {
+        return stopping_ || !jobs_.empty();
+      });
+
+    if (jobs_.empty())
+      return;
+
+    RunJob(lock);
+  }
+}
+
+//##############################################################################
+// A job that throws still counts as finished, so Wait() can't hang on it.
+void ThreadPool::RunJob(std::unique_lock<std::mutex> & lock)
+{
+  Job job = std::move(jobs_.front());
+  jobs_.pop_front();
+
+  ThreadPool const * const outerPool = runningPool;
+  std::exception_ptr jobError;
+
+  lock.unlock();
+  runningPool = this;
+
+  try
+  {
+    job();
+  }
+  catch (...)
+  {
+    jobError = std::current_exception();
+  }
+
+  runningPool = outerPool;
+  lock.lock();
+
+  if (jobError && !jobError_)
+    jobError_ = jobError;
+
+  if (--pendingJobs_ == 0)
+    jobsFinished_.notify_all();
+}
+
+//##############################################################################
+void ThreadPool::WaitForJobs(std::unique_lock<std::mutex> & lock)
+{
+  while (pendingJobs_ != 0)
+  {
+    if (!jobs_.empty())
+      RunJob(lock);
+    else
+      jobsFinished_.wait(lock);
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef ENGINE_UTILITY_THREADPOOL_H
+#define ENGINE_UTILITY_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "utility/containers/Array.h"
+
+//##############################################################################
+// Fixed set of worker threads pulling jobs from a shared queue. Wait() runs
+// queued jobs on the calling thread as well, so a pool with no workers runs
+// everything inline and in submission order. Wait() can't be called from a
+// job of the same pool, the job would wait on itself. An exception thrown by
+// a job is rethrown from Wait(), the first one if several jobs threw.
+class ThreadPool
+{
+public:
+  typedef std::function<void(void)> Job;
+
+  ThreadPool(void);
+  ThreadPool(int workerCount);
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool(ThreadPool &&) = delete;
+  ~ThreadPool(void);
+
+  int WorkerCount(void) const;
+
+  bool IsRunningJob(void) const;
+
+  void Submit(Job const & job);
+  void Wait(void);
+
+  ThreadPool & operator =(ThreadPool const &) = delete;
+  ThreadPool & operator =(ThreadPool &&) = delete;
+
+private:
+  void WorkerLoop(void);
+  void RunJob(std::unique_lock<std::mutex> & lock);
+  void WaitForJobs(std::unique_lock<std::mutex> & lock);
+
+  Array<std::thread>      workers_;
+  std::deque<Job>         jobs_;
+  std::exception_ptr      jobError_;
+  int                     pendingJobs_ = 0;
+  bool                    stopping_    = false;
+  std::mutex              mutex_;
+  std::condition_variable jobAdded_;
+  std::condition_variable jobsFinished_;
+};
+
+#endif
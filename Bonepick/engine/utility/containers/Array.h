@@ -22,6 +22,7 @@ public:
 
   void Reserve(SizeType capacity);
   void Resize(SizeType size);
+  void Resize(SizeType size, T const & value);
 
   void Erase(T const * location);
   void Erase(SizeType index);
@@ -121,6 +122,13 @@ void Array<T, SizeType>::Resize(SizeType size)
   data_.resize(size);
 }
 
+//##############################################################################
+template <typename T, typename SizeType>
+void Array<T, SizeType>::Resize(SizeType size, T const & value)
+{
+  data_.resize(size, value);
+}
+
 //##############################################################################
 template <typename T, typename SizeType>
 void Array<T, SizeType>::Erase(T const * value)
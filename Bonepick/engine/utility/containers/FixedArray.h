@@ -0,0 +1,279 @@
+#ifndef ENGINE_UTILITY_CONTAINERS_FIXEDARRAY_H
+#define ENGINE_UTILITY_CONTAINERS_FIXEDARRAY_H
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "utility/Debug.h"
+
+//##############################################################################
+// Contiguous array with a capacity that is set once and never grows, so
+// elements are never relocated while the array is alive.
+template <typename T, typename SizeType = int>
+class FixedArray
+{
+public:
+  FixedArray(void) = default;
+  FixedArray(SizeType capacity);
+  FixedArray(FixedArray const & arr);
+  FixedArray(FixedArray && arr);
+  ~FixedArray(void);
+
+  template <typename ... Params>
+  void EmplaceBack(Params && ... params);
+
+  void PopBack(void);
+
+  bool Empty(void) const;
+  bool Full(void) const;
+  SizeType Size(void) const;
+  SizeType Capacity(void) const;
+
+  void Clear(void);
+
+  FixedArray & operator =(FixedArray const & arr);
+  FixedArray & operator =(FixedArray && arr);
+
+  T & operator [](SizeType index);
+  T const & operator [](SizeType index) const;
+
+  T * Begin(void);
+  T * End(void);
+  T const * Begin(void) const;
+  T const * End(void) const;
+
+private:
+  typedef std::aligned_storage_t<sizeof(T), alignof(T)> Storage;
+
+  void Release(void);
+
+  Storage * data_     = nullptr;
+  SizeType  size_     = 0;
+  SizeType  capacity_ = 0;
+};
+
+//##############################################################################
+template <typename T, typename SizeType>
+FixedArray<T, SizeType>::FixedArray(SizeType capacity) :
+  data_(capacity ? new Storage[capacity] : nullptr),
+  capacity_(capacity)
+{}
+
+//##############################################################################
+template <typename T, typename SizeType>
+FixedArray<T, SizeType>::FixedArray(FixedArray const & arr) :
+  FixedArray(arr.capacity_)
+{
+  for (T const & value : arr)
+    EmplaceBack(value);
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+FixedArray<T, SizeType>::FixedArray(FixedArray && arr) :
+  data_(arr.data_),
+  size_(arr.size_),
+  capacity_(arr.capacity_)
+{
+  arr.data_     = nullptr;
+  arr.size_     = 0;
+  arr.capacity_ = 0;
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+FixedArray<T, SizeType>::~FixedArray(void)
+{
+  Release();
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+template <typename ... Params>
+void FixedArray<T, SizeType>::EmplaceBack(Params && ... params)
+{
+  ASSERT(size_ < capacity_);
+
+  new (data_ + size_) T(std::forward<Params &&>(params)...);
+  ++size_;
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+void FixedArray<T, SizeType>::PopBack(void)
+{
+  if (!Empty())
+  {
+    --size_;
+    Begin()[size_].~T();
+  }
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+bool FixedArray<T, SizeType>::Empty(void) const
+{
+  return size_ == SizeType(0);
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+bool FixedArray<T, SizeType>::Full(void) const
+{
+  return size_ == capacity_;
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+SizeType FixedArray<T, SizeType>::Size(void) const
+{
+  return size_;
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+SizeType FixedArray<T, SizeType>::Capacity(void) const
+{
+  return capacity_;
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+void FixedArray<T, SizeType>::Clear(void)
+{
+  while (!Empty())
+    PopBack();
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+FixedArray<T, SizeType> &
+  FixedArray<T, SizeType>::operator =(FixedArray const & arr)
+{
+  if (this != &arr)
+  {
+    Release();
+
+    data_     = arr.capacity_ ? new Storage[arr.capacity_] : nullptr;
+    capacity_ = arr.capacity_;
+
+    for (T const & value : arr)
+      EmplaceBack(value);
+  }
+
+  return *this;
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+FixedArray<T, SizeType> & FixedArray<T, SizeType>::operator =(FixedArray && arr)
+{
+  if (this != &arr)
+  {
+    Release();
+
+    data_     = arr.data_;
+    size_     = arr.size_;
+    capacity_ = arr.capacity_;
+
+    arr.data_     = nullptr;
+    arr.size_     = 0;
+    arr.capacity_ = 0;
+  }
+
+  return *this;
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+T & FixedArray<T, SizeType>::operator [](SizeType index)
+{
+  ASSERT(index < size_);
+  ASSERT(index >= SizeType(0));
+
+  return Begin()[index];
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+T const & FixedArray<T, SizeType>::operator [](SizeType index) const
+{
+  ASSERT(index < size_);
+  ASSERT(index >= SizeType(0));
+
+  return Begin()[index];
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+T * FixedArray<T, SizeType>::Begin(void)
+{
+  return std::launder(reinterpret_cast<T *>(data_));
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+T * FixedArray<T, SizeType>::End(void)
+{
+  return Begin() + size_;
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+T const * FixedArray<T, SizeType>::Begin(void) const
+{
+  return std::launder(reinterpret_cast<T const *>(data_));
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+T const * FixedArray<T, SizeType>::End(void) const
+{
+  return Begin() + size_;
+}
+
+//##############################################################################
+template <typename T, typename SizeType>
+void FixedArray<T, SizeType>::Release(void)
+{
+  Clear();
+
+  delete [] data_;
+
+  data_     = nullptr;
+  capacity_ = 0;
+}
+
+namespace std
+{
+  //############################################################################
+  template <typename T, typename SizeType>
+  T * begin(FixedArray<T, SizeType> & arr)
+  {
+    return arr.Begin();
+  }
+
+  //############################################################################
+  template <typename T, typename SizeType>
+  T * end(FixedArray<T, SizeType> & arr)
+  {
+    return arr.End();
+  }
+
+  //############################################################################
+  template <typename T, typename SizeType>
+  T const * begin(FixedArray<T, SizeType> const & arr)
+  {
+    return arr.Begin();
+  }
+
+  //############################################################################
+  template <typename T, typename SizeType>
+  T const * end(FixedArray<T, SizeType> const & arr)
+  {
+    return arr.End();
+  }
+}
+
+#endif
@@ -95,9 +95,9 @@ private:
 template <typename T, typename SizeType>
 template <typename U>
 Grid<T, SizeType>::Grid(Grid<U> const & grid) :
-  size_(size)
+  size_(grid.GetSize())
 {
-  SizeType const count = size.x * size.y;
+  SizeType const count = size_.x * size_.y;
 
   data_.reserve(count);
   for (SizeType i = 0; i < count; ++i)
@@ -458,10 +458,10 @@ SizeType Grid<T, SizeType>::GetIndexFromPos(UVec2 const & pos) const
 template <typename T, typename SizeType>
 SizeType Grid<T, SizeType>::GetIndexFromPos(SizeType xPos, SizeType yPos) const
 {
-  ASSERT(x < size_.x);
-  ASSERT(y < size_.y);
+  ASSERT(xPos < size_.x);
+  ASSERT(yPos < size_.y);
 
-  return y * size_.x + x;
+  return yPos * size_.x + xPos;
 }
 
 //##############################################################################
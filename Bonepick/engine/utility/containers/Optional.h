@@ -29,8 +29,8 @@ public:
   T * operator ->(void);
   T const * operator ->(void) const;
 
-  Optional & operator =(Optional const & optional);
-  Optional & operator =(Optional && optional);
+  Optional & operator =(Optional const & optional) = default;
+  Optional & operator =(Optional && optional) = default;
 
   template <typename ... Params>
   T & Emplace(Params && ... params);
@@ -83,22 +83,6 @@ T const * Optional<T>::operator ->(void) const
   return &data_.value();
 }
 
-//##############################################################################
-template <typename T>
-Optional<T> & Optional<T>::operator =(Optional const & optional)
-{
-  data_ = optional.data_;
-  return *this;
-}
-
-//##############################################################################
-template <typename T>
-Optional<T> & Optional<T>::operator =(Optional && optional)
-{
-  data_ = std::move(optional.data_);
-  return *this;
-}
-
 //##############################################################################
 template <typename T>
 template <typename ... Params>
@@ -35,12 +35,17 @@ public:
   template <typename ... Params>
   void Emplace(Params && ... params);
 
+  void Merge(StoreType const * values, SizeType count);
+
   bool Empty(void) const;
   SizeType Size(void) const;
 
   void Erase(SizeType index);
   void Erase(Type * location);
 
+  template <typename ErasePred>
+  SizeType EraseIf(ErasePred const & pred);
+
   void Clear(void);
 
   template <typename U>
@@ -122,6 +127,36 @@ void SortedArrayBase<StoreType, UseType, Pred, AlwaysConst, SizeType>::Emplace(
   data_.Emplace(data_.Begin() + index, std::move(value));
 }
 
+//##############################################################################
+// Inserts a sorted run of values with one linear pass from the back, instead
+// of a shifting insert per value.
+template <typename StoreType, typename UseType, typename Pred, bool AlwaysConst,
+  typename SizeType>
+void SortedArrayBase<StoreType, UseType, Pred, AlwaysConst, SizeType>::Merge(
+  StoreType const * values, SizeType count)
+{
+  ASSERT(std::is_sorted(values, values + count, Pred()));
+
+  SizeType existing = data_.Size();
+  SizeType incoming = count;
+  SizeType write    = existing + count;
+
+  data_.Resize(write);
+
+  while (incoming > 0)
+  {
+    if (existing > 0 && Pred()(values[incoming - 1], data_[existing - 1]))
+      data_[--write] = std::move(data_[--existing]);
+    else
+    {
+      ASSERT(existing == 0 || Pred()(data_[existing - 1], values[incoming - 1]),
+        "Value is already in the sorted array");
+
+      data_[--write] = values[--incoming];
+    }
+  }
+}
+
 //##############################################################################
 template <typename StoreType, typename UseType, typename Pred, bool AlwaysConst,
   typename SizeType>
@@ -160,6 +195,36 @@ void SortedArrayBase<StoreType, UseType, Pred, AlwaysConst, SizeType>::Erase(
   data_.Erase(reinterpret_cast<StoreType const *>(location));
 }
 
+//##############################################################################
+// Removes every value matching the predicate in one stable pass and returns
+// how many were removed.
+template <typename StoreType, typename UseType, typename Pred, bool AlwaysConst,
+  typename SizeType>
+template <typename ErasePred>
+SizeType SortedArrayBase<StoreType, UseType, Pred, AlwaysConst, SizeType>::
+  EraseIf(ErasePred const & pred)
+{
+  SizeType write = 0;
+
+  for (SizeType read = 0; read < data_.Size(); ++read)
+  {
+    if (pred(data_[read]))
+      continue;
+
+    if (write != read)
+      data_[write] = std::move(data_[read]);
+
+    ++write;
+  }
+
+  SizeType const erased = data_.Size() - write;
+
+  while (data_.Size() > write)
+    data_.PopBack();
+
+  return erased;
+}
+
 //##############################################################################
 template <typename StoreType, typename UseType, typename Pred, bool AlwaysConst,
   typename SizeType>
@@ -0,0 +1,445 @@
+#ifndef ENGINE_UTILITY_CONTAINERS_SPARSESET_H
+#define ENGINE_UTILITY_CONTAINERS_SPARSESET_H
+
+#include <algorithm>
+#include <utility>
+
+#include "utility/containers/Array.h"
+#include "utility/Debug.h"
+
+//##############################################################################
+// Map from non-negative integer keys to values with constant time lookup,
+// insertion and removal. Values live in a dense array next to their keys, and
+// a paged sparse array maps each key to its dense index. Removal swaps the
+// last element into the hole, so the dense order is only kept in key order
+// while IsSorted() is true; Sort() restores it. The set remembers how long its
+// sorted prefix is, so Sort() only has to sort what came after it.
+template <typename Value, typename SizeType = int>
+class SparseSet
+{
+public:
+  SparseSet(void) = default;
+  SparseSet(SparseSet const & set) = default;
+  SparseSet(SparseSet && set) = default;
+  ~SparseSet(void) = default;
+
+  void Reserve(SizeType capacity);
+
+  void Assign(int const * keys, Value const * values, SizeType count);
+
+  template <typename ... Params>
+  Value & Emplace(int key, Params && ... params);
+
+  template <typename ValueOf>
+  void EmplaceRange(int firstKey, SizeType count, ValueOf const & valueOf);
+
+  void Erase(int key);
+
+  template <typename Pred>
+  SizeType EraseIf(Pred const & pred);
+
+  bool Empty(void) const;
+  SizeType Size(void) const;
+
+  void Clear(void);
+
+  Value * Find(int key);
+  Value const * Find(int key) const;
+
+  bool Contains(int key) const;
+  void Prefetch(int key) const;
+
+  int GetKey(SizeType index) const;
+  Value & GetValue(SizeType index);
+  Value const & GetValue(SizeType index) const;
+
+  SizeType GetIndex(int key) const;
+
+  int const * Keys(void) const;
+  Value const * Values(void) const;
+
+  bool IsSorted(void) const;
+  void Sort(void);
+
+  SparseSet & operator =(SparseSet const & set) = default;
+  SparseSet & operator =(SparseSet && set) = default;
+
+private:
+  static int const PageBits = 12;
+  static int const PageSize = 1 << PageBits;
+
+  SizeType * FindSparse(int key);
+  SizeType const * FindSparse(int key) const;
+  SizeType & GetSparse(int key);
+
+  Array<Array<SizeType>> pages_;
+  Array<int>             keys_;
+  Array<Value>           values_;
+  SizeType               sortedSize_ = 0;
+
+  //Scratch space of Sort(), kept to not allocate every time
+  Array<std::pair<int, Value>> unsorted_;
+};
+
+//##############################################################################
+template <typename Value, typename SizeType>
+void SparseSet<Value, SizeType>::Reserve(SizeType capacity)
+{
+  keys_.Reserve(capacity);
+  values_.Reserve(capacity);
+}
+
+//##############################################################################
+// Replaces the contents with the given entries, copying the dense arrays in
+// one go and indexing the keys in a single pass.
+template <typename Value, typename SizeType>
+void SparseSet<Value, SizeType>::Assign(int const * keys, Value const * values,
+  SizeType count)
+{
+  Clear();
+
+  keys_   = Array<int>(keys, count);
+  values_ = Array<Value>(values, count);
+
+  for (SizeType i = 0; i < count; ++i)
+  {
+    ASSERT(keys[i] >= 0);
+    ASSERT(!Contains(keys[i]), "Key is already in the sparse set");
+
+    GetSparse(keys[i]) = i;
+  }
+
+  sortedSize_ = SizeType(std::is_sorted_until(keys, keys + count) - keys);
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+template <typename ... Params>
+Value & SparseSet<Value, SizeType>::Emplace(int key, Params && ... params)
+{
+  ASSERT(key >= 0);
+  ASSERT(!Contains(key), "Key is already in the sparse set");
+
+  if (sortedSize_ == keys_.Size() && (keys_.Empty() || key > keys_.GetBack()))
+    ++sortedSize_;
+
+  GetSparse(key) = keys_.Size();
+  keys_.EmplaceBack(key);
+  values_.EmplaceBack(std::forward<Params &&>(params)...);
+
+  return values_.GetBack();
+}
+
+//##############################################################################
+// Adds the keys firstKey up to firstKey + count, each with the value
+// valueOf(i) of its offset i into the range. The sparse entries are written
+// page by page and the sorted prefix is only checked once for the range.
+template <typename Value, typename SizeType>
+template <typename ValueOf>
+void SparseSet<Value, SizeType>::EmplaceRange(int firstKey, SizeType count,
+  ValueOf const & valueOf)
+{
+  ASSERT(firstKey >= 0);
+  ASSERT(count >= 0);
+
+  if (count == 0)
+    return;
+
+  if (sortedSize_ == keys_.Size() &&
+    (keys_.Empty() || firstKey > keys_.GetBack()))
+  {
+    sortedSize_ += count;
+  }
+
+  int const endKey = firstKey + int(count);
+
+  for (int key = firstKey; key < endKey;)
+  {
+    SizeType * sparse = &GetSparse(key);
+    int const pageEnd = std::min(endKey, (key | (PageSize - 1)) + 1);
+
+    for (; key < pageEnd; ++key, ++sparse)
+    {
+      ASSERT(*sparse < 0, "Key is already in the sparse set");
+
+      *sparse = keys_.Size();
+      keys_.EmplaceBack(key);
+      values_.EmplaceBack(valueOf(SizeType(key - firstKey)));
+    }
+  }
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+void SparseSet<Value, SizeType>::Erase(int key)
+{
+  SizeType * sparse = FindSparse(key);
+
+  ASSERT(sparse && *sparse >= 0, "Key is not in the sparse set");
+
+  SizeType const index = *sparse;
+  SizeType const last  = keys_.Size() - 1;
+
+  if (index != last)
+  {
+    keys_[index]   = keys_[last];
+    values_[index] = std::move(values_[last]);
+    GetSparse(keys_[index]) = index;
+    sortedSize_ = std::min(sortedSize_, index);
+  }
+
+  *sparse = SizeType(-1);
+  keys_.PopBack();
+  values_.PopBack();
+  sortedSize_ = std::min(sortedSize_, keys_.Size());
+}
+
+//##############################################################################
+// Removes every entry the predicate accepts, called with the key and value, in
+// one pass. Unlike Erase() the remaining entries keep their order.
+template <typename Value, typename SizeType>
+template <typename Pred>
+SizeType SparseSet<Value, SizeType>::EraseIf(Pred const & pred)
+{
+  SizeType write = 0;
+  SizeType sortedSize = 0;
+
+  for (SizeType read = 0; read < keys_.Size(); ++read)
+  {
+    if (pred(keys_[read], static_cast<Value const &>(values_[read])))
+    {
+      GetSparse(keys_[read]) = SizeType(-1);
+      continue;
+    }
+
+    if (read < sortedSize_)
+      ++sortedSize;
+
+    if (write != read)
+    {
+      keys_[write]   = keys_[read];
+      values_[write] = std::move(values_[read]);
+      GetSparse(keys_[write]) = write;
+    }
+
+    ++write;
+  }
+
+  SizeType const erased = keys_.Size() - write;
+
+  while (keys_.Size() > write)
+  {
+    keys_.PopBack();
+    values_.PopBack();
+  }
+
+  sortedSize_ = sortedSize;
+
+  return erased;
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+bool SparseSet<Value, SizeType>::Empty(void) const
+{
+  return keys_.Empty();
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+SizeType SparseSet<Value, SizeType>::Size(void) const
+{
+  return keys_.Size();
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+void SparseSet<Value, SizeType>::Clear(void)
+{
+  //Keep the pages, sets refilled every frame touch the same ones again
+  for (int key : keys_)
+    GetSparse(key) = SizeType(-1);
+
+  keys_.Clear();
+  values_.Clear();
+  sortedSize_ = 0;
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+Value * SparseSet<Value, SizeType>::Find(int key)
+{
+  SizeType const * sparse = FindSparse(key);
+
+  if (sparse && *sparse >= 0)
+    return &values_[*sparse];
+  else
+    return nullptr;
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+Value const * SparseSet<Value, SizeType>::Find(int key) const
+{
+  return const_cast<SparseSet *>(this)->Find(key);
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+bool SparseSet<Value, SizeType>::Contains(int key) const
+{
+  SizeType const * sparse = FindSparse(key);
+
+  return sparse && *sparse >= 0;
+}
+
+//##############################################################################
+// Hints that the key is about to be looked up. Only the sparse entry is
+// fetched, its value can't be known without waiting for it.
+template <typename Value, typename SizeType>
+void SparseSet<Value, SizeType>::Prefetch(int key) const
+{
+  if (SizeType const * sparse = FindSparse(key))
+    PREFETCH(sparse);
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+int SparseSet<Value, SizeType>::GetKey(SizeType index) const
+{
+  return keys_[index];
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+Value & SparseSet<Value, SizeType>::GetValue(SizeType index)
+{
+  return values_[index];
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+Value const & SparseSet<Value, SizeType>::GetValue(SizeType index) const
+{
+  return values_[index];
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+SizeType SparseSet<Value, SizeType>::GetIndex(int key) const
+{
+  SizeType const * sparse = FindSparse(key);
+
+  ASSERT(sparse && *sparse >= 0, "Key is not in the sparse set");
+
+  return *sparse;
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+int const * SparseSet<Value, SizeType>::Keys(void) const
+{
+  return keys_.Begin();
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+Value const * SparseSet<Value, SizeType>::Values(void) const
+{
+  return values_.Begin();
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+bool SparseSet<Value, SizeType>::IsSorted(void) const
+{
+  return sortedSize_ == keys_.Size();
+}
+
+//##############################################################################
+// Sorts the entries past the sorted prefix, usually the ones added since the
+// last sort, and merges them into the prefix from the back. Prefix entries
+// with keys below the lowest new key don't move.
+template <typename Value, typename SizeType>
+void SparseSet<Value, SizeType>::Sort(void)
+{
+  if (IsSorted())
+    return;
+
+  for (SizeType i = sortedSize_; i < keys_.Size(); ++i)
+    unsorted_.EmplaceBack(keys_[i], std::move(values_[i]));
+
+  std::sort(unsorted_.Begin(), unsorted_.End(),
+    [](std::pair<int, Value> const & entry0,
+       std::pair<int, Value> const & entry1)
+    {
+      return entry0.first < entry1.first;
+    });
+
+  SizeType sorted = sortedSize_;
+  SizeType write = keys_.Size();
+
+  for (SizeType next = unsorted_.Size(); next > 0; )
+  {
+    --write;
+
+    if (sorted > 0 && keys_[sorted - 1] > unsorted_[next - 1].first)
+    {
+      --sorted;
+      keys_[write]   = keys_[sorted];
+      values_[write] = std::move(values_[sorted]);
+    }
+    else
+    {
+      --next;
+      keys_[write]   = unsorted_[next].first;
+      values_[write] = std::move(unsorted_[next].second);
+    }
+
+    GetSparse(keys_[write]) = write;
+  }
+
+  unsorted_.Clear();
+  sortedSize_ = keys_.Size();
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+SizeType * SparseSet<Value, SizeType>::FindSparse(int key)
+{
+  if (key < 0)
+    return nullptr;
+
+  int const page = key >> PageBits;
+
+  if (page >= pages_.Size() || pages_[page].Empty())
+    return nullptr;
+
+  return &pages_[page][key & (PageSize - 1)];
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+SizeType const * SparseSet<Value, SizeType>::FindSparse(int key) const
+{
+  return const_cast<SparseSet *>(this)->FindSparse(key);
+}
+
+//##############################################################################
+template <typename Value, typename SizeType>
+SizeType & SparseSet<Value, SizeType>::GetSparse(int key)
+{
+  ASSERT(key >= 0);
+
+  int const page = key >> PageBits;
+
+  if (page >= pages_.Size())
+    pages_.Resize(page + 1);
+
+  if (pages_[page].Empty())
+    pages_[page] = Array<SizeType>(SizeType(-1), SizeType(PageSize));
+
+  return pages_[page][key & (PageSize - 1)];
+}
+
+#endif
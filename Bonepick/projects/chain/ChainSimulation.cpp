@@ -0,0 +1,243 @@
+#include "ChainSimulation.h"
+
+#include "utility/math/VectorMath.h"
+
+namespace
+{
+  int const   linkCalculations = 1;
+  float const linkDist         = 0.3f;
+  float const linkDistSqrd     = linkDist * linkDist;
+  float const pullStrength     = 0.9f;
+  float const dragStrength     = 0.01f;
+  float const gravity          = 0.01f;
+  bool const  attachBackEnd    = false;
+  float const maxSpeed         = 0.1f;
+}
+
+//##############################################################################
+ChainSimulation::ChainSimulation(int linkCount)
+{
+  int const mouseId =
+    manager_.AddEntity(
+      TransformationData(),
+      ControlData()
+    );
+
+  int previousLink = mouseId;
+  for (int i = 0; i < linkCount; ++i)
+  {
+    int const link =
+      manager_.AddEntity(
+        TransformationData(),
+        PhysicsData()
+      );
+
+    manager_.SetParent(link, previousLink);
+    previousLink = link;
+  }
+
+  manager_.Advance();
+
+  if (attachBackEnd)
+  {
+    manager_.AddEntity(
+      TransformationData()
+    );
+
+    manager_.Advance();
+  }
+
+  control_ =
+    &manager_.RegisterQuery<ControlData, TransformationData>();
+  motion_ =
+    &manager_.RegisterQuery<PhysicsData, TransformationData>();
+  transforms_ =
+    &manager_.RegisterQuery<TransformationData>();
+}
+
+//##############################################################################
+void ChainSimulation::SetControlPosition(Vec2 const & position)
+{
+  controlPosition_ = position;
+}
+
+//##############################################################################
+void ChainSimulation::Step(ThreadPool & pool)
+{
+  auto const & control = *control_;
+  auto const & motion = *motion_;
+
+  //Update mouse entities
+  for (int i = 0; i < control.EntityIds().Size(); ++i)
+  {
+    TransformationData controlTransform;
+    controlTransform.position = controlPosition_;
+
+    manager_.SetComponent<TransformationData>(
+      control.EntityIds()[i], controlTransform);
+  }
+  manager_.Advance();
+
+  //Apply motion
+  manager_.ParallelForEach(pool, motion,
+    [&](int i)
+    {
+      TransformationData const & transform =
+        *motion.Components<TransformationData>()[i];
+
+      PhysicsData const & physics =
+        *motion.Components<PhysicsData>()[i];
+
+      TransformationData entityTransform;
+      entityTransform.position = (transform.position +
+        (transform.position - physics.lastPos)) * (1.0f - dragStrength) +
+        transform.position * dragStrength;
+
+      if (VectorLengthSquared(entityTransform.position - transform.position) >
+        maxSpeed * maxSpeed)
+      {
+        Vec2 const dirFromRoot =
+          VectorNormalized(entityTransform.position - transform.position);
+
+        entityTransform.position =
+          transform.position + dirFromRoot * maxSpeed;
+      }
+
+      PhysicsData entityPhysics;
+      entityPhysics.lastPos = transform.position;
+
+      manager_.SetComponent<TransformationData>(motion.EntityIds()[i],
+        entityTransform);
+      manager_.SetComponent<PhysicsData>(motion.EntityIds()[i],
+        entityPhysics);
+    });
+  manager_.Advance();
+
+  //Apply gravity
+  manager_.ParallelForEach(pool, motion,
+    [&](int i)
+    {
+      TransformationData const & transform =
+        *motion.Components<TransformationData>()[i];
+
+      TransformationData entityTransform;
+      entityTransform.position = transform.position + Vec2(0.0f, -gravity);
+
+      manager_.SetComponent<TransformationData>(motion.EntityIds()[i],
+        entityTransform);
+    });
+  manager_.Advance();
+
+  //Apply chain links
+  for (int i = 0; i < linkCalculations; ++i)
+  {
+    ApplyLinks();
+    manager_.Advance();
+  }
+}
+
+//##############################################################################
+ChainManager const & ChainSimulation::GetManager(void) const
+{
+  return manager_;
+}
+
+//##############################################################################
+EntityQuery<ChainManager, TransformationData> const &
+  ChainSimulation::GetTransforms(void) const
+{
+  return *transforms_;
+}
+
+//##############################################################################
+// Walks the chain in relation order, the previous link of every link is its
+// parent row and the next one, if any, is the row right after it.
+void ChainSimulation::ApplyLinks(void)
+{
+  EntityRelations const & relations = manager_.GetRelations();
+  Array<int> const & entityIds = relations.EntityIds();
+  Array<int> const & parentRows = relations.ParentRows();
+
+  manager_.GetRelatedComponents(&linkTransforms_);
+
+  for (int j = 0; j < entityIds.Size(); ++j)
+  {
+    if (parentRows[j] < 0)
+      continue;
+
+    TransformationData const & transform = *linkTransforms_[j];
+
+    bool const hasNext =
+      j + 1 < entityIds.Size() && parentRows[j + 1] == j;
+
+    if (!hasNext && !attachBackEnd)
+    {
+      Vec2 const & linkPos = linkTransforms_[parentRows[j]]->position;
+
+      Vec2 const diffFromLink = transform.position - linkPos;
+
+      if (VectorLengthSquared(diffFromLink) > linkDistSqrd)
+      {
+        Vec2 const dirFromLink = VectorNormalized(diffFromLink);
+
+        TransformationData entityTransform;
+        entityTransform.position =
+          (linkPos + dirFromLink * linkDist) * pullStrength +
+          transform.position * (1.0f - pullStrength);
+
+        manager_.SetComponent<TransformationData>(entityIds[j],
+          entityTransform);
+      }
+    }
+    else
+    {
+      Vec2 const linkPos[2] =
+      {
+        linkTransforms_[parentRows[j]]->position,
+        hasNext ? linkTransforms_[j + 1]->position : Vec2()
+      };
+
+      Vec2 const diffFromLink[2] =
+      {
+        transform.position - linkPos[0],
+        transform.position - linkPos[1],
+      };
+
+      bool const pull[2] =
+      {
+        VectorLengthSquared(diffFromLink[0]) > linkDistSqrd,
+        VectorLengthSquared(diffFromLink[1]) > linkDistSqrd,
+      };
+
+      bool const bothPull =
+        (VectorLengthSquared(linkPos[0] - linkPos[1]) >
+          linkDistSqrd * 4.0f) || (pull[0] && pull[1]);
+
+      if (bothPull)
+      {
+        Vec2 const targetPos = (linkPos[0] + linkPos[1]) * 0.5f;
+        TransformationData entityTransform;
+        entityTransform.position =
+          targetPos * pullStrength +
+          transform.position * (1.0f - pullStrength);
+
+        manager_.SetComponent<TransformationData>(entityIds[j],
+          entityTransform);
+      }
+      else if (pull[0] || pull[1])
+      {
+        int const pulledLink = pull[0] ? 0 : 1;
+        Vec2 const dirFromLink =
+          VectorNormalized(diffFromLink[pulledLink]);
+
+        TransformationData entityTransform;
+        entityTransform.position =
+          (linkPos[pulledLink] + dirFromLink * linkDist) *
+          pullStrength + transform.position * (1.0f - pullStrength);
+
+        manager_.SetComponent<TransformationData>(entityIds[j],
+          entityTransform);
+      }
+    }
+  }
+}
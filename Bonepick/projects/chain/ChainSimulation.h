@@ -0,0 +1,73 @@
+#ifndef PROJECTS_CHAIN_CHAINSIMULATION_H
+#define PROJECTS_CHAIN_CHAINSIMULATION_H
+
+#include "system/EntityManager.h"
+#include "utility/math/Vector.h"
+#include "utility/ThreadPool.h"
+
+//##############################################################################
+struct TransformationData
+{
+  Vec2 position;
+};
+
+//##############################################################################
+struct PhysicsData
+{
+  Vec2 lastPos;
+};
+
+//##############################################################################
+struct ControlData
+{
+};
+
+//##############################################################################
+template <>
+struct ComponentStorage<ControlData>
+{
+  typedef TagStorage type;
+};
+
+//##############################################################################
+using ChainManager =
+  EntityManager<
+    TransformationData,
+    PhysicsData,
+    ControlData
+  >;
+
+//##############################################################################
+// Chain of links hanging off a controlled entity, each link is the child of
+// the one before it. Knows nothing about input or drawing, so it runs the same
+// in the Chain project and headless.
+class ChainSimulation
+{
+public:
+  ChainSimulation(int linkCount);
+  ChainSimulation(ChainSimulation const &) = delete;
+
+  void SetControlPosition(Vec2 const & position);
+  void Step(ThreadPool & pool);
+
+  ChainManager const & GetManager(void) const;
+  EntityQuery<ChainManager, TransformationData> const &
+    GetTransforms(void) const;
+
+private:
+  void ApplyLinks(void);
+
+  ChainManager manager_;
+
+  EntityQuery<ChainManager, ControlData, TransformationData> const *
+    control_;
+  EntityQuery<ChainManager, PhysicsData, TransformationData> const *
+    motion_;
+  EntityQuery<ChainManager, TransformationData> const * transforms_;
+
+  Array<TransformationData const *> linkTransforms_;
+
+  Vec2 controlPosition_;
+};
+
+#endif
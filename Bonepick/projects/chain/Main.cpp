@@ -1,48 +1,14 @@
-#include "system/EntityManager.h"
+#include "ChainSimulation.h"
+
 #include "utility/math/Vector.h"
-#include "utility/math/VectorMath.h"
+#include "utility/ThreadPool.h"
 #include "io/ascii/Graphics.h"
 #include "io/ascii/Input.h"
 
-#include <algorithm>
-
 using namespace Ascii;
 
 namespace
 {
-  struct LinkData
-  {
-    LinkData(int previous) :
-      prevLinkedId(previous),
-      nextLinkedId(0)
-    {}
-
-    int prevLinkedId;
-    int nextLinkedId;
-  };
-
-  struct TransformationData
-  {
-    Vec2 position;
-  };
-
-  struct PhysicsData
-  {
-    Vec2 lastPos;
-  };
-
-  struct ControlData
-  {
-  };
-
-  using ChainManager =
-    EntityManager<
-      LinkData,
-      TransformationData,
-      PhysicsData,
-      ControlData
-    >;
-
   Vec2 ImageToWorldPos(AsciiImage const & image, IVec2 const & pos)
   {
     return Vec2(
@@ -65,55 +31,14 @@ namespace
 //##############################################################################
 int main(void)
 {
-  int const   linkCount        = 5;
-  int const   screenWidth      = 100;
-  int const   screenHeight     = 100;
-  int const   linkCalculations = 1;
-  float const linkDist         = 0.3f;
-  float const linkDistSqrd     = linkDist * linkDist;
-  float const pullStrength     = 0.9f;
-  float const dragStrength     = 0.01f;
-  float const gravity          = 0.01f;
-  bool const  attachBackEnd    = false;
-  float const maxSpeed         = 0.1f;
+  int const linkCount    = 5;
+  int const screenWidth  = 100;
+  int const screenHeight = 100;
 
-  ChainManager manager;
+  ChainSimulation simulation(linkCount);
+  ThreadPool pool;
   bool ending = false;
 
-  int const mouseId =
-    manager.AddEntity(
-      TransformationData(),
-      ControlData()
-    );
-
-  int previousLink = 0;
-  for (int i = 0; i < linkCount; ++i)
-  {
-    int const link =
-      manager.AddEntity(
-        LinkData(previousLink ? previousLink : mouseId),
-        TransformationData(),
-        PhysicsData()
-      );
-
-    if (previousLink)
-      manager.UpdateComponent<LinkData>(previousLink).nextLinkedId = link;
-
-    previousLink = link;
-
-    //Can't yet update components that aren't gettable
-    manager.Advance();
-  }
-
-  if (attachBackEnd)
-  {
-    manager.AddEntity(
-      TransformationData()
-    );
-
-    manager.Advance();
-  }
-
   Color palette[NumberOfColors] =
   {
     Color(0, 0, 0),
@@ -122,6 +47,8 @@ int main(void)
 
   SetColorPalette(palette, NumberOfColors, 0);
 
+  auto const & transforms = simulation.GetTransforms();
+
   while (!ending)
   {
     //Input!
@@ -143,184 +70,10 @@ int main(void)
     AsciiImageData clearValue(' ', 1, 0);
     AsciiImage screen(screenWidth, screenHeight, clearValue);
 
-    Array<int> entityIds;
-
-    //Might want a way to do this without looping (at least externally)
-    for (int i = 0; i < manager.EntityCount(); ++i)
-    {
-      int const entityId = manager.GetEntityId(i);
-      entityIds.EmplaceBack(entityId);
-    }
-
-    //Update mouse entities
-    auto const mouse = manager.GetComponents<ControlData, TransformationData>();
-
-    for (int i = 0; i < mouse.EntityIds().Size(); ++i)
-    {
-      TransformationData mouseTransform;
-      mouseTransform.position = ImageToWorldPos(screen, GetMousePos());
-
-      manager.SetComponent<TransformationData>(
-        mouse.EntityIds()[i], mouseTransform);
-    }
-    manager.Advance();
-
-    //Apply motion
-    auto const motion =
-      manager.GetComponents<PhysicsData, TransformationData>();
-
-    for (int i = 0; i < motion.EntityIds().Size(); ++i)
-    {
-      TransformationData const & transform =
-        *motion.Components<TransformationData>()[i];
-
-      PhysicsData const & physics =
-        *motion.Components<PhysicsData>()[i];
-
-      TransformationData entityTransform;
-      entityTransform.position = (transform.position +
-        (transform.position - physics.lastPos)) * (1.0f - dragStrength) +
-        transform.position * dragStrength;
-
-      if (VectorLengthSquared(entityTransform.position - transform.position) >
-        maxSpeed * maxSpeed)
-      {
-        Vec2 const dirFromRoot =
-          VectorNormalized(entityTransform.position - transform.position);
-
-        entityTransform.position = transform.position + dirFromRoot * maxSpeed;
-      }
-
-      PhysicsData entityPhysics;
-      entityPhysics.lastPos = transform.position;
-
-      manager.SetComponent<TransformationData>(motion.EntityIds()[i],
-        entityTransform);
-      manager.SetComponent<PhysicsData>(motion.EntityIds()[i], entityPhysics);
-    }
-    manager.Advance();
-
-    //Apply gravity
-    for (int i = 0; i < motion.EntityIds().Size(); ++i)
-    {
-      TransformationData const & transform =
-        *motion.Components<TransformationData>()[i];
-
-      TransformationData entityTransform;
-      entityTransform.position = transform.position + Vec2(0.0f, -gravity);
-
-      manager.SetComponent<TransformationData>(motion.EntityIds()[i],
-        entityTransform);
-    }
-    manager.Advance();
-
-    //Apply chain links
-    auto const links =
-      manager.GetComponents<LinkData, TransformationData>();
-
-    for (int i = 0; i < linkCalculations; ++i)
-    {
-      for (int j = 0; j < links.EntityIds().Size(); ++j)
-      {
-        TransformationData const & transform =
-          *links.Components<TransformationData>()[j];
-
-        LinkData const & linkData = *links.Components<LinkData>()[j];
-
-        {
-          int linked[2] =
-          {
-            linkData.prevLinkedId,
-            linkData.nextLinkedId
-          };
-
-          if (!linked[0])
-            std::swap(linked[0], linked[1]);
-
-          if (!linked[0])
-            continue;
-
-          if (!linked[1] && !attachBackEnd)
-          {
-            Vec2 const & linkPos =
-              manager.GetComponent<TransformationData>(linked[0]).position;
-
-            Vec2 const diffFromLink = transform.position - linkPos;
-
-            if (VectorLengthSquared(diffFromLink) > linkDistSqrd)
-            {
-              Vec2 const dirFromLink = VectorNormalized(diffFromLink);
-
-              TransformationData entityTransform;
-              entityTransform.position =
-                (linkPos + dirFromLink * linkDist) * pullStrength +
-                transform.position * (1.0f - pullStrength);
-
-              manager.SetComponent<TransformationData>(links.EntityIds()[j],
-                entityTransform);
-            }
-          }
-          else
-          {
-            Vec2 const linkPos[2] =
-            {
-              manager.GetComponent<TransformationData>(linked[0]).position,
-              linked[1] ?
-                manager.GetComponent<TransformationData>(linked[1]).position :
-                Vec2()
-            };
-
-            Vec2 const diffFromLink[2] =
-            {
-              transform.position - linkPos[0],
-              transform.position - linkPos[1],
-            };
-
-            bool const pull[2] =
-            {
-              VectorLengthSquared(diffFromLink[0]) > linkDistSqrd,
-              VectorLengthSquared(diffFromLink[1]) > linkDistSqrd,
-            };
-
-            bool const bothPull =
-              (VectorLengthSquared(linkPos[0] - linkPos[1]) >
-                linkDistSqrd * 4.0f) || (pull[0] && pull[1]);
-
-            if (bothPull)
-            {
-              Vec2 const targetPos = (linkPos[0] + linkPos[1]) * 0.5f;
-              TransformationData entityTransform;
-              entityTransform.position =
-                targetPos * pullStrength +
-                transform.position * (1.0f - pullStrength);
-
-              manager.SetComponent<TransformationData>(links.EntityIds()[j],
-                entityTransform);
-            }
-            else if (pull[0] || pull[1])
-            {
-              int const pulledLink = pull[0] ? 0 : 1;
-              Vec2 const dirFromLink =
-                VectorNormalized(diffFromLink[pulledLink]);
-
-              TransformationData entityTransform;
-              entityTransform.position =
-                (linkPos[pulledLink] + dirFromLink * linkDist) *
-                pullStrength + transform.position * (1.0f - pullStrength);
-
-              manager.SetComponent<TransformationData>(links.EntityIds()[j],
-                entityTransform);
-            }
-          }
-        }
-      }
-      manager.Advance();
-    }
+    simulation.SetControlPosition(ImageToWorldPos(screen, GetMousePos()));
+    simulation.Step(pool);
 
     //Draw
-    auto const transforms =
-      manager.GetComponents<TransformationData>();
-
     for (int i = 0; i < transforms.EntityIds().Size(); ++i)
     {
       TransformationData const & transform =
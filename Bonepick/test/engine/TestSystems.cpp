@@ -1,8 +1,63 @@
 #include "test/engine/TestSystems.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <typeinfo>
+
+#include "engine/system/ArchetypeEntityManager.h"
 #include "engine/system/Entity.h"
 #include "engine/system/EntityManager.h"
+#include "engine/system/SystemScheduler.h"
 #include "engine/utility/Debug.h"
+#include "engine/utility/math/VectorMath.h"
+
+namespace
+{
+  //############################################################################
+  struct Particle
+  {
+    float position[3];
+    float velocity[3];
+  };
+
+  //############################################################################
+  struct Body
+  {
+    Vec2 position;
+  };
+
+  //############################################################################
+  struct Frozen
+  {};
+
+  //############################################################################
+  struct Gravity
+  {
+    float value;
+  };
+}
+
+//##############################################################################
+template <>
+struct ComponentStorage<Particle>
+{
+  typedef DoubleBufferedStorage type;
+};
+
+//##############################################################################
+template <>
+struct ComponentStorage<Frozen>
+{
+  typedef TagStorage type;
+};
+
+//##############################################################################
+template <>
+struct ComponentStorage<Gravity>
+{
+  typedef SingletonStorage type;
+};
 
 namespace
 {
@@ -159,84 +214,2108 @@ namespace
   }
 
   //############################################################################
-  void TestEntityManagerIdGetterHelper(
-    EntityManager<float, int, bool> const & entMan)
+  template <typename EntMan>
+  void TestEntityManagerFiltersHelper(void)
   {
-    Array<int> entityIds;
+    typedef ComponentFilter<TypeList<float>, TypeList<int>, TypeList<char>>
+      Filter;
 
-    for (int i = 0; i < entMan.EntityCount(); ++i)
+    EntMan entMan;
+
+    int const ent0 = entMan.AddEntity(1.0f);
+    int const ent1 = entMan.AddEntity(2.0f, 2);
+    int const ent2 = entMan.AddEntity(3.0f, 'c');
+    entMan.AddEntity(4, 'd');
+    entMan.Advance();
+
+    auto compArray = entMan.template GetMatchingComponents<Filter>();
+
+    ASSERT(compArray.EntityIds().Size() == 2);
+    ASSERT(compArray.EntityIds()[0] == ent0);
+    ASSERT(compArray.EntityIds()[1] == ent2);
+    ASSERT(*compArray.template Components<float>()[1] == 3.0f);
+    ASSERT(compArray.template Components<char>()[0] == nullptr);
+    ASSERT(*compArray.template Components<char>()[1] == 'c');
+    ASSERT(compArray.template Components<int>()[0] == nullptr);
+
+    entMan.template RemoveComponent<int>(ent1);
+    entMan.DestroyEntity(ent2);
+    entMan.Advance();
+
+    compArray = entMan.template GetMatchingComponents<Filter>();
+
+    ASSERT(compArray.EntityIds().Size() == 2);
+    ASSERT(compArray.EntityIds()[0] == ent0);
+    ASSERT(compArray.EntityIds()[1] == ent1);
+  }
+
+  //############################################################################
+  void TestEntityManagerFilters(void)
+  {
+    using EntMan = EntityManager<float, int, char>;
+    using ArchetypeEntMan = EntityManager<Archetypes<float, int, char>>;
+
+    TestEntityManagerFiltersHelper<EntMan>();
+    TestEntityManagerFiltersHelper<ArchetypeEntMan>();
+
+    EntMan entMan;
+    int const entityId = entMan.AddEntity(1.0f, 'a');
+    entMan.Advance();
+
+    ASSERT(entMan.GetSignature(entityId) ==
+      (ComponentBit<float, float, int, char>::value |
+        ComponentBit<char, float, int, char>::value));
+  }
+
+  //############################################################################
+  void TestEntityManagerBulkCreation(void)
+  {
+    using EntMan = EntityManager<float, int, bool>;
+
+    EntMan entMan;
+
+    int const ent0 = entMan.AddEntity(4.0f, 2);
+
+    int const firstId = entMan.AddEntities<float, int>(100000,
+      [](int index, float & value0, int & value1)
+      {
+        value0 = float(index);
+        value1 = index * 2;
+      });
+
+    int const ent1 = entMan.AddEntity(1.0f);
+
+    ASSERT(firstId == ent0 + 1);
+    ASSERT(ent1 == firstId + 100000);
+
+    entMan.Advance();
+
+    ASSERT(entMan.EntityCount() == 100002);
+
+    for (int i = 1; i < entMan.EntityCount(); ++i)
+      ASSERT(entMan.GetEntityId(i - 1) < entMan.GetEntityId(i));
+
+    ASSERT(entMan.GetComponent<float>(firstId + 7) == 7.0f);
+    ASSERT(entMan.GetComponent<int>(firstId + 99999) == 199998);
+
+    Array<int> const ints = { 5, 6, 7 };
+
+    int const secondId = entMan.AddEntities(ints);
+
+    EXPECT_ERROR(entMan.AddEntities(ints, Array<float>({ 1.0f, 2.0f })););
+
+    entMan.Advance();
+
+    ASSERT(entMan.GetComponent<int>(secondId + 2) == 7);
+    ASSERT(!entMan.ContainsComponent<float>(secondId));
+
+    //Spawning and destroying in bulk keeps reusing the same slots
+    EntMan churn;
+
+    int const waveSize = 10000;
+    Array<int> const values(1, waveSize);
+
+    for (int wave = 0; wave < 100; ++wave)
     {
-      ASSERT(!entityIds.Contains(entMan.GetEntityId(i)));
-      entityIds.EmplaceBack(entMan.GetEntityId(i));
+      int const first = wave % 2 ? churn.AddEntities(values) :
+        churn.AddEntities<int>(waveSize,
+          [wave](int, int & value)
+          {
+            value = wave;
+          });
+
+      churn.Advance();
+
+      ASSERT(GetEntityIndex(first + waveSize - 1) <= waveSize);
+      ASSERT(churn.EntityCount() == waveSize);
+
+      churn.DestroyEntities(first, waveSize);
+      churn.Advance();
     }
 
-    ASSERT(entityIds.Size() == entMan.EntityCount());
+    ASSERT(churn.EntityCount() == 0);
   }
 
   //############################################################################
-  void TestEntityManagerIdGetter(void)
+  void TestEntityManagerBatchedDestruction(void)
   {
-    EntityManager<float, int, bool> entMan;
+    using EntMan = EntityManager<float, int, Particle>;
 
-    int const ent0 = entMan.AddEntity(4.0f, 2);
-    int const ent1 = entMan.AddEntity(false, 2.0f);
-    int const ent2 = entMan.AddEntity(7, 3.0f, true);
+    EntMan entMan;
+
+    int const firstId = entMan.AddEntities<float, int>(10000,
+      [](int index, float & value0, int & value1)
+      {
+        value0 = float(index);
+        value1 = index;
+      });
+
+    int const particleId = entMan.AddEntity(Particle());
 
     entMan.Advance();
-    TestEntityManagerIdGetterHelper(entMan);
 
-    entMan.DestroyEntity(ent1);
+    entMan.DestroyEntities(firstId, 5000);
+    entMan.DestroyEntity(firstId + 10);
+    entMan.DestroyEntities(Array<int>({ firstId + 9000, particleId }));
+
+    ASSERT(entMan.EntityCount() == 10001);
 
     entMan.Advance();
-    TestEntityManagerIdGetterHelper(entMan);
 
-    int const ent3 = entMan.AddEntity(2.5f, false, 4);
+    ASSERT(entMan.EntityCount() == 4999);
+    ASSERT(!entMan.DoesEntityExist(firstId + 4999));
+    ASSERT(!entMan.DoesEntityExist(particleId));
+
+    for (int i = 1; i < entMan.EntityCount(); ++i)
+      ASSERT(entMan.GetEntityId(i - 1) < entMan.GetEntityId(i));
+
+    auto compArray = entMan.GetComponents<float, int>();
+
+    ASSERT(compArray.EntityIds().Size() == 4999);
+    ASSERT(compArray.EntityIds()[0] == firstId + 5000);
+    ASSERT(*compArray.Components<int>()[0] == 5000);
+
+    int const ent0 = entMan.AddEntity(1.0f, 2);
+    entMan.Advance();
+
+    ASSERT(entMan.GetComponent<int>(ent0) == 2);
+    ASSERT(entMan.GetComponent<int>(firstId + 8999) == 8999);
+  }
+
+  //############################################################################
+  void TestEntityManagerGenerations(void)
+  {
+    EntityManager<float, int> entMan;
+
+    int const ent0 = entMan.AddEntity(1.0f, 1);
+    int const ent1 = entMan.AddEntity(2.0f);
 
     entMan.Advance();
-    TestEntityManagerIdGetterHelper(entMan);
 
-    entMan.DestroyEntity(ent2);
-    entMan.DestroyEntity(ent3);
     entMan.DestroyEntity(ent0);
+    entMan.Advance();
+
+    int const ent2 = entMan.AddEntity(3.0f, 3);
+
+    ASSERT(GetEntityIndex(ent2) == GetEntityIndex(ent0));
+    ASSERT(GetEntityGeneration(ent2) == GetEntityGeneration(ent0) + 1);
+    ASSERT(!entMan.DoesEntityExist(ent2));
 
     entMan.Advance();
-    TestEntityManagerIdGetterHelper(entMan);
+
+    ASSERT(entMan.DoesEntityExist(ent2));
+    ASSERT(!entMan.DoesEntityExist(ent0));
+    ASSERT(entMan.EntityCount() == 2);
+    ASSERT(entMan.GetComponent<int>(ent2) == 3);
+    ASSERT(entMan.GetComponent<float>(ent1) == 2.0f);
+
+    EXPECT_ERROR(entMan.GetComponent<int>(ent0););
+    EXPECT_ERROR(entMan.SetComponent(ent0, 4););
+    EXPECT_ERROR(entMan.DestroyEntity(ent0););
+
+    auto compArray = entMan.GetComponents<float, int>();
+
+    ASSERT(compArray.EntityIds().Size() == 1);
+    ASSERT(compArray.EntityIds()[0] == ent2);
   }
 
   //############################################################################
-  void TestEntityCreation(void)
+  void TestEntitySlotReuse(void)
+  {
+    EntitySlotTable slots;
+
+    //Waves of creations and releases over more ids than there are slots
+    int const waveSize = 10000;
+    int const waveCount = (EntityIndexMask + 1) / waveSize + 10;
+    Array<int> entityIds;
+
+    for (int wave = 0; wave < waveCount; ++wave)
+    {
+      entityIds.Clear();
+
+      if (wave % 2)
+      {
+        for (int i = 0; i < waveSize; ++i)
+          entityIds.EmplaceBack(slots.Create());
+      }
+      else
+      {
+        int const firstEntityId = slots.CreateRange(waveSize);
+
+        for (int i = 0; i < waveSize; ++i)
+          entityIds.EmplaceBack(firstEntityId + i);
+      }
+
+      for (int entityId : entityIds)
+        slots.Activate(entityId);
+
+      slots.Release(entityIds.Begin(), entityIds.Size());
+    }
+
+    ASSERT(slots.SlotCount() == waveSize + 1);
+    ASSERT(slots.FreeSlotCount() == waveSize);
+
+    //Ranges reuse a run of free slots and extend it at the end of the table
+    int const first = slots.CreateRange(waveSize + 5);
+
+    ASSERT(GetEntityIndex(first) == 1);
+    ASSERT(slots.SlotCount() == waveSize + 6);
+    ASSERT(slots.FreeSlotCount() == 0);
+
+    //Generations wrap, one slot serves any number of entities. A stale id
+    //only matches again once its slot went through every generation.
+    EntitySlotTable small;
+
+    int const firstSlotId = small.Create();
+    int slotId = firstSlotId;
+    small.Activate(slotId);
+
+    for (int i = 1; i <= 4 * (EntityGenerationMask + 1); ++i)
+    {
+      small.Release(&slotId, 1);
+      ASSERT(!small.IsAlive(slotId));
+
+      slotId = small.Create();
+      small.Activate(slotId);
+
+      ASSERT(GetEntityIndex(slotId) == GetEntityIndex(firstSlotId));
+      ASSERT(GetEntityGeneration(slotId) == (i & EntityGenerationMask));
+      ASSERT(small.IsAlive(firstSlotId) ==
+        (i % (EntityGenerationMask + 1) == 0));
+    }
+
+    ASSERT(small.SlotCount() == 2);
+    ASSERT(small.FreeSlotCount() == 0);
+
+    EntityManager<int> entMan;
+
+    int const firstId = entMan.AddEntity(0);
+    int entityId = firstId;
+    entMan.Advance();
+
+    for (int i = 0; i < 2 * (EntityGenerationMask + 1) + 1; ++i)
+    {
+      entMan.DestroyEntity(entityId);
+      entMan.Advance();
+
+      entityId = entMan.AddEntity(i);
+      entMan.Advance();
+
+      ASSERT(GetEntityIndex(entityId) == GetEntityIndex(firstId));
+      ASSERT(entMan.GetComponent<int>(entityId) == i);
+    }
+
+    ASSERT(entMan.EntityCount() == 1);
+
+    //Joins stay in id order when reused slots put newer ids in front
+    EntityManager<float, int> joined;
+    int const firstJoinedId = joined.AddEntities<float, int>(100,
+      [](int index, float & value0, int & value1)
+      {
+        value0 = float(index);
+        value1 = index;
+      });
+
+    joined.Advance();
+    joined.DestroyEntities(firstJoinedId, 10);
+    joined.Advance();
+
+    for (int i = 0; i < 10; ++i)
+      joined.AddEntity(1.0f, -i);
+
+    joined.Advance();
+
+    auto const compArray = joined.GetComponents<float, int>();
+    SortedArray<int> const & joinedIds = compArray.EntityIds();
+
+    ASSERT(joinedIds.Size() == 100);
+    ASSERT(std::is_sorted(joinedIds.Begin(), joinedIds.End()));
+    ASSERT(GetEntityIndex(joinedIds[joinedIds.Size() - 1]) < 100);
+
+    for (int i = 0; i < joinedIds.Size(); ++i)
+    {
+      ASSERT(compArray.Components<int>()[i] ==
+        &joined.GetComponent<int>(joinedIds[i]));
+    }
+  }
+
+  //############################################################################
+  void TestEntityManagerCompaction(void)
   {
     EntityManager<float, int> entMan;
 
-    int const entIndex = entMan.AddEntity(2.0f);
+    auto const & query = entMan.RegisterQuery<int>();
 
-    Entity<float, int> ent(entMan, entIndex);
-    auto easyEnt = MakeEntity(entMan, entIndex);
+    int const firstId = entMan.AddEntities<int>(1000,
+      [](int index, int & value)
+      {
+        value = index;
+      });
 
-    ASSERT(easyEnt == ent);
-    ASSERT(!(easyEnt != ent));
+    entMan.Advance();
 
-    EXPECT_ERROR(ent.GetComponent<float>(););
+    for (int i = 0; i < 1000; i += 2)
+      entMan.DestroyEntity(firstId + i);
 
     entMan.Advance();
 
-    ASSERT(ent.GetComponent<float>() == 2.0f);
-    EXPECT_ERROR(ent.GetComponent<int>(););
+    CompactionStats const & stats = entMan.GetCompactionStats<int>();
+
+    ASSERT(stats.movedComponents > 0);
+    ASSERT(stats.sortedComponents == 500);
+    ASSERT(stats.emptySlots == 0);
+
+    auto compArray = entMan.GetComponents<int>();
+    Array<int const *> const & ints = compArray.Components<int>();
+
+    for (int i = 0; i < ints.Size(); ++i)
+    {
+      ASSERT(*ints[i] == i * 2 + 1);
+      ASSERT(i == 0 || ints[i - 1] < ints[i]);
+    }
+
+    entMan.SetCompactionBudget(16);
+
+    for (int i = 1; i < 500; i += 2)
+      entMan.DestroyEntity(firstId + i);
+
+    entMan.Advance();
+
+    int const ent0 = entMan.AddEntity(-1);
+
+    entMan.Advance();
+
+    ASSERT(stats.sortedComponents < 751);
+    ASSERT(stats.emptySlots > 0);
+
+    //Compaction reports what it moved, the storage itself stays put
+    int const storageVersion = entMan.GetStorageVersion<int>();
+
+    while (stats.emptySlots > 0)
+    {
+      entMan.Advance();
+
+      ASSERT(entMan.GetMovedEntityIds<int>().Size() > 0);
+    }
+
+    ASSERT(entMan.GetStorageVersion<int>() == storageVersion);
+    ASSERT(stats.sortedComponents == 251);
+    ASSERT(entMan.GetComponent<int>(ent0) == -1);
+    ASSERT(entMan.GetComponent<int>(firstId + 999) == 999);
+
+    ASSERT(query.Size() == 251);
+
+    for (int i = 0; i < query.Size(); ++i)
+    {
+      ASSERT(query.Components<int>()[i] ==
+        &entMan.GetComponent<int>(query.EntityIds()[i]));
+    }
   }
 
   //############################################################################
-  void TestEntityManagers(void)
+  void TestEntityManagerChangeDetection(void)
   {
-    TestEntityManagerSingleComponent();
-    TestEntityManagerMultipleComponents();
-    TestEntityManagerDestruction();
-    TestEntityManagerGroupGetters();
+    EntityManager<float, Particle> entMan;
+
+    int const ent0 = entMan.AddEntity(1.0f, Particle());
+    int const ent1 = entMan.AddEntity(2.0f);
+    int const ent2 = entMan.AddEntity(3.0f, Particle());
+
+    entMan.Advance();
+
+    int const frame = entMan.GetFrame();
+
+    ComponentChanges changes = entMan.GetChangedComponents<float>();
+
+    ASSERT(changes.added.Size() == 3);
+    ASSERT(changes.changed.Empty());
+    ASSERT(changes.removed.Empty());
+
+    entMan.SetComponent(ent1, 4.0f);
+    entMan.SetComponent(ent2, 5.0f);
+    entMan.UpdateComponent<Particle>(ent0).position[0] = 1.0f;
+    entMan.DestroyEntity(ent2);
+    entMan.Advance();
+
+    changes = entMan.GetChangedComponents<float>();
+
+    ASSERT(changes.added.Empty());
+    ASSERT(changes.changed.Size() == 1);
+    ASSERT(changes.changed[0] == ent1);
+    ASSERT(changes.removed.Size() == 1);
+    ASSERT(changes.removed[0] == ent2);
+
+    changes = entMan.GetChangedComponents<Particle>();
+
+    ASSERT(changes.changed.Size() == 1);
+    ASSERT(changes.changed[0] == ent0);
+
+    entMan.Advance();
+
+    ASSERT(entMan.GetChangedComponents<float>().removed.Empty());
+
+    changes = entMan.GetChangedComponents<float>(frame - 1);
+
+    ASSERT(changes.added.Size() == 2);
+    ASSERT(changes.changed.Size() == 1);
+    ASSERT(changes.removed.Size() == 1);
+
+    for (int i = 0; i < ChangeHistoryFrames; ++i)
+      entMan.Advance();
+
+    EXPECT_ERROR(entMan.GetChangedComponents<float>(frame););
   }
 
   //############################################################################
-  void TestEntities(void)
+  void TestEntityManagerSnapshots(void)
   {
-    TestEntityCreation();
+    using EntMan = EntityManager<float, int, Particle>;
+
+    char const * const path = "TestEntityManagerSnapshots.bin";
+
+    EntMan saved;
+
+    int const first  = saved.AddEntity(1.0f, 10);
+    int const second = saved.AddEntity(2.0f);
+    int const third  = saved.AddEntity(Particle{ { 3.0f }, { 4.0f } }, 30);
+
+    saved.Advance();
+    saved.DestroyEntity(second);
+    saved.Advance();
+
+    int const reused = saved.AddEntity(5.0f, 50);
+    saved.Advance();
+
+    ASSERT(GetEntityIndex(reused) == GetEntityIndex(second));
+    ASSERT(saved.SaveSnapshot(path));
+
+    EntMan loaded;
+    auto const & query = loaded.RegisterQuery<float, int>();
+
+    ASSERT(!loaded.LoadSnapshot("MissingSnapshot.bin"));
+    ASSERT(loaded.LoadSnapshot(path));
+
+    EntityManager<float, int> otherLayout;
+    ASSERT(!otherLayout.LoadSnapshot(path));
+
+    std::remove(path);
+
+    ASSERT(loaded.EntityCount() == 3);
+    ASSERT(loaded.GetFrame() == saved.GetFrame());
+    ASSERT(loaded.DoesEntityExist(first));
+    ASSERT(!loaded.DoesEntityExist(second));
+    ASSERT(loaded.DoesEntityExist(reused));
+
+    ASSERT(loaded.GetComponent<float>(first) == 1.0f);
+    ASSERT(loaded.GetComponent<int>(first) == 10);
+    ASSERT(!loaded.ContainsComponent<float>(third));
+    ASSERT(loaded.GetComponent<Particle>(third).velocity[0] == 4.0f);
+    ASSERT(loaded.GetComponent<float>(reused) == 5.0f);
+
+    ASSERT(query.Size() == 2);
+    ASSERT(query.EntityIds()[0] == first);
+    ASSERT(query.EntityIds()[1] == reused);
+
+    //Loaded managers keep working like the one they were saved from
+    loaded.SetComponent(first, 6.0f);
+    loaded.DestroyEntity(third);
+    int const added = loaded.AddEntity(7.0f);
+    loaded.Advance();
+
+    ASSERT(loaded.GetComponent<float>(first) == 6.0f);
+    ASSERT(!loaded.DoesEntityExist(third));
+    ASSERT(loaded.GetComponent<float>(added) == 7.0f);
+    ASSERT(added != reused);
+
+    //Every section of an empty manager is empty
+    EntMan empty;
+    ASSERT(empty.SaveSnapshot(path));
+    ASSERT(loaded.LoadSnapshot(path));
+    std::remove(path);
+
+    ASSERT(loaded.EntityCount() == 0);
+    ASSERT(query.Size() == 0);
+  }
+
+  //############################################################################
+  void TestEntityManagerRollback(void)
+  {
+    using EntMan = EntityManager<float, int, Particle>;
+
+    EntMan entMan;
+    entMan.SetHistoryFrames(4);
+
+    auto const & query = entMan.RegisterQuery<float, int>();
+
+    int const first = entMan.AddEntity(1.0f, 1);
+    int const doomed = entMan.AddEntity(Particle{ { 2.0f }, { 0.0f } });
+    entMan.Advance();
+
+    entMan.SetComponent(first, 1.5f);
+    entMan.UpdateComponent<Particle>(doomed).position[0] = 3.0f;
+    int const second = entMan.AddEntity(2.0f);
+    entMan.Advance();
+
+    entMan.DestroyEntity(doomed);
+    entMan.AddComponent(second, 20);
+    entMan.RemoveComponent<int>(first);
+    entMan.Advance();
+
+    ASSERT(entMan.RewindableFrames() == 3);
+    ASSERT(query.Size() == 1);
+
+    entMan.Rewind(2);
+
+    ASSERT(entMan.GetFrame() == 1);
+    ASSERT(entMan.ReplayableFrames() == 2);
+    ASSERT(entMan.EntityCount() == 2);
+    ASSERT(!entMan.DoesEntityExist(second));
+    ASSERT(entMan.DoesEntityExist(doomed));
+    ASSERT(entMan.GetComponent<float>(first) == 1.0f);
+    ASSERT(entMan.GetComponent<int>(first) == 1);
+    ASSERT(entMan.GetComponent<Particle>(doomed).position[0] == 2.0f);
+    ASSERT(query.Size() == 1 && query.EntityIds()[0] == first);
+
+    entMan.Replay(2);
+
+    ASSERT(entMan.GetFrame() == 3);
+    ASSERT(!entMan.DoesEntityExist(doomed));
+    ASSERT(!entMan.ContainsComponent<int>(first));
+    ASSERT(entMan.GetComponent<float>(first) == 1.5f);
+    ASSERT(entMan.GetComponent<int>(second) == 20);
+    ASSERT(query.Size() == 1 && query.EntityIds()[0] == second);
+
+    //Resimulating from a rewound frame hands out the same ids and drops the
+    //frames that were rewound
+    entMan.Rewind(2);
+    ASSERT(entMan.AddEntity(4.0f) == second);
+    entMan.Advance();
+
+    ASSERT(entMan.ReplayableFrames() == 0);
+    ASSERT(entMan.GetComponent<float>(second) == 4.0f);
+    ASSERT(entMan.GetComponent<Particle>(doomed).position[0] == 2.0f);
+
+    //Only the last four frames are kept
+    for (int i = 0; i < 6; ++i)
+      entMan.Advance();
+
+    ASSERT(entMan.RewindableFrames() == 4);
+  }
+
+  //############################################################################
+  void TestEntityManagerRelations(void)
+  {
+    EntityManager<float> entMan;
+    entMan.SetHistoryFrames(2);
+
+    int const root = entMan.AddEntity(0.0f);
+    int const a = entMan.AddEntity(1.0f);
+    int const b = entMan.AddEntity(2.0f);
+    int const c = entMan.AddEntity(3.0f);
+    int const d = entMan.AddEntity(4.0f);
+
+    //Chain root -> a -> b, with c and d as further children of root
+    entMan.SetParent(a, root);
+    entMan.SetParent(b, a);
+    entMan.SetParent(c, root);
+    entMan.SetParent(d, root);
+    entMan.Advance();
+
+    EntityRelations const & relations = entMan.GetRelations();
+
+    ASSERT(relations.GetParent(b) == a);
+    ASSERT(relations.GetFirstChild(root) == a);
+    ASSERT(relations.GetLastChild(root) == d);
+    ASSERT(relations.GetNextSibling(a) == c);
+    ASSERT(relations.GetPrevSibling(d) == c);
+    ASSERT(relations.IsAncestor(root, b));
+    ASSERT(relations.EntityIds() == Array<int>({ root, a, b, c, d }));
+    ASSERT(relations.ParentRows() == Array<int>({ -1, 0, 1, 0, 0 }));
+
+    Array<float const *> values;
+    entMan.GetRelatedComponents(&values);
+
+    ASSERT(values.Size() == 5);
+    ASSERT(*values[2] == 2.0f && *values[values.Size() - 1] == 4.0f);
+
+    //Destroying a link joins its children to its parent in its place
+    entMan.DestroyEntity(a);
+    entMan.SetParent(d, 0);
+    entMan.Advance();
+
+    ASSERT(!relations.Contains(a));
+    ASSERT(relations.GetParent(b) == root);
+    ASSERT(relations.GetNextSibling(b) == c);
+    ASSERT(relations.GetNextSibling(c) == 0);
+    ASSERT(relations.EntityIds() == Array<int>({ root, b, c, d }));
+    ASSERT(relations.ParentRows() == Array<int>({ -1, 0, 0, -1 }));
+
+    //Children of a destroyed root become roots
+    entMan.DestroyEntity(root);
+    entMan.Advance();
+
+    ASSERT(relations.GetParent(b) == 0 && relations.GetParent(c) == 0);
+    ASSERT(relations.GetNextSibling(b) == 0);
+
+    //Rewinding restores the relations with the entities
+    entMan.Rewind(2);
+
+    ASSERT(relations.GetParent(a) == root);
+    ASSERT(relations.EntityIds() == Array<int>({ root, a, b, c, d }));
+
+    ASSERT(relations.GetNextSibling(a) == c);
+    ASSERT(relations.GetLastChild(root) == d);
+    ASSERT(relations.ParentRows() == Array<int>({ -1, 0, 1, 0, 0 }));
+
+    entMan.Replay(1);
+
+    ASSERT(relations.GetParent(b) == root);
+    ASSERT(relations.GetPrevSibling(c) == b);
+    ASSERT(relations.EntityIds() == Array<int>({ root, b, c, d }));
+    ASSERT(relations.ParentRows() == Array<int>({ -1, 0, 0, -1 }));
+
+    entMan.Replay(1);
+
+    ASSERT(!relations.Contains(root));
+    ASSERT(relations.GetParent(b) == 0 && relations.GetNextSibling(b) == 0);
+    ASSERT(relations.EntityIds() == Array<int>({ b, c, d }));
+  }
+
+#if PROFILING_ENABLED
+  //############################################################################
+  void TestEntityManagerProfiling(void)
+  {
+    EntityManager<float, int> entMan;
+
+    int const first = entMan.AddEntity(1.0f, 1);
+    entMan.AddEntity(2.0f);
+    entMan.Advance();
+
+    entMan.GetComponents<float, int>();
+    entMan.SetComponent(first, 3.0f);
+    entMan.DestroyEntity(first);
+    entMan.Advance();
+
+    Array<ComponentFrameProfile> const floats = entMan.GetProfile<float>();
+
+    ASSERT(floats.Size() == 2);
+    ASSERT(floats[0].frame == 1);
+    ASSERT(floats[0].adds == 2);
+    ASSERT(floats[0].components == 2);
+    ASSERT(floats[0].joins == 1);
+    ASSERT(floats[0].joinedComponents == 2);
+    ASSERT(floats[1].writes == 1);
+    ASSERT(floats[1].destroys == 1);
+    ASSERT(floats[1].components == 1);
+    ASSERT(entMan.GetProfile<int>()[0].joinedComponents == 1);
+
+    char const * const path = "TestEntityManagerProfiling.csv";
+    ASSERT(entMan.SaveProfile(path));
+    std::remove(path);
+
+    entMan.ClearProfile();
+    ASSERT(entMan.GetProfile<float>().Empty());
+
+    //Joins from several threads all count, and only the last frames are kept
+    ThreadPool pool(3);
+
+    for (int i = 0; i < 100; ++i)
+    {
+      pool.Submit(
+        [&entMan](void)
+        {
+          entMan.GetComponents<float>();
+        });
+    }
+
+    pool.Wait();
+
+    ASSERT(entMan.GetProfile<float>().Size() == 1);
+    ASSERT(entMan.GetProfile<float>()[0].joins == 100);
+
+    for (int i = 0; i < ProfileFrames + 10; ++i)
+      entMan.Advance();
+
+    Array<ComponentFrameProfile> const frames = entMan.GetProfile<float>();
+
+    ASSERT(frames.Size() == ProfileFrames);
+    ASSERT(frames[0].frame + ProfileFrames - 1 == frames.GetBack().frame);
+    ASSERT(frames.GetBack().frame == entMan.GetFrame());
+  }
+#endif
+
+  //############################################################################
+  void TestEntityManagerPendingWrites(void)
+  {
+    EntityManager<float, int> entMan;
+
+    Array<int> entityIds;
+
+    for (int i = 0; i < 5000; ++i)
+      entityIds.EmplaceBack(entMan.AddEntity(i));
+
+    entMan.Advance();
+
+    for (int i = entityIds.Size() - 1; i >= 0; --i)
+      entMan.SetComponent(entityIds[i], i);
+
+    EXPECT_ERROR(entMan.SetComponent(entityIds[0], 0););
+
+    for (int entityId : entityIds)
+      entMan.UpdateComponent<int>(entityId) *= 2;
+
+    ASSERT(entMan.GetComponent<int>(entityIds[1]) == 1);
+
+    entMan.Advance();
+
+    for (int i = 0; i < entityIds.Size(); ++i)
+      ASSERT(entMan.GetComponent<int>(entityIds[i]) == i * 2);
+
+    entMan.SetComponent(entityIds[2], 7);
+    entMan.Advance();
+
+    ASSERT(entMan.GetComponent<int>(entityIds[2]) == 7);
+    ASSERT(entMan.GetComponent<int>(entityIds[3]) == 6);
+  }
+
+  //############################################################################
+  void TestEntityManagerDoubleBuffered(void)
+  {
+    using EntMan = EntityManager<Particle, int>;
+
+    EntMan entMan;
+    ThreadPool pool(3);
+
+    for (int i = 0; i < 1000; ++i)
+      entMan.AddEntity(Particle{ { float(i), 0.0f, 0.0f }, { 1.0f } }, i);
+
+    entMan.Advance();
+
+    auto const & query = entMan.RegisterQuery<Particle, int>();
+    int const firstId = query.EntityIds()[0];
+
+    entMan.UpdateComponent<Particle>(firstId).position[0] = -1.0f;
+    EXPECT_ERROR(entMan.SetComponent(firstId, Particle()););
+
+    ASSERT(entMan.GetComponent<Particle>(firstId).position[0] == 0.0f);
+
+    entMan.Advance();
+
+    ASSERT(entMan.GetComponent<Particle>(firstId).position[0] == -1.0f);
+    ASSERT(entMan.GetComponent<Particle>(firstId + 1).position[0] == 1.0f);
+
+    entMan.ParallelForEach(pool, query,
+      [&entMan, &query](int row)
+      {
+        Particle particle = *query.Components<Particle>()[row];
+        particle.position[0] += particle.velocity[0];
+
+        entMan.SetComponent(query.EntityIds()[row], particle);
+      });
+
+    //Committing every component moves the writes over, not the buffers
+    int const storageVersion = entMan.GetStorageVersion<Particle>();
+    Particle const * const firstParticle = query.Components<Particle>()[0];
+
+    entMan.Advance();
+
+    ASSERT(entMan.GetStorageVersion<Particle>() == storageVersion);
+    ASSERT(query.Components<Particle>()[0] == firstParticle);
+
+    entMan.DestroyEntity(firstId);
+    entMan.Advance();
+
+    ASSERT(query.Size() == 999);
+
+    for (int i = 0; i < query.Size(); ++i)
+    {
+      int const entityId = query.EntityIds()[i];
+      Particle const & particle = *query.Components<Particle>()[i];
+
+      ASSERT(&entMan.GetComponent<Particle>(entityId) == &particle);
+      ASSERT(entMan.GetEntityId(&particle) == entityId);
+      ASSERT(particle.position[0] == float(entityId - firstId) + 1.0f);
+    }
+  }
+
+  //############################################################################
+  void TestEntityManagerCachedQueries(void)
+  {
+    using EntMan = EntityManager<float, int, bool>;
+
+    EntMan entMan;
+
+    int const ent0 = entMan.AddEntity(4.0f, 2);
+    int const ent1 = entMan.AddEntity(false, 2.0f);
+
+    entMan.Advance();
+
+    auto const & query = entMan.RegisterQuery<float, int>();
+
+    ASSERT(query.Size() == 1);
+    ASSERT(query.Contains(ent0));
+    ASSERT(*query.Components<int>()[0] == 2);
+
+    int const ent2 = entMan.AddEntity(7, 3.0f, true);
+    entMan.AddComponent(ent1, 5);
+    entMan.SetComponent(ent0, 6);
+
+    ASSERT(query.Size() == 1);
+
+    entMan.Advance();
+
+    ASSERT(query.Size() == 3);
+    ASSERT(query.Contains(ent1) && query.Contains(ent2));
+
+    entMan.RemoveComponent<int>(ent0);
+    entMan.DestroyEntity(ent2);
+    entMan.Advance();
+
+    ASSERT(query.Size() == 1);
+    ASSERT(query.EntityIds()[0] == ent1);
+    ASSERT(*query.Components<int>()[0] == 5);
+    ASSERT(*query.Components<float>()[0] == 2.0f);
+
+    for (int i = 0; i < 1000; ++i)
+      entMan.AddEntity(float(i), i);
+
+    entMan.Advance();
+
+    ASSERT(query.Size() == 1001);
+
+    for (int i = 0; i < query.Size(); ++i)
+    {
+      int const entityId = query.EntityIds()[i];
+
+      ASSERT(&entMan.GetComponent<int>(entityId) == query.Components<int>()[i]);
+      ASSERT(
+        &entMan.GetComponent<float>(entityId) == query.Components<float>()[i]);
+    }
+
+    entMan.UnregisterQuery(query);
+  }
+
+  //############################################################################
+  void TestEntityManagerIdGetterHelper(
+    EntityManager<float, int, bool> const & entMan)
+  {
+    Array<int> entityIds;
+
+    for (int i = 0; i < entMan.EntityCount(); ++i)
+    {
+      ASSERT(!entityIds.Contains(entMan.GetEntityId(i)));
+      entityIds.EmplaceBack(entMan.GetEntityId(i));
+    }
+
+    ASSERT(entityIds.Size() == entMan.EntityCount());
+  }
+
+  //############################################################################
+  void TestEntityManagerIdGetter(void)
+  {
+    EntityManager<float, int, bool> entMan;
+
+    int const ent0 = entMan.AddEntity(4.0f, 2);
+    int const ent1 = entMan.AddEntity(false, 2.0f);
+    int const ent2 = entMan.AddEntity(7, 3.0f, true);
+
+    entMan.Advance();
+    TestEntityManagerIdGetterHelper(entMan);
+
+    entMan.DestroyEntity(ent1);
+
+    entMan.Advance();
+    TestEntityManagerIdGetterHelper(entMan);
+
+    int const ent3 = entMan.AddEntity(2.5f, false, 4);
+
+    entMan.Advance();
+    TestEntityManagerIdGetterHelper(entMan);
+
+    entMan.DestroyEntity(ent2);
+    entMan.DestroyEntity(ent3);
+    entMan.DestroyEntity(ent0);
+
+    entMan.Advance();
+    TestEntityManagerIdGetterHelper(entMan);
+  }
+
+  //############################################################################
+  void TestSystemSchedulerDependencies(void)
+  {
+    using Scheduler = SystemScheduler<float, int, bool>;
+
+    Scheduler scheduler;
+
+    auto const nop = [](Scheduler::Manager &) {};
+
+    scheduler.AddSystem<TypeSet<float>, TypeSet<int>>(nop);
+    scheduler.AddSystem<TypeSet<int>, TypeSet<float>>(nop);
+    scheduler.AddSystem<TypeSet<>, TypeSet<int, bool>>(nop);
+    scheduler.AddSystem<TypeSet<float, int, bool>, TypeSet<>>(nop);
+
+    ASSERT(scheduler.SystemCount() == 4);
+    ASSERT(scheduler.GetDependencies(0).Empty());
+    ASSERT(scheduler.GetDependencies(1).Empty());
+    ASSERT(scheduler.GetDependencies(2) == Array<int>({ 0 }));
+    ASSERT(scheduler.GetDependencies(3).Empty());
+  }
+
+  //############################################################################
+  void TestSystemSchedulerRun(void)
+  {
+    using Scheduler = SystemScheduler<float, int, bool>;
+
+    Scheduler::Manager entMan;
+    Scheduler scheduler;
+    ThreadPool pool(3);
+
+    for (int i = 0; i < 100; ++i)
+      entMan.AddEntity(float(i), i);
+
+    entMan.Advance();
+
+    auto const & query = entMan.RegisterQuery<float, int>();
+
+    scheduler.AddSystem<TypeSet<float>, TypeSet<int>>(
+      [&query](Scheduler::Manager & manager)
+      {
+        for (int i = 0; i < query.Size(); ++i)
+        {
+          manager.SetComponent(query.EntityIds()[i],
+            int(*query.Components<float>()[i]) * 2);
+        }
+      });
+
+    scheduler.AddSystem<TypeSet<int>, TypeSet<float>>(
+      [&query](Scheduler::Manager & manager)
+      {
+        for (int i = 0; i < query.Size(); ++i)
+        {
+          manager.SetComponent(query.EntityIds()[i],
+            float(*query.Components<int>()[i]) + 0.5f);
+        }
+      });
+
+    scheduler.AddSystem<TypeSet<int>, TypeSet<int>>(
+      [&query](Scheduler::Manager & manager)
+      {
+        for (int i = 0; i < query.Size(); ++i)
+          manager.UpdateComponent<int>(query.EntityIds()[i]) += 1;
+      });
+
+    scheduler.Run(entMan, pool);
+    entMan.Advance();
+
+    for (int i = 0; i < query.Size(); ++i)
+    {
+      int const entityId = query.EntityIds()[i];
+      int const index = entityId - query.EntityIds()[0];
+
+      ASSERT(entMan.GetComponent<int>(entityId) == index * 2 + 1);
+      ASSERT(entMan.GetComponent<float>(entityId) == float(index) + 0.5f);
+    }
+  }
+
+  //############################################################################
+  // Systems run as jobs of the pool and share the manager's buffers, so they
+  // can't use any pool through the manager. The error comes out of Run().
+  void TestSystemSchedulerNestedPool(void)
+  {
+    using Scheduler = SystemScheduler<float, int, bool>;
+
+    Scheduler::Manager entMan;
+    ThreadPool pool(3);
+
+    for (int i = 0; i < 100; ++i)
+      entMan.AddEntity(float(i), i);
+
+    entMan.Advance();
+
+    auto const & query = entMan.RegisterQuery<float, int>();
+
+    {
+      Scheduler scheduler;
+
+      scheduler.AddSystem<TypeSet<float>, TypeSet<int>>(
+        [&pool, &query](Scheduler::Manager & manager)
+        {
+          manager.ParallelForEach(pool, query,
+            [&manager, &query](int row)
+            {
+              manager.SetComponent(query.EntityIds()[row], row);
+            });
+        });
+
+      EXPECT_ERROR(scheduler.Run(entMan, pool););
+    }
+
+    {
+      Scheduler scheduler;
+
+      scheduler.AddSystem<TypeSet<float>, TypeSet<int>>(
+        [&pool](Scheduler::Manager & manager)
+        {
+          manager.Advance(pool);
+        });
+
+      EXPECT_ERROR(scheduler.Run(entMan, pool););
+    }
+
+    //Another pool doesn't help, the systems share the manager's buffers
+    {
+      Scheduler scheduler;
+      ThreadPool otherPool(1);
+
+      scheduler.AddSystem<TypeSet<float>, TypeSet<int>>(
+        [&otherPool, &query](Scheduler::Manager & manager)
+        {
+          manager.ParallelForEach(otherPool, query,
+            [&manager, &query](int row)
+            {
+              manager.SetComponent(query.EntityIds()[row], row);
+            });
+        });
+
+      EXPECT_ERROR(scheduler.Run(entMan, pool););
+    }
+
+    //The pool is still usable afterwards
+    entMan.ParallelForEach(pool, query,
+      [&entMan, &query](int row)
+      {
+        entMan.SetComponent(query.EntityIds()[row], -row);
+      });
+
+    entMan.Advance(pool);
+
+    for (int i = 0; i < query.Size(); ++i)
+      ASSERT(*query.Components<int>()[i] == -i);
+  }
+
+  //############################################################################
+  void TestEntityManagerParallelForEach(void)
+  {
+    using EntMan = EntityManager<float, int, bool>;
+
+    EntMan entMan;
+    ThreadPool pool(3);
+
+    for (int i = 0; i < 10000; ++i)
+      entMan.AddEntity(float(i), i);
+
+    entMan.Advance();
+
+    auto const & query = entMan.RegisterQuery<float, int>();
+    int const firstId = query.EntityIds()[0];
+
+    entMan.SetComponent(firstId, 1.5f);
+
+    entMan.ParallelForEach(pool, query,
+      [&entMan, &query](int row)
+      {
+        int const entityId = query.EntityIds()[row];
+        int const value = *query.Components<int>()[row];
+
+        entMan.SetComponent(entityId, float(value) * 2.0f);
+        entMan.UpdateComponent<int>(entityId) = value + 1;
+      });
+
+    ASSERT(entMan.GetComponent<float>(firstId) == 0.0f);
+
+    entMan.Advance();
+
+    for (int i = 0; i < query.Size(); ++i)
+    {
+      int const entityId = query.EntityIds()[i];
+      int const index = entityId - firstId;
+
+      ASSERT(entMan.GetComponent<int>(entityId) == index + 1);
+      ASSERT(entMan.GetComponent<float>(entityId) == float(index) * 2.0f);
+    }
+
+    //A throwing job still puts its thread back on the serial buffer
+    ThreadPool inlinePool(0);
+    bool threw = false;
+
+    try
+    {
+      entMan.ParallelForEach(inlinePool, query,
+        [](int)
+        {
+          throw 0;
+        });
+    }
+    catch (int)
+    {
+      threw = true;
+    }
+
+    ASSERT(threw);
+    ASSERT(!IsWritingFromJob());
+
+    entMan.SetComponent(firstId, 3.0f);
+    entMan.Advance();
+
+    ASSERT(entMan.GetComponent<float>(firstId) == 3.0f);
+  }
+
+  //############################################################################
+  void TestEntityManagerParallelCommands(void)
+  {
+    using EntMan = EntityManager<float, int, bool>;
+
+    EntMan entMan;
+    ThreadPool pool(3);
+
+    for (int i = 0; i < 10000; ++i)
+      entMan.AddEntity(float(i), i);
+
+    entMan.Advance();
+
+    auto const & query = entMan.RegisterQuery<int>();
+    auto const & spawned = entMan.RegisterQuery<bool>();
+
+    //Odd values are destroyed, every fourth spawns an entity and every third
+    //loses its int
+    entMan.ParallelForEach(pool, query,
+      [&entMan, &query](int row)
+      {
+        int const entityId = query.EntityIds()[row];
+        int const value = *query.Components<int>()[row];
+
+        if (value % 2)
+          entMan.DestroyEntity(entityId);
+        else if (value % 3 == 0)
+          entMan.RemoveComponent<int>(entityId);
+
+        if (value % 4 == 0)
+          entMan.AddEntity(float(-value), true);
+      });
+
+    //Serial changes after the jobs get ids of their own
+    int const serialId = entMan.AddEntity(true);
+    entMan.Advance();
+
+    ASSERT(entMan.EntityCount() == 10000 - 5000 + 2500 + 1);
+    ASSERT(query.Size() == 5000 - 1667);
+    ASSERT(spawned.Size() == 2501);
+    ASSERT(entMan.DoesEntityExist(serialId));
+
+    for (int i = 0; i < spawned.Size(); ++i)
+    {
+      int const entityId = spawned.EntityIds()[i];
+
+      if (entityId != serialId)
+        ASSERT(int(-entMan.GetComponent<float>(entityId)) % 4 == 0);
+    }
+
+    //Ids of entities created in jobs only depend on the job order, and they
+    //reuse freed slots. The placeholder ids work within the job.
+    auto const spawnChildren =
+      [&pool](EntMan & manager)
+      {
+        auto const & parents = manager.RegisterQuery<int>();
+
+        manager.ParallelForEach(pool, parents,
+          [&manager, &parents](int row)
+          {
+            int const parentId = parents.EntityIds()[row];
+            int const childId = manager.AddEntity(true);
+
+            manager.SetParent(childId, parentId);
+          });
+
+        manager.Advance();
+      };
+
+    Array<Array<int>> runs;
+
+    for (int run = 0; run < 2; ++run)
+    {
+      EntMan manager;
+
+      manager.AddEntities<int>(2000,
+        [](int index, int & value)
+        {
+          value = index;
+        });
+
+      manager.AddEntities<float>(1000,
+        [](int index, float & value)
+        {
+          value = float(index);
+        });
+
+      manager.Advance();
+      manager.DestroyEntities(manager.GetEntityId(2000), 1000);
+      manager.Advance();
+
+      spawnChildren(manager);
+
+      auto const & children = manager.RegisterQuery<bool>();
+      Array<int> childIds = children.EntityIds();
+      std::sort(childIds.Begin(), childIds.End());
+
+      ASSERT(childIds.Size() == 2000);
+      ASSERT(GetEntityIndex(childIds.GetBack()) <= 3000);
+
+      //Which child got which id has to match as well
+      Array<int> parentIds;
+
+      for (int childId : childIds)
+      {
+        parentIds.EmplaceBack(manager.GetRelations().GetParent(childId));
+        ASSERT(parentIds.GetBack() != 0);
+      }
+
+      runs.EmplaceBack(std::move(childIds));
+      runs.EmplaceBack(std::move(parentIds));
+    }
+
+    ASSERT(runs[0] == runs[2]);
+    ASSERT(runs[1] == runs[3]);
+
+    //An entity destroyed by the job that created it is never created
+    int const entityCount = entMan.EntityCount();
+
+    entMan.ParallelForEach(pool, spawned,
+      [&entMan](int row)
+      {
+        int const entityId = entMan.AddEntity(float(row), 1);
+
+        if (row % 2)
+          entMan.DestroyEntity(entityId);
+      });
+
+    entMan.Advance();
+
+    int const keptCount = (spawned.Size() + 1) / 2;
+
+    ASSERT(entMan.EntityCount() == entityCount + keptCount);
+    ASSERT(query.Size() == 5000 - 1667 + keptCount);
+
+    //Job buffers belong to the manager running the job
+    EntMan other;
+    int const otherId = other.AddEntity(0);
+    other.Advance();
+
+    ThreadPool inlinePool(0);
+
+    entMan.ParallelForEach(inlinePool, query,
+      [&other, otherId](int row)
+      {
+        if (row == 0)
+          EXPECT_ERROR(other.SetComponent(otherId, 1););
+      });
+  }
+
+  //############################################################################
+  // Commits the same frames serially and on a pool, both must end up equal.
+  void TestEntityManagerParallelAdvance(void)
+  {
+    using EntMan = EntityManager<float, int, Particle>;
+
+    EntMan serial;
+    EntMan parallel;
+    ThreadPool pool(3);
+
+    serial.SetHistoryFrames(2);
+    parallel.SetHistoryFrames(2);
+
+    auto const & serialQuery = serial.RegisterQuery<float, Particle>();
+    auto const & parallelQuery = parallel.RegisterQuery<float, Particle>();
+
+    for (int frame = 0; frame < 20; ++frame)
+    {
+      for (EntMan * entMan : { &serial, &parallel })
+      {
+        for (int i = 0; i < 50; ++i)
+          entMan->AddEntity(float(frame * 50 + i), Particle());
+
+        for (int i = frame; i < entMan->EntityCount(); i += 7)
+        {
+          int const entityId = entMan->GetEntityId(i);
+
+          if (i % 3 == 0)
+            entMan->DestroyEntity(entityId);
+          else if (i % 3 == 1)
+            entMan->SetComponent(entityId, float(-i));
+          else if (!entMan->ContainsComponent<int>(entityId))
+            entMan->AddComponent(entityId, i);
+        }
+      }
+
+      serial.Advance();
+      parallel.Advance(pool);
+
+      ASSERT(serial.EntityCount() == parallel.EntityCount());
+      ASSERT(serialQuery.EntityIds() == parallelQuery.EntityIds());
+
+      for (int i = 0; i < serial.EntityCount(); ++i)
+      {
+        int const entityId = serial.GetEntityId(i);
+
+        ASSERT(parallel.GetEntityId(i) == entityId);
+        ASSERT(serial.GetSignature(entityId) ==
+          parallel.GetSignature(entityId));
+        ASSERT(serial.GetComponent<float>(entityId) ==
+          parallel.GetComponent<float>(entityId));
+      }
+
+      ASSERT(serial.GetChangedComponents<int>().added ==
+        parallel.GetChangedComponents<int>().added);
+    }
+
+    serial.Rewind(2);
+    parallel.Rewind(2);
+
+    ASSERT(serialQuery.EntityIds() == parallelQuery.EntityIds());
+  }
+
+  //############################################################################
+  void TestEntityManagerTagsAndSingletons(void)
+  {
+    using EntMan = EntityManager<float, Frozen, Gravity>;
+
+    EntMan entMan;
+    entMan.SetHistoryFrames(2);
+
+    int const ent0 = entMan.AddEntity(1.0f, Frozen());
+    int const ent1 = entMan.AddEntity(2.0f);
+    int const ent2 = entMan.AddEntity(Frozen());
+
+    entMan.SetSingleton(Gravity{ -9.8f });
+    ASSERT(!entMan.HasSingleton<Gravity>());
+
+    entMan.Advance();
+
+    auto const & frozen = entMan.RegisterQuery<float, Frozen>();
+
+    ASSERT(entMan.GetSingleton<Gravity>().value == -9.8f);
+    ASSERT(entMan.ContainsComponent<Frozen>(ent0));
+    ASSERT(!entMan.ContainsComponent<Frozen>(ent1));
+    ASSERT(entMan.ContainsComponent<Frozen>(ent2));
+    ASSERT(!entMan.ContainsComponent<Gravity>(ent0));
+    ASSERT(frozen.EntityIds() == Array<int>({ ent0 }));
+
+    typedef ComponentFilter<TypeList<Frozen>, TypeList<float>> Filter;
+    auto const frozenFalling = entMan.GetMatchingComponents<Filter>();
+    ASSERT(frozenFalling.EntityIds().Size() == 1);
+    ASSERT(frozenFalling.EntityIds()[0] == ent2);
+
+    entMan.SetSingleton(Gravity{ 2.0f });
+    EXPECT_ERROR(entMan.SetSingleton(Gravity{ 1.0f }););
+    EXPECT_ERROR(entMan.AddComponent(ent1, Gravity{ 1.0f }););
+
+    entMan.AddComponent(ent1, Frozen());
+    entMan.RemoveComponent<Frozen>(ent0);
+    entMan.DestroyEntity(ent2);
+    entMan.Advance();
+
+    ASSERT(entMan.GetSingleton<Gravity>().value == 2.0f);
+    ASSERT(!entMan.ContainsComponent<Frozen>(ent0));
+    ASSERT(entMan.ContainsComponent<Frozen>(ent1));
+    ASSERT(frozen.EntityIds() == Array<int>({ ent1 }));
+    ASSERT(entMan.GetChangedComponents<Frozen>().added ==
+      Array<int>({ ent1 }));
+
+    //Reused slots must not inherit the tag
+    int const ent3 = entMan.AddEntity(3.0f);
+    entMan.Advance();
+
+    ASSERT(GetEntityIndex(ent3) == GetEntityIndex(ent2));
+    ASSERT(!entMan.ContainsComponent<Frozen>(ent3));
+
+    entMan.Rewind(2);
+
+    ASSERT(entMan.GetSingleton<Gravity>().value == -9.8f);
+    ASSERT(entMan.ContainsComponent<Frozen>(ent0));
+    ASSERT(entMan.ContainsComponent<Frozen>(ent2));
+    ASSERT(frozen.EntityIds() == Array<int>({ ent0 }));
+
+    entMan.Replay(1);
+
+    ASSERT(entMan.GetSingleton<Gravity>().value == 2.0f);
+    ASSERT(frozen.EntityIds() == Array<int>({ ent1 }));
+
+    char const * const path = "TestEntityManagerTagsAndSingletons.bin";
+    ASSERT(entMan.SaveSnapshot(path));
+
+    EntMan loaded;
+    ASSERT(loaded.LoadSnapshot(path));
+    ASSERT(loaded.ContainsComponent<Frozen>(ent1));
+    ASSERT(!loaded.ContainsComponent<Frozen>(ent0));
+    ASSERT(loaded.GetSingleton<Gravity>().value == 2.0f);
+
+    std::remove(path);
+  }
+
+  //############################################################################
+  void TestEntityManagerQueryViews(void)
+  {
+    EntityManager<int, float, Particle, Frozen> entMan;
+
+    for (int i = 0; i < 100; ++i)
+    {
+      int const entityId = entMan.AddEntity(i);
+
+      if (i % 2 == 0)
+        entMan.AddComponent(entityId, float(i));
+      if (i % 3 == 0)
+        entMan.AddComponent(entityId, Particle{ { float(i) }, {} });
+      if (i % 5 == 0)
+        entMan.AddComponent(entityId, Frozen());
+    }
+
+    entMan.Advance();
+
+    //Same entities as the gathered join, in id order
+    auto const compArray = entMan.GetComponents<float, int>();
+    Array<int> entityIds;
+
+    for (auto [value, index] : entMan.Query<float, int>())
+    {
+      ASSERT(value == float(index));
+      entityIds.EmplaceBack(entMan.GetEntityId(&index));
+    }
+
+    Array<int> const expectedIds(compArray.EntityIds().Begin(),
+      compArray.EntityIds().Size());
+
+    ASSERT(entityIds.Size() == 50);
+    ASSERT(entityIds == expectedIds);
+
+    //Either order walks the type with fewer components, the floats
+    Array<int> swappedIds;
+
+    for (auto [index, value] : entMan.Query<int, float>())
+      swappedIds.EmplaceBack(entMan.GetEntityId(&index));
+
+    ASSERT(swappedIds == expectedIds);
+
+    int visited = 0;
+
+    for (auto [frozen, particle, index] :
+      entMan.Query<Frozen, Particle, int>())
+    {
+      ASSERT(index % 15 == 0);
+      ASSERT(particle.position[0] == float(index));
+      ++visited;
+    }
+
+    ASSERT(visited == 7);
+
+    //Writes show up after the next Advance()
+    for (auto [index, value] : entMan.Query<int, float>())
+      entMan.SetComponent(entMan.GetEntityId(&index), value + 1.0f);
+
+    for (auto [index, value] : entMan.Query<int, float>())
+      ASSERT(value == float(index));
+
+    entMan.Advance();
+
+    for (auto [index, value] : entMan.Query<int, float>())
+      ASSERT(value == float(index + 1));
+
+    EntityManager<int, float> empty;
+    ASSERT(!(empty.Query<int, float>().begin() !=
+      empty.Query<int, float>().end()));
+  }
+
+  //############################################################################
+  void TestEntityManagerPrefabs(void)
+  {
+    EntityManager<int, float, Particle, Frozen> entMan;
+    entMan.SetHistoryFrames(1);
+
+    //Freed slots are reused before the rest of the range is appended
+    int const first = entMan.AddEntities<int>(10,
+      [](int index, int & value)
+      {
+        value = index;
+      });
+
+    entMan.Advance();
+    entMan.DestroyEntities(first, 5);
+    entMan.Advance();
+
+    Prefab<int, float, Particle, Frozen> prefab(
+      7, 2.0f, Particle{ { 1.0f, 2.0f, 3.0f }, {} }, Frozen());
+    prefab.SetComponent(8);
+
+    int const count = 1000;
+    int const spawned = entMan.Instantiate(prefab, count);
+
+    ASSERT(!entMan.DoesEntityExist(spawned));
+
+    entMan.Advance();
+
+    ASSERT(entMan.EntityCount() == count + 5);
+
+    for (int i = 0; i < count; ++i)
+    {
+      int const entityId = spawned + i;
+
+      ASSERT(entMan.GetComponent<int>(entityId) == 8);
+      ASSERT(entMan.GetComponent<float>(entityId) == 2.0f);
+      ASSERT(entMan.GetComponent<Particle>(entityId).position[2] == 3.0f);
+      ASSERT(entMan.ContainsComponent<Frozen>(entityId));
+    }
+
+    ASSERT(entMan.GetChangedComponents<float>().added.Size() == count);
+
+    int visited = 0;
+
+    for (auto [value, frozen] : entMan.Query<int, Frozen>())
+    {
+      ASSERT(value == 8);
+      ++visited;
+    }
+
+    ASSERT(visited == count);
+
+    entMan.Rewind(1);
+
+    ASSERT(entMan.EntityCount() == 5);
+    ASSERT(!entMan.DoesEntityExist(spawned));
+    ASSERT(entMan.GetComponent<int>(first + 9) == 9);
+
+    entMan.Replay(1);
+
+    ASSERT(entMan.GetComponent<int>(spawned + count - 1) == 8);
+    ASSERT(entMan.Instantiate(prefab, 0) == 0);
+
+    //A steady spawn and despawn loop keeps reusing the same slots
+    EntityManager<int, float, Particle, Frozen> churn;
+
+    for (int wave = 0; wave < 200; ++wave)
+    {
+      prefab.SetComponent(wave);
+
+      int const first = churn.Instantiate(prefab, count);
+      churn.Advance();
+
+      ASSERT(GetEntityIndex(first + count - 1) <= count);
+      ASSERT(churn.GetComponent<int>(first + count - 1) == wave);
+
+      churn.DestroyEntities(first, count);
+      churn.Advance();
+    }
+
+    ASSERT(churn.EntityCount() == 0);
+
+    //Jobs record one command per prefab, a destroyed placeholder splits it
+    EntityManager<int, float, Particle, Frozen> spawner;
+    ThreadPool pool(3);
+
+    for (int i = 0; i < 64; ++i)
+      spawner.AddEntity(i);
+
+    spawner.Advance();
+
+    auto const & query = spawner.RegisterQuery<int>();
+    prefab.SetComponent(-1);
+
+    spawner.ParallelForEach(pool, query,
+      [&spawner, &prefab](int row)
+      {
+        if (row % 16 != 0)
+          return;
+
+        int const first = spawner.Instantiate(prefab, 10);
+
+        if (row == 0)
+          spawner.DestroyEntity(first + 3);
+      });
+
+    spawner.Advance();
+
+    visited = 0;
+
+    for (auto [frozen, value] : spawner.Query<Frozen, int>())
+    {
+      ASSERT(value == -1);
+      ++visited;
+    }
+
+    ASSERT(visited == 39);
+    ASSERT(spawner.EntityCount() == 64 + 39);
+  }
+
+  //############################################################################
+  void TestEntityManagerRuntimeComponents(void)
+  {
+    using EntMan = EntityManager<int>;
+
+    char const * const path = "TestEntityManagerRuntimeComponents.bin";
+
+    struct Health
+    {
+      float current;
+      int   armor;
+    };
+
+    DataLayout layout;
+    layout.Add("current", typeid(float), offsetof(Health, current),
+      sizeof(float));
+    layout.Add("armor", typeid(int), offsetof(Health, armor), sizeof(int));
+
+    EntMan entMan;
+    RuntimeComponentManager & health =
+      entMan.RegisterRuntimeComponent("Health", layout, sizeof(Health));
+
+    ASSERT(entMan.FindRuntimeComponent("Health") == &health);
+    ASSERT(!entMan.FindRuntimeComponent("Mana"));
+    EXPECT_ERROR(entMan.RegisterRuntimeComponent("Health", layout, 8););
+
+    //Every field has to end inside of the component
+    DataLayout overlapping;
+    overlapping.Add("armor", typeid(int), 2, sizeof(int));
+    EXPECT_ERROR(entMan.RegisterRuntimeComponent("Armor", overlapping, 4););
+
+    Array<int> entityIds;
+
+    for (int i = 0; i < 4; ++i)
+    {
+      entityIds.EmplaceBack(entMan.AddEntity(i));
+
+      Health const value = { float(i), i * 10 };
+      health.AddComponent(entityIds.GetBack(), &value);
+    }
+
+    int const unarmored = entMan.AddEntity(4);
+    health.AddComponent(unarmored);
+
+    ASSERT(!health.ContainsComponent(unarmored));
+
+    entMan.Advance();
+
+    ASSERT(health.ComponentCount() == 5);
+    ASSERT(health.GetField<float>(entityIds[2], "current") == 2.0f);
+    ASSERT(health.GetField<int>(unarmored, "armor") == 0);
+    EXPECT_ERROR(health.GetField<int>(unarmored, "current"););
+
+    //Field writes of a frame add up and only show after Advance()
+    health.SetField(entityIds[1], "current", 5.0f);
+    health.SetField(entityIds[1], "armor", 7);
+    health.SetField(entityIds[0], "armor", 9);
+
+    ASSERT(health.GetField<float>(entityIds[1], "current") == 1.0f);
+
+    //The write to the destroyed entity is not logged as a change
+    entMan.DestroyEntity(entityIds[0]);
+    entMan.Advance();
+
+    ASSERT(health.ComponentCount() == 4);
+    ASSERT(!health.ContainsComponent(entityIds[0]));
+
+    ComponentChanges changes;
+    health.GetChangeLog().GetChanges(&changes, entMan.GetFrame() - 1);
+
+    ASSERT(changes.changed.Size() == 1);
+    ASSERT(changes.removed.Size() == 1);
+
+    Blob const copy = health.CopyComponent(entityIds[1]);
+    ASSERT(static_cast<Health const *>(copy.Data())->armor == 7);
+    ASSERT(health.GetField<float>(entityIds[1], "current") == 5.0f);
+    ASSERT(health.GetField<int>(entityIds[3], "armor") == 30);
+
+    for (int i = 0; i < health.ComponentCount(); ++i)
+    {
+      int const entityId = health.GetEntityIdAt(i);
+      ASSERT(health.GetComponentAt(i) == health.FindComponent(entityId));
+    }
+
+    //Jobs write disjoint entities into their own write buffers
+    ThreadPool pool(3);
+    auto const & query = entMan.RegisterQuery<int>();
+
+    entMan.ParallelForEach(pool, query,
+      [&health, &query](int row)
+      {
+        int const entityId = query.EntityIds()[row];
+
+        if (health.ContainsComponent(entityId))
+          health.SetField(entityId, "armor", *query.Components<int>()[row]);
+      });
+
+    entMan.Advance(pool);
+
+    ASSERT(health.GetField<int>(entityIds[3], "armor") == 3);
+    ASSERT(health.GetField<float>(entityIds[3], "current") == 3.0f);
+    ASSERT(entMan.SaveSnapshot(path));
+
+    EntMan loaded;
+    ASSERT(!loaded.LoadSnapshot(path));
+
+    RuntimeComponentManager & loadedHealth =
+      loaded.RegisterRuntimeComponent("Health", layout, sizeof(Health));
+
+    ASSERT(loaded.LoadSnapshot(path));
+    ASSERT(loadedHealth.ComponentCount() == 4);
+    ASSERT(loadedHealth.GetField<int>(entityIds[1], "armor") == 1);
+    ASSERT(loadedHealth.GetField<float>(entityIds[3], "current") == 3.0f);
+
+    std::remove(path);
+  }
+
+  //############################################################################
+  void TestEntityManagerSpatialIndex(void)
+  {
+    EntityManager<Body, int> entMan;
+    entMan.SetHistoryFrames(4);
+
+    auto const & index = entMan.RegisterSpatialIndex<Body>(1.0f, 8);
+    SpatialHash const & hash = index.GetHash();
+
+    //A 20 by 20 lattice, wider than the buckets so cells wrap onto each other
+    Array<int> entityIds;
+
+    for (int i = 0; i < 400; ++i)
+    {
+      entityIds.EmplaceBack(entMan.AddEntity(
+        Body{ Vec2(float(i % 20) * 0.75f, float(i / 20) * 0.75f) }, i));
+    }
+
+    entMan.AddEntity(7);
+    entMan.Advance();
+
+    ASSERT(hash.Size() == 400);
+
+    Array<int> found;
+    hash.QueryRadius(Vec2(3.0f, 3.0f), 0.8f, &found);
+    std::sort(found.Begin(), found.End());
+    ASSERT(found == Array<int>({ entityIds[64], entityIds[83],
+      entityIds[84], entityIds[85], entityIds[104] }));
+
+    hash.QueryBox(Vec2(-1.0f, -1.0f), Vec2(0.8f, 0.1f), &found);
+    std::sort(found.Begin(), found.End());
+    ASSERT(found == Array<int>({ entityIds[0], entityIds[1] }));
+
+    hash.QueryNearest(Vec2(14.3f, 14.3f), 3, &found);
+    ASSERT(found == Array<int>({ entityIds[399], entityIds[379],
+      entityIds[398] }));
+
+    Array<SpatialHash::Pair> pairs;
+    hash.QueryPairs(0.75f, &pairs);
+    ASSERT(pairs.Size() == 2 * 20 * 19);
+
+    for (SpatialHash::Pair const & pair : pairs)
+    {
+      ASSERT(pair.entityId0 < pair.entityId1);
+      ASSERT(VectorLength(hash.GetPosition(pair.entityId0) -
+        hash.GetPosition(pair.entityId1)) <= 0.75f);
+    }
+
+    //Moves within a cell, across cells, removals and destruction
+    entMan.SetComponent(entityIds[0], Body{ Vec2(0.1f, 0.1f) });
+    entMan.SetComponent(entityIds[1], Body{ Vec2(100.0f, 100.0f) });
+    entMan.RemoveComponent<Body>(entityIds[2]);
+    entMan.DestroyEntity(entityIds[3]);
+    entMan.Advance();
+
+    ASSERT(hash.Size() == 398);
+    ASSERT(!hash.Contains(entityIds[2]));
+    ASSERT(!hash.Contains(entityIds[3]));
+    ASSERT(hash.GetPosition(entityIds[0]) == Vec2(0.1f, 0.1f));
+
+    hash.QueryRadius(Vec2(100.0f, 100.0f), 0.5f, &found);
+    ASSERT(found == Array<int>({ entityIds[1] }));
+
+    hash.QueryNearest(Vec2(0.0f, 0.0f), 1, &found);
+    ASSERT(found == Array<int>({ entityIds[0] }));
+
+    //Rewinding and replaying restore the positions of those frames
+    entMan.Rewind(1);
+
+    ASSERT(hash.Size() == 400);
+    ASSERT(hash.GetPosition(entityIds[1]) == Vec2(0.75f, 0.0f));
+
+    entMan.Replay(1);
+
+    ASSERT(hash.Size() == 398);
+    ASSERT(hash.GetPosition(entityIds[1]) == Vec2(100.0f, 100.0f));
+
+    entMan.UnregisterQuery(index);
+  }
+
+  //############################################################################
+  // Copies get their own queries, reading the copy's components.
+  void TestEntityManagerCopies(void)
+  {
+    using EntMan = EntityManager<Body, int>;
+
+    DataLayout layout;
+    layout.Add("armor", typeid(int), 0, sizeof(int));
+
+    EntMan original;
+    original.RegisterRuntimeComponent("Armor", layout, sizeof(int));
+
+    auto const & query = original.RegisterQuery<Body, int>();
+    auto const & index = original.RegisterSpatialIndex<Body>(1.0f, 8);
+
+    Array<int> entityIds;
+
+    for (int i = 0; i < 100; ++i)
+    {
+      entityIds.EmplaceBack(
+        original.AddEntity(Body{ Vec2(float(i), 0.0f) }, i));
+      original.FindRuntimeComponent("Armor")->AddComponent(entityIds[i], &i);
+    }
+
+    original.Advance();
+
+    EntMan copy(original);
+
+    auto const & copiedQuery = copy.GetCopiedQuery(original, query);
+    auto const & copiedIndex = copy.GetCopiedQuery(original, index);
+
+    ASSERT(&copiedQuery != &query);
+    ASSERT(copiedQuery.Size() == 100);
+    ASSERT(copiedIndex.GetHash().Size() == 100);
+
+    for (int i = 0; i < copiedQuery.Size(); ++i)
+    {
+      int const entityId = copiedQuery.EntityIds()[i];
+
+      ASSERT(copiedQuery.Components<int>()[i] ==
+        &copy.GetComponent<int>(entityId));
+    }
+
+    //Changes to the copy don't reach the original
+    copy.DestroyEntities(entityIds[0], 50);
+    copy.SetComponent(entityIds[50], Body{ Vec2(-5.0f, 0.0f) });
+    copy.FindRuntimeComponent("Armor")->SetField(entityIds[51], "armor", 7);
+    copy.Advance();
+
+    ASSERT(copiedQuery.Size() == 50);
+    ASSERT(copiedIndex.GetHash().GetPosition(entityIds[50]) ==
+      Vec2(-5.0f, 0.0f));
+    ASSERT(copy.FindRuntimeComponent("Armor")->GetField<int>(entityIds[51],
+      "armor") == 7);
+
+    ASSERT(query.Size() == 100);
+    ASSERT(index.GetHash().GetPosition(entityIds[50]) == Vec2(50.0f, 0.0f));
+    ASSERT(original.FindRuntimeComponent("Armor")->GetField<int>(
+      entityIds[51], "armor") == 51);
+
+    //Assigning replaces the target's queries with copies of the source's
+    EntMan assigned;
+    assigned.RegisterQuery<int>();
+    assigned = copy;
+
+    auto const & assignedQuery = assigned.GetCopiedQuery(copy, copiedQuery);
+
+    ASSERT(assignedQuery.Size() == 50);
+    ASSERT(assigned.EntityCount() == 50);
+
+    for (int i = 0; i < assignedQuery.Size(); ++i)
+    {
+      int const entityId = assignedQuery.EntityIds()[i];
+
+      ASSERT(assignedQuery.Components<Body>()[i] ==
+        &assigned.GetComponent<Body>(entityId));
+    }
+  }
+
+  //############################################################################
+  void TestEntityCreation(void)
+  {
+    EntityManager<float, int> entMan;
+
+    int const entIndex = entMan.AddEntity(2.0f);
+
+    Entity<float, int> ent(entMan, entIndex);
+    auto easyEnt = MakeEntity(entMan, entIndex);
+
+    ASSERT(easyEnt == ent);
+    ASSERT(!(easyEnt != ent));
+
+    EXPECT_ERROR(ent.GetComponent<float>(););
+
+    entMan.Advance();
+
+    ASSERT(ent.GetComponent<float>() == 2.0f);
+    EXPECT_ERROR(ent.GetComponent<int>(););
+
+    entMan.DestroyEntity(entIndex);
+    entMan.Advance();
+
+    ASSERT(!ent.IsValid());
+    EXPECT_ERROR(ent.GetComponent<float>(););
+  }
+
+  //############################################################################
+  void TestArchetypeEntityManagerMultipleComponents(void)
+  {
+    EntityManager<Archetypes<float, int, bool>> entMan;
+
+    int const ent0 = entMan.AddEntity(4.0f, 2);
+    int const ent1 = entMan.AddEntity(false, 2.0f);
+    int const ent2 = entMan.AddEntity(7, 3.0f, true);
+
+    ASSERT(entMan.EntityCount() == 0);
+
+    entMan.Advance();
+
+    ASSERT(entMan.EntityCount() == 3);
+    ASSERT(entMan.ArchetypeCount() == 3);
+    ASSERT(entMan.ContainsComponent<int>(ent0));
+    ASSERT(!entMan.ContainsComponent<int>(ent1));
+    ASSERT(!entMan.ContainsComponent<bool>(ent0));
+    ASSERT(entMan.GetComponent<float>(ent0) == 4.0f);
+    ASSERT(entMan.GetComponent<int>(ent2) == 7);
+    ASSERT(entMan.GetComponent<bool>(ent2) == true);
+
+    entMan.UpdateComponent<float>(ent1) = 3.5f;
+    entMan.SetComponent<int>(ent2, 8);
+    EXPECT_ERROR(entMan.SetComponent<int>(ent2, 9););
+    ASSERT(entMan.GetComponent<float>(ent1) == 2.0f);
+
+    entMan.Advance();
+
+    ASSERT(entMan.GetComponent<float>(ent1) == 3.5f);
+    ASSERT(entMan.GetComponent<int>(ent2) == 8);
+
+    entMan.AddComponent(ent1, 4);
+    entMan.RemoveComponent<bool>(ent1);
+
+    entMan.Advance();
+
+    ASSERT(entMan.GetComponent<int>(ent1) == 4);
+    ASSERT(entMan.GetComponent<float>(ent1) == 3.5f);
+    ASSERT(!entMan.ContainsComponent<bool>(ent1));
+    ASSERT(entMan.ArchetypeCount() == 3);
+
+    entMan.DestroyEntity(ent0);
+    entMan.Advance();
+
+    ASSERT(entMan.EntityCount() == 2);
+    ASSERT(!entMan.DoesEntityExist(ent0));
+    ASSERT(entMan.GetComponent<float>(ent1) == 3.5f);
+    ASSERT(entMan.GetComponent<float>(ent2) == 3.0f);
+  }
+
+  //############################################################################
+  void TestArchetypeEntityManagerChunks(void)
+  {
+    EntityManager<Archetypes<float, int>> entMan;
+
+    int const count = 5000;
+
+    for (int i = 0; i < count; ++i)
+    {
+      if (i % 2)
+        entMan.AddEntity(float(i), i);
+      else
+        entMan.AddEntity(float(i));
+    }
+
+    entMan.Advance();
+
+    for (int i = 0; i < count; i += 3)
+      entMan.DestroyEntity(entMan.GetEntityId(i));
+
+    entMan.Advance();
+
+    int visited = 0;
+
+    entMan.ForEach<float, int>(
+      [&](int entityId, float const & floatComp, int const & intComp)
+      {
+        ASSERT(float(intComp) == floatComp);
+        ASSERT(entMan.GetComponent<int>(entityId) == intComp);
+        ++visited;
+      });
+
+    auto compArray = entMan.GetComponents<int, float>();
+
+    SortedArray<int> const &     entityIds  = compArray.EntityIds();
+    Array<int const *> const &   compInts   = compArray.Components<int>();
+    Array<float const *> const & compFloats = compArray.Components<float>();
+
+    ASSERT(entityIds.Size() == visited);
+    ASSERT(compInts.Size() == visited);
+    ASSERT(compFloats.Size() == visited);
+
+    for (int i = 0; i < entityIds.Size(); ++i)
+    {
+      ASSERT(entMan.GetEntityId(compInts[i]) == entityIds[i]);
+      ASSERT(entMan.GetEntityId(compFloats[i]) == entityIds[i]);
+      ASSERT(float(*compInts[i]) == *compFloats[i]);
+    }
+
+    //Every entity written in one frame, updates find the pending write
+    Array<int> values;
+
+    for (int i = 0; i < entityIds.Size(); ++i)
+    {
+      values.EmplaceBack(*compInts[i]);
+      entMan.SetComponent(entityIds[i], -values[i]);
+      entMan.UpdateComponent<float>(entityIds[i]) = 1.0f;
+      entMan.UpdateComponent<float>(entityIds[i]) += 1.0f;
+    }
+
+    EXPECT_ERROR(entMan.SetComponent(entityIds[0], 0););
+
+    entMan.Advance();
+
+    for (int i = 0; i < entityIds.Size(); ++i)
+    {
+      ASSERT(entMan.GetComponent<int>(entityIds[i]) == -values[i]);
+      ASSERT(entMan.GetComponent<float>(entityIds[i]) == 2.0f);
+    }
+  }
+
+  //############################################################################
+  void TestEntityManagers(void)
+  {
+    TestEntityManagerSingleComponent();
+    TestEntityManagerMultipleComponents();
+    TestEntityManagerDestruction();
+    TestEntityManagerGroupGetters();
+    TestEntityManagerFilters();
+    TestEntityManagerBulkCreation();
+    TestEntityManagerBatchedDestruction();
+    TestEntityManagerGenerations();
+    TestEntitySlotReuse();
+    TestEntityManagerCompaction();
+    TestEntityManagerChangeDetection();
+    TestEntityManagerSnapshots();
+    TestEntityManagerRollback();
+    TestEntityManagerRelations();
+    TestEntityManagerTagsAndSingletons();
+    TestEntityManagerQueryViews();
+    TestEntityManagerPrefabs();
+    TestEntityManagerRuntimeComponents();
+#if PROFILING_ENABLED
+    TestEntityManagerProfiling();
+#endif
+    TestEntityManagerPendingWrites();
+    TestEntityManagerDoubleBuffered();
+    TestEntityManagerCachedQueries();
+    TestEntityManagerParallelForEach();
+    TestEntityManagerParallelCommands();
+    TestEntityManagerParallelAdvance();
+    TestEntityManagerSpatialIndex();
+    TestEntityManagerCopies();
+    TestArchetypeEntityManagerMultipleComponents();
+    TestArchetypeEntityManagerChunks();
+  }
+
+  //############################################################################
+  void TestEntities(void)
+  {
+    TestEntityCreation();
+  }
+
+  //############################################################################
+  void TestSystemSchedulers(void)
+  {
+    TestSystemSchedulerDependencies();
+    TestSystemSchedulerRun();
+    TestSystemSchedulerNestedPool();
   }
 }
 
@@ -245,4 +2324,5 @@ void TestAllSystems(void)
 {
   TestEntityManagers();
   TestEntities();
+  TestSystemSchedulers();
 }
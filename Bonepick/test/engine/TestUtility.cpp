@@ -1,5 +1,6 @@
 #include "test/engine/TestUtility.h"
 
+#include <atomic>
 #include <cstring>
 #include <type_traits>
 
@@ -9,6 +10,7 @@
 #include "engine/utility/containers/External.h"
 #include "engine/utility/containers/Optional.h"
 #include "engine/utility/containers/SortedArray.h"
+#include "engine/utility/containers/SparseSet.h"
 #include "engine/utility/containers/Tuple.h"
 #include "engine/utility/containers/Variant.h"
 #include "engine/utility/DataLayout.h"
@@ -16,6 +18,7 @@
 #include "engine/utility/math/Vector.h"
 #include "engine/utility/String.h"
 #include "engine/utility/TemplateTools.h"
+#include "engine/utility/ThreadPool.h"
 #include "engine/utility/Token.h"
 
 namespace
@@ -319,6 +322,44 @@ namespace
     ASSERT(arr0.Size() == 0);
   }
 
+  //############################################################################
+  void TestSortedArrayMerge(void)
+  {
+    SortedArray<int> arr = { 2, 5, 9 };
+
+    int const values0[] = { 1, 3, 4, 10, 12 };
+    arr.Merge(values0, 5);
+
+    ASSERT(arr.Size() == 8);
+    ASSERT(arr[0] == 1);
+    ASSERT(arr[1] == 2);
+    ASSERT(arr[2] == 3);
+    ASSERT(arr[3] == 4);
+    ASSERT(arr[4] == 5);
+    ASSERT(arr[5] == 9);
+    ASSERT(arr[6] == 10);
+    ASSERT(arr[7] == 12);
+
+    int const values1[] = { 6, 5 };
+    EXPECT_ERROR(arr.Merge(values1, 2););
+  }
+
+  //############################################################################
+  void TestSortedArrayEraseIf(void)
+  {
+    SortedArray<int> arr = { 1, 2, 3, 4, 5, 6, 7 };
+
+    int const erased = arr.EraseIf([](int value) { return value % 3 != 1; });
+
+    ASSERT(erased == 4);
+    ASSERT(arr.Size() == 3);
+    ASSERT(arr[0] == 1);
+    ASSERT(arr[1] == 4);
+    ASSERT(arr[2] == 7);
+    ASSERT(arr.Contains(4));
+    ASSERT(!arr.Contains(5));
+  }
+
   //############################################################################
   void TestArrayMapSingleValue(void)
   {
@@ -467,6 +508,299 @@ namespace
     ASSERT(map.Find(1) == ref.Find(1));
   }
 
+  //############################################################################
+  void TestSparseSetEmplaceFind(void)
+  {
+    SparseSet<std::string> set;
+
+    ASSERT(set.Empty());
+
+    set.Emplace(5, "hello");
+    set.Emplace(9000, "world");
+
+    ASSERT(set.Size() == 2);
+    ASSERT(set.Contains(5));
+    ASSERT(set.Contains(9000));
+    ASSERT(!set.Contains(6));
+    ASSERT(!set.Contains(-1));
+    ASSERT(set.Find(1 << 20) == nullptr);
+    ASSERT(*set.Find(5) == "hello");
+    ASSERT(*set.Find(9000) == "world");
+    ASSERT(set.GetKey(set.GetIndex(9000)) == 9000);
+
+    EXPECT_ERROR(set.Emplace(5, "bye"););
+  }
+
+  //############################################################################
+  void TestSparseSetErase(void)
+  {
+    SparseSet<std::string> set;
+
+    set.Emplace(2, "For ");
+    set.Emplace(4, "sale: ");
+    set.Emplace(8, "baby ");
+    set.Emplace(15, "shoes");
+
+    ASSERT(set.IsSorted());
+
+    set.Erase(4);
+
+    ASSERT(set.Size() == 3);
+    ASSERT(!set.Contains(4));
+    ASSERT(*set.Find(2) == "For ");
+    ASSERT(*set.Find(8) == "baby ");
+    ASSERT(*set.Find(15) == "shoes");
+    EXPECT_ERROR(set.Erase(4););
+
+    set.Erase(15);
+    set.Erase(2);
+    set.Erase(8);
+
+    ASSERT(set.Empty());
+  }
+
+  //############################################################################
+  void TestSparseSetSort(void)
+  {
+    SparseSet<std::string> set;
+
+    set.Emplace(8, "baby ");
+    set.Emplace(2, "For ");
+    set.Emplace(22, "worn");
+    set.Emplace(4, "sale: ");
+
+    ASSERT(!set.IsSorted());
+
+    set.Sort();
+
+    ASSERT(set.IsSorted());
+    ASSERT(set.GetKey(0) == 2);
+    ASSERT(set.GetKey(1) == 4);
+    ASSERT(set.GetKey(2) == 8);
+    ASSERT(set.GetKey(3) == 22);
+    ASSERT(set.GetValue(3) == "worn");
+    ASSERT(*set.Find(4) == "sale: ");
+  }
+
+  //############################################################################
+  void TestSparseSetClear(void)
+  {
+    SparseSet<int> set;
+
+    set.Emplace(3, 1);
+    set.Emplace(1, 2);
+    set.Clear();
+
+    ASSERT(set.Empty());
+    ASSERT(set.IsSorted());
+    ASSERT(!set.Contains(3));
+    ASSERT(!set.Contains(1));
+
+    set.Emplace(1, 4);
+
+    ASSERT(set.Size() == 1);
+    ASSERT(*set.Find(1) == 4);
+    ASSERT(!set.Contains(3));
+  }
+
+  //############################################################################
+  void TestSparseSetEraseIf(void)
+  {
+    SparseSet<int> set;
+
+    for (int i = 0; i < 10; ++i)
+      set.Emplace(i * 2, i);
+
+    int const erased = set.EraseIf(
+      [](int key, int value) { return key == 4 || value > 6; });
+
+    ASSERT(erased == 4);
+    ASSERT(set.Size() == 6);
+    ASSERT(set.IsSorted());
+    ASSERT(!set.Contains(4));
+    ASSERT(!set.Contains(14));
+    ASSERT(set.GetKey(2) == 6);
+    ASSERT(*set.Find(12) == 6);
+  }
+
+  //############################################################################
+  void TestSparseSetSortMerge(void)
+  {
+    SparseSet<int> set;
+
+    for (int i = 0; i < 10; ++i)
+      set.Emplace(i * 10, i);
+
+    //Appended keys are merged into the sorted prefix, in and past it
+    set.Emplace(95, 95);
+    set.Emplace(5, 5);
+    set.Emplace(45, 45);
+
+    ASSERT(!set.IsSorted());
+
+    set.Sort();
+
+    ASSERT(set.IsSorted());
+    ASSERT(set.Size() == 13);
+
+    for (int i = 1; i < set.Size(); ++i)
+      ASSERT(set.GetKey(i - 1) < set.GetKey(i));
+
+    for (int i = 0; i < set.Size(); ++i)
+      ASSERT(set.GetIndex(set.GetKey(i)) == i);
+
+    ASSERT(set.GetKey(1) == 5);
+    ASSERT(*set.Find(45) == 45);
+    ASSERT(*set.Find(90) == 9);
+
+    //Erasing swaps into the prefix, what follows the hole is sorted again
+    set.Erase(20);
+    set.Emplace(1, 1);
+    set.Sort();
+
+    ASSERT(set.Size() == 13);
+    ASSERT(set.GetKey(0) == 0);
+    ASSERT(set.GetKey(1) == 1);
+    ASSERT(set.GetKey(12) == 95);
+    ASSERT(!set.Contains(20));
+
+    for (int i = 1; i < set.Size(); ++i)
+      ASSERT(set.GetKey(i - 1) < set.GetKey(i));
+
+    for (int i = 0; i < set.Size(); ++i)
+      ASSERT(set.GetIndex(set.GetKey(i)) == i);
+  }
+
+  //############################################################################
+  void TestSparseSetEmplaceRange(void)
+  {
+    SparseSet<int> set;
+    set.Emplace(7, -1);
+
+    //Ranges past the last key stay sorted, also across a page
+    set.EmplaceRange(4090, 20, [](int i) { return i * 2; });
+
+    ASSERT(set.Size() == 21);
+    ASSERT(set.IsSorted());
+    ASSERT(*set.Find(4090) == 0);
+    ASSERT(*set.Find(4109) == 38);
+    ASSERT(!set.Contains(4110));
+
+    for (int i = 0; i < set.Size(); ++i)
+      ASSERT(set.GetIndex(set.GetKey(i)) == i);
+
+    //A range below the last key needs a Sort()
+    set.EmplaceRange(0, 3, [](int i) { return i; });
+
+    ASSERT(!set.IsSorted());
+
+    set.Sort();
+
+    ASSERT(set.GetKey(0) == 0);
+    ASSERT(set.GetKey(3) == 7);
+    ASSERT(*set.Find(2) == 2);
+
+    set.EmplaceRange(100, 0, [](int) { return 0; });
+
+    ASSERT(set.Size() == 24);
+    ASSERT(set.IsSorted());
+
+    EXPECT_ERROR(set.EmplaceRange(4100, 1, [](int) { return 0; }););
+  }
+
+  //############################################################################
+  void TestThreadPoolWorkers(void)
+  {
+    ThreadPool pool(4);
+    std::atomic<int> count = 0;
+
+    ASSERT(pool.WorkerCount() == 4);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+      pool.Submit(
+        [&count](void)
+        {
+          ++count;
+        });
+    }
+
+    pool.Wait();
+
+    ASSERT(count == 1000);
+  }
+
+  //############################################################################
+  void TestThreadPoolInline(void)
+  {
+    ThreadPool pool(0);
+    Array<int> order;
+
+    pool.Submit(
+      [&pool, &order](void)
+      {
+        order.EmplaceBack(0);
+
+        pool.Submit(
+          [&order](void)
+          {
+            order.EmplaceBack(2);
+          });
+      });
+
+    pool.Submit(
+      [&order](void)
+      {
+        order.EmplaceBack(1);
+      });
+
+    ASSERT(order.Empty());
+
+    pool.Wait();
+
+    ASSERT(order == Array<int>({ 0, 1, 2 }));
+  }
+
+  //############################################################################
+  void TestThreadPoolErrors(void)
+  {
+    ThreadPool pool(2);
+    std::atomic<int> count = 0;
+
+    //A failing job reaches Wait() and the other jobs still finish
+    for (int i = 0; i < 100; ++i)
+    {
+      pool.Submit(
+        [&count, i](void)
+        {
+          ASSERT(i != 50);
+          ++count;
+        });
+    }
+
+    EXPECT_ERROR(pool.Wait(););
+    ASSERT(count == 99);
+
+    //Waiting from a job would wait on the job itself
+    pool.Submit(
+      [&pool](void)
+      {
+        pool.Wait();
+      });
+
+    EXPECT_ERROR(pool.Wait(););
+
+    pool.Submit(
+      [&count](void)
+      {
+        ++count;
+      });
+
+    pool.Wait();
+
+    ASSERT(count == 100);
+  }
+
   //############################################################################
   void TestDataLayoutSingleEntry(void)
   {
@@ -1381,6 +1715,8 @@ namespace
     TestSortedArrayContains();
     TestSortedArrayConstAccess();
     TestSortedArrayAssignment();
+    TestSortedArrayMerge();
+    TestSortedArrayEraseIf();
   }
 
   //############################################################################
@@ -1395,6 +1731,26 @@ namespace
     TestArrayMapConstAccess();
   }
 
+  //############################################################################
+  void TestSparseSets(void)
+  {
+    TestSparseSetEmplaceFind();
+    TestSparseSetErase();
+    TestSparseSetSort();
+    TestSparseSetClear();
+    TestSparseSetEraseIf();
+    TestSparseSetSortMerge();
+    TestSparseSetEmplaceRange();
+  }
+
+  //############################################################################
+  void TestThreadPools(void)
+  {
+    TestThreadPoolWorkers();
+    TestThreadPoolInline();
+    TestThreadPoolErrors();
+  }
+
   //############################################################################
   void TestDataLayouts(void)
   {
@@ -1487,6 +1843,8 @@ void TestAllUtilities(void)
 {
   TestTokens();
   TestSortedArrays();
+  TestSparseSets();
+  TestThreadPools();
   TestDataLayouts();
   TestStrings();
   TestDumbVariants();